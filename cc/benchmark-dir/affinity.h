@@ -0,0 +1,137 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT license.
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#define NOMINMAX
+#define _WINSOCKAPI_
+#include <Windows.h>
+#else
+#include <sched.h>
+#endif
+#ifdef FASTER_NUMA
+#include <numa.h>
+#endif
+
+#include "options.h"
+
+namespace FASTER {
+namespace benchmark {
+
+/// Pins worker threads and sets their memory policy, per --affinity and --numa. NUMA policies
+/// need libnuma (FASTER_NUMA); without it, every CPU is taken to be on one node.
+class ThreadPlacement {
+public:
+    ThreadPlacement(Affinity affinity, NumaPolicy numa)
+            : affinity_{affinity}, numa_{numa} {
+        std::vector<std::vector<uint32_t>> node_cpus;
+#ifdef _WIN32
+        SYSTEM_INFO info;
+        ::GetSystemInfo(&info);
+        node_cpus.resize(1);
+        for (uint32_t cpu = 0; cpu < info.dwNumberOfProcessors && cpu < 64; ++cpu) {
+            node_cpus[0].push_back(cpu);
+        }
+#else
+        cpu_set_t allowed;
+        CPU_ZERO(&allowed);
+        ::sched_getaffinity(0, sizeof(allowed), &allowed);
+#ifdef FASTER_NUMA
+        if (::numa_available() != -1) {
+            node_cpus.resize(::numa_max_node() + 1);
+        }
+#endif
+        if (node_cpus.empty()) {
+            node_cpus.resize(1);
+        }
+        for (uint32_t cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+            if (!CPU_ISSET(cpu, &allowed)) {
+                continue;
+            }
+            uint32_t node = 0;
+#ifdef FASTER_NUMA
+            if (node_cpus.size() > 1) {
+                int cpu_node = ::numa_node_of_cpu(cpu);
+                node = cpu_node < 0 ? 0 : static_cast<uint32_t>(cpu_node);
+            }
+#endif
+            node_cpus[node].push_back(cpu);
+        }
+#endif
+        for (const auto &cpus : node_cpus) {
+            if (!cpus.empty()) {
+                node_cpus_.push_back(cpus);
+                compact_.insert(compact_.end(), cpus.begin(), cpus.end());
+            }
+        }
+        // Scatter: the first CPU of each node, then the second of each, and so on.
+        for (uint32_t idx = 0; scatter_.size() < compact_.size(); ++idx) {
+            for (const auto &cpus : node_cpus_) {
+                if (idx < cpus.size()) {
+                    scatter_.push_back(cpus[idx]);
+                }
+            }
+        }
+    }
+
+    /// Whether this build can apply "numa".
+    static bool Supports(NumaPolicy numa) {
+#ifdef FASTER_NUMA
+        return numa == NumaPolicy::Default || ::numa_available() != -1;
+#else
+        return numa == NumaPolicy::Default;
+#endif
+    }
+
+    /// Called on the main thread, before the store is created (so that its memory follows the
+    /// policy, too).
+    void PlaceMainThread() const {
+#ifdef FASTER_NUMA
+        if (numa_ == NumaPolicy::Interleave) {
+            ::numa_set_interleave_mask(::numa_all_nodes_ptr);
+        } else if (numa_ == NumaPolicy::Local) {
+            ::numa_set_localalloc();
+        }
+#endif
+    }
+
+    /// Called on worker thread "thread_idx", before it starts its session.
+    void PlaceWorker(uint32_t thread_idx) const {
+        if (affinity_ != Affinity::None && !compact_.empty()) {
+            const std::vector<uint32_t> &order = affinity_ == Affinity::Compact ? compact_ : scatter_;
+            uint32_t cpu = order[thread_idx % order.size()];
+#ifdef _WIN32
+            ::SetThreadAffinityMask(::GetCurrentThread(), DWORD_PTR{1} << cpu);
+#else
+            cpu_set_t mask;
+            CPU_ZERO(&mask);
+            CPU_SET(cpu, &mask);
+            ::sched_setaffinity(0, sizeof(mask), &mask);
+#endif
+        }
+        PlaceMainThread();
+    }
+
+    uint32_t num_nodes() const {
+        return static_cast<uint32_t>(node_cpus_.size());
+    }
+
+    uint32_t num_cpus() const {
+        return static_cast<uint32_t>(compact_.size());
+    }
+
+private:
+    Affinity affinity_;
+    NumaPolicy numa_;
+    std::vector<std::vector<uint32_t>> node_cpus_;
+    std::vector<uint32_t> compact_;
+    std::vector<uint32_t> scatter_;
+};
+
+}
+} // namespace FASTER::benchmark
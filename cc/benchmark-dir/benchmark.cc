@@ -1,636 +1,827 @@
 // Copyright (c) Microsoft Corporation. All rights reserved.
 // Licensed under the MIT license.
 
+#include <algorithm>
 #include <atomic>
+#include <chrono>
 #include <cinttypes>
 #include <cstdint>
 #include <cstdio>
-#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <iostream>
+#include <memory>
 #include <random>
 #include <string>
+#include <thread>
+#include <vector>
+#include <experimental/filesystem>
 
-#include "file.h"
-
-#include "core/auto_ptr.h"
+#include "core/checkpoint_scheduler.h"
 #include "core/faster.h"
+#include "core/stats.h"
+#include "device/file_system_disk.h"
 #include "device/null_disk.h"
+#include "device/serializablecontext.h"
+
+#include "affinity.h"
+#include "options.h"
+#include "perf_counters.h"
+#include "report.h"
+#include "trace.h"
+#include "workload.h"
 
-using namespace std::chrono_literals;
+using namespace FASTER::api;
 using namespace FASTER::core;
+using namespace FASTER::benchmark;
 
-/// Basic YCSB benchmark.
+/// YCSB-style benchmark: loads --records keys, then runs the configured operation mix on
+/// --threads threads, sampling throughput as it goes. See BenchmarkUsage() for the options.
 
-enum class Op : uint8_t {
-  Insert = 0,
-  Read = 1,
-  Upsert = 2,
-  Scan = 3,
-  ReadModifyWrite = 4,
-};
-
-enum class Workload {
-  A_50_50 = 0,
-  RMW_100 = 1,
-};
-
-static constexpr uint64_t kInitCount = 250000000;
-static constexpr uint64_t kTxnCount = 1000000000;
-static constexpr uint64_t kChunkSize = 3200;
+static constexpr uint64_t kLoadChunkSize = 3200;
 static constexpr uint64_t kRefreshInterval = 64;
 static constexpr uint64_t kCompletePendingInterval = 1600;
+/// An open-loop worker that is ahead of schedule completes pending operations every this many
+/// checks of the clock.
+static constexpr uint32_t kIdleRefreshSpins = 1024;
 
-static_assert(kInitCount % kChunkSize == 0, "kInitCount % kChunkSize != 0");
-static_assert(kTxnCount % kChunkSize == 0, "kTxnCount % kChunkSize != 0");
 static_assert(kCompletePendingInterval % kRefreshInterval == 0,
               "kCompletePendingInterval % kRefreshInterval != 0");
 
-static constexpr uint64_t kNanosPerSecond = 1000000000;
-
-static constexpr uint64_t kMaxKey = 268435456;
-static constexpr uint64_t kRunSeconds = 360;
-static constexpr uint64_t kCheckpointSeconds = 30;
-
-aligned_unique_ptr_t<uint64_t> init_keys_;
-aligned_unique_ptr_t<uint64_t> txn_keys_;
-std::atomic<uint64_t> idx_{ 0 };
-std::atomic<bool> done_{ false };
-std::atomic<uint64_t> total_duration_{ 0 };
-std::atomic<uint64_t> total_reads_done_{ 0 };
-std::atomic<uint64_t> total_writes_done_{ 0 };
-
-class ReadContext;
-class UpsertContext;
-class RmwContext;
-
-/// This benchmark stores 8-byte keys in key-value store.
-class Key {
- public:
-  Key(uint64_t key)
-    : key_{ key } {
-  }
-
-  /// Methods and operators required by the (implicit) interface:
-  inline static constexpr uint32_t size() {
-    return static_cast<uint32_t>(sizeof(Key));
-  }
-  inline KeyHash GetHash() const {
-    return KeyHash{ Utility::GetHashCode(key_) };
-  }
-
-  /// Comparison operators.
-  inline bool operator==(const Key& other) const {
-    return key_ == other.key_;
-  }
-  inline bool operator!=(const Key& other) const {
-    return key_ != other.key_;
-  }
-
- private:
-  uint64_t key_;
-};
+/// A worker thread's counters, on their own cache lines. Only "ops" is read while the thread
+/// runs (by the throughput sampler); the rest is summed once the thread is done.
+struct alignas(64) WorkerCounters {
+    WorkerCounters()
+            : ops{0} {
+    }
 
-/// This benchmark stores an 8-byte value in the key-value store.
-class Value {
- public:
-  Value()
-    : value_{ 0 } {
-  }
-
-  Value(const Value& other)
-    : value_{ other.value_ } {
-  }
-
-  Value(uint64_t value)
-    : value_{ value } {
-  }
-
-  inline static constexpr uint32_t size() {
-    return static_cast<uint32_t>(sizeof(Value));
-  }
-
-  friend class ReadContext;
-  friend class UpsertContext;
-  friend class RmwContext;
-
- private:
-  union {
-    uint64_t value_;
-    std::atomic<uint64_t> atomic_value_;
-  };
-};
+    inline void Increment() {
+        ops.store(ops.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    }
 
-/// Class passed to store_t::Read().
-class ReadContext : public IAsyncContext {
- public:
-  typedef Key key_t;
-  typedef Value value_t;
-
-  ReadContext(uint64_t key)
-    : key_{ key } {
-  }
-
-  /// Copy (and deep-copy) constructor.
-  ReadContext(const ReadContext& other)
-    : key_{ other.key_ } {
-  }
-
-  /// The implicit and explicit interfaces require a key() accessor.
-  inline const Key& key() const {
-    return key_;
-  }
-
-  // For this benchmark, we don't copy out, so these are no-ops.
-  inline void Get(const value_t& value) { }
-  inline void GetAtomic(const value_t& value) { }
-
- protected:
-  /// The explicit interface requires a DeepCopy_Internal() implementation.
-  Status DeepCopy_Internal(IAsyncContext*& context_copy) {
-    return IAsyncContext::DeepCopy_Internal(*this, context_copy);
-  }
-
- private:
-  Key key_;
+    std::atomic<uint64_t> ops;
+    OperationCounts counts;
+    /// Open-loop latencies (in TscClock ticks), from when each operation was due.
+    LatencyHistogram latency;
+    /// Hardware events during the thread's share of the phase (with --perf-counters).
+    PerfCounts perf;
 };
 
-/// Class passed to store_t::Upsert().
-class UpsertContext : public IAsyncContext {
- public:
-  typedef Key key_t;
-  typedef Value value_t;
-
-  UpsertContext(uint64_t key, uint64_t input)
-    : key_{ key }
-    , input_{ input } {
-  }
-
-  /// Copy (and deep-copy) constructor.
-  UpsertContext(const UpsertContext& other)
-    : key_{ other.key_ }
-    , input_{ other.input_ } {
-  }
-
-  /// The implicit and explicit interfaces require a key() accessor.
-  inline const Key& key() const {
-    return key_;
-  }
-  inline static constexpr uint32_t value_size() {
-    return sizeof(value_t);
-  }
-
-  /// Non-atomic and atomic Put() methods.
-  inline void Put(value_t& value) {
-    value.value_ = input_;
-  }
-  inline bool PutAtomic(value_t& value) {
-    value.atomic_value_.store(input_);
-    return true;
-  }
-
- protected:
-  /// The explicit interface requires a DeepCopy_Internal() implementation.
-  Status DeepCopy_Internal(IAsyncContext*& context_copy) {
-    return IAsyncContext::DeepCopy_Internal(*this, context_copy);
-  }
-
- private:
-  Key key_;
-  uint64_t input_;
-};
+/// The running worker's counters, for the callbacks of operations that went pending (which run
+/// on the same thread, from CompletePending()).
+static thread_local WorkerCounters *tls_counters = nullptr;
+
+/// Keys are formatted into a buffer that the operation's context points to (it does not copy
+/// the key's bytes). If the operation goes pending, its deep-copied context still points to the
+/// buffer; so the buffer goes with it, to be freed by its callback, and the thread switches to a
+/// fresh one.
+///
+/// In front of the key's bytes, the buffer keeps the time (in TscClock ticks) the operation was
+/// due, in an open-loop run, so that the callback of an operation that went pending can time it.
+class KeyBuffer {
+public:
+    KeyBuffer(uint32_t key_size)
+            : key_size_{key_size}, bytes_{Allocate(key_size)} {
+    }
+
+    ~KeyBuffer() {
+        Free(bytes_);
+    }
+
+    KeyBuffer(const KeyBuffer &other) = delete;
+
+    inline Key Format(uint64_t key) {
+        FormatKey(key, bytes_, key_size_);
+        return Key{bytes_, key_size_};
+    }
 
-/// Class passed to store_t::RMW().
-class RmwContext : public IAsyncContext {
- public:
-  typedef Key key_t;
-  typedef Value value_t;
-
-  RmwContext(uint64_t key, uint64_t incr)
-    : key_{ key }
-    , incr_{ incr } {
-  }
-
-  /// Copy (and deep-copy) constructor.
-  RmwContext(const RmwContext& other)
-    : key_{ other.key_ }
-    , incr_{ other.incr_ } {
-  }
-
-  /// The implicit and explicit interfaces require a key() accessor.
-  const Key& key() const {
-    return key_;
-  }
-  inline static constexpr uint32_t value_size() {
-    return sizeof(value_t);
-  }
-  inline static constexpr uint32_t value_size(const value_t& old_value) {
-    return sizeof(value_t);
-  }
-
-  /// Initial, non-atomic, and atomic RMW methods.
-  inline void RmwInitial(value_t& value) {
-    value.value_ = incr_;
-  }
-  inline void RmwCopy(const value_t& old_value, value_t& value) {
-    value.value_ = old_value.value_ + incr_;
-  }
-  inline bool RmwAtomic(value_t& value) {
-    value.atomic_value_.fetch_add(incr_);
-    return true;
-  }
-
- protected:
-  /// The explicit interface requires a DeepCopy_Internal() implementation.
-  Status DeepCopy_Internal(IAsyncContext*& context_copy) {
-    return IAsyncContext::DeepCopy_Internal(*this, context_copy);
-  }
-
- private:
-  Key key_;
-  uint64_t incr_;
+    /// For the next operation; 0 (the default) if it isn't timed.
+    inline void set_due(uint64_t due) {
+        std::memcpy(bytes_ - kHeaderSize, &due, sizeof(due));
+    }
+
+    /// The last operation went pending and took the buffer.
+    inline void HandOff() {
+        bytes_ = Allocate(key_size_);
+    }
+
+    /// Of the buffer a (pending) operation's key points to.
+    static inline uint64_t Due(const uint8_t *key_bytes) {
+        uint64_t due;
+        std::memcpy(&due, key_bytes - kHeaderSize, sizeof(due));
+        return due;
+    }
+
+    static inline void Free(const uint8_t *key_bytes) {
+        delete[] (key_bytes - kHeaderSize);
+    }
+
+private:
+    static constexpr uint32_t kHeaderSize = sizeof(uint64_t);
+
+    static inline uint8_t *Allocate(uint32_t key_size) {
+        auto *buffer = new uint8_t[kHeaderSize + key_size]();
+        return buffer + kHeaderSize;
+    }
+
+    uint32_t key_size_;
+    uint8_t *bytes_;
 };
 
-/// Key-value store, specialized to our key and value types.
-#ifdef _WIN32
-typedef FASTER::environment::ThreadPoolIoHandler handler_t;
-#else
-typedef FASTER::environment::QueueIoHandler handler_t;
-#endif
-typedef FASTER::device::FileSystemDisk<handler_t, 1073741824ull> disk_t;
-using store_t = FasterKv<Key, Value, disk_t>;
-
-inline Op ycsb_a_50_50(std::mt19937& rng) {
-  if(rng() % 100 < 50) {
-    return Op::Read;
-  } else {
-    return Op::Upsert;
-  }
+static inline void CountRead(Status result) {
+    if (result == Status::Ok) {
+        ++tls_counters->counts.found;
+    } else if (result == Status::NotFound) {
+        ++tls_counters->counts.not_found;
+    }
 }
 
-inline Op ycsb_rmw_100(std::mt19937& rng) {
-  return Op::ReadModifyWrite;
+/// Called as an operation that went pending completes: times it (if it was due at a set time),
+/// and frees its key buffer.
+static inline void CompletePendingKey(const uint8_t *key_bytes) {
+    uint64_t due = KeyBuffer::Due(key_bytes);
+    if (due != 0) {
+        uint64_t now = TscClock::Now();
+        tls_counters->latency.Record(now > due ? now - due : 0);
+    }
+    KeyBuffer::Free(key_bytes);
 }
 
-/// Affinitize to hardware threads on the same core first, before
-/// moving on to the next core.
-void SetThreadAffinity(size_t core) {
-
-  // For now, assume 36 cores. (Set this correctly for your test system.)
-  constexpr size_t kCoreCount = 36;
-#ifdef _WIN32
-  HANDLE thread_handle = ::GetCurrentThread();
-  GROUP_AFFINITY group;
-  group.Group = WORD(core / kCoreCount);
-  group.Mask = KAFFINITY(0x1llu << (core - kCoreCount * group.Group));
-  ::SetThreadGroupAffinity(thread_handle, &group, nullptr);
-#else
-  // On our 28-core test system, we see CPU 0, Core 0 assigned to 0, 28;
-  //                                    CPU 1, Core 0 assigned to 1, 29; etc.
-  cpu_set_t mask;
-  CPU_ZERO(&mask);
-#ifdef NUMA
-  switch(core % 4) {
-  case 0:
-    // 0 |-> 0
-    // 4 |-> 2
-    // 8 |-> 4
-    core = core / 2;
-    break;
-  case 1:
-    // 1 |-> 28
-    // 5 |-> 30
-    // 9 |-> 32
-    core = kCoreCount + (core - 1) / 2;
-    break;
-  case 2:
-    // 2  |-> 1
-    // 6  |-> 3
-    // 10 |-> 5
-    core = core / 2;
-    break;
-  case 3:
-    // 3  |-> 29
-    // 7  |-> 31
-    // 11 |-> 33
-    core = kCoreCount + (core - 1) / 2;
-    break;
-  }
-#else
-  switch(core % 2) {
-  case 0:
-    // 0 |-> 0
-    // 2 |-> 2
-    // 4 |-> 4
-    core = core;
-    break;
-  case 1:
-    // 1 |-> 28
-    // 3 |-> 30
-    // 5 |-> 32
-    core = (core - 1) + kCoreCount;
-    break;
-  }
-#endif
-  CPU_SET(core, &mask);
+static void ReadCallback(IAsyncContext *ctxt, Status result) {
+    CallbackContext<ReadContext> context{ctxt};
+    CountRead(result);
+    CompletePendingKey(context->key().get());
+}
 
-  ::sched_setaffinity(0, sizeof(mask), &mask);
-#endif
+static void UpsertCallback(IAsyncContext *ctxt, Status result) {
+    CallbackContext<UpsertContext> context{ctxt};
+    CompletePendingKey(context->key().get());
 }
 
-void load_files(const std::string& load_filename, const std::string& run_filename) {
-  constexpr size_t kFileChunkSize = 131072;
+static void DeleteCallback(IAsyncContext *ctxt, Status result) {
+    CallbackContext<DeleteContext> context{ctxt};
+    CompletePendingKey(context->key().get());
+}
 
-  auto chunk_guard = alloc_aligned<uint64_t>(512, kFileChunkSize);
-  uint64_t* chunk = chunk_guard.get();
+/// Called for each key a scan reads right away. (Those keys point into the ordered index, which
+/// owns them.)
+static void ScanVisitor(const ReadContext &context, Status result) {
+    if (result == Status::Ok) {
+        ++tls_counters->counts.scanned;
+    }
+}
 
-  FASTER::benchmark::File init_file{ load_filename };
+/// Called for each key a scan read that went pending.
+static void ScanCallback(IAsyncContext *ctxt, Status result) {
+    CallbackContext<ReadContext> context{ctxt};
+    ScanVisitor(*context.get(), result);
+}
 
-  printf("loading keys from %s into memory...\n", load_filename.c_str());
+/// Loads and runs the benchmark against a store.
+template<class S>
+class BenchmarkRunner {
+public:
+    typedef S store_t;
+    typedef CheckpointScheduler<store_t> scheduler_t;
+    typedef std::chrono::steady_clock clock_t;
+
+    /// "load_trace" and "run_trace" (if not null) must outlive the runner.
+    BenchmarkRunner(store_t &store, const BenchmarkOptions &options, const ThreadPlacement &placement,
+                    BenchmarkReport &report, const TraceFile *load_trace, const TraceFile *run_trace)
+            : store_{store}, options_{options}, placement_{placement}, report_{report},
+              load_trace_{load_trace}, run_trace_{run_trace}, value_size_{options.value_size},
+              counters_(options.num_threads), chooser_{options.mix}, pregenerated_(options.num_threads),
+              num_records_{options.num_records},
+              done_{false}, num_finished_{0} {
+        if (IsZipfian(options.distribution)) {
+            zipfian_.reset(new ZipfianGenerator{options.num_records, options.theta});
+        }
+        for (const TraceFile *trace : {load_trace, run_trace}) {
+            if (trace) {
+                value_size_ = std::max(value_size_, trace->max_value_size());
+            }
+        }
+    }
 
-  init_keys_ = alloc_aligned<uint64_t>(64, kInitCount * sizeof(uint64_t));
-  uint64_t count = 0;
+    /// Inserts keys [0, --records), or replays the load trace.
+    PhaseResult Load() {
+        if (load_trace_) {
+            return Replay("load", *load_trace_);
+        }
+        std::atomic<uint64_t> cursor{0};
+        return RunPhase("load", false, [&](uint32_t thread_idx) {
+            WorkerBuffers buffers{options_.key_size, value_size_};
+            WorkerCounters &counters = counters_[thread_idx];
+            uint64_t serial_num = 0;
+            for (uint64_t chunk = cursor.fetch_add(kLoadChunkSize); chunk < options_.num_records;
+                 chunk = cursor.fetch_add(kLoadChunkSize)) {
+                uint64_t chunk_end = std::min(chunk + kLoadChunkSize, options_.num_records);
+                for (uint64_t key = chunk; key < chunk_end; ++key) {
+                    Upsert(buffers, key, options_.value_size, ++serial_num);
+                    ++counters.counts.issued[static_cast<uint8_t>(Op::Insert)];
+                    counters.Increment();
+                    Tick(serial_num);
+                }
+            }
+        });
+    }
 
-  uint64_t offset = 0;
-  while(true) {
-    uint64_t size = init_file.Read(chunk, kFileChunkSize, offset);
-    for(uint64_t idx = 0; idx < size / 8; ++idx) {
-      init_keys_.get()[count] = chunk[idx];
-      ++count;
+    /// Runs the operation mix, for --ops operations or --duration seconds; or replays the trace.
+    PhaseResult Run() {
+        StartCheckpoints();
+        if (run_trace_) {
+            return Replay("run", *run_trace_);
+        }
+        if (options_.pregenerate > 0 && pregenerated_[0].empty()) {
+            Pregenerate();
+        }
+        return RunWorkload("run", 0);
     }
-    if(size == kFileChunkSize) {
-      offset += kFileChunkSize;
-    } else {
-      break;
+
+    /// Runs the operation mix open-loop, at "rate" ops/s in total, for --ops operations or
+    /// --duration seconds. Each operation is due at a set time (per --arrivals), whether or not
+    /// the previous one has returned, and is timed from then; so a stall shows up in the latencies
+    /// of all the operations that fell due during it, not just the one that was stuck.
+    PhaseResult RunOpenLoop(uint64_t rate, OpenLoopSummary &summary) {
+        StartCheckpoints();
+        if (options_.pregenerate > 0 && pregenerated_[0].empty()) {
+            Pregenerate();
+        }
+        PhaseResult result = RunWorkload("run@" + std::to_string(rate), rate);
+        LatencyHistogram latency;
+        for (const WorkerCounters &counters : counters_) {
+            latency.Merge(counters.latency);
+        }
+        summary.phase = result.name;
+        summary.target_ops_per_s = rate;
+        summary.ops_per_s = result.OpsPerSecond();
+        summary.count = latency.count();
+        summary.p50_ns = TscClock::ToNanoseconds(latency.ValueAtPercentile(50));
+        summary.p99_ns = TscClock::ToNanoseconds(latency.ValueAtPercentile(99));
+        summary.p999_ns = TscClock::ToNanoseconds(latency.ValueAtPercentile(99.9));
+        summary.max_ns = TscClock::ToNanoseconds(latency.max());
+        report_.AddOpenLoop(summary);
+        return result;
     }
-  }
-  if(kInitCount != count) {
-    printf("Init file load fail!\n");
-    exit(1);
-  }
 
-  printf("loaded %" PRIu64 " keys.\n", count);
+private:
+    void StartCheckpoints() {
+        if (options_.checkpoint_interval_s > 0) {
+            CheckpointPolicy policy;
+            policy.interval = std::chrono::seconds{options_.checkpoint_interval_s};
+            scheduler_.reset(new scheduler_t{store_, policy});
+        }
+    }
 
-  FASTER::benchmark::File txn_file{ run_filename };
+    /// Runs the operation mix closed-loop (if "rate" is 0) or open-loop.
+    PhaseResult RunWorkload(const std::string &name, uint64_t rate) {
+        return RunPhase(name, options_.num_ops == 0, [&](uint32_t thread_idx) {
+            WorkerBuffers buffers{options_.key_size, value_size_};
+            WorkerCounters &counters = counters_[thread_idx];
+            KeyChooser key_chooser = MakeKeyChooser();
+            std::mt19937_64 rng{std::random_device{}() + thread_idx};
+            const std::vector<TraceRecord> &pregenerated = pregenerated_[thread_idx];
+            uint64_t next_pregenerated = 0;
+            ArrivalSchedule schedule{rate, options_.num_threads, thread_idx, options_.arrivals};
+
+            uint64_t quota = options_.num_ops / options_.num_threads +
+                             (thread_idx < options_.num_ops % options_.num_threads ? 1 : 0);
+            uint64_t serial_num = 0;
+            TraceRecord record;
+            for (uint64_t idx = 0; options_.num_ops > 0 ? idx < quota : !done_.load(std::memory_order_relaxed);
+                 ++idx) {
+                if (pregenerated.empty()) {
+                    Generate(key_chooser, rng, record);
+                } else {
+                    record = pregenerated[next_pregenerated];
+                    if (++next_pregenerated == pregenerated.size()) {
+                        next_pregenerated = 0;
+                    }
+                }
+                uint64_t due = 0;
+                if (rate > 0) {
+                    due = schedule.Next(rng);
+                    if (!WaitUntil(due)) {
+                        break;
+                    }
+                    buffers.key.set_due(due);
+                }
+                auto op = static_cast<Op>(record.op);
+                uint64_t key = op == Op::Insert ? num_records_.fetch_add(1) :
+                               key_chooser.Resolve(record.key, num_records_.load(std::memory_order_relaxed));
+                uint64_t pending = counters.counts.pending;
+                Issue(buffers, op, key, record.length, serial_num);
+                if (due != 0 && counters.counts.pending == pending) {
+                    // (Operations that went pending are timed by their callbacks.)
+                    uint64_t now = TscClock::Now();
+                    counters.latency.Record(now > due ? now - due : 0);
+                }
+                ++counters.counts.issued[record.op];
+                counters.Increment();
+                Tick(serial_num);
+            }
+        });
+    }
 
-  printf("loading txns from %s into memory...\n", run_filename.c_str());
+    /// When a worker's open-loop operations are due, in TscClock ticks: each worker issues its
+    /// share of the rate, starting now. Fixed arrivals are staggered across the workers.
+    class ArrivalSchedule {
+    public:
+        ArrivalSchedule(uint64_t rate, uint32_t num_threads, uint32_t thread_idx, Arrivals arrivals)
+                : arrivals_{arrivals}, gap_{1.0} {
+            interval_ticks_ = rate == 0 ? 0 :
+                              1e9 * num_threads / static_cast<double>(rate) / TscClock::NanosecondsPerTick();
+            next_ = static_cast<double>(TscClock::Now()) + interval_ticks_ * thread_idx / num_threads;
+        }
 
-  txn_keys_ = alloc_aligned<uint64_t>(64, kTxnCount * sizeof(uint64_t));
+        template<class R>
+        inline uint64_t Next(R &rng) {
+            auto due = static_cast<uint64_t>(next_);
+            next_ += arrivals_ == Arrivals::Poisson ? gap_(rng) * interval_ticks_ : interval_ticks_;
+            return due;
+        }
 
-  count = 0;
-  offset = 0;
+    private:
+        Arrivals arrivals_;
+        std::exponential_distribution<double> gap_;
+        double interval_ticks_;
+        double next_;
+    };
 
-  while(true) {
-    uint64_t size = txn_file.Read(chunk, kFileChunkSize, offset);
-    for(uint64_t idx = 0; idx < size / 8; ++idx) {
-      txn_keys_.get()[count] = chunk[idx];
-      ++count;
+    /// Spins until "due", completing pending operations now and then (so that they, and any
+    /// checkpoint, don't wait on this thread), and yielding (in case there are more threads than
+    /// CPUs); returns false if the phase ends first.
+    inline bool WaitUntil(uint64_t due) {
+        for (uint32_t spins = 1; TscClock::Now() < due; ++spins) {
+            if (spins % kIdleRefreshSpins == 0) {
+                if (done_.load(std::memory_order_relaxed)) {
+                    return false;
+                }
+                store_.CompletePending(false);
+                std::this_thread::yield();
+            }
+        }
+        return true;
     }
-    if(size == kFileChunkSize) {
-      offset += kFileChunkSize;
-    } else {
-      break;
-    }
-  }
-  if(kTxnCount != count) {
-    printf("Txn file load fail!\n");
-    exit(1);
-  }
-  printf("loaded %" PRIu64 " txns.\n", count);
-}
 
-void thread_setup_store(store_t* store, size_t thread_idx) {
-  auto callback = [](IAsyncContext* ctxt, Status result) {
-    assert(result == Status::Ok);
-  };
+private:
+    /// A worker thread's key and value buffers.
+    struct WorkerBuffers {
+        WorkerBuffers(uint32_t key_size, uint32_t value_size)
+                : key{key_size}, end_key{key_size}, value(value_size, 'v') {
+        }
 
-  SetThreadAffinity(thread_idx);
+        KeyBuffer key;
+        KeyBuffer end_key;
+        std::vector<uint8_t> value;
+    };
 
-  Guid guid = store->StartSession();
+    inline KeyChooser MakeKeyChooser() const {
+        return KeyChooser{options_.distribution, zipfian_.get(), options_.hot_set_fraction, options_.hot_op_fraction};
+    }
 
-  uint64_t value = 42;
-  for(uint64_t chunk_idx = idx_.fetch_add(kChunkSize); chunk_idx < kInitCount;
-      chunk_idx = idx_.fetch_add(kChunkSize)) {
-    for(uint64_t idx = chunk_idx; idx < chunk_idx + kChunkSize; ++idx) {
-      if(idx % kRefreshInterval == 0) {
-        store->Refresh();
-        if(idx % kCompletePendingInterval == 0) {
-          store->CompletePending(false);
+    /// Picks an operation: its Op, its key's KeyChooser::Draw() (to be resolved when it is
+    /// issued), and the value size or scan length.
+    template<class R>
+    inline void Generate(KeyChooser &key_chooser, R &rng, TraceRecord &record) const {
+        Op op = chooser_.Next(rng);
+        record.op = static_cast<uint8_t>(op);
+        record.key = op == Op::Insert ? 0 : key_chooser.Draw(rng);
+        if (op == Op::Scan) {
+            record.length = 1 + static_cast<uint32_t>(rng() % options_.max_scan_length);
+        } else {
+            record.length = options_.value_size;
         }
-      }
+    }
 
-      UpsertContext context{ init_keys_.get()[idx], value };
-      store->Upsert(context, callback, 1);
+    /// Fills each worker's --pregenerate buffer, on (and so, with --numa=local, in memory local
+    /// to) the CPU that the worker will run on, all in parallel.
+    void Pregenerate() {
+        auto start = clock_t::now();
+        std::deque<std::thread> threads;
+        for (uint32_t thread_idx = 0; thread_idx < options_.num_threads; ++thread_idx) {
+            threads.emplace_back([this, thread_idx]() {
+                placement_.PlaceWorker(thread_idx);
+                KeyChooser key_chooser = MakeKeyChooser();
+                std::mt19937_64 rng{std::random_device{}() + thread_idx};
+                std::vector<TraceRecord> &pregenerated = pregenerated_[thread_idx];
+                pregenerated.resize(options_.pregenerate);
+                for (TraceRecord &record : pregenerated) {
+                    Generate(key_chooser, rng, record);
+                }
+            });
+        }
+        for (auto &thread : threads) {
+            thread.join();
+        }
+        std::printf("generated %" PRIu64 " operations per thread in %.2f s\n", options_.pregenerate,
+                    std::chrono::duration<double>(clock_t::now() - start).count());
     }
-  }
 
-  store->CompletePending(true);
-  store->StopSession();
-}
+    /// Replays "trace" once, from all the worker threads, which claim its records in batches.
+    PhaseResult Replay(const std::string &name, const TraceFile &trace) {
+        TraceCursor cursor{trace};
+        return RunPhase(name, false, [&](uint32_t thread_idx) {
+            WorkerBuffers buffers{options_.key_size, value_size_};
+            WorkerCounters &counters = counters_[thread_idx];
+            uint64_t serial_num = 0;
+            uint64_t begin, end;
+            while (cursor.Next(begin, end) && !done_.load(std::memory_order_relaxed)) {
+                for (uint64_t idx = begin; idx < end; ++idx) {
+                    const TraceRecord &record = trace.record(idx);
+                    if (record.op >= kNumOps) {
+                        continue;
+                    }
+                    Issue(buffers, static_cast<Op>(record.op), record.key, record.length, serial_num);
+                    ++counters.counts.issued[record.op];
+                    counters.Increment();
+                    Tick(serial_num);
+                }
+            }
+        });
+    }
 
-void setup_store(store_t* store, size_t num_threads) {
-  idx_ = 0;
-  std::deque<std::thread> threads;
-  for(size_t thread_idx = 0; thread_idx < num_threads; ++thread_idx) {
-    threads.emplace_back(&thread_setup_store, store, thread_idx);
-  }
-  for(auto& thread : threads) {
-    thread.join();
-  }
+    /// Issues one operation. "length" is the value size of an insert or update, or the number of
+    /// keys a scan covers. Advances "serial_num" (by two, for a read-modify-write).
+    inline void Issue(WorkerBuffers &buffers, Op op, uint64_t key, uint32_t length, uint64_t &serial_num) {
+        ++serial_num;
+        switch (op) {
+            case Op::Read:
+                Read(buffers, key, serial_num);
+                break;
+            case Op::Update:
+            case Op::Insert:
+                Upsert(buffers, key, length, serial_num);
+                break;
+            case Op::ReadModifyWrite: {
+                ReadContext context{buffers.key.Format(key)};
+                Status result = store_.Read(context, ReadCallback, serial_num);
+                CountResult(result, buffers.key, [&]() { CountRead(result); });
+                // Modify what was read (if it came back right away), and write it back.
+                if (result == Status::Ok && context.output_length >= sizeof(uint64_t)) {
+                    std::memcpy(buffers.value.data(), context.output_bytes, sizeof(uint64_t));
+                }
+                uint64_t counter;
+                std::memcpy(&counter, buffers.value.data(), sizeof(counter));
+                ++counter;
+                std::memcpy(buffers.value.data(), &counter, sizeof(counter));
+                Upsert(buffers, key, options_.value_size, ++serial_num);
+                break;
+            }
+            case Op::Scan: {
+                Status result = store_.template RangeScan<ReadContext>(
+                        buffers.key.Format(key), buffers.end_key.Format(key + length), ScanVisitor, ScanCallback,
+                        serial_num);
+                if (result == Status::Pending) {
+                    ++tls_counters->counts.pending;
+                }
+                break;
+            }
+            case Op::Delete: {
+                DeleteContext context{buffers.key.Format(key)};
+                Status result = store_.Delete(context, DeleteCallback, serial_num);
+                CountResult(result, buffers.key, []() {});
+                break;
+            }
+        }
+    }
 
-  init_keys_.reset();
+    template<class F>
+    inline void CountResult(Status result, KeyBuffer &key_buffer, F count_sync_result) {
+        if (result == Status::Pending) {
+            ++tls_counters->counts.pending;
+            key_buffer.HandOff();
+        } else {
+            count_sync_result();
+        }
+    }
 
-  printf("Finished populating store: contains ?? elements.\n");
-}
+    inline void Read(WorkerBuffers &buffers, uint64_t key, uint64_t serial_num) {
+        ReadContext context{buffers.key.Format(key)};
+        Status result = store_.Read(context, ReadCallback, serial_num);
+        CountResult(result, buffers.key, [&]() { CountRead(result); });
+    }
 
+    inline void Upsert(WorkerBuffers &buffers, uint64_t key, uint32_t value_size, uint64_t serial_num) {
+        UpsertContext context{buffers.key.Format(key), Value{buffers.value.data(), value_size}};
+        Status result = store_.UpsertT(context, UpsertCallback, serial_num,
+                                       static_cast<uint16_t>(store_.NumPartitions()));
+        CountResult(result, buffers.key, []() {});
+    }
 
-static std::atomic<int64_t> async_reads_done{ 0 };
-static std::atomic<int64_t> async_writes_done{ 0 };
-
-template <Op(*FN)(std::mt19937&)>
-void thread_run_benchmark(store_t* store, size_t thread_idx) {
-  SetThreadAffinity(thread_idx);
-
-  std::random_device rd{};
-  std::mt19937 rng{ rd() };
-
-  auto start_time = std::chrono::high_resolution_clock::now();
-
-  uint64_t upsert_value = 0;
-  int64_t reads_done = 0;
-  int64_t writes_done = 0;
-
-  Guid guid = store->StartSession();
-
-  while(!done_) {
-    uint64_t chunk_idx = idx_.fetch_add(kChunkSize);
-    while(chunk_idx >= kTxnCount) {
-      if(chunk_idx == kTxnCount) {
-        idx_ = 0;
-      }
-      chunk_idx = idx_.fetch_add(kChunkSize);
-    }
-    for(uint64_t idx = chunk_idx; idx < chunk_idx + kChunkSize; ++idx) {
-      if(idx % kRefreshInterval == 0) {
-        store->Refresh();
-        if(idx % kCompletePendingInterval == 0) {
-          store->CompletePending(false);
-        }
-      }
-      switch(FN(rng)) {
-      case Op::Insert:
-      case Op::Upsert: {
-        auto callback = [](IAsyncContext* ctxt, Status result) {
-          CallbackContext<UpsertContext> context{ ctxt };
-        };
-
-        UpsertContext context{ txn_keys_.get()[idx], upsert_value };
-        Status result = store->Upsert(context, callback, 1);
-        ++writes_done;
-        break;
-      }
-      case Op::Scan:
-        printf("Scan currently not supported!\n");
-        exit(1);
-        break;
-      case Op::Read: {
-        auto callback = [](IAsyncContext* ctxt, Status result) {
-          CallbackContext<ReadContext> context{ ctxt };
-        };
-
-        ReadContext context{ txn_keys_.get()[idx] };
-
-        Status result = store->Read(context, callback, 1);
-        ++reads_done;
-        break;
-      }
-      case Op::ReadModifyWrite:
-        auto callback = [](IAsyncContext* ctxt, Status result) {
-          CallbackContext<RmwContext> context{ ctxt };
-        };
-
-        RmwContext context{ txn_keys_.get()[idx], 5 };
-        Status result = store->Rmw(context, callback, 1);
-        if(result == Status::Ok) {
-          ++writes_done;
-        }
-        break;
-      }
-    }
-  }
-
-  store->CompletePending(true);
-  store->StopSession();
-
-  auto end_time = std::chrono::high_resolution_clock::now();
-  std::chrono::nanoseconds duration = end_time - start_time;
-  total_duration_ += duration.count();
-  total_reads_done_ += reads_done;
-  total_writes_done_ += writes_done;
-  printf("Finished thread %" PRIu64 " : %" PRIu64 " reads, %" PRIu64 " writes, in %.2f seconds.\n",
-         thread_idx, reads_done, writes_done, (double)duration.count() / kNanosPerSecond);
-}
+    inline void Tick(uint64_t serial_num) {
+        if (serial_num % kRefreshInterval == 0) {
+            if (serial_num % kCompletePendingInterval == 0) {
+                store_.CompletePending(false);
+            } else {
+                store_.Refresh();
+            }
+        }
+    }
 
-template <Op(*FN)(std::mt19937&)>
-void run_benchmark(store_t* store, size_t num_threads) {
-  idx_ = 0;
-  total_duration_ = 0;
-  total_reads_done_ = 0;
-  total_writes_done_ = 0;
-  done_ = false;
-  std::deque<std::thread> threads;
-  for(size_t thread_idx = 0; thread_idx < num_threads; ++thread_idx) {
-    threads.emplace_back(&thread_run_benchmark<FN>, store, thread_idx);
-  }
-
-  static std::atomic<uint64_t> num_checkpoints;
-  num_checkpoints = 0;
-
-  if(kCheckpointSeconds == 0) {
-    std::this_thread::sleep_for(std::chrono::seconds(kRunSeconds));
-  } else {
-    auto callback = [](Status result, uint64_t persistent_serial_num) {
-      if(result != Status::Ok) {
-        printf("Thread %" PRIu32 " reports checkpoint failed.\n",
-               Thread::id());
-      } else {
-        ++num_checkpoints;
-      }
-    };
+    /// Runs "work" on each worker thread, inside a session, sampling throughput until every thread
+    /// is done (or, if "timed", until --duration is up).
+    template<class F>
+    PhaseResult RunPhase(const std::string &name, bool timed, F work) {
+        for (WorkerCounters &counters : counters_) {
+            counters.ops = 0;
+            counters.counts = OperationCounts{};
+            counters.latency.Clear();
+            counters.perf = PerfCounts{};
+        }
+        done_ = false;
+        num_finished_ = 0;
+
+        std::deque<std::thread> threads;
+        for (uint32_t thread_idx = 0; thread_idx < options_.num_threads; ++thread_idx) {
+            threads.emplace_back([this, thread_idx, &work]() {
+                placement_.PlaceWorker(thread_idx);
+                tls_counters = &counters_[thread_idx];
+                store_.StartSession();
+                // (A thread that can't count hardware events just leaves them out of the totals.)
+                PerfCounterGroup perf;
+                std::string perf_error;
+                bool count_perf = options_.perf_counters && perf.Open(perf_error);
+                if (count_perf) {
+                    perf.Start();
+                }
+                work(thread_idx);
+                if (count_perf) {
+                    counters_[thread_idx].perf = perf.Stop();
+                }
+                ++num_finished_;
+                // Keep refreshing until every thread is done, so that a checkpoint in progress can
+                // finish.
+                while (!done_) {
+                    store_.CompletePending(false);
+                    std::this_thread::yield();
+                }
+                while (!store_.CheckpointCheck()) {
+                    store_.CompletePending(false);
+                }
+                store_.CompletePending(true);
+                store_.StopSession();
+                tls_counters = nullptr;
+            });
+        }
 
-    auto start_time = std::chrono::high_resolution_clock::now();
-    auto last_checkpoint_time = start_time;
-    auto current_time = start_time;
-
-    uint64_t checkpoint_num = 0;
-
-    while(current_time - start_time < std::chrono::seconds(kRunSeconds)) {
-      std::this_thread::sleep_for(std::chrono::seconds(1));
-      current_time = std::chrono::high_resolution_clock::now();
-      if(current_time - last_checkpoint_time >= std::chrono::seconds(kCheckpointSeconds)) {
-        Guid token;
-        bool success = store->Checkpoint(nullptr, callback, token);
-        if(success) {
-          printf("Starting checkpoint %" PRIu64 ".\n", checkpoint_num);
-          ++checkpoint_num;
-        } else {
-          printf("Failed to start checkpoint.\n");
+        const auto interval = std::chrono::milliseconds{options_.sample_interval_ms};
+        const auto poll_interval = std::min(interval, std::chrono::milliseconds{10});
+        clock_t::time_point start = clock_t::now();
+        clock_t::time_point last_sample = start;
+        uint64_t last_ops = 0;
+        for (bool stop = false; !stop;) {
+            std::this_thread::sleep_for(poll_interval);
+            clock_t::time_point now = clock_t::now();
+            stop = num_finished_ == options_.num_threads ||
+                   (timed && now - start >= std::chrono::seconds{options_.duration_s});
+            if (now - last_sample < interval && !stop) {
+                continue;
+            }
+            uint64_t ops = 0;
+            for (const WorkerCounters &counters : counters_) {
+                ops += counters.ops.load(std::memory_order_relaxed);
+            }
+            double interval_s = std::chrono::duration<double>(now - last_sample).count();
+            report_.AddSample(TimelineSample{name, std::chrono::duration<double>(now - start).count(),
+                                             ops - last_ops, (ops - last_ops) / interval_s});
+            last_sample = now;
+            last_ops = ops;
+        }
+        clock_t::time_point end = clock_t::now();
+
+        PhaseResult result;
+        result.name = name;
+        result.seconds = std::chrono::duration<double>(end - start).count();
+        result.checkpoints = 0;
+        if (scheduler_) {
+            // Stop starting checkpoints; the threads finish the one in progress (if any).
+            result.checkpoints = scheduler_->GetStats().checkpoints_started;
+            scheduler_.reset();
         }
-        last_checkpoint_time = current_time;
-      }
+        done_ = true;
+        for (auto &thread : threads) {
+            thread.join();
+        }
+        for (const WorkerCounters &counters : counters_) {
+            result.counts += counters.counts;
+            result.perf += counters.perf;
+        }
+        report_.AddPhase(result);
+        return result;
     }
 
-    done_ = true;
-  }
-
-  for(auto& thread : threads) {
-    thread.join();
-  }
+    store_t &store_;
+    const BenchmarkOptions &options_;
+    const ThreadPlacement &placement_;
+    BenchmarkReport &report_;
+    const TraceFile *load_trace_;
+    const TraceFile *run_trace_;
+    /// Of the value buffers: the largest value any phase writes.
+    uint32_t value_size_;
+
+    std::vector<WorkerCounters> counters_;
+    OperationChooser chooser_;
+    std::unique_ptr<ZipfianGenerator> zipfian_;
+    /// Each worker's pregenerated operations (empty, without --pregenerate).
+    std::vector<std::vector<TraceRecord>> pregenerated_;
+    /// Keys [0, num_records_) have been (or are being) inserted.
+    std::atomic<uint64_t> num_records_;
+    std::unique_ptr<scheduler_t> scheduler_;
+
+    std::atomic<bool> done_;
+    std::atomic<uint32_t> num_finished_;
+};
 
-  printf("Finished benchmark: %" PRIu64 " thread checkpoints completed;  %.2f ops/second/thread\n",
-         num_checkpoints.load(),
-         ((double)total_reads_done_ + (double)total_writes_done_) / ((double)total_duration_ /
-             kNanosPerSecond));
+static void PrintPhase(const PhaseResult &phase) {
+    const OperationCounts &counts = phase.counts;
+    std::printf("%s: %" PRIu64 " ops in %.2f s, %.0f ops/s\n", phase.name.c_str(), counts.Total(),
+                phase.seconds, phase.OpsPerSecond());
+    for (uint32_t op = 0; op < kNumOps; ++op) {
+        if (counts.issued[op] > 0) {
+            std::printf("  %-7s %" PRIu64 "\n", OpName(static_cast<Op>(op)), counts.issued[op]);
+        }
+    }
+    std::printf("  found %" PRIu64 ", not found %" PRIu64 ", pending %" PRIu64 ", scanned %" PRIu64
+                ", checkpoints %" PRIu64 "\n", counts.found, counts.not_found, counts.pending, counts.scanned,
+                phase.checkpoints);
+    const PerfCounts &perf = phase.perf;
+    if (perf.num_threads > 0) {
+        double ops = static_cast<double>(std::max<uint64_t>(counts.Total(), 1));
+        std::printf("  per op:");
+        for (uint32_t idx = 0; idx < kNumPerfEvents; ++idx) {
+            if (perf.available[idx]) {
+                std::printf(" %s %.2f", PerfEventName(static_cast<PerfEvent>(idx)), perf.values[idx] / ops);
+            }
+        }
+        if (perf.has(PerfEvent::Cycles) && perf.has(PerfEvent::Instructions) && perf[PerfEvent::Cycles] > 0) {
+            std::printf(" (IPC %.2f)", static_cast<double>(perf[PerfEvent::Instructions]) / perf[PerfEvent::Cycles]);
+        }
+        std::printf("\n");
+    }
 }
 
-void run(Workload workload, size_t num_threads) {
-  // FASTER store has a hash table with approx. kInitCount / 2 entries and a log of size 16 GB
-  size_t init_size = next_power_of_two(kInitCount / 2);
-  store_t store{ init_size, 17179869184, "storage" };
-
-  printf("Populating the store...\n");
-
-  setup_store(&store, num_threads);
-
-  store.DumpDistribution();
-
-  printf("Running benchmark on %" PRIu64 " threads...\n", num_threads);
-  switch(workload) {
-  case Workload::A_50_50:
-    run_benchmark<ycsb_a_50_50>(&store, num_threads);
-    break;
-  case Workload::RMW_100:
-    run_benchmark<ycsb_rmw_100>(&store, num_threads);
-    break;
-  default:
-    printf("Unknown workload!\n");
-    exit(1);
-  }
+/// Whether the run's mix, or either trace, has scans (which need the ordered index).
+static bool UsesScans(const BenchmarkOptions &options, const TraceFile *load_trace, const TraceFile *run_trace) {
+    return (!run_trace && options.mix[Op::Scan] > 0) || (load_trace && load_trace->op_count(Op::Scan) > 0) ||
+           (run_trace && run_trace->op_count(Op::Scan) > 0);
 }
 
-int main(int argc, char* argv[]) {
-  constexpr size_t kNumArgs = 4;
-  if(argc != kNumArgs + 1) {
-    printf("Usage: benchmark.exe <workload> <# threads> <load_filename> <run_filename>\n");
-    exit(0);
-  }
+template<class D>
+static void RunBenchmark(const BenchmarkOptions &options, const ThreadPlacement &placement,
+                         BenchmarkReport &report, const TraceFile *load_trace, const TraceFile *run_trace) {
+    typedef FasterKv<Key, Value, D> store_t;
+    // (One more session than workers: the checkpoint scheduler's thread doesn't need one, but
+    // leave room for the main thread.)
+    store_t store{static_cast<int>(options.num_lanes), options.table_size, options.log_size,
+                  options.null_disk ? "" : options.path, options.mutable_fraction, options.num_threads + 1};
+    if (UsesScans(options, load_trace, run_trace)) {
+        // (The store is still empty, and main() checked the key size; so this doesn't fail.)
+        if (store.EnableOrderedIndex() != Status::Ok) {
+            std::fprintf(stderr, "could not enable the ordered index\n");
+            return;
+        }
+    }
+    BenchmarkRunner<store_t> runner{store, options, placement, report, load_trace, run_trace};
 
-  Workload workload = static_cast<Workload>(std::atol(argv[1]));
-  size_t num_threads = ::atol(argv[2]);
-  std::string load_filename{ argv[3] };
-  std::string run_filename{ argv[4] };
+    if (load_trace) {
+        std::printf("loading %s (%" PRIu64 " operations)...\n", options.load_trace_path.c_str(), load_trace->size());
+    } else {
+        std::printf("loading %" PRIu64 " records...\n", options.num_records);
+    }
+    PrintPhase(runner.Load());
+    if (options.latency_sample > 0) {
+        store.EnableLatencyStats(options.latency_sample);
+    }
+    if (run_trace) {
+        std::printf("replaying %s (%" PRIu64 " operations) on %" PRIu32 " threads...\n",
+                    options.trace_path.c_str(), run_trace->size(), options.num_threads);
+    } else {
+        std::printf("running workload %s on %" PRIu32 " threads...\n", options.workload.c_str(),
+                    options.num_threads);
+    }
+    {
+        std::unique_ptr<StatsExporter> exporter;
+        if (options.stats_interval_ms > 0) {
+            exporter.reset(new StatsExporter{std::chrono::milliseconds{options.stats_interval_ms},
+                                             StatsFormat::Text, [](const std::string &text) {
+                        std::fprintf(stderr, "%s", text.c_str());
+                    }});
+        }
+        if (options.rates.empty()) {
+            PrintPhase(runner.Run());
+        }
+        for (uint64_t rate : options.rates) {
+            OpenLoopSummary summary;
+            PrintPhase(runner.RunOpenLoop(rate, summary));
+            std::printf("  target %" PRIu64 " ops/s: %.0f ops/s, %" PRIu64 " timed, p50 %.0f ns, p99 %.0f, "
+                        "p99.9 %.0f, max %.0f\n", rate, summary.ops_per_s, summary.count, summary.p50_ns,
+                        summary.p99_ns, summary.p999_ns, summary.max_ns);
+        }
+    }
 
-  load_files(load_filename, run_filename);
+    for (uint32_t op = 0; op < kNumLatencyOps; ++op) {
+        for (uint32_t outcome = 0; outcome < kNumLatencyOutcomes; ++outcome) {
+            LatencyHistogram histogram = store.GetLatencyHistogram(static_cast<LatencyOp>(op),
+                                                                   static_cast<LatencyOutcome>(outcome));
+            if (histogram.count() == 0) {
+                continue;
+            }
+            LatencySummary latency;
+            latency.op = LatencyOpName(static_cast<LatencyOp>(op));
+            latency.outcome = LatencyOutcomeName(static_cast<LatencyOutcome>(outcome));
+            latency.count = histogram.count();
+            latency.mean_ns = histogram.Mean() * TscClock::NanosecondsPerTick();
+            latency.p50_ns = TscClock::ToNanoseconds(histogram.ValueAtPercentile(50));
+            latency.p99_ns = TscClock::ToNanoseconds(histogram.ValueAtPercentile(99));
+            latency.p999_ns = TscClock::ToNanoseconds(histogram.ValueAtPercentile(99.9));
+            latency.max_ns = TscClock::ToNanoseconds(histogram.max());
+            std::printf("  %-6s %-8s %10" PRIu64 " samples: mean %.0f ns, p50 %.0f, p99 %.0f, p99.9 %.0f, "
+                        "max %.0f\n", latency.op.c_str(), latency.outcome.c_str(), latency.count,
+                        latency.mean_ns, latency.p50_ns, latency.p99_ns, latency.p999_ns, latency.max_ns);
+            report.AddLatency(latency);
+        }
+    }
+}
 
-  run(workload, num_threads);
+int main(int argc, char *argv[]) {
+    BenchmarkOptions options;
+    std::string error;
+    if (!ParseBenchmarkOptions(argc, argv, options, error)) {
+        if (error.empty()) {
+            std::printf("%s", BenchmarkUsage());
+            return 0;
+        }
+        std::fprintf(stderr, "%s\n\n%s", error.c_str(), BenchmarkUsage());
+        return 1;
+    }
+    TraceFile load_trace, run_trace;
+    if ((!options.load_trace_path.empty() && !load_trace.Open(options.load_trace_path, error)) ||
+        (!options.trace_path.empty() && !run_trace.Open(options.trace_path, error))) {
+        std::fprintf(stderr, "%s\n", error.c_str());
+        return 1;
+    }
+    const TraceFile *load_trace_ptr = options.load_trace_path.empty() ? nullptr : &load_trace;
+    const TraceFile *run_trace_ptr = options.trace_path.empty() ? nullptr : &run_trace;
+    if (load_trace_ptr) {
+        options.num_records = std::max<uint64_t>(load_trace.size(), 1);
+        if (options.table_size == 0) {
+            options.table_size = std::max<uint64_t>(DefaultTableSize(options.num_records), options.num_lanes);
+        }
+    }
+    if (UsesScans(options, load_trace_ptr, run_trace_ptr) && options.key_size != kMinKeySize) {
+        // The ordered index keeps 16 bytes of each key, and scans read back just those.
+        std::fprintf(stderr, "scans need --key-size=%" PRIu32 "\n", kMinKeySize);
+        return 1;
+    }
+    if (options.stats_interval_ms > 0 && !Stats::kEnabled) {
+        std::fprintf(stderr, "--stats-interval needs a build with -DFASTER_STATS=ON\n");
+        return 1;
+    }
+    if (options.perf_counters) {
+        // Counters are a diagnostic; the run goes on without them.
+        PerfCounterGroup probe;
+        if (!probe.Open(error)) {
+            std::fprintf(stderr, "--perf-counters: %s; continuing without them\n", error.c_str());
+            options.perf_counters = false;
+        }
+    }
+    if (!ThreadPlacement::Supports(options.numa)) {
+        std::fprintf(stderr, "--numa needs a build with libnuma, on a NUMA system\n");
+        return 1;
+    }
+
+    ThreadPlacement placement{options.affinity, options.numa};
+    placement.PlaceMainThread();
+    if (!options.null_disk) {
+        std::experimental::filesystem::create_directories(options.path);
+    }
+
+    BenchmarkReport report{options};
+    if (options.null_disk) {
+        RunBenchmark<FASTER::device::NullDisk>(options, placement, report, load_trace_ptr, run_trace_ptr);
+    } else {
+#ifdef _WIN32
+        typedef FASTER::environment::ThreadPoolIoHandler handler_t;
+#else
+        typedef FASTER::environment::QueueIoHandler handler_t;
+#endif
+        RunBenchmark<FASTER::device::FileSystemDisk<handler_t, 1073741824ull>>(options, placement, report,
+                                                                              load_trace_ptr, run_trace_ptr);
+    }
 
-  return 0;
+    if (!options.report_path.empty()) {
+        std::ofstream out{options.report_path};
+        if (options.report_format == ReportFormat::Csv) {
+            report.WriteCsv(out);
+        } else {
+            report.WriteJson(out);
+        }
+        if (!out) {
+            std::fprintf(stderr, "could not write %s\n", options.report_path.c_str());
+            return 1;
+        }
+    }
+    return 0;
 }
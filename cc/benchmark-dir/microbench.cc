@@ -0,0 +1,538 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT license.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cinttypes>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <map>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "core/hash_table.h"
+#include "core/light_epoch.h"
+#include "core/malloc_fixed_page_size.h"
+#include "core/native_buffer_pool.h"
+#include "core/persistent_memory_malloc.h"
+#include "core/utility.h"
+#include "device/null_disk.h"
+#include "device/serializablecontext.h"
+
+using namespace FASTER::core;
+using FASTER::api::MurmurHash64A;
+
+/// Microbenchmarks of the primitives that bound the store's throughput, each run on 1, 2, 4, ...
+/// threads at once. Prints nanoseconds per operation (per thread: the time each thread took,
+/// divided by the operations it did), the median of --repetitions runs. --save writes the results
+/// as a baseline; --compare reads one, and exits with 1 if any case got slower by more than
+/// --threshold percent. (CMake's "microbench_baseline" and "microbench_check" targets do both.)
+
+typedef FASTER::device::NullDisk disk_t;
+
+static const char *const kUsage =
+        "Usage: microbench [--option=value ...]\n"
+        "  --filter=<text>         run the cases whose names contain this\n"
+        "  --threads=<n>[,<n>...]  thread counts (1, 2, 4, ... up to the number of CPUs)\n"
+        "  --repetitions=<n>       runs per case and thread count; the median counts (5)\n"
+        "  --scale=<x>             multiply each case's operation count by this (1)\n"
+        "  --save=<file>           write the results, as a baseline\n"
+        "  --compare=<file>        compare the results to a baseline\n"
+        "  --threshold=<percent>   a case more than this much slower is a regression (10)\n";
+
+/// Keeps the compiler from optimizing away a result.
+static std::atomic<uint64_t> sink{0};
+
+static inline void Consume(uint64_t value) {
+    sink.fetch_add(value, std::memory_order_relaxed);
+}
+
+/// A microbenchmark. Setup() runs first, on the main thread; then Run() on each of "num_threads"
+/// threads at once (thread "thread_idx" does "num_ops" operations); then Teardown().
+class Case {
+public:
+    virtual ~Case() {
+    }
+
+    virtual const char *name() const = 0;
+
+    /// Operations per thread per run, before --scale.
+    virtual uint64_t num_ops() const = 0;
+
+    virtual void Setup(uint32_t num_threads) {
+    }
+
+    virtual void Run(uint32_t thread_idx, uint64_t num_ops) = 0;
+
+    virtual void Teardown() {
+    }
+};
+
+/// Looks up keys in a full hash table, the way FasterKv::FindEntry() does: pick the bucket by
+/// hash, then compare tags, and then keys, across its entries. One in eight lookups misses.
+class HashBucketProbe : public Case {
+public:
+    static constexpr uint64_t kNumBuckets = 1 << 16;
+    static constexpr uint64_t kKeySize = 16;
+
+    const char *name() const override {
+        return "hash_bucket_probe";
+    }
+
+    uint64_t num_ops() const override {
+        return 4000000;
+    }
+
+    void Setup(uint32_t num_threads) override {
+        table_.Initialize(kNumBuckets, Constants::kCacheLineBytes);
+        for (uint64_t bucket_idx = 0; bucket_idx < kNumBuckets; ++bucket_idx) {
+            HashBucket &bucket = table_.bucket(bucket_idx);
+            for (uint32_t entry_idx = 0; entry_idx < HashBucket::kNumEntries; ++entry_idx) {
+                uint64_t key = bucket_idx * 8 + entry_idx;
+                bucket.entries[entry_idx].store(HashBucketEntry{Address{64 + key}, Tag(key), false});
+                std::memcpy(bucket.entries[entry_idx].GetKey(), &key, sizeof(key));
+            }
+        }
+    }
+
+    void Run(uint32_t thread_idx, uint64_t num_ops) override {
+        std::mt19937_64 rng{thread_idx};
+        uint64_t found = 0;
+        for (uint64_t idx = 0; idx < num_ops; ++idx) {
+            // Keys bucket * 8 + 7 aren't in the table.
+            uint64_t key = rng() % (kNumBuckets * 8);
+            uint8_t key_bytes[kKeySize] = {};
+            std::memcpy(key_bytes, &key, sizeof(key));
+            const HashBucket &bucket = table_.bucket(key / 8);
+            uint16_t tag = Tag(key);
+            for (uint32_t entry_idx = 0; entry_idx < HashBucket::kNumEntries; ++entry_idx) {
+                HashBucketEntry entry = bucket.entries[entry_idx].load();
+                if (!entry.unused() && entry.tag() == tag && !entry.tentative() &&
+                    std::memcmp(bucket.entries[entry_idx].GetKey(), key_bytes, kKeySize) == 0) {
+                    found += entry.address().control();
+                    break;
+                }
+            }
+        }
+        Consume(found);
+    }
+
+private:
+    static inline uint16_t Tag(uint64_t key) {
+        return static_cast<uint16_t>(Utility::GetHashCode(key) >> 48) & 0x3fff;
+    }
+
+    InternalHashTable<disk_t> table_;
+};
+
+/// Allocates 64-byte records from the log's tail, opening new pages (and so flushing and
+/// evicting old ones, to the null disk) as it goes, the way FasterKv::BlockAllocate() does.
+class LogAllocate : public Case {
+public:
+    /// 8 pages of 32 MB.
+    static constexpr uint64_t kLogSize = 8 * (Address::kMaxOffset + 1);
+    static constexpr uint32_t kRecordSize = 64;
+
+    const char *name() const override {
+        return "persistent_memory_malloc_allocate";
+    }
+
+    uint64_t num_ops() const override {
+        return 4000000;
+    }
+
+    void Setup(uint32_t num_threads) override {
+        epoch_.reset(new LightEpoch{});
+        disk_.reset(new disk_t{"", *epoch_});
+        log_.reset(new PersistentMemoryMalloc<disk_t>{kLogSize, *epoch_, *disk_, disk_->log(), 0.5, 0});
+    }
+
+    void Run(uint32_t thread_idx, uint64_t num_ops) override {
+        epoch_->Protect();
+        uint64_t sum = 0;
+        for (uint64_t idx = 0; idx < num_ops; ++idx) {
+            uint32_t page;
+            Address address = log_->Allocate(kRecordSize, page);
+            while (address < log_->read_only_address.load()) {
+                epoch_->ProtectAndDrain();
+                bool page_closed = address == Address::kInvalidAddress;
+                while (page_closed) {
+                    page_closed = !log_->NewPage(page);
+                    epoch_->ProtectAndDrain();
+                }
+                address = log_->Allocate(kRecordSize, page);
+            }
+            sum += address.control();
+            if (idx % 64 == 0) {
+                epoch_->ProtectAndDrain();
+            }
+        }
+        epoch_->Unprotect();
+        Consume(sum);
+    }
+
+    void Teardown() override {
+        log_.reset();
+        disk_.reset();
+        epoch_.reset();
+    }
+
+private:
+    std::unique_ptr<LightEpoch> epoch_;
+    std::unique_ptr<disk_t> disk_;
+    std::unique_ptr<PersistentMemoryMalloc<disk_t>> log_;
+};
+
+/// Enters and leaves the epoch.
+class EpochProtect : public Case {
+public:
+    const char *name() const override {
+        return "light_epoch_protect";
+    }
+
+    uint64_t num_ops() const override {
+        return 10000000;
+    }
+
+    void Run(uint32_t thread_idx, uint64_t num_ops) override {
+        uint64_t sum = 0;
+        for (uint64_t idx = 0; idx < num_ops; ++idx) {
+            sum += epoch_.Protect();
+            epoch_.Unprotect();
+        }
+        Consume(sum);
+    }
+
+private:
+    LightEpoch epoch_;
+};
+
+/// Refreshes a protected epoch (ProtectAndDrain(), the heart of FasterKv::Refresh()), with one
+/// thread bumping the epoch, and queueing an (empty) action, every 1024 refreshes.
+class EpochRefresh : public Case {
+public:
+    const char *name() const override {
+        return "light_epoch_refresh";
+    }
+
+    uint64_t num_ops() const override {
+        return 10000000;
+    }
+
+    void Run(uint32_t thread_idx, uint64_t num_ops) override {
+        epoch_.Protect();
+        uint64_t sum = 0;
+        for (uint64_t idx = 0; idx < num_ops; ++idx) {
+            sum += epoch_.ProtectAndDrain();
+            if (thread_idx == 0 && idx % 1024 == 0) {
+                epoch_.BumpCurrentEpoch([](IAsyncContext *context) {}, nullptr);
+            }
+        }
+        epoch_.Unprotect();
+        Consume(sum);
+    }
+
+private:
+    LightEpoch epoch_;
+};
+
+/// Allocates overflow buckets (as the hash index does), from one allocator shared by the threads.
+class FixedPageAllocate : public Case {
+public:
+    const char *name() const override {
+        return "malloc_fixed_page_size_allocate";
+    }
+
+    uint64_t num_ops() const override {
+        return 2000000;
+    }
+
+    void Setup(uint32_t num_threads) override {
+        allocator_.reset(new MallocFixedPageSize<HashBucket, disk_t>{});
+        allocator_->Initialize(Constants::kCacheLineBytes, epoch_);
+    }
+
+    void Run(uint32_t thread_idx, uint64_t num_ops) override {
+        uint64_t sum = 0;
+        for (uint64_t idx = 0; idx < num_ops; ++idx) {
+            sum += allocator_->Allocate().control();
+        }
+        Consume(sum);
+    }
+
+    void Teardown() override {
+        allocator_.reset();
+    }
+
+private:
+    LightEpoch epoch_;
+    std::unique_ptr<MallocFixedPageSize<HashBucket, disk_t>> allocator_;
+};
+
+/// Gets (and returns) 4 KB read buffers from a shared pool, as disk reads do.
+class BufferPoolGet : public Case {
+public:
+    const char *name() const override {
+        return "native_buffer_pool_get";
+    }
+
+    uint64_t num_ops() const override {
+        return 4000000;
+    }
+
+    void Setup(uint32_t num_threads) override {
+        pool_.reset(new NativeSectorAlignedBufferPool{1, 512});
+    }
+
+    void Run(uint32_t thread_idx, uint64_t num_ops) override {
+        uint64_t sum = 0;
+        for (uint64_t idx = 0; idx < num_ops; ++idx) {
+            SectorAlignedMemory buffer = pool_->Get(4096);
+            sum += reinterpret_cast<uintptr_t>(buffer.GetValidPointer());
+        }
+        Consume(sum);
+    }
+
+    void Teardown() override {
+        pool_.reset();
+    }
+
+private:
+    std::unique_ptr<NativeSectorAlignedBufferPool> pool_;
+};
+
+/// Utility::GetHashCode() of 8-byte keys.
+class HashCode : public Case {
+public:
+    const char *name() const override {
+        return "utility_get_hash_code";
+    }
+
+    uint64_t num_ops() const override {
+        return 50000000;
+    }
+
+    void Run(uint32_t thread_idx, uint64_t num_ops) override {
+        uint64_t sum = 0;
+        for (uint64_t idx = 0; idx < num_ops; ++idx) {
+            sum += Utility::GetHashCode(idx + sum);
+        }
+        Consume(sum);
+    }
+};
+
+/// MurmurHash64A() of "key_size"-byte keys, as the variable-length key contexts hash them.
+class MurmurHash : public Case {
+public:
+    MurmurHash(uint32_t key_size)
+            : key_size_{key_size}, name_{"murmur_hash_64a_" + std::to_string(key_size)} {
+    }
+
+    const char *name() const override {
+        return name_.c_str();
+    }
+
+    uint64_t num_ops() const override {
+        return 20000000;
+    }
+
+    void Run(uint32_t thread_idx, uint64_t num_ops) override {
+        std::vector<uint8_t> key(key_size_, 'k');
+        uint64_t sum = 0;
+        for (uint64_t idx = 0; idx < num_ops; ++idx) {
+            std::memcpy(key.data(), &sum, std::min<size_t>(sizeof(sum), key_size_));
+            sum += MurmurHash64A(key.data(), static_cast<int>(key_size_), idx);
+        }
+        Consume(sum);
+    }
+
+private:
+    uint32_t key_size_;
+    std::string name_;
+};
+
+/// Runs "test_case" on "num_threads" threads at once; returns nanoseconds per operation.
+static double RunOnce(Case &test_case, uint32_t num_threads, uint64_t num_ops) {
+    test_case.Setup(num_threads);
+    std::atomic<uint32_t> ready{0};
+    std::atomic<bool> start{false};
+    std::vector<std::thread> threads;
+    for (uint32_t thread_idx = 0; thread_idx < num_threads; ++thread_idx) {
+        threads.emplace_back([&, thread_idx]() {
+            ++ready;
+            while (!start.load()) {
+                std::this_thread::yield();
+            }
+            test_case.Run(thread_idx, num_ops);
+        });
+    }
+    while (ready.load() < num_threads) {
+        std::this_thread::yield();
+    }
+    auto begin = std::chrono::steady_clock::now();
+    start = true;
+    for (std::thread &thread : threads) {
+        thread.join();
+    }
+    auto end = std::chrono::steady_clock::now();
+    test_case.Teardown();
+    return std::chrono::duration<double, std::nano>(end - begin).count() / static_cast<double>(num_ops);
+}
+
+/// Results, keyed by "<case>/<threads>".
+typedef std::map<std::string, double> results_t;
+
+static bool ReadBaseline(const std::string &path, results_t &baseline) {
+    std::ifstream in{path};
+    if (!in) {
+        return false;
+    }
+    std::string line;
+    while (std::getline(in, line)) {
+        std::istringstream fields{line};
+        std::string key;
+        double ns_per_op;
+        if (line.empty() || line[0] == '#' || !(fields >> key >> ns_per_op)) {
+            continue;
+        }
+        baseline[key] = ns_per_op;
+    }
+    return true;
+}
+
+static bool ParseThreads(const std::string &text, std::vector<uint32_t> &threads) {
+    threads.clear();
+    std::istringstream in{text};
+    std::string item;
+    while (std::getline(in, item, ',')) {
+        unsigned long count = std::strtoul(item.c_str(), nullptr, 10);
+        if (count == 0 || count > 1024) {
+            return false;
+        }
+        threads.push_back(static_cast<uint32_t>(count));
+    }
+    return !threads.empty();
+}
+
+int main(int argc, char *argv[]) {
+    std::string filter;
+    std::vector<uint32_t> thread_counts;
+    for (uint32_t count = 1; count <= std::max(std::thread::hardware_concurrency(), 1u); count *= 2) {
+        thread_counts.push_back(count);
+    }
+    uint32_t repetitions = 5;
+    double scale = 1.0;
+    std::string save_path;
+    std::string compare_path;
+    double threshold = 10.0;
+
+    for (int idx = 1; idx < argc; ++idx) {
+        std::string arg{argv[idx]};
+        size_t equals = arg.find('=');
+        std::string name = arg.substr(0, equals);
+        std::string value = equals == std::string::npos ? "" : arg.substr(equals + 1);
+        bool ok = equals != std::string::npos;
+        if (arg == "--help" || arg == "-h") {
+            std::printf("%s", kUsage);
+            return 0;
+        } else if (name == "--filter") {
+            filter = value;
+        } else if (name == "--threads") {
+            ok = ok && ParseThreads(value, thread_counts);
+        } else if (name == "--repetitions") {
+            repetitions = static_cast<uint32_t>(std::strtoul(value.c_str(), nullptr, 10));
+            ok = ok && repetitions > 0;
+        } else if (name == "--scale") {
+            scale = std::strtod(value.c_str(), nullptr);
+            ok = ok && scale > 0;
+        } else if (name == "--save") {
+            save_path = value;
+        } else if (name == "--compare") {
+            compare_path = value;
+        } else if (name == "--threshold") {
+            threshold = std::strtod(value.c_str(), nullptr);
+            ok = ok && threshold > 0;
+        } else {
+            ok = false;
+        }
+        if (!ok) {
+            std::fprintf(stderr, "bad option \"%s\"\n\n%s", arg.c_str(), kUsage);
+            return 1;
+        }
+    }
+
+    results_t baseline;
+    if (!compare_path.empty() && !ReadBaseline(compare_path, baseline)) {
+        std::fprintf(stderr, "could not read baseline %s (run with --save first)\n", compare_path.c_str());
+        return 1;
+    }
+
+    std::vector<std::unique_ptr<Case>> cases;
+    cases.emplace_back(new HashBucketProbe{});
+    cases.emplace_back(new LogAllocate{});
+    cases.emplace_back(new EpochProtect{});
+    cases.emplace_back(new EpochRefresh{});
+    cases.emplace_back(new FixedPageAllocate{});
+    cases.emplace_back(new BufferPoolGet{});
+    cases.emplace_back(new HashCode{});
+    cases.emplace_back(new MurmurHash{16});
+    cases.emplace_back(new MurmurHash{100});
+
+    results_t results;
+    uint32_t regressions = 0;
+    std::printf("%-40s %12s %12s %9s\n", "case/threads", "ns/op", "baseline", "change");
+    for (const std::unique_ptr<Case> &test_case : cases) {
+        if (std::string{test_case->name()}.find(filter) == std::string::npos) {
+            continue;
+        }
+        auto num_ops = std::max<uint64_t>(static_cast<uint64_t>(scale * test_case->num_ops()), 1);
+        for (uint32_t num_threads : thread_counts) {
+            std::vector<double> runs;
+            for (uint32_t run = 0; run < repetitions; ++run) {
+                runs.push_back(RunOnce(*test_case, num_threads, num_ops));
+            }
+            std::sort(runs.begin(), runs.end());
+            double ns_per_op = runs[runs.size() / 2];
+            std::string key = std::string{test_case->name()} + "/" + std::to_string(num_threads);
+            results[key] = ns_per_op;
+
+            auto base = baseline.find(key);
+            if (base == baseline.end()) {
+                std::printf("%-40s %12.2f\n", key.c_str(), ns_per_op);
+                continue;
+            }
+            double change = (ns_per_op - base->second) / base->second * 100.0;
+            bool regressed = change > threshold;
+            regressions += regressed ? 1 : 0;
+            std::printf("%-40s %12.2f %12.2f %+8.1f%%%s\n", key.c_str(), ns_per_op, base->second, change,
+                        regressed ? "  REGRESSION" : "");
+        }
+    }
+
+    if (!save_path.empty()) {
+        std::ofstream out{save_path};
+        out << "# microbench baseline: <case>/<threads> <ns/op>\n";
+        for (const auto &result : results) {
+            out << result.first << " " << result.second << "\n";
+        }
+        if (!out) {
+            std::fprintf(stderr, "could not write %s\n", save_path.c_str());
+            return 1;
+        }
+    }
+    if (regressions > 0) {
+        std::printf("%" PRIu32 " regression(s) of more than %.1f%%\n", regressions, threshold);
+        return 1;
+    }
+    return 0;
+}
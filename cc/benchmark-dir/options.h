@@ -0,0 +1,413 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT license.
+
+#pragma once
+
+#include <cstdint>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include "core/address.h"
+#include "workload.h"
+
+namespace FASTER {
+namespace benchmark {
+
+/// Where worker threads run.
+enum class Affinity : uint8_t {
+    /// Wherever the OS puts them.
+    None = 0,
+    /// Thread i on the i-th CPU this process may use.
+    Compact,
+    /// Round-robin across NUMA nodes (same as Compact on a single node).
+    Scatter,
+};
+
+/// Where the store's memory comes from.
+enum class NumaPolicy : uint8_t {
+    /// The OS default.
+    Default = 0,
+    /// Each thread allocates on its own node.
+    Local,
+    /// Pages are spread across all nodes.
+    Interleave,
+};
+
+/// When an open-loop run's operations are due.
+enum class Arrivals : uint8_t {
+    /// Evenly spaced.
+    Fixed = 0,
+    /// A Poisson process (exponentially distributed gaps).
+    Poisson,
+};
+
+/// Report file format.
+enum class ReportFormat : uint8_t {
+    Json = 0,
+    Csv,
+};
+
+/// Everything the benchmark driver takes from the command line.
+struct BenchmarkOptions {
+    // Workload.
+    std::string workload = "a";
+    OperationMix mix;
+    Distribution distribution = Distribution::ScrambledZipfian;
+    double theta = 0.99;
+    /// For the hotspot distribution: "hot_op_fraction" of the operations go to the first
+    /// "hot_set_fraction" of the keys.
+    double hot_set_fraction = 0.2;
+    double hot_op_fraction = 0.8;
+    uint64_t num_records = 1000000;
+    /// The run phase stops after this many operations (if nonzero), or else after duration_s.
+    uint64_t num_ops = 0;
+    uint64_t duration_s = 30;
+    uint32_t key_size = 16;
+    uint32_t value_size = 100;
+    uint32_t max_scan_length = 100;
+    /// Each worker generates this many operations before the run phase, and cycles through them
+    /// (so that the run measures the store, not the generators); 0 generates them as they are
+    /// issued.
+    uint64_t pregenerate = 0;
+    /// Open-loop target rates (total ops/s); the run phase is repeated once per rate. Empty runs
+    /// closed-loop, issuing each operation as soon as the previous one returns.
+    std::vector<uint64_t> rates;
+    Arrivals arrivals = Arrivals::Fixed;
+    /// Replay these traces (see trace.h) instead of generating the load / run phase's operations.
+    std::string load_trace_path;
+    std::string trace_path;
+
+    // Threads.
+    uint32_t num_threads = 4;
+    Affinity affinity = Affinity::None;
+    NumaPolicy numa = NumaPolicy::Default;
+
+    // Store.
+    /// Hash table size (buckets, a power of two); 0 picks one from num_records.
+    uint64_t table_size = 0;
+    uint64_t log_size = 1ull << 30;
+    double mutable_fraction = 0.9;
+    /// Partitions (each with its own hash table and log lane).
+    uint32_t num_lanes = 4;
+    /// Run against the null disk (in memory), rather than files under "path".
+    bool null_disk = false;
+    std::string path = "storage";
+    /// Start a checkpoint this often during the run phase; 0 disables checkpoints.
+    uint64_t checkpoint_interval_s = 0;
+
+    // Output.
+    std::string report_path;
+    ReportFormat report_format = ReportFormat::Json;
+    /// Throughput is sampled this often.
+    uint64_t sample_interval_ms = 1000;
+    /// The store times every n-th operation of the run phase; 0 turns latency histograms off.
+    uint32_t latency_sample = 0;
+    /// Print the store's event counters (core/stats.h) this often during the run phase; 0 = never.
+    uint64_t stats_interval_ms = 0;
+    /// Count hardware events (perf_counters.h) on each worker, and report them per operation.
+    bool perf_counters = false;
+};
+
+inline const char *BenchmarkUsage() {
+    return
+            "Usage: benchmark [--option=value ...]\n"
+            "\n"
+            "Workload:\n"
+            "  --workload=a|b|c|d|e|f|rmw|insert|scan   mix and distribution preset (a)\n"
+            "  --read= --update= --insert= --scan= --rmw= --delete=\n"
+            "                                  percentages, replacing the preset's mix\n"
+            "  --distribution=uniform|zipfian|scrambled|latest|hotspot\n"
+            "                                  key distribution (preset's; YCSB's zipfian\n"
+            "                                  is scrambled)\n"
+            "  --theta=<0..1>                  zipfian skew (0.99)\n"
+            "  --hot-set=<0..1> --hot-ops=<0..1>\n"
+            "                                  hotspot: share of the keys that is hot (0.2),\n"
+            "                                  and of the operations that go to it (0.8)\n"
+            "  --records=<n>                   keys loaded before the run (1m)\n"
+            "  --ops=<n>                       run this many operations...\n"
+            "  --duration=<seconds>            ...or for this long (30)\n"
+            "  --key-size=<bytes>              at least 16 (16)\n"
+            "  --value-size=<bytes>            (100)\n"
+            "  --scan-length=<n>               scans read 1..n keys (100)\n"
+            "  --pregenerate=<n>               each worker generates n operations before the\n"
+            "                                  run, and cycles through them; 0 = off (0)\n"
+            "  --rate=<ops/s>[,<ops/s>...]    open loop: issue operations at this total rate,\n"
+            "                                  timing them from when they were due; one run\n"
+            "                                  per rate (closed loop)\n"
+            "  --arrivals=fixed|poisson        open-loop arrival process (fixed)\n"
+            "  --load-trace=<file>             load by replaying this trace (from trace_convert)\n"
+            "  --trace=<file>                  run by replaying this trace, once\n"
+            "\n"
+            "Threads:\n"
+            "  --threads=<n>                   worker threads (4)\n"
+            "  --affinity=none|compact|scatter thread pinning (none)\n"
+            "  --numa=default|local|interleave memory policy (default)\n"
+            "\n"
+            "Store:\n"
+            "  --table-size=<buckets>          hash table size (sized from --records, or\n"
+            "                                  the load trace)\n"
+            "  --log-size=<bytes>              in-memory log size, per lane; a multiple of 32m (1g)\n"
+            "  --mutable-fraction=<0..1>       of the in-memory log (0.9)\n"
+            "  --lanes=<n>                     hash partitions / log lanes, a power of two (4)\n"
+            "  --disk=file|null                (file)\n"
+            "  --path=<dir>                    log and checkpoint directory (storage)\n"
+            "  --checkpoint-interval=<seconds> checkpoint cadence during the run; 0 = off (0)\n"
+            "\n"
+            "Output:\n"
+            "  --report=<file>                 write results to this file\n"
+            "  --format=json|csv               report format (json)\n"
+            "  --sample-interval=<ms>          throughput sampling interval (1000)\n"
+            "  --latency-sample=<n>            time every n-th operation; 0 = off (0)\n"
+            "  --stats-interval=<ms>           print event counters this often; needs a\n"
+            "                                  FASTER_STATS build; 0 = off (0)\n"
+            "  --perf-counters=on|off          count cycles, cache and TLB misses, etc. per\n"
+            "                                  operation, where the OS allows (off)\n"
+            "\n"
+            "Counts and sizes take k, m, g suffixes (powers of 1000 for counts, of 1024 for\n"
+            "sizes).\n";
+}
+
+/// Parses "text" as an unsigned integer with an optional k/m/g suffix; "base" is 1000 or 1024.
+inline bool ParseCount(const std::string &text, uint64_t base, uint64_t &result) {
+    if (text.empty()) {
+        return false;
+    }
+    char *end;
+    uint64_t value = std::strtoull(text.c_str(), &end, 10);
+    if (end == text.c_str()) {
+        return false;
+    }
+    std::string suffix{end};
+    if (suffix == "k" || suffix == "K") {
+        value *= base;
+    } else if (suffix == "m" || suffix == "M") {
+        value *= base * base;
+    } else if (suffix == "g" || suffix == "G") {
+        value *= base * base * base;
+    } else if (!suffix.empty()) {
+        return false;
+    }
+    result = value;
+    return true;
+}
+
+inline bool ParseFraction(const std::string &text, double &result) {
+    char *end;
+    double value = std::strtod(text.c_str(), &end);
+    if (text.empty() || *end != '\0' || value < 0 || value > 1) {
+        return false;
+    }
+    result = value;
+    return true;
+}
+
+/// About two keys per bucket entry, once "num_records" are loaded.
+inline uint64_t DefaultTableSize(uint64_t num_records) {
+    uint64_t table_size = 1;
+    while (table_size < num_records / 2) {
+        table_size <<= 1;
+    }
+    return table_size;
+}
+
+/// Fills "options" from the command line. On failure, returns false with a message in "error"
+/// (empty, for --help).
+inline bool ParseBenchmarkOptions(int argc, char *argv[], BenchmarkOptions &options, std::string &error) {
+    WorkloadPreset(options.workload, options.mix, options.distribution);
+    OperationMix custom_mix;
+    bool has_custom_mix = false;
+    bool has_distribution = false;
+    Distribution distribution = options.distribution;
+
+    for (int idx = 1; idx < argc; ++idx) {
+        std::string arg{argv[idx]};
+        if (arg == "--help" || arg == "-h") {
+            error.clear();
+            return false;
+        }
+        size_t equals = arg.find('=');
+        if (arg.compare(0, 2, "--") != 0 || equals == std::string::npos) {
+            error = "expected --option=value, got \"" + arg + "\"";
+            return false;
+        }
+        std::string name = arg.substr(2, equals - 2);
+        std::string value = arg.substr(equals + 1);
+        uint64_t number = 0;
+        bool ok = true;
+
+        if (name == "workload") {
+            options.workload = value;
+            ok = WorkloadPreset(value, options.mix, options.distribution);
+        } else if (name == "read" || name == "update" || name == "insert" || name == "scan" ||
+                   name == "rmw" || name == "delete") {
+            Op op = name == "read" ? Op::Read : name == "update" ? Op::Update :
+                                                name == "insert" ? Op::Insert :
+                                                name == "scan" ? Op::Scan :
+                                                name == "rmw" ? Op::ReadModifyWrite : Op::Delete;
+            ok = ParseCount(value, 1000, number) && number <= 100;
+            custom_mix[op] = static_cast<uint32_t>(number);
+            has_custom_mix = true;
+        } else if (name == "distribution") {
+            has_distribution = true;
+            if (value == "uniform") {
+                distribution = Distribution::Uniform;
+            } else if (value == "zipfian") {
+                distribution = Distribution::Zipfian;
+            } else if (value == "scrambled") {
+                distribution = Distribution::ScrambledZipfian;
+            } else if (value == "latest") {
+                distribution = Distribution::Latest;
+            } else if (value == "hotspot") {
+                distribution = Distribution::Hotspot;
+            } else {
+                ok = false;
+            }
+        } else if (name == "theta") {
+            ok = ParseFraction(value, options.theta) && options.theta > 0 && options.theta < 1;
+        } else if (name == "hot-set") {
+            ok = ParseFraction(value, options.hot_set_fraction) && options.hot_set_fraction > 0;
+        } else if (name == "hot-ops") {
+            ok = ParseFraction(value, options.hot_op_fraction);
+        } else if (name == "pregenerate") {
+            ok = ParseCount(value, 1000, options.pregenerate);
+        } else if (name == "records") {
+            ok = ParseCount(value, 1000, options.num_records) && options.num_records > 0;
+        } else if (name == "ops") {
+            ok = ParseCount(value, 1000, options.num_ops);
+        } else if (name == "duration") {
+            ok = ParseCount(value, 1000, options.duration_s);
+        } else if (name == "key-size") {
+            ok = ParseCount(value, 1024, number) && number >= kMinKeySize && number <= UINT16_MAX;
+            options.key_size = static_cast<uint32_t>(number);
+        } else if (name == "value-size") {
+            ok = ParseCount(value, 1024, number) && number >= sizeof(uint64_t) && number <= UINT16_MAX;
+            options.value_size = static_cast<uint32_t>(number);
+        } else if (name == "scan-length") {
+            ok = ParseCount(value, 1000, number) && number > 0 && number <= UINT32_MAX;
+            options.max_scan_length = static_cast<uint32_t>(number);
+        } else if (name == "rate") {
+            options.rates.clear();
+            for (size_t begin = 0; ok && begin <= value.size();) {
+                size_t comma = value.find(',', begin);
+                size_t end = comma == std::string::npos ? value.size() : comma;
+                ok = ParseCount(value.substr(begin, end - begin), 1000, number) && number > 0;
+                options.rates.push_back(number);
+                begin = end + 1;
+            }
+        } else if (name == "arrivals") {
+            ok = value == "fixed" || value == "poisson";
+            options.arrivals = value == "poisson" ? Arrivals::Poisson : Arrivals::Fixed;
+        } else if (name == "load-trace") {
+            options.load_trace_path = value;
+        } else if (name == "trace") {
+            options.trace_path = value;
+        } else if (name == "threads") {
+            ok = ParseCount(value, 1000, number) && number > 0 && number <= 1024;
+            options.num_threads = static_cast<uint32_t>(number);
+        } else if (name == "affinity") {
+            if (value == "none") {
+                options.affinity = Affinity::None;
+            } else if (value == "compact") {
+                options.affinity = Affinity::Compact;
+            } else if (value == "scatter") {
+                options.affinity = Affinity::Scatter;
+            } else {
+                ok = false;
+            }
+        } else if (name == "numa") {
+            if (value == "default") {
+                options.numa = NumaPolicy::Default;
+            } else if (value == "local") {
+                options.numa = NumaPolicy::Local;
+            } else if (value == "interleave") {
+                options.numa = NumaPolicy::Interleave;
+            } else {
+                ok = false;
+            }
+        } else if (name == "table-size") {
+            ok = ParseCount(value, 1024, options.table_size) &&
+                 (options.table_size & (options.table_size - 1)) == 0;
+        } else if (name == "log-size") {
+            ok = ParseCount(value, 1024, options.log_size) && options.log_size > 0;
+        } else if (name == "mutable-fraction") {
+            ok = ParseFraction(value, options.mutable_fraction);
+        } else if (name == "lanes") {
+            // (Keys are split among the lanes by hash-table index.)
+            ok = ParseCount(value, 1000, number) && number > 0 && number <= 32 && (number & (number - 1)) == 0;
+            options.num_lanes = static_cast<uint32_t>(number);
+        } else if (name == "disk") {
+            ok = value == "file" || value == "null";
+            options.null_disk = value == "null";
+        } else if (name == "path") {
+            options.path = value;
+        } else if (name == "checkpoint-interval") {
+            ok = ParseCount(value, 1000, options.checkpoint_interval_s);
+        } else if (name == "report") {
+            options.report_path = value;
+        } else if (name == "format") {
+            ok = value == "json" || value == "csv";
+            options.report_format = value == "csv" ? ReportFormat::Csv : ReportFormat::Json;
+        } else if (name == "latency-sample") {
+            ok = ParseCount(value, 1000, number) && number <= UINT32_MAX;
+            options.latency_sample = static_cast<uint32_t>(number);
+        } else if (name == "stats-interval") {
+            ok = ParseCount(value, 1000, options.stats_interval_ms);
+        } else if (name == "perf-counters") {
+            ok = value == "on" || value == "off";
+            options.perf_counters = value == "on";
+        } else if (name == "sample-interval") {
+            ok = ParseCount(value, 1000, options.sample_interval_ms) && options.sample_interval_ms > 0;
+        } else {
+            error = "unknown option --" + name;
+            return false;
+        }
+        if (!ok) {
+            error = "bad value for --" + name + ": \"" + value + "\"";
+            return false;
+        }
+    }
+
+    if (!options.rates.empty() && !options.trace_path.empty()) {
+        error = "--rate does not apply to --trace";
+        return false;
+    }
+    if (has_custom_mix) {
+        if (custom_mix.Total() != 100) {
+            error = "operation percentages add up to " + std::to_string(custom_mix.Total()) + ", not 100";
+            return false;
+        }
+        options.mix = custom_mix;
+        options.workload = "custom";
+    }
+    if (has_distribution) {
+        options.distribution = distribution;
+    }
+    if (options.table_size == 0 && options.load_trace_path.empty()) {
+        options.table_size = DefaultTableSize(options.num_records);
+    }
+    // (With a load trace, and no --table-size, the table is sized once the trace is opened.)
+    if (options.table_size != 0 && options.table_size < options.num_lanes) {
+        error = "--table-size must be at least --lanes";
+        return false;
+    }
+    // The store's own checks, so they fail here with a message instead of as an exception. Also,
+    // the head address can only advance past pages that have been flushed, and those must first
+    // become read-only; with fewer than two read-only pages, the log fills up and stops once the
+    // records no longer fit in memory.
+    const uint64_t page_size = core::Address::kMaxOffset + 1;
+    uint64_t num_pages = options.log_size / page_size;
+    auto num_mutable_pages = static_cast<uint64_t>(options.mutable_fraction * num_pages);
+    if (options.log_size % page_size != 0 || num_pages < 6) {
+        error = "--log-size must be a multiple of 32m, and at least 192m";
+        return false;
+    }
+    if (num_mutable_pages < 2 || num_mutable_pages + 2 > num_pages) {
+        error = "--mutable-fraction must leave at least two 32m pages mutable, and two not";
+        return false;
+    }
+    return true;
+}
+
+}
+} // namespace FASTER::benchmark
@@ -0,0 +1,253 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT license.
+
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <cerrno>
+#endif
+
+namespace FASTER {
+namespace benchmark {
+
+/// Hardware events the benchmark can count (--perf-counters), per worker thread.
+enum class PerfEvent : uint8_t {
+    Cycles = 0,
+    Instructions,
+    BranchMisses,
+    L1dMisses,
+    LlcMisses,
+    DtlbMisses,
+    /// Loads served from another NUMA node (perf's "node-load-misses").
+    RemoteNodeLoads,
+};
+
+static constexpr uint32_t kNumPerfEvents = 7;
+
+inline const char *PerfEventName(PerfEvent event) {
+    switch (event) {
+        case PerfEvent::Cycles:
+            return "cycles";
+        case PerfEvent::Instructions:
+            return "instructions";
+        case PerfEvent::BranchMisses:
+            return "branch_misses";
+        case PerfEvent::L1dMisses:
+            return "l1d_misses";
+        case PerfEvent::LlcMisses:
+            return "llc_misses";
+        case PerfEvent::DtlbMisses:
+            return "dtlb_misses";
+        case PerfEvent::RemoteNodeLoads:
+            return "remote_node_loads";
+    }
+    return "unknown";
+}
+
+/// Event counts, summed over the threads that counted them. An event the CPU (or kernel, or
+/// hypervisor) does not offer is not "available", and its count is 0.
+struct PerfCounts {
+    PerfCounts()
+            : values{}, available{}, num_threads{0} {
+    }
+
+    PerfCounts &operator+=(const PerfCounts &other) {
+        for (uint32_t idx = 0; idx < kNumPerfEvents; ++idx) {
+            values[idx] += other.values[idx];
+            // Available only if every thread counted it.
+            available[idx] = other.available[idx] && (available[idx] || num_threads == 0);
+        }
+        num_threads += other.num_threads;
+        return *this;
+    }
+
+    inline bool has(PerfEvent event) const {
+        return available[static_cast<uint8_t>(event)];
+    }
+
+    inline uint64_t operator[](PerfEvent event) const {
+        return values[static_cast<uint8_t>(event)];
+    }
+
+    uint64_t values[kNumPerfEvents];
+    bool available[kNumPerfEvents];
+    /// Threads whose counts these are (0: nothing was counted).
+    uint32_t num_threads;
+};
+
+#ifdef __linux__
+/// How to count a PerfEvent, and which PerfCounterGroup group it goes in.
+struct PerfEventSpec {
+    uint32_t type;
+    uint64_t config;
+    uint32_t group;
+};
+
+constexpr uint64_t PerfCacheReadMisses(uint64_t cache) {
+    return cache | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+}
+
+/// Per PerfEvent.
+static constexpr PerfEventSpec kPerfEventSpecs[kNumPerfEvents] = {
+        {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES, 0},
+        {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS, 0},
+        {PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES, 0},
+        {PERF_TYPE_HW_CACHE, PerfCacheReadMisses(PERF_COUNT_HW_CACHE_L1D), 1},
+        {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES, 1},
+        {PERF_TYPE_HW_CACHE, PerfCacheReadMisses(PERF_COUNT_HW_CACHE_DTLB), 1},
+        {PERF_TYPE_HW_CACHE, PerfCacheReadMisses(PERF_COUNT_HW_CACHE_NODE), 1},
+};
+#endif
+
+/// Counts hardware events on the calling thread, with perf_event_open (Linux only), in two
+/// groups--cycles, instructions, and branch misses; and the cache, TLB, and NUMA misses--so that
+/// each group's events are counted over the same intervals, and ratios within a group (such as
+/// instructions per cycle) hold even when the kernel has to time-share the hardware counters.
+/// Counts are scaled up by the share of the time each group was actually counting.
+///
+/// Only user-space events count (so that the default perf_event_paranoid setting, 2, allows
+/// them). Events the machine does not offer are skipped; Open() fails only if none can be
+/// counted, or counting isn't permitted at all.
+class PerfCounterGroup {
+public:
+    static constexpr uint32_t kNumGroups = 2;
+
+    PerfCounterGroup() {
+        for (int &fd : fds_) {
+            fd = -1;
+        }
+        for (int &fd : leader_fds_) {
+            fd = -1;
+        }
+    }
+
+    ~PerfCounterGroup() {
+        Close();
+    }
+
+    PerfCounterGroup(const PerfCounterGroup &other) = delete;
+
+    /// Opens the counters, for the calling thread; on failure, sets "error" and returns false.
+    bool Open(std::string &error) {
+        Close();
+#ifdef __linux__
+        int first_errno = 0;
+        bool any_open = false;
+        for (uint32_t idx = 0; idx < kNumPerfEvents; ++idx) {
+            const PerfEventSpec &spec = kPerfEventSpecs[idx];
+            // (Whichever event of a group opens first leads it.)
+            int leader = leader_fds_[spec.group];
+            perf_event_attr attr;
+            std::memset(&attr, 0, sizeof(attr));
+            attr.size = sizeof(attr);
+            attr.type = spec.type;
+            attr.config = spec.config;
+            attr.disabled = leader < 0 ? 1 : 0;
+            attr.exclude_kernel = 1;
+            attr.exclude_hv = 1;
+            attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_ID | PERF_FORMAT_TOTAL_TIME_ENABLED |
+                               PERF_FORMAT_TOTAL_TIME_RUNNING;
+            auto fd = static_cast<int>(::syscall(__NR_perf_event_open, &attr, 0, -1, leader, 0));
+            if (fd < 0) {
+                first_errno = first_errno == 0 ? errno : first_errno;
+                continue;
+            }
+            if (leader < 0) {
+                leader_fds_[spec.group] = fd;
+            }
+            fds_[idx] = fd;
+            ::ioctl(fd, PERF_EVENT_IOC_ID, &ids_[idx]);
+            any_open = true;
+        }
+        if (!any_open) {
+            error = std::string{"could not open hardware counters ("} + std::strerror(first_errno) + ")";
+            if (first_errno == EACCES || first_errno == EPERM) {
+                error += "; see /proc/sys/kernel/perf_event_paranoid";
+            }
+            return false;
+        }
+        return true;
+#else
+        error = "hardware counters need Linux";
+        return false;
+#endif
+    }
+
+    /// Zeroes the counts, and starts counting.
+    void Start() {
+#ifdef __linux__
+        for (int leader : leader_fds_) {
+            if (leader >= 0) {
+                ::ioctl(leader, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+                ::ioctl(leader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+            }
+        }
+#endif
+    }
+
+    /// Stops counting, and returns the counts since Start().
+    PerfCounts Stop() {
+        PerfCounts result;
+#ifdef __linux__
+        for (int leader : leader_fds_) {
+            if (leader < 0) {
+                continue;
+            }
+            ::ioctl(leader, PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+            // nr, time_enabled, time_running, then {value, id} per event.
+            uint64_t data[3 + 2 * kNumPerfEvents];
+            ssize_t size = ::read(leader, data, sizeof(data));
+            if (size < static_cast<ssize_t>(3 * sizeof(uint64_t)) || data[2] == 0) {
+                // The group never got the hardware; count nothing, rather than guess.
+                continue;
+            }
+            double scale = static_cast<double>(data[1]) / static_cast<double>(data[2]);
+            for (uint64_t entry = 0; entry < data[0] && entry < kNumPerfEvents; ++entry) {
+                for (uint32_t idx = 0; idx < kNumPerfEvents; ++idx) {
+                    if (fds_[idx] >= 0 && ids_[idx] == data[4 + 2 * entry]) {
+                        result.values[idx] = static_cast<uint64_t>(static_cast<double>(data[3 + 2 * entry]) * scale);
+                        result.available[idx] = true;
+                    }
+                }
+            }
+        }
+        result.num_threads = 1;
+#endif
+        return result;
+    }
+
+private:
+    void Close() {
+#ifdef __linux__
+        for (int fd : fds_) {
+            if (fd >= 0) {
+                ::close(fd);
+            }
+        }
+#endif
+        for (int &fd : fds_) {
+            fd = -1;
+        }
+        for (int &fd : leader_fds_) {
+            fd = -1;
+        }
+    }
+
+    /// Per PerfEvent; -1 if it isn't counted.
+    int fds_[kNumPerfEvents];
+    int leader_fds_[kNumGroups];
+#ifdef __linux__
+    uint64_t ids_[kNumPerfEvents];
+#endif
+};
+
+}
+} // namespace FASTER::benchmark
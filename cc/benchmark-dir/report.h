@@ -0,0 +1,312 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT license.
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "options.h"
+#include "perf_counters.h"
+#include "workload.h"
+
+namespace FASTER {
+namespace benchmark {
+
+/// Operation counts, summed over a phase's worker threads.
+struct OperationCounts {
+    OperationCounts()
+            : issued{}, found{0}, not_found{0}, pending{0}, scanned{0} {
+    }
+
+    OperationCounts &operator+=(const OperationCounts &other) {
+        for (uint32_t idx = 0; idx < kNumOps; ++idx) {
+            issued[idx] += other.issued[idx];
+        }
+        found += other.found;
+        not_found += other.not_found;
+        pending += other.pending;
+        scanned += other.scanned;
+        return *this;
+    }
+
+    uint64_t Total() const {
+        uint64_t total = 0;
+        for (uint32_t idx = 0; idx < kNumOps; ++idx) {
+            total += issued[idx];
+        }
+        return total;
+    }
+
+    uint64_t issued[kNumOps];
+    /// Reads (including those of RMWs) that found / did not find their key.
+    uint64_t found;
+    uint64_t not_found;
+    /// Operations that went pending (to disk, or to be retried).
+    uint64_t pending;
+    /// Records returned by scans.
+    uint64_t scanned;
+};
+
+/// Throughput over one sampling interval.
+struct TimelineSample {
+    std::string phase;
+    /// Since the start of the phase, at the end of the interval.
+    double elapsed_s;
+    uint64_t ops;
+    double ops_per_s;
+};
+
+struct PhaseResult {
+    std::string name;
+    double seconds;
+    OperationCounts counts;
+    uint64_t checkpoints;
+    /// Hardware events, summed over the workers that could count them (--perf-counters).
+    PerfCounts perf;
+
+    double OpsPerSecond() const {
+        return seconds > 0 ? static_cast<double>(counts.Total()) / seconds : 0;
+    }
+};
+
+/// Latency percentiles of one operation and outcome, from the store's histograms.
+struct LatencySummary {
+    std::string op;
+    std::string outcome;
+    uint64_t count;
+    double mean_ns;
+    double p50_ns;
+    double p99_ns;
+    double p999_ns;
+    double max_ns;
+};
+
+/// One open-loop run: the throughput it achieved at a target rate, and its latencies, measured
+/// from when each operation was due (so that time spent behind schedule counts).
+struct OpenLoopSummary {
+    std::string phase;
+    uint64_t target_ops_per_s;
+    double ops_per_s;
+    uint64_t count;
+    double p50_ns;
+    double p99_ns;
+    double p999_ns;
+    double max_ns;
+};
+
+/// The benchmark's results, written as JSON (everything) or CSV (the timeline, plus one row per
+/// phase for its totals) so that runs can be compared across builds.
+class BenchmarkReport {
+public:
+    BenchmarkReport(const BenchmarkOptions &options)
+            : options_{options} {
+    }
+
+    void AddPhase(const PhaseResult &phase) {
+        phases_.push_back(phase);
+    }
+
+    void AddOpenLoop(const OpenLoopSummary &summary) {
+        open_loop_.push_back(summary);
+    }
+
+    void AddSample(const TimelineSample &sample) {
+        timeline_.push_back(sample);
+    }
+
+    void AddLatency(const LatencySummary &latency) {
+        latencies_.push_back(latency);
+    }
+
+    const std::vector<PhaseResult> &phases() const {
+        return phases_;
+    }
+
+    void WriteJson(std::ostream &out) const {
+        out << "{\n";
+        out << "  \"build\": {\"compiler\": " << Quote(Compiler()) << ", \"debug\": " <<
+            (IsDebugBuild() ? "true" : "false") << "},\n";
+        out << "  \"config\": {\n";
+        out << "    \"workload\": " << Quote(options_.workload) << ",\n";
+        out << "    \"mix\": {";
+        for (uint32_t idx = 0; idx < kNumOps; ++idx) {
+            out << (idx > 0 ? ", " : "") << Quote(OpName(static_cast<Op>(idx))) << ": " << options_.mix.percent[idx];
+        }
+        out << "},\n";
+        out << "    \"distribution\": " << Quote(DistributionName(options_.distribution)) << ",\n";
+        out << "    \"theta\": " << options_.theta << ",\n";
+        out << "    \"hot_set\": " << options_.hot_set_fraction << ",\n";
+        out << "    \"hot_ops\": " << options_.hot_op_fraction << ",\n";
+        out << "    \"pregenerate\": " << options_.pregenerate << ",\n";
+        out << "    \"records\": " << options_.num_records << ",\n";
+        out << "    \"ops\": " << options_.num_ops << ",\n";
+        out << "    \"duration_s\": " << options_.duration_s << ",\n";
+        out << "    \"key_size\": " << options_.key_size << ",\n";
+        out << "    \"value_size\": " << options_.value_size << ",\n";
+        out << "    \"scan_length\": " << options_.max_scan_length << ",\n";
+        out << "    \"rates\": [";
+        for (size_t idx = 0; idx < options_.rates.size(); ++idx) {
+            out << (idx > 0 ? ", " : "") << options_.rates[idx];
+        }
+        out << "],\n";
+        out << "    \"arrivals\": " << Quote(options_.arrivals == Arrivals::Poisson ? "poisson" : "fixed") << ",\n";
+        out << "    \"load_trace\": " << Quote(options_.load_trace_path) << ",\n";
+        out << "    \"trace\": " << Quote(options_.trace_path) << ",\n";
+        out << "    \"threads\": " << options_.num_threads << ",\n";
+        out << "    \"affinity\": " << Quote(AffinityName(options_.affinity)) << ",\n";
+        out << "    \"numa\": " << Quote(NumaPolicyName(options_.numa)) << ",\n";
+        out << "    \"table_size\": " << options_.table_size << ",\n";
+        out << "    \"log_size\": " << options_.log_size << ",\n";
+        out << "    \"mutable_fraction\": " << options_.mutable_fraction << ",\n";
+        out << "    \"lanes\": " << options_.num_lanes << ",\n";
+        out << "    \"disk\": " << Quote(options_.null_disk ? "null" : "file") << ",\n";
+        out << "    \"checkpoint_interval_s\": " << options_.checkpoint_interval_s << ",\n";
+        out << "    \"latency_sample\": " << options_.latency_sample << ",\n";
+        out << "    \"perf_counters\": " << (options_.perf_counters ? "true" : "false") << "\n";
+        out << "  },\n";
+        out << "  \"phases\": [";
+        for (size_t idx = 0; idx < phases_.size(); ++idx) {
+            const PhaseResult &phase = phases_[idx];
+            out << (idx > 0 ? "," : "") << "\n    {\"name\": " << Quote(phase.name) <<
+                ", \"seconds\": " << phase.seconds <<
+                ", \"ops\": " << phase.counts.Total() <<
+                ", \"ops_per_s\": " << phase.OpsPerSecond() << ",\n     \"issued\": {";
+            for (uint32_t op = 0; op < kNumOps; ++op) {
+                out << (op > 0 ? ", " : "") << Quote(OpName(static_cast<Op>(op))) << ": " <<
+                    phase.counts.issued[op];
+            }
+            out << "},\n     \"found\": " << phase.counts.found <<
+                ", \"not_found\": " << phase.counts.not_found <<
+                ", \"pending\": " << phase.counts.pending <<
+                ", \"scanned\": " << phase.counts.scanned <<
+                ", \"checkpoints\": " << phase.checkpoints;
+            if (phase.perf.num_threads > 0) {
+                WritePerf(out, phase);
+            }
+            out << "}";
+        }
+        out << "\n  ],\n";
+        out << "  \"latency\": [";
+        for (size_t idx = 0; idx < latencies_.size(); ++idx) {
+            const LatencySummary &latency = latencies_[idx];
+            out << (idx > 0 ? "," : "") << "\n    {\"op\": " << Quote(latency.op) <<
+                ", \"outcome\": " << Quote(latency.outcome) <<
+                ", \"count\": " << latency.count <<
+                ", \"mean_ns\": " << latency.mean_ns <<
+                ", \"p50_ns\": " << latency.p50_ns <<
+                ", \"p99_ns\": " << latency.p99_ns <<
+                ", \"p999_ns\": " << latency.p999_ns <<
+                ", \"max_ns\": " << latency.max_ns << "}";
+        }
+        out << "\n  ],\n";
+        out << "  \"open_loop\": [";
+        for (size_t idx = 0; idx < open_loop_.size(); ++idx) {
+            const OpenLoopSummary &summary = open_loop_[idx];
+            out << (idx > 0 ? "," : "") << "\n    {\"phase\": " << Quote(summary.phase) <<
+                ", \"target_ops_per_s\": " << summary.target_ops_per_s <<
+                ", \"ops_per_s\": " << summary.ops_per_s <<
+                ", \"count\": " << summary.count <<
+                ", \"p50_ns\": " << summary.p50_ns <<
+                ", \"p99_ns\": " << summary.p99_ns <<
+                ", \"p999_ns\": " << summary.p999_ns <<
+                ", \"max_ns\": " << summary.max_ns << "}";
+        }
+        out << "\n  ],\n";
+        out << "  \"timeline\": [";
+        for (size_t idx = 0; idx < timeline_.size(); ++idx) {
+            const TimelineSample &sample = timeline_[idx];
+            out << (idx > 0 ? "," : "") << "\n    {\"phase\": " << Quote(sample.phase) <<
+                ", \"elapsed_s\": " << sample.elapsed_s <<
+                ", \"ops\": " << sample.ops <<
+                ", \"ops_per_s\": " << sample.ops_per_s << "}";
+        }
+        out << "\n  ]\n";
+        out << "}\n";
+    }
+
+    void WriteCsv(std::ostream &out) const {
+        out << "phase,elapsed_s,ops,ops_per_s\n";
+        for (const TimelineSample &sample : timeline_) {
+            out << sample.phase << "," << sample.elapsed_s << "," << sample.ops << "," << sample.ops_per_s << "\n";
+        }
+        for (const PhaseResult &phase : phases_) {
+            out << phase.name << "-total," << phase.seconds << "," << phase.counts.Total() << "," <<
+                phase.OpsPerSecond() << "\n";
+        }
+    }
+
+private:
+    /// The phase's hardware event counts, per operation; events that weren't counted are left out.
+    static void WritePerf(std::ostream &out, const PhaseResult &phase) {
+        double ops = static_cast<double>(std::max<uint64_t>(phase.counts.Total(), 1));
+        out << ",\n     \"perf\": {\"threads\": " << phase.perf.num_threads << ", \"per_op\": {";
+        bool first = true;
+        for (uint32_t idx = 0; idx < kNumPerfEvents; ++idx) {
+            if (phase.perf.available[idx]) {
+                out << (first ? "" : ", ") << Quote(PerfEventName(static_cast<PerfEvent>(idx))) << ": " <<
+                    static_cast<double>(phase.perf.values[idx]) / ops;
+                first = false;
+            }
+        }
+        out << "}}";
+    }
+
+    static std::string Quote(const std::string &text) {
+        std::string result = "\"";
+        for (char c : text) {
+            if (c == '"' || c == '\\') {
+                result += '\\';
+                result += c;
+            } else if (static_cast<unsigned char>(c) < 0x20) {
+                char escaped[8];
+                std::snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+                result += escaped;
+            } else {
+                result += c;
+            }
+        }
+        return result + "\"";
+    }
+
+    static const char *AffinityName(Affinity affinity) {
+        return affinity == Affinity::Compact ? "compact" : affinity == Affinity::Scatter ? "scatter" : "none";
+    }
+
+    static const char *NumaPolicyName(NumaPolicy numa) {
+        return numa == NumaPolicy::Local ? "local" : numa == NumaPolicy::Interleave ? "interleave" : "default";
+    }
+
+    static std::string Compiler() {
+#if defined(__clang__)
+        return std::string{"clang "} + __clang_version__;
+#elif defined(__GNUC__)
+        return std::string{"gcc "} + __VERSION__;
+#elif defined(_MSC_VER)
+        return "msvc " + std::to_string(_MSC_VER);
+#else
+        return "unknown";
+#endif
+    }
+
+    static bool IsDebugBuild() {
+#ifdef NDEBUG
+        return false;
+#else
+        return true;
+#endif
+    }
+
+    const BenchmarkOptions &options_;
+    std::vector<PhaseResult> phases_;
+    std::vector<TimelineSample> timeline_;
+    std::vector<OpenLoopSummary> open_loop_;
+    std::vector<LatencySummary> latencies_;
+};
+
+}
+} // namespace FASTER::benchmark
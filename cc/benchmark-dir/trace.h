@@ -0,0 +1,267 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT license.
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+#ifdef _WIN32
+#define NOMINMAX
+#define _WINSOCKAPI_
+#include <Windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include "workload.h"
+
+namespace FASTER {
+namespace benchmark {
+
+/// A workload trace, for replay by the benchmark (--trace, --load-trace): a TraceHeader, then
+/// "num_records" fixed-size TraceRecords, then (if the header's kTraceHasTimestamps flag is set)
+/// one uint64_t timestamp per record. Everything is little-endian, and the file is used in place,
+/// memory-mapped, so replaying it allocates nothing per operation. "trace_convert" writes traces
+/// from the output of YCSB's "basic" driver.
+static constexpr char kTraceMagic[8] = {'F', 'A', 'S', 'T', 'E', 'R', 'T', 'R'};
+static constexpr uint32_t kTraceVersion = 1;
+/// Records have (arrival) timestamps, in nanoseconds.
+static constexpr uint32_t kTraceHasTimestamps = 1;
+
+struct TraceHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t flags;
+    uint64_t num_records;
+    /// The largest TraceRecord::length of an insert or update; replay needs a value buffer this big.
+    uint32_t max_value_size;
+    uint32_t reserved1;
+    /// Number of records of each Op (so that the benchmark knows, for example, whether it needs
+    /// the ordered index for scans, without reading the records).
+    uint64_t op_counts[8];
+    uint64_t reserved2[4];
+};
+
+static_assert(sizeof(TraceHeader) == 128, "sizeof(TraceHeader) != 128");
+static_assert(kNumOps <= 8, "TraceHeader::op_counts is too small");
+
+struct TraceRecord {
+    /// Formatted, on replay, with FormatKey().
+    uint64_t key;
+    /// Value size, for inserts and updates; number of records, for scans; otherwise 0.
+    uint32_t length;
+    /// An Op.
+    uint8_t op;
+    uint8_t reserved[3];
+};
+
+static_assert(sizeof(TraceRecord) == 16, "sizeof(TraceRecord) != 16");
+
+/// Size of a trace file with "num_records" records.
+inline uint64_t TraceFileSize(uint64_t num_records, bool has_timestamps) {
+    return sizeof(TraceHeader) + num_records * (sizeof(TraceRecord) + (has_timestamps ? sizeof(uint64_t) : 0));
+}
+
+/// "op_counts" has kNumOps entries.
+inline TraceHeader MakeTraceHeader(const uint64_t *op_counts, uint32_t max_value_size, bool has_timestamps) {
+    TraceHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, kTraceMagic, sizeof(kTraceMagic));
+    header.version = kTraceVersion;
+    header.flags = has_timestamps ? kTraceHasTimestamps : 0;
+    for (uint32_t idx = 0; idx < kNumOps; ++idx) {
+        header.op_counts[idx] = op_counts[idx];
+        header.num_records += op_counts[idx];
+    }
+    header.max_value_size = max_value_size;
+    return header;
+}
+
+/// A trace file, mapped read-only.
+class TraceFile {
+public:
+    TraceFile()
+            : data_{nullptr}, size_{0}, header_{nullptr}, records_{nullptr}, timestamps_{nullptr} {
+#ifdef _WIN32
+        file_handle_ = INVALID_HANDLE_VALUE;
+        mapping_handle_ = nullptr;
+#endif
+    }
+
+    ~TraceFile() {
+        Close();
+    }
+
+    TraceFile(const TraceFile &other) = delete;
+
+    /// Maps "path" and checks its header; on failure, sets "error" and returns false.
+    bool Open(const std::string &path, std::string &error) {
+        Close();
+        if (!Map(path, error)) {
+            Close();
+            return false;
+        }
+        header_ = reinterpret_cast<const TraceHeader *>(data_);
+        if (size_ < sizeof(TraceHeader) || std::memcmp(header_->magic, kTraceMagic, sizeof(kTraceMagic)) != 0) {
+            error = path + " is not a trace file";
+        } else if (header_->version != kTraceVersion) {
+            error = path + " has trace version " + std::to_string(header_->version) + ", not " +
+                    std::to_string(kTraceVersion);
+        } else if (size_ != TraceFileSize(header_->num_records, has_timestamps())) {
+            error = path + " is truncated (or has trailing bytes)";
+        } else {
+            records_ = reinterpret_cast<const TraceRecord *>(data_ + sizeof(TraceHeader));
+            if (has_timestamps()) {
+                timestamps_ = reinterpret_cast<const uint64_t *>(records_ + header_->num_records);
+            }
+            return true;
+        }
+        Close();
+        return false;
+    }
+
+    inline uint64_t size() const {
+        return header_ ? header_->num_records : 0;
+    }
+
+    inline uint32_t max_value_size() const {
+        return header_ ? header_->max_value_size : 0;
+    }
+
+    inline uint64_t op_count(Op op) const {
+        return header_ ? header_->op_counts[static_cast<uint8_t>(op)] : 0;
+    }
+
+    inline bool has_timestamps() const {
+        return header_ && (header_->flags & kTraceHasTimestamps) != 0;
+    }
+
+    inline const TraceRecord &record(uint64_t idx) const {
+        return records_[idx];
+    }
+
+    /// Only if has_timestamps().
+    inline uint64_t timestamp(uint64_t idx) const {
+        return timestamps_[idx];
+    }
+
+private:
+    bool Map(const std::string &path, std::string &error) {
+#ifdef _WIN32
+        file_handle_ = ::CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                                     FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+        LARGE_INTEGER file_size;
+        if (file_handle_ == INVALID_HANDLE_VALUE || !::GetFileSizeEx(file_handle_, &file_size)) {
+            error = "could not open " + path;
+            return false;
+        }
+        size_ = static_cast<uint64_t>(file_size.QuadPart);
+        if (size_ == 0) {
+            return true;
+        }
+        mapping_handle_ = ::CreateFileMappingA(file_handle_, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (mapping_handle_) {
+            data_ = static_cast<const uint8_t *>(::MapViewOfFile(mapping_handle_, FILE_MAP_READ, 0, 0, 0));
+        }
+        if (!data_) {
+            error = "could not map " + path;
+            return false;
+        }
+#else
+        int fd = ::open(path.c_str(), O_RDONLY);
+        struct stat file_stat;
+        if (fd < 0 || ::fstat(fd, &file_stat) != 0) {
+            if (fd >= 0) {
+                ::close(fd);
+            }
+            error = "could not open " + path;
+            return false;
+        }
+        size_ = static_cast<uint64_t>(file_stat.st_size);
+        if (size_ == 0) {
+            ::close(fd);
+            return true;
+        }
+        void *data = ::mmap(nullptr, size_, PROT_READ, MAP_SHARED, fd, 0);
+        // (The mapping keeps the file open.)
+        ::close(fd);
+        if (data == MAP_FAILED) {
+            error = "could not map " + path;
+            return false;
+        }
+        data_ = static_cast<const uint8_t *>(data);
+        // Workers read it front to back (in interleaved batches).
+        ::madvise(data, size_, MADV_SEQUENTIAL);
+#endif
+        return true;
+    }
+
+    void Close() {
+#ifdef _WIN32
+        if (data_) {
+            ::UnmapViewOfFile(data_);
+        }
+        if (mapping_handle_) {
+            ::CloseHandle(mapping_handle_);
+        }
+        if (file_handle_ != INVALID_HANDLE_VALUE) {
+            ::CloseHandle(file_handle_);
+        }
+        file_handle_ = INVALID_HANDLE_VALUE;
+        mapping_handle_ = nullptr;
+#else
+        if (data_) {
+            ::munmap(const_cast<uint8_t *>(data_), size_);
+        }
+#endif
+        data_ = nullptr;
+        size_ = 0;
+        header_ = nullptr;
+        records_ = nullptr;
+        timestamps_ = nullptr;
+    }
+
+#ifdef _WIN32
+    HANDLE file_handle_;
+    HANDLE mapping_handle_;
+#endif
+    const uint8_t *data_;
+    uint64_t size_;
+    const TraceHeader *header_;
+    const TraceRecord *records_;
+    const uint64_t *timestamps_;
+};
+
+/// Hands out a trace's records to worker threads, in batches, in order: each call to Next()
+/// claims the next batch. Workers then read the batch's records in place.
+class TraceCursor {
+public:
+    static constexpr uint64_t kBatchSize = 1024;
+
+    TraceCursor(const TraceFile &trace)
+            : trace_{trace}, next_{0} {
+    }
+
+    /// Claims records [begin, end); returns false once the trace is used up.
+    inline bool Next(uint64_t &begin, uint64_t &end) {
+        begin = next_.fetch_add(kBatchSize, std::memory_order_relaxed);
+        if (begin >= trace_.size()) {
+            return false;
+        }
+        end = std::min(begin + kBatchSize, trace_.size());
+        return true;
+    }
+
+private:
+    const TraceFile &trace_;
+    std::atomic<uint64_t> next_;
+};
+
+}
+} // namespace FASTER::benchmark
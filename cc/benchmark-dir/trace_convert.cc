@@ -0,0 +1,356 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT license.
+
+#include <algorithm>
+#include <cinttypes>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "trace.h"
+
+using namespace FASTER::benchmark;
+
+/// Converts the output of YCSB's "basic" driver (both "load" and "run") to a trace for the
+/// benchmark's --load-trace and --trace. Lines look like
+///
+///   INSERT usertable user5575651532496486335 [ field0=... field1=... ]
+///   READ usertable user5575651532496486335 [ <all fields>]
+///   SCAN usertable user5575651532496486335 73 [ <all fields>]
+///
+/// and become (op, key number, value size or scan length) records; other lines are skipped. With
+/// --timestamps, each line starts with an arrival time in nanoseconds, which the trace keeps.
+///
+/// The input is split among the threads at line boundaries. Each thread parses its part twice:
+/// first to count its records, so that it knows where in the output they go, then to write them.
+
+static constexpr uint64_t kWriteBatchSize = 64 * 1024;
+
+static const char *const kUsage =
+        "Usage: trace_convert [--threads=<n>] [--timestamps] <YCSB output> <trace file>\n";
+
+/// A parsed line.
+struct TraceLine {
+    Op op;
+    uint64_t key;
+    uint32_t length;
+    uint64_t timestamp;
+};
+
+/// Splits off the next space-separated token of [pos, end).
+static inline bool NextToken(const char *&pos, const char *end, const char *&token, size_t &token_size) {
+    while (pos < end && *pos == ' ') {
+        ++pos;
+    }
+    token = pos;
+    while (pos < end && *pos != ' ') {
+        ++pos;
+    }
+    token_size = pos - token;
+    return token_size > 0;
+}
+
+static inline bool ParseNumber(const char *text, size_t size, uint64_t &result) {
+    if (size == 0) {
+        return false;
+    }
+    uint64_t value = 0;
+    for (size_t idx = 0; idx < size; ++idx) {
+        if (text[idx] < '0' || text[idx] > '9') {
+            return false;
+        }
+        uint64_t digit = static_cast<uint64_t>(text[idx] - '0');
+        if (value > (UINT64_MAX - digit) / 10) {
+            return false;
+        }
+        value = value * 10 + digit;
+    }
+    result = value;
+    return true;
+}
+
+static inline bool TokenIs(const char *token, size_t token_size, const char *word) {
+    return token_size == std::strlen(word) && std::memcmp(token, word, token_size) == 0;
+}
+
+/// Total size of the field values in "[ field0=value field1=value ... ]". (A token with no "="
+/// continues the previous value, which had a space in it.)
+static uint32_t ValueSize(const char *pos, const char *end) {
+    uint64_t size = 0;
+    const char *token;
+    size_t token_size;
+    while (NextToken(pos, end, token, token_size)) {
+        if (TokenIs(token, token_size, "[") || TokenIs(token, token_size, "]")) {
+            continue;
+        }
+        const char *equals = static_cast<const char *>(std::memchr(token, '=', token_size));
+        size += equals ? token_size - (equals + 1 - token) : token_size + 1;
+    }
+    return static_cast<uint32_t>(std::min<uint64_t>(size, UINT32_MAX));
+}
+
+static bool ParseLine(const char *pos, const char *end, bool timestamps, TraceLine &line) {
+    const char *token;
+    size_t token_size;
+    line.timestamp = 0;
+    if (timestamps && !(NextToken(pos, end, token, token_size) && ParseNumber(token, token_size, line.timestamp))) {
+        return false;
+    }
+    if (!NextToken(pos, end, token, token_size)) {
+        return false;
+    }
+    if (TokenIs(token, token_size, "READ")) {
+        line.op = Op::Read;
+    } else if (TokenIs(token, token_size, "UPDATE")) {
+        line.op = Op::Update;
+    } else if (TokenIs(token, token_size, "INSERT")) {
+        line.op = Op::Insert;
+    } else if (TokenIs(token, token_size, "SCAN")) {
+        line.op = Op::Scan;
+    } else if (TokenIs(token, token_size, "DELETE")) {
+        line.op = Op::Delete;
+    } else {
+        return false;
+    }
+    // The table, then the key: "user" and a number.
+    if (!NextToken(pos, end, token, token_size) || !NextToken(pos, end, token, token_size) ||
+        token_size <= 4 || std::memcmp(token, "user", 4) != 0 || !ParseNumber(token + 4, token_size - 4, line.key)) {
+        return false;
+    }
+    line.length = 0;
+    if (line.op == Op::Scan) {
+        uint64_t length;
+        if (!NextToken(pos, end, token, token_size) || !ParseNumber(token, token_size, length) ||
+            length > UINT32_MAX) {
+            return false;
+        }
+        line.length = static_cast<uint32_t>(length);
+    } else if (line.op == Op::Update || line.op == Op::Insert) {
+        line.length = ValueSize(pos, end);
+    }
+    return true;
+}
+
+/// One thread's part of the input.
+struct InputPart {
+    InputPart()
+            : begin{nullptr}, end{nullptr}, op_counts{}, max_value_size{0}, first_record{0} {
+    }
+
+    uint64_t num_records() const {
+        uint64_t total = 0;
+        for (uint32_t idx = 0; idx < kNumOps; ++idx) {
+            total += op_counts[idx];
+        }
+        return total;
+    }
+
+    /// Calls "visit" with each line of the part that parses.
+    template<class F>
+    void ForEachLine(bool timestamps, F visit) const {
+        for (const char *line = begin; line < end;) {
+            const char *line_end = static_cast<const char *>(std::memchr(line, '\n', end - line));
+            if (!line_end) {
+                line_end = end;
+            }
+            const char *text_end = line_end > line && line_end[-1] == '\r' ? line_end - 1 : line_end;
+            TraceLine parsed;
+            if (ParseLine(line, text_end, timestamps, parsed)) {
+                visit(parsed);
+            }
+            line = line_end + 1;
+        }
+    }
+
+    const char *begin;
+    const char *end;
+    uint64_t op_counts[kNumOps];
+    uint32_t max_value_size;
+    /// Index, in the trace, of the part's first record.
+    uint64_t first_record;
+};
+
+static bool WriteAt(int fd, const void *buffer, size_t size, uint64_t offset) {
+    const char *bytes = static_cast<const char *>(buffer);
+    while (size > 0) {
+        ssize_t written = ::pwrite(fd, bytes, size, static_cast<off_t>(offset));
+        if (written <= 0) {
+            return false;
+        }
+        bytes += written;
+        size -= static_cast<size_t>(written);
+        offset += static_cast<uint64_t>(written);
+    }
+    return true;
+}
+
+/// Writes a part's records (and timestamps) to where they go in the trace.
+static bool WritePart(int fd, const InputPart &part, bool timestamps, uint64_t num_records) {
+    std::vector<TraceRecord> records;
+    std::vector<uint64_t> times;
+    records.reserve(kWriteBatchSize);
+    times.reserve(kWriteBatchSize);
+    uint64_t next_record = part.first_record;
+    bool ok = true;
+    auto flush = [&]() {
+        ok = ok && WriteAt(fd, records.data(), records.size() * sizeof(TraceRecord),
+                           sizeof(TraceHeader) + next_record * sizeof(TraceRecord));
+        if (timestamps) {
+            ok = ok && WriteAt(fd, times.data(), times.size() * sizeof(uint64_t),
+                               TraceFileSize(num_records, false) + next_record * sizeof(uint64_t));
+        }
+        next_record += records.size();
+        records.clear();
+        times.clear();
+    };
+    part.ForEachLine(timestamps, [&](const TraceLine &line) {
+        TraceRecord record;
+        std::memset(&record, 0, sizeof(record));
+        record.key = line.key;
+        record.length = line.length;
+        record.op = static_cast<uint8_t>(line.op);
+        records.push_back(record);
+        times.push_back(line.timestamp);
+        if (records.size() == kWriteBatchSize) {
+            flush();
+        }
+    });
+    flush();
+    return ok;
+}
+
+int main(int argc, char *argv[]) {
+    uint32_t num_threads = std::max<uint32_t>(std::thread::hardware_concurrency(), 1);
+    bool timestamps = false;
+    std::vector<std::string> paths;
+    for (int idx = 1; idx < argc; ++idx) {
+        std::string arg{argv[idx]};
+        if (arg.compare(0, 10, "--threads=") == 0) {
+            num_threads = static_cast<uint32_t>(std::strtoul(arg.c_str() + 10, nullptr, 10));
+            if (num_threads == 0) {
+                std::fprintf(stderr, "%s", kUsage);
+                return 1;
+            }
+        } else if (arg == "--timestamps") {
+            timestamps = true;
+        } else if (arg.compare(0, 2, "--") == 0 || arg == "-h") {
+            std::fprintf(stderr, "%s", kUsage);
+            return arg == "--help" || arg == "-h" ? 0 : 1;
+        } else {
+            paths.push_back(arg);
+        }
+    }
+    if (paths.size() != 2) {
+        std::fprintf(stderr, "%s", kUsage);
+        return 1;
+    }
+
+    int in_fd = ::open(paths[0].c_str(), O_RDONLY);
+    struct stat in_stat;
+    if (in_fd < 0 || ::fstat(in_fd, &in_stat) != 0) {
+        std::fprintf(stderr, "could not open %s\n", paths[0].c_str());
+        return 1;
+    }
+    auto in_size = static_cast<uint64_t>(in_stat.st_size);
+    const char *input = nullptr;
+    if (in_size > 0) {
+        void *data = ::mmap(nullptr, in_size, PROT_READ, MAP_SHARED, in_fd, 0);
+        if (data == MAP_FAILED) {
+            std::fprintf(stderr, "could not map %s\n", paths[0].c_str());
+            return 1;
+        }
+        ::madvise(data, in_size, MADV_SEQUENTIAL);
+        input = static_cast<const char *>(data);
+    }
+    ::close(in_fd);
+
+    // Split the input into parts that start at the beginning of a line.
+    std::vector<InputPart> parts(num_threads);
+    const char *input_end = input + in_size;
+    const char *pos = input;
+    for (uint32_t idx = 0; idx < num_threads; ++idx) {
+        parts[idx].begin = pos;
+        if (idx + 1 < num_threads) {
+            pos = std::max(pos, input + in_size * (idx + 1) / num_threads);
+            const char *newline = pos < input_end ?
+                                  static_cast<const char *>(std::memchr(pos, '\n', input_end - pos)) : nullptr;
+            pos = newline ? newline + 1 : input_end;
+        } else {
+            pos = input_end;
+        }
+        parts[idx].end = pos;
+    }
+
+    // Count each part's records.
+    std::vector<std::thread> threads;
+    for (InputPart &part : parts) {
+        threads.emplace_back([&part, timestamps]() {
+            part.ForEachLine(timestamps, [&part](const TraceLine &line) {
+                ++part.op_counts[static_cast<uint8_t>(line.op)];
+                if (line.op == Op::Update || line.op == Op::Insert) {
+                    part.max_value_size = std::max(part.max_value_size, line.length);
+                }
+            });
+        });
+    }
+    for (std::thread &thread : threads) {
+        thread.join();
+    }
+    threads.clear();
+
+    uint64_t op_counts[kNumOps] = {};
+    uint32_t max_value_size = 0;
+    uint64_t num_records = 0;
+    for (InputPart &part : parts) {
+        part.first_record = num_records;
+        num_records += part.num_records();
+        for (uint32_t idx = 0; idx < kNumOps; ++idx) {
+            op_counts[idx] += part.op_counts[idx];
+        }
+        max_value_size = std::max(max_value_size, part.max_value_size);
+    }
+
+    // Then write them.
+    int out_fd = ::open(paths[1].c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (out_fd < 0 || ::ftruncate(out_fd, static_cast<off_t>(TraceFileSize(num_records, timestamps))) != 0) {
+        std::fprintf(stderr, "could not create %s\n", paths[1].c_str());
+        return 1;
+    }
+    std::vector<char> written(num_threads, 0);
+    for (uint32_t idx = 0; idx < num_threads; ++idx) {
+        threads.emplace_back([&, idx]() {
+            written[idx] = WritePart(out_fd, parts[idx], timestamps, num_records);
+        });
+    }
+    for (std::thread &thread : threads) {
+        thread.join();
+    }
+    TraceHeader header = MakeTraceHeader(op_counts, max_value_size, timestamps);
+    bool ok = std::all_of(written.begin(), written.end(), [](char part_ok) { return part_ok != 0; }) &&
+              WriteAt(out_fd, &header, sizeof(header), 0);
+    ok = ::close(out_fd) == 0 && ok;
+    if (input) {
+        ::munmap(const_cast<char *>(input), in_size);
+    }
+    if (!ok) {
+        std::fprintf(stderr, "could not write %s\n", paths[1].c_str());
+        return 1;
+    }
+
+    std::printf("%" PRIu64 " records:", num_records);
+    for (uint32_t idx = 0; idx < kNumOps; ++idx) {
+        if (op_counts[idx] > 0) {
+            std::printf(" %s %" PRIu64, OpName(static_cast<Op>(idx)), op_counts[idx]);
+        }
+    }
+    std::printf("\n");
+    return 0;
+}
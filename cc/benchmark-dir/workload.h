@@ -0,0 +1,352 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT license.
+
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <random>
+#include <string>
+
+namespace FASTER {
+namespace benchmark {
+
+/// Operations a YCSB-style workload issues.
+enum class Op : uint8_t {
+    Read = 0,
+    Update,
+    Insert,
+    Scan,
+    ReadModifyWrite,
+    Delete,
+};
+
+static constexpr uint32_t kNumOps = 6;
+
+inline const char *OpName(Op op) {
+    switch (op) {
+        case Op::Read:
+            return "read";
+        case Op::Update:
+            return "update";
+        case Op::Insert:
+            return "insert";
+        case Op::Scan:
+            return "scan";
+        case Op::ReadModifyWrite:
+            return "rmw";
+        case Op::Delete:
+            return "delete";
+    }
+    return "unknown";
+}
+
+/// How keys are picked for reads, updates, scans, RMWs, and deletes. (Inserts always add the next
+/// new key.)
+enum class Distribution : uint8_t {
+    Uniform = 0,
+    /// Zipfian over the loaded keys; key 0 is the hottest, key 1 the next hottest, and so on.
+    Zipfian,
+    /// Zipfian, with the ranks hashed onto the keys, so that the hot keys are spread out (as
+    /// YCSB's "zipfian" is), instead of being loaded, and laid out in the log, next to each other.
+    ScrambledZipfian,
+    /// Zipfian over the keys, counting back from the last one inserted.
+    Latest,
+    /// A fraction of the operations go to a fraction of the keys (the first ones), uniformly; the
+    /// rest go to the other keys, uniformly.
+    Hotspot,
+};
+
+inline const char *DistributionName(Distribution distribution) {
+    switch (distribution) {
+        case Distribution::Uniform:
+            return "uniform";
+        case Distribution::Zipfian:
+            return "zipfian";
+        case Distribution::ScrambledZipfian:
+            return "scrambled";
+        case Distribution::Latest:
+            return "latest";
+        case Distribution::Hotspot:
+            return "hotspot";
+    }
+    return "unknown";
+}
+
+/// Whether keys are picked with a ZipfianGenerator.
+inline bool IsZipfian(Distribution distribution) {
+    return distribution == Distribution::Zipfian || distribution == Distribution::ScrambledZipfian ||
+           distribution == Distribution::Latest;
+}
+
+/// Percentage of each Op in a workload; they add up to 100.
+struct OperationMix {
+    OperationMix()
+            : percent{} {
+    }
+
+    uint32_t &operator[](Op op) {
+        return percent[static_cast<uint8_t>(op)];
+    }
+
+    uint32_t operator[](Op op) const {
+        return percent[static_cast<uint8_t>(op)];
+    }
+
+    uint32_t Total() const {
+        uint32_t total = 0;
+        for (uint32_t idx = 0; idx < kNumOps; ++idx) {
+            total += percent[idx];
+        }
+        return total;
+    }
+
+    uint32_t percent[kNumOps];
+};
+
+/// The standard YCSB core workloads (A-F), plus read-modify-write, insert-only, and scan-only
+/// mixes. Sets the mix and the key distribution the workload is defined with (YCSB's zipfian is
+/// scrambled); returns false if "name" is not one of them.
+inline bool WorkloadPreset(const std::string &name, OperationMix &mix, Distribution &distribution) {
+    mix = OperationMix{};
+    distribution = Distribution::ScrambledZipfian;
+    if (name == "a") {
+        // Update heavy.
+        mix[Op::Read] = 50;
+        mix[Op::Update] = 50;
+    } else if (name == "b") {
+        // Read mostly.
+        mix[Op::Read] = 95;
+        mix[Op::Update] = 5;
+    } else if (name == "c") {
+        // Read only.
+        mix[Op::Read] = 100;
+    } else if (name == "d") {
+        // Read latest.
+        mix[Op::Read] = 95;
+        mix[Op::Insert] = 5;
+        distribution = Distribution::Latest;
+    } else if (name == "e") {
+        // Short ranges.
+        mix[Op::Scan] = 95;
+        mix[Op::Insert] = 5;
+    } else if (name == "f") {
+        // Read-modify-write.
+        mix[Op::Read] = 50;
+        mix[Op::ReadModifyWrite] = 50;
+    } else if (name == "rmw") {
+        mix[Op::ReadModifyWrite] = 100;
+    } else if (name == "insert") {
+        mix[Op::Insert] = 100;
+        distribution = Distribution::Uniform;
+    } else if (name == "scan") {
+        mix[Op::Scan] = 100;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+/// Picks each next operation according to an OperationMix.
+class OperationChooser {
+public:
+    OperationChooser(const OperationMix &mix) {
+        assert(mix.Total() == 100);
+        uint32_t cumulative = 0;
+        for (uint32_t idx = 0; idx < kNumOps; ++idx) {
+            cumulative += mix.percent[idx];
+            thresholds_[idx] = cumulative;
+        }
+    }
+
+    template<class R>
+    inline Op Next(R &rng) const {
+        uint32_t draw = static_cast<uint32_t>(rng() % 100);
+        uint32_t idx = 0;
+        while (draw >= thresholds_[idx]) {
+            ++idx;
+        }
+        return static_cast<Op>(idx);
+    }
+
+private:
+    uint32_t thresholds_[kNumOps];
+};
+
+/// Terms of zeta(n) that ZipfianGenerator sums one by one.
+static constexpr uint64_t kZetaExactTerms = 1024;
+
+/// YCSB's Zipfian generator (Gray et al., "Quickly Generating Billion-Record Synthetic
+/// Databases", SIGMOD 1994): item i in [0, n) comes up with probability proportional to
+/// 1 / (i + 1)^theta. Each sample is O(1), and so is setup: zeta(n) is summed term by term only
+/// up to kZetaExactTerms, and the rest of the sum is taken from its Euler-Maclaurin expansion
+/// (accurate to about 1e-12, relative), so a billion keys take no longer than a thousand. Samples
+/// are const, so one generator can be shared by all threads.
+class ZipfianGenerator {
+public:
+    ZipfianGenerator(uint64_t num_items, double theta)
+            : num_items_{num_items}, zeta_n_{Zeta(num_items, theta)} {
+        assert(num_items > 0);
+        assert(theta > 0 && theta < 1);
+        alpha_ = 1.0 / (1.0 - theta);
+        double zeta_2 = Zeta(2, theta);
+        half_pow_theta_ = 1.0 + std::pow(0.5, theta);
+        eta_ = (1.0 - std::pow(2.0 / static_cast<double>(num_items), 1.0 - theta)) /
+               (1.0 - zeta_2 / zeta_n_);
+    }
+
+    /// Maps "uniform", drawn from [0, 1), to an item.
+    inline uint64_t Next(double uniform) const {
+        double uz = uniform * zeta_n_;
+        if (uz < 1.0) {
+            return 0;
+        }
+        if (uz < half_pow_theta_) {
+            return std::min<uint64_t>(1, num_items_ - 1);
+        }
+        auto item = static_cast<uint64_t>(static_cast<double>(num_items_) *
+                                          std::pow(eta_ * uniform - eta_ + 1.0, alpha_));
+        return std::min(item, num_items_ - 1);
+    }
+
+    inline uint64_t num_items() const {
+        return num_items_;
+    }
+
+    /// Sum of 1 / i^theta, for i in [1, num_items].
+    static double Zeta(uint64_t num_items, double theta) {
+        double sum = 0;
+        uint64_t exact_terms = std::min(num_items, kZetaExactTerms);
+        for (uint64_t idx = 1; idx <= exact_terms; ++idx) {
+            sum += 1.0 / std::pow(static_cast<double>(idx), theta);
+        }
+        if (num_items > exact_terms) {
+            // Sum over (m, n] = integral from m to n + (f(n) - f(m)) / 2 + (f'(n) - f'(m)) / 12 - ...,
+            // for f(x) = x^-theta.
+            auto m = static_cast<double>(exact_terms);
+            auto n = static_cast<double>(num_items);
+            sum += (std::pow(n, 1.0 - theta) - std::pow(m, 1.0 - theta)) / (1.0 - theta) +
+                   (std::pow(n, -theta) - std::pow(m, -theta)) / 2.0 -
+                   theta * (std::pow(n, -theta - 1.0) - std::pow(m, -theta - 1.0)) / 12.0;
+        }
+        return sum;
+    }
+
+private:
+    uint64_t num_items_;
+    double zeta_n_;
+    double alpha_;
+    double eta_;
+    double half_pow_theta_;
+};
+
+/// 64-bit FNV-1a of "value"'s bytes, as YCSB scrambles its zipfian keys.
+inline uint64_t FnvHash64(uint64_t value) {
+    uint64_t hash = 0xcbf29ce484222325ull;
+    for (uint32_t idx = 0; idx < 8; ++idx) {
+        hash ^= value & 0xff;
+        hash *= 0x100000001b3ull;
+        value >>= 8;
+    }
+    return hash;
+}
+
+/// Picks the keys for a worker thread. Keys are numbered; [0, num_records) exist, where
+/// num_records grows as the workload inserts.
+///
+/// Picking a key is two steps: Draw() takes the random part, which doesn't depend on
+/// num_records, and Resolve() maps it to a key, given the current num_records. So draws can be
+/// made ahead of time (see --pregenerate), and resolved when the operation is issued.
+class KeyChooser {
+public:
+    /// "zipfian" must outlive the chooser, if the distribution IsZipfian(). A hotspot
+    /// distribution sends "hot_op_fraction" of the operations to the first "hot_set_fraction" of
+    /// the keys.
+    KeyChooser(Distribution distribution, const ZipfianGenerator *zipfian, double hot_set_fraction = 0.2,
+               double hot_op_fraction = 0.8)
+            : distribution_{distribution}, zipfian_{zipfian}, hot_set_fraction_{hot_set_fraction},
+              hot_op_fraction_{hot_op_fraction} {
+        assert(!IsZipfian(distribution) || zipfian);
+    }
+
+    template<class R>
+    inline uint64_t Next(R &rng, uint64_t num_records) {
+        return Resolve(Draw(rng), num_records);
+    }
+
+    template<class R>
+    inline uint64_t Draw(R &rng) {
+        switch (distribution_) {
+            case Distribution::Uniform:
+                return rng();
+            case Distribution::Zipfian:
+            case Distribution::ScrambledZipfian:
+            case Distribution::Latest:
+                return zipfian_->Next(uniform_(rng));
+            case Distribution::Hotspot:
+            {
+                // The top bit says whether the key is hot; the rest picks it.
+                uint64_t draw = rng() & ~kHotBit;
+                if (uniform_(rng) < hot_op_fraction_) {
+                    draw |= kHotBit;
+                }
+                return draw;
+            }
+        }
+        return 0;
+    }
+
+    inline uint64_t Resolve(uint64_t draw, uint64_t num_records) const {
+        assert(num_records > 0);
+        switch (distribution_) {
+            case Distribution::Uniform:
+                return draw % num_records;
+            case Distribution::Zipfian:
+                return std::min(draw, num_records - 1);
+            case Distribution::ScrambledZipfian:
+                return FnvHash64(draw) % num_records;
+            case Distribution::Latest:
+                return num_records - 1 - std::min(draw, num_records - 1);
+            case Distribution::Hotspot: {
+                auto hot_keys = static_cast<uint64_t>(hot_set_fraction_ * static_cast<double>(num_records));
+                hot_keys = std::min(std::max<uint64_t>(hot_keys, 1), num_records);
+                if ((draw & kHotBit) != 0 || hot_keys == num_records) {
+                    return (draw & ~kHotBit) % hot_keys;
+                }
+                return hot_keys + (draw & ~kHotBit) % (num_records - hot_keys);
+            }
+        }
+        return 0;
+    }
+
+private:
+    static constexpr uint64_t kHotBit = uint64_t{1} << 63;
+
+    Distribution distribution_;
+    const ZipfianGenerator *zipfian_;
+    double hot_set_fraction_;
+    double hot_op_fraction_;
+    std::uniform_real_distribution<double> uniform_;
+};
+
+/// Keys are stored as bytes: 16 hex digits of the key number, padded to the key size. Hash
+/// bucket entries keep (and compare) the first 16 bytes of a key inline, so keys can't be
+/// shorter than that; and since the digits come first and are fixed-width, keys sort (for
+/// range scans) in numeric order.
+static constexpr uint32_t kMinKeySize = 16;
+
+inline void FormatKey(uint64_t key, uint8_t *buffer, uint32_t key_size) {
+    assert(key_size >= kMinKeySize);
+    static const char kDigits[] = "0123456789ABCDEF";
+    for (int32_t idx = 15; idx >= 0; --idx) {
+        buffer[idx] = static_cast<uint8_t>(kDigits[key & 0xf]);
+        key >>= 4;
+    }
+    std::memset(buffer + kMinKeySize, '.', key_size - kMinKeySize);
+}
+
+}
+} // namespace FASTER::benchmark
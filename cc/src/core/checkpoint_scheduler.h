@@ -0,0 +1,194 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT license.
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+
+#include "guid.h"
+#include "status.h"
+
+namespace FASTER {
+namespace core {
+
+/// When CheckpointScheduler starts checkpoints.
+struct CheckpointPolicy {
+    /// Start a hybrid-log checkpoint once this long has passed since the previous one started
+    /// (zero: time alone never triggers one)...
+    std::chrono::milliseconds interval{30000};
+    /// ...or once the logs have grown by this many bytes since then (zero: never).
+    uint64_t log_bytes = 0;
+    /// Every index_every-th checkpoint also checkpoints the index (zero: never).
+    uint32_t index_every = 0;
+    /// How often the scheduler checks the thresholds, and whether the last checkpoint is done.
+    std::chrono::milliseconds poll_interval{10};
+};
+
+/// Counters kept by CheckpointScheduler.
+struct CheckpointSchedulerStats {
+    uint64_t checkpoints_started;
+    uint64_t index_checkpoints_started;
+    uint64_t checkpoints_completed;
+    /// Times a due checkpoint could not start, because a GC, GrowIndex() (or a checkpoint started
+    /// by someone else) was in progress; the scheduler tries again at the next poll.
+    uint64_t checkpoints_postponed;
+    /// Sessions that reported a failed checkpoint.
+    uint64_t session_failures;
+    /// From starting a checkpoint until the store was back at rest, for the last one and at most.
+    std::chrono::microseconds last_duration;
+    std::chrono::microseconds max_duration;
+};
+
+/// Runs CPR checkpoints of a store from a background thread, so that commit lag stays bounded
+/// without every service driving Checkpoint() by hand. As with any checkpoint, sessions must keep
+/// calling Refresh() (or CompletePending()) for it to make progress; as each session passes the
+/// persistence point, the "durable" callback gets its ID and serial number (on the session's
+/// thread).
+///
+/// Store callbacks are plain functions, so only one scheduler can run per process (like the store
+/// itself).
+template<class S>
+class CheckpointScheduler {
+public:
+    typedef S store_t;
+    typedef std::function<void(const Guid &session_id, uint64_t persistent_serial_num)> durable_callback_t;
+
+    CheckpointScheduler(store_t &store, const CheckpointPolicy &policy,
+                        durable_callback_t durable_callback = nullptr)
+            : store_{store}, policy_{policy}, durable_callback_{durable_callback}, stop_{false}, stats_{} {
+        CheckpointScheduler *expected = nullptr;
+        bool success = instance_.compare_exchange_strong(expected, this);
+        assert(success);
+        (void) success;
+        thread_ = std::thread{&CheckpointScheduler::Run, this};
+    }
+
+    /// Stops scheduling; a checkpoint already started still completes as the sessions refresh.
+    ~CheckpointScheduler() {
+        {
+            std::lock_guard<std::mutex> lock{mutex_};
+            stop_ = true;
+        }
+        stop_cv_.notify_all();
+        thread_.join();
+        instance_.store(nullptr);
+    }
+
+    // No copy constructor.
+    CheckpointScheduler(const CheckpointScheduler &other) = delete;
+
+    /// The latest serial number that "session_id" reported durable; 0 if none yet.
+    uint64_t DurableSerialNum(const Guid &session_id) const {
+        std::lock_guard<std::mutex> lock{mutex_};
+        auto iter = durable_serial_nums_.find(session_id);
+        return iter == durable_serial_nums_.end() ? 0 : iter->second;
+    }
+
+    CheckpointSchedulerStats GetStats() const {
+        std::lock_guard<std::mutex> lock{mutex_};
+        return stats_;
+    }
+
+private:
+    static void PersistenceCallback(Status result, uint64_t persistent_serial_num) {
+        CheckpointScheduler *scheduler = instance_.load();
+        if (!scheduler) {
+            return;
+        }
+        const Guid &session_id = scheduler->store_.SessionId();
+        {
+            std::lock_guard<std::mutex> lock{scheduler->mutex_};
+            if (result != Status::Ok) {
+                ++scheduler->stats_.session_failures;
+                return;
+            }
+            scheduler->durable_serial_nums_[session_id] = persistent_serial_num;
+        }
+        if (scheduler->durable_callback_) {
+            scheduler->durable_callback_(session_id, persistent_serial_num);
+        }
+    }
+
+    void Run() {
+        typedef std::chrono::steady_clock clock_t;
+        clock_t::time_point last_start = clock_t::now();
+        uint64_t last_log_bytes = store_.LogBytes();
+        bool in_progress = false;
+
+        std::unique_lock<std::mutex> lock{mutex_};
+        while (!stop_cv_.wait_for(lock, policy_.poll_interval, [this]() {
+            return stop_;
+        })) {
+            lock.unlock();
+            clock_t::time_point now = clock_t::now();
+            if (in_progress) {
+                if (!store_.CheckpointCheck()) {
+                    // The previous checkpoint is still running.
+                    lock.lock();
+                    continue;
+                }
+                in_progress = false;
+                auto duration = std::chrono::duration_cast<std::chrono::microseconds>(now - last_start);
+                lock.lock();
+                ++stats_.checkpoints_completed;
+                stats_.last_duration = duration;
+                stats_.max_duration = std::max(stats_.max_duration, duration);
+                lock.unlock();
+            }
+
+            uint64_t log_bytes = store_.LogBytes();
+            bool due = (policy_.interval.count() > 0 && now - last_start >= policy_.interval) ||
+                       (policy_.log_bytes > 0 && log_bytes - last_log_bytes >= policy_.log_bytes);
+            if (!due) {
+                lock.lock();
+                continue;
+            }
+            bool index = policy_.index_every > 0 &&
+                         (stats_.checkpoints_started + 1) % policy_.index_every == 0;
+            Guid token;
+            bool started = index ? store_.Checkpoint(nullptr, PersistenceCallback, token) :
+                           store_.CheckpointHybridLog(PersistenceCallback, token);
+            lock.lock();
+            if (!started) {
+                ++stats_.checkpoints_postponed;
+                continue;
+            }
+            ++stats_.checkpoints_started;
+            if (index) {
+                ++stats_.index_checkpoints_started;
+            }
+            last_start = now;
+            last_log_bytes = log_bytes;
+            in_progress = true;
+        }
+    }
+
+    static std::atomic<CheckpointScheduler *> instance_;
+
+    store_t &store_;
+    CheckpointPolicy policy_;
+    durable_callback_t durable_callback_;
+
+    mutable std::mutex mutex_;
+    std::condition_variable stop_cv_;
+    bool stop_;
+    CheckpointSchedulerStats stats_;
+    std::unordered_map<Guid, uint64_t> durable_serial_nums_;
+
+    std::thread thread_;
+};
+
+template<class S>
+std::atomic<CheckpointScheduler<S> *> CheckpointScheduler<S>::instance_{nullptr};
+
+}
+} // namespace FASTER::core
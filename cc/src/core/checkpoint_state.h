@@ -3,9 +3,12 @@
 
 #pragma once
 
+#include <algorithm>
 #include <atomic>
 #include <cstdint>
+#include <cstdio>
 #include <unordered_map>
+#include <vector>
 #include "address.h"
 #include "guid.h"
 #include "malloc_fixed_page_size.h"
@@ -81,14 +84,17 @@ public:
 };
 //static_assert(sizeof(IndexMetadata) == 56, "sizeof(IndexMetadata) != 56");
 
-/// Checkpoint metadata, for the log.
+/// Checkpoint metadata, for the log. The per-thread arrays have one slot per thread ID the store
+/// was constructed for, so the metadata is variable length on disk. A delta checkpoint also lists
+/// the log segments it copied to its delta file, in file order.
 class LogMetadata {
 public:
+    static constexpr uint32_t kNumTlogs = 40;
+
     LogMetadata()
             : use_snapshot_file{false}, version{UINT32_MAX}, num_threads{0}, flushed_address{Address::kInvalidAddress},
-              final_address{Address::kMaxAddress} {
-        std::memset(guids, 0, sizeof(guids));
-        std::memset(monotonic_serial_nums, 0, sizeof(monotonic_serial_nums));
+              final_address{Address::kMaxAddress}, use_delta{false} {
+        Resize(Thread::kDefaultNumThreads);
     }
 
     inline void Initialize(bool use_snapshot_file_, uint32_t version_, Address flushed_address_) {
@@ -97,27 +103,133 @@ public:
         num_threads = 0;
         flushed_address = flushed_address_;
         final_address = Address::kMaxAddress;
-        for (int i = 0; i < 40; i++)
+        for (uint32_t i = 0; i < kNumTlogs; i++)
             tfinal_address[i] = Address::kMaxAddress;
-        std::memset(guids, 0, sizeof(guids));
-        std::memset(monotonic_serial_nums, 0, sizeof(monotonic_serial_nums));
+        use_delta = false;
+        previous_delta_token = Guid{};
+        std::fill(tdelta_address, tdelta_address + kNumTlogs, Address{Address::kMaxAddress});
+        delta_segments.clear();
+        std::fill(guids.begin(), guids.end(), Guid{});
+        std::fill(monotonic_serial_nums.begin(), monotonic_serial_nums.end(), 0);
     }
 
     inline void Reset() {
         Initialize(false, UINT32_MAX, Address::kInvalidAddress);
     }
 
+    /// Sets the number of per-thread slots (and clears them).
+    inline void Resize(uint32_t num_slots) {
+        guids.assign(num_slots, Guid{});
+        monotonic_serial_nums.assign(num_slots, 0);
+    }
+
+    inline uint32_t num_slots() const {
+        return static_cast<uint32_t>(guids.size());
+    }
+
+    /// On disk: the fixed-size fields, then the number of slots, then the per-thread arrays, then
+    /// the delta segments.
+    Status Write(std::FILE *file) const {
+        // (Value-initialized, so that its padding goes to disk as zeros.)
+        Header header{};
+        header.use_snapshot_file = use_snapshot_file;
+        header.version = version;
+        header.num_threads = num_threads.load();
+        header.num_slots = num_slots();
+        header.flushed_address = flushed_address;
+        header.final_address = final_address;
+        std::copy(tfinal_address, tfinal_address + kNumTlogs, header.tfinal_address);
+        header.use_delta = use_delta;
+        header.previous_delta_token = previous_delta_token;
+        std::copy(tdelta_address, tdelta_address + kNumTlogs, header.tdelta_address);
+        header.num_delta_segments = static_cast<uint32_t>(delta_segments.size());
+        if (std::fwrite(&header, sizeof(header), 1, file) != 1) {
+            return Status::IOError;
+        }
+        if (std::fwrite(monotonic_serial_nums.data(), sizeof(uint64_t), header.num_slots, file) !=
+            header.num_slots) {
+            return Status::IOError;
+        }
+        if (std::fwrite(guids.data(), sizeof(Guid), header.num_slots, file) != header.num_slots) {
+            return Status::IOError;
+        }
+        if (std::fwrite(delta_segments.data(), sizeof(Address), header.num_delta_segments, file) !=
+            header.num_delta_segments) {
+            return Status::IOError;
+        }
+        return Status::Ok;
+    }
+
+    /// Reads the slots the file has, which may be fewer or more than this store's. Keeps at least
+    /// this store's slots, since the next checkpoint writes to them by thread ID.
+    Status Read(std::FILE *file) {
+        Header header;
+        if (std::fread(&header, sizeof(header), 1, file) != 1) {
+            return Status::IOError;
+        }
+        if (header.num_slots > Thread::kMaxNumThreads) {
+            return Status::Corruption;
+        }
+        use_snapshot_file = header.use_snapshot_file;
+        version = header.version;
+        num_threads = header.num_threads;
+        flushed_address = header.flushed_address;
+        final_address = header.final_address;
+        std::copy(header.tfinal_address, header.tfinal_address + kNumTlogs, tfinal_address);
+        use_delta = header.use_delta;
+        previous_delta_token = header.previous_delta_token;
+        std::copy(header.tdelta_address, header.tdelta_address + kNumTlogs, tdelta_address);
+        Resize(std::max(header.num_slots, num_slots()));
+        if (std::fread(monotonic_serial_nums.data(), sizeof(uint64_t), header.num_slots, file) !=
+            header.num_slots) {
+            return Status::IOError;
+        }
+        if (std::fread(guids.data(), sizeof(Guid), header.num_slots, file) != header.num_slots) {
+            return Status::IOError;
+        }
+        delta_segments.resize(header.num_delta_segments);
+        if (std::fread(delta_segments.data(), sizeof(Address), header.num_delta_segments, file) !=
+            header.num_delta_segments) {
+            return Status::IOError;
+        }
+        return Status::Ok;
+    }
+
+private:
+    /// Fixed-size part of the on-disk format.
+    struct Header {
+        bool use_snapshot_file;
+        uint32_t version;
+        uint32_t num_threads;
+        uint32_t num_slots;
+        Address flushed_address;
+        Address final_address;
+        Address tfinal_address[kNumTlogs];
+        bool use_delta;
+        Guid previous_delta_token;
+        Address tdelta_address[kNumTlogs];
+        uint32_t num_delta_segments;
+    };
+    // The header is written as is; a different layout can't read existing checkpoints.
+    static_assert(sizeof(Header) == 704, "sizeof(Header) != 704");
+
+public:
     bool use_snapshot_file;
     uint32_t version;
     std::atomic<uint32_t> num_threads;
     Address flushed_address;
     Address final_address;
-    uint64_t monotonic_serial_nums[Thread::kMaxNumThreads];
-    Guid guids[Thread::kMaxNumThreads];
-    Address tfinal_address[40];
+    std::vector<uint64_t> monotonic_serial_nums;
+    std::vector<Guid> guids;
+    Address tfinal_address[kNumTlogs];
+    /// Delta checkpoints: the previous delta checkpoint in the chain (Guid{} if this is the first
+    /// one); where each log's delta starts (everything below is in the log itself); and the
+    /// segments in the delta file.
+    bool use_delta;
+    Guid previous_delta_token;
+    Address tdelta_address[kNumTlogs];
+    std::vector<Address> delta_segments;
 };
-//static_assert(sizeof(LogMetadata) == 32 + (24 * Thread::kMaxNumThreads),
-//             "sizeof(LogMetadata) != 32 + (24 * Thread::kMaxNumThreads)");
 
 /// State of the active Checkpoint()/Recover() call, including metadata written to disk.
 template<class F>
@@ -130,7 +242,8 @@ public:
     typedef void(*hybrid_log_persistence_callback_t)(Status result, uint64_t persistent_serial_num);
 
     CheckpointState()
-            : index_checkpoint_started{false}, failed{false}, flush_pending{UINT32_MAX},
+            : index_checkpoint_started{false}, index_checkpoint_lane{0}, failed{false},
+              flush_pending{UINT32_MAX},
               index_persistence_callback{nullptr}, hybrid_log_persistence_callback{nullptr} {
     }
 
@@ -236,7 +349,12 @@ public:
         snapshot_file.Close();
     }
 
+    /// The partition whose hash table is being checkpointed (kIssuingLane while a thread issues
+    /// the next one's writes).
+    static constexpr uint32_t kIssuingLane = UINT32_MAX;
+
     std::atomic<bool> index_checkpoint_started;
+    std::atomic<uint32_t> index_checkpoint_lane;
     std::atomic<bool> failed;
     IndexMetadata index_metadata;
     LogMetadata log_metadata;
@@ -244,7 +362,7 @@ public:
     Guid index_token;
     Guid hybrid_log_token;
 
-    /// State used when fold_over_snapshot = false.
+    /// State used when fold_over_snapshot = false, or for delta checkpoints.
     file_t snapshot_file;
     std::atomic<uint32_t> flush_pending;
 
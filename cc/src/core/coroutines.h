@@ -0,0 +1,278 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT license.
+
+#pragma once
+
+/// Optional C++20 coroutine front-end for Read/Upsert/Delete. Build with -DFASTER_COROUTINES=ON
+/// (which compiles the tree as C++20) to use it. (There is no RmwAsync(): Rmw() doesn't support
+/// this tree's per-partition logs.)
+#ifdef FASTER_COROUTINES
+
+#include <algorithm>
+#include <cassert>
+#include <coroutine>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <utility>
+
+#include "async.h"
+#include "status.h"
+
+namespace FASTER {
+namespace core {
+
+/// A top-level coroutine, run by a CoroutineScheduler. It starts suspended; Spawn() it to run it.
+class StoreTask {
+public:
+    struct promise_type {
+        StoreTask get_return_object() {
+            return StoreTask{std::coroutine_handle<promise_type>::from_promise(*this)};
+        }
+
+        std::suspend_always initial_suspend() noexcept {
+            return {};
+        }
+
+        /// The scheduler destroys the frame once the task is done.
+        std::suspend_always final_suspend() noexcept {
+            return {};
+        }
+
+        void return_void() {
+        }
+
+        void unhandled_exception() {
+            exception = std::current_exception();
+        }
+
+        std::exception_ptr exception;
+    };
+
+    StoreTask(StoreTask &&other)
+            : handle_{std::exchange(other.handle_, {})} {
+    }
+
+    ~StoreTask() {
+        if (handle_) {
+            // Never spawned.
+            handle_.destroy();
+        }
+    }
+
+    // No copy constructor.
+    StoreTask(const StoreTask &other) = delete;
+
+private:
+    explicit StoreTask(std::coroutine_handle<promise_type> handle)
+            : handle_{handle} {
+    }
+
+    std::coroutine_handle<promise_type> handle_;
+
+    template<class S>
+    friend class CoroutineScheduler;
+};
+
+/// Wraps a caller context for use with co_await. The context has to be a local variable of the
+/// coroutine: the coroutine frame already keeps it alive while the operation is pending, so going
+/// async needs no DeepCopy(); "deep copying" the context just returns the context itself. (So C
+/// must not declare its own DeepCopy_Internal() final.)
+template<class C>
+class CoroutineContext : public C {
+public:
+    template<class... Args>
+    CoroutineContext(Args &&... args)
+            : C(std::forward<Args>(args)...), result{Status::Pending}, handle_{} {
+    }
+
+    /// Status of the operation, once it has completed.
+    Status result;
+
+protected:
+    Status DeepCopy_Internal(IAsyncContext *&context_copy) final {
+        context_copy = this;
+        return Status::Ok;
+    }
+
+private:
+    /// The StoreTask waiting on this context.
+    std::coroutine_handle<StoreTask::promise_type> handle_;
+
+    template<class S>
+    friend class CoroutineScheduler;
+    template<class S, class CC, class Op>
+    friend class StoreAwaiter;
+};
+
+/// Per-thread scheduler for StoreTasks on one store. Run() resumes tasks whose operations have
+/// completed, and calls CompletePending() whenever every live task is waiting on the store, so a
+/// single thread can keep as many operations outstanding as it has spawned tasks. The thread must
+/// have a session open on the store.
+template<class S>
+class CoroutineScheduler {
+public:
+    typedef S store_t;
+
+    explicit CoroutineScheduler(store_t &store)
+            : store_{store}, num_live_tasks_{0} {
+    }
+
+    // No copy constructor.
+    CoroutineScheduler(const CoroutineScheduler &other) = delete;
+
+    ~CoroutineScheduler() {
+        // Tasks still suspended (if Run() exited with an exception) are destroyed with the scheduler.
+        for (auto handle : tasks_) {
+            handle.destroy();
+        }
+    }
+
+    void Spawn(StoreTask task) {
+        auto handle = std::exchange(task.handle_, {});
+        tasks_.push_back(handle);
+        ready_.push_back(handle);
+        ++num_live_tasks_;
+    }
+
+    /// Runs until every spawned task has finished. Rethrows the first exception a task let escape.
+    void Run() {
+        CoroutineScheduler *previous = current_;
+        current_ = this;
+        while (num_live_tasks_ > 0) {
+            while (!ready_.empty()) {
+                task_handle_t handle = ready_.front();
+                ready_.pop_front();
+                handle.resume();
+                if (handle.done()) {
+                    Finish(handle);
+                }
+            }
+            if (num_live_tasks_ > 0) {
+                // Completions (from the I/O handler, or retries) resume tasks via ready_.
+                store_.CompletePending(false);
+            }
+        }
+        current_ = previous;
+        if (exception_) {
+            std::rethrow_exception(std::exchange(exception_, nullptr));
+        }
+    }
+
+    inline uint64_t num_live_tasks() const {
+        return num_live_tasks_;
+    }
+
+    inline store_t &store() {
+        return store_;
+    }
+
+    /// Callback for operations that went pending: the operation's coroutine is ready to run again.
+    /// Called from CompletePending(), so always on the scheduler's thread.
+    template<class CC>
+    static void OnComplete(IAsyncContext *ctxt, Status result) {
+        CC *context = static_cast<CC *>(ctxt);
+        context->result = result;
+        assert(current_);
+        current_->ready_.push_back(context->handle_);
+    }
+
+private:
+    typedef std::coroutine_handle<StoreTask::promise_type> task_handle_t;
+
+    /// Destroys a task that has run to completion.
+    void Finish(task_handle_t handle) {
+        if (handle.promise().exception && !exception_) {
+            exception_ = handle.promise().exception;
+        }
+        tasks_.erase(std::find(tasks_.begin(), tasks_.end(), handle));
+        handle.destroy();
+        --num_live_tasks_;
+    }
+
+    store_t &store_;
+    uint64_t num_live_tasks_;
+    /// Every live task (for cleanup), and the ones ready to be resumed.
+    std::deque<task_handle_t> tasks_;
+    std::deque<task_handle_t> ready_;
+    std::exception_ptr exception_;
+
+    /// Scheduler running on this thread.
+    static thread_local CoroutineScheduler *current_;
+};
+
+template<class S>
+thread_local CoroutineScheduler<S> *CoroutineScheduler<S>::current_ = nullptr;
+
+/// Awaitable for one store operation. The operation is issued from await_ready(); the coroutine
+/// is suspended only if the operation went pending. Only a StoreTask body may co_await it (the
+/// scheduler resumes the task directly); awaiting it from any other coroutine doesn't compile.
+template<class S, class CC, class Op>
+class StoreAwaiter {
+public:
+    StoreAwaiter(CC &context, Op issue)
+            : context_{context}, issue_{issue} {
+    }
+
+    bool await_ready() {
+        context_.result = issue_(context_, CoroutineScheduler<S>::template OnComplete<CC>);
+        return context_.result != Status::Pending;
+    }
+
+    void await_suspend(std::coroutine_handle<StoreTask::promise_type> handle) {
+        // The completion callback runs later, from the scheduler's CompletePending() call.
+        context_.handle_ = handle;
+    }
+
+    Status await_resume() const {
+        return context_.result;
+    }
+
+private:
+    CC &context_;
+    Op issue_;
+};
+
+template<class S, class CC, class Op>
+inline StoreAwaiter<S, CC, Op> MakeStoreAwaiter(CC &context, Op issue) {
+    return StoreAwaiter<S, CC, Op>{context, issue};
+}
+
+/// co_await ReadAsync(scheduler, context, serial_num) returns the Read()'s final status.
+template<class S, class RC>
+inline auto ReadAsync(CoroutineScheduler<S> &scheduler, CoroutineContext<RC> &context,
+                      uint64_t monotonic_serial_num) {
+    S &store = scheduler.store();
+    return MakeStoreAwaiter<S>(context, [&store, monotonic_serial_num](CoroutineContext<RC> &ctxt,
+                                                                        AsyncCallback callback) {
+        return store.Read(ctxt, callback, monotonic_serial_num);
+    });
+}
+
+/// co_await UpsertAsync(scheduler, context, serial_num) returns the UpsertT()'s final status. (An
+/// upsert that has to wait out a checkpoint phase goes pending, and completes via OnComplete().)
+template<class S, class UC>
+inline auto UpsertAsync(CoroutineScheduler<S> &scheduler, CoroutineContext<UC> &context,
+                        uint64_t monotonic_serial_num, uint32_t ttl_seconds = 0) {
+    S &store = scheduler.store();
+    return MakeStoreAwaiter<S>(context, [&store, monotonic_serial_num, ttl_seconds](CoroutineContext<UC> &ctxt,
+                                                                                     AsyncCallback callback) {
+        // (UpsertT() doesn't use its thread number.)
+        return store.UpsertT(ctxt, callback, monotonic_serial_num, 1, ttl_seconds);
+    });
+}
+
+template<class S, class DC>
+inline auto DeleteAsync(CoroutineScheduler<S> &scheduler, CoroutineContext<DC> &context,
+                        uint64_t monotonic_serial_num) {
+    S &store = scheduler.store();
+    return MakeStoreAwaiter<S>(context, [&store, monotonic_serial_num](CoroutineContext<DC> &ctxt,
+                                                                        AsyncCallback callback) {
+        return store.Delete(ctxt, callback, monotonic_serial_num);
+    });
+}
+
+}
+} // namespace FASTER::core
+
+#endif // FASTER_COROUTINES
@@ -3,6 +3,7 @@
 
 #pragma once
 
+#include <algorithm>
 #include <atomic>
 #include <cassert>
 #include <cinttypes>
@@ -10,8 +11,11 @@
 #include <cstdio>
 #include <cstring>
 #include <type_traits>
+#include <thread>
+#include <unordered_set>
 #include <vector>
 #include <map>
+#include <memory>
 #include <iostream>
 #include "device/file_system_disk.h"
 
@@ -20,17 +24,22 @@
 #include "checkpoint_state.h"
 #include "constants.h"
 #include "gc_state.h"
+#include "gen_lock.h"
 #include "grow_state.h"
 #include "guid.h"
 #include "hash_table.h"
 #include "internal_contexts.h"
 #include "key_hash.h"
+#include "latency_histogram.h"
 #include "malloc_fixed_page_size.h"
+#include "ordered_index.h"
 #include "persistent_memory_malloc.h"
 #include "record.h"
 #include "recovery_status.h"
 #include "state_transitions.h"
+#include "stats.h"
 #include "status.h"
+#include "transaction.h"
 #include "utility.h"
 
 using namespace std;
@@ -43,8 +52,12 @@ namespace core {
 
 class alignas(Constants::kCacheLineBytes) ThreadContext {
 public:
+    /// No partition is owned.
+    static constexpr uint32_t kNoPartition = UINT32_MAX;
+
     ThreadContext()
-            : contexts_{}, cur_{0} {
+            : contexts_{}, cur_{0}, owned_partition_{kNoPartition}, refreshes_since_sweep_{0},
+              owned_sweep_chunk_{0} {
     }
 
     inline const ExecutionContext &cur() const {
@@ -67,9 +80,36 @@ public:
         cur_ = (cur_ + 1) % 2;
     }
 
+    /// Partition this session owns (see FasterKv::OwnPartition()). Kept outside the execution
+    /// contexts, so that it survives their swap at a checkpoint.
+    inline uint32_t owned_partition() const {
+        return owned_partition_;
+    }
+
+    inline void set_owned_partition(uint32_t partition) {
+        owned_partition_ = partition;
+    }
+
+    /// True once every "interval" calls (see FasterKv::Refresh()).
+    inline bool ExpirySweepDue(uint32_t interval) {
+        if (++refreshes_since_sweep_ < interval) {
+            return false;
+        }
+        refreshes_since_sweep_ = 0;
+        return true;
+    }
+
+    /// Next chunk of the owned partition's hash table to sweep (see FasterKv::SweepExpiredEntries()).
+    inline uint32_t NextOwnedSweepChunk() {
+        return owned_sweep_chunk_++;
+    }
+
 private:
     ExecutionContext contexts_[2];
     uint8_t cur_;
+    uint32_t owned_partition_;
+    uint32_t refreshes_since_sweep_;
+    uint32_t owned_sweep_chunk_;
 };
 
 static_assert(sizeof(ThreadContext) == 448, "sizeof(ThreadContext) != 448");
@@ -97,11 +137,15 @@ public:
     typedef AsyncPendingDeleteContext<key_t> async_pending_delete_context_t;
     typedef AsyncPendingRmwContext<key_t> async_pending_rmw_context_t;
 
+    /// "max_sessions" bounds the number of threads that can have a session open at once; the epoch
+    /// table and the other per-thread structures are allocated to that size.
     FasterKv(uint64_t table_size, uint64_t log_size, const std::string &filename,
-             double log_mutable_fraction = 0.9)
-            : min_table_size_{table_size}, disk{filename, epoch_},
+             double log_mutable_fraction = 0.9, uint32_t max_sessions = Thread::kDefaultNumThreads)
+            : epoch_{Thread::ReserveCapacity(max_sessions)}, min_table_size_{table_size}, disk{filename, epoch_},
               hlog{log_size, epoch_, disk, disk.log(), log_mutable_fraction, 0},
-              system_state_{Action::None, Phase::REST, 1}, num_pending_ios{0} {
+              system_state_{Action::None, Phase::REST, 1}, num_pending_ios{0},
+              thread_contexts_{epoch_.num_entries()} {
+        checkpoint_.log_metadata.Resize(epoch_.num_entries());
         // ,system_state_{Action::None, Phase::REST, 1},num_pending_ios{0}
         // hlog{log_size, epoch_, disk, disk.log(), log_mutable_fraction,1},
         //hlog_t a[4];
@@ -202,10 +246,13 @@ public:
 
 
     FasterKv(int number, uint64_t table_size, uint64_t log_size, const std::string &filename,
-             double log_mutable_fraction = 0.9)
-            : min_table_size_{table_size},min_log_size{log_size}, tlog_number{number}, disk{filename, epoch_},
+             double log_mutable_fraction = 0.9, uint32_t max_sessions = Thread::kDefaultNumThreads)
+            : epoch_{Thread::ReserveCapacity(max_sessions)}, min_table_size_{table_size},min_log_size{log_size},
+              tlog_number{number}, disk{filename, epoch_},
               hlog{log_size, epoch_, disk, disk.log(), log_mutable_fraction, 0},
-              system_state_{Action::None, Phase::REST, 1}, num_pending_ios{0} {
+              system_state_{Action::None, Phase::REST, 1}, num_pending_ios{0},
+              thread_contexts_{epoch_.num_entries()} {
+        checkpoint_.log_metadata.Resize(epoch_.num_entries());
         // ,system_state_{Action::None, Phase::REST, 1},num_pending_ios{0}
         // hlog{log_size, epoch_, disk, disk.log(), log_mutable_fraction,1},
         //hlog_t a[4];
@@ -232,6 +279,12 @@ public:
             state_[i].Initialize(min_table_size_ / tlog_number, disk.log().alignment());
     }
 
+    ~FasterKv() {
+        if (recovery_thread_.joinable()) {
+            recovery_thread_.join();
+        }
+    }
+
     // No copy constructor.
     FasterKv(const FasterKv &other) = delete;
 
@@ -256,9 +309,24 @@ public:
     template<class UC>
     inline Status Upsert(UC &context, AsyncCallback callback, uint64_t monotonic_serial_num);
 
+    /// A non-zero "ttl_seconds" makes the record expire that many seconds from now. The expiry is
+    /// kept (to the second) in the bucket entry, and an in-place update can't change it; so an
+    /// upsert with a TTL updates in place only if it lands on the existing expiry, which is to say
+    /// that TTL upserts nearly always go through RCU.
     template<class UC>
-    inline Status UpsertT(UC &context, AsyncCallback callback, uint64_t monotonic_serial_num, uint16_t thread_number);
-
+    inline Status UpsertT(UC &context, AsyncCallback callback, uint64_t monotonic_serial_num, uint16_t thread_number,
+                          uint32_t ttl_seconds = 0);
+
+    /// Upserts contexts[0, num_contexts), for bulk ingestion from one thread. Records are grouped
+    /// by log lane, and each group's log space is reserved with a single allocation, the records
+    /// written one after another, and then published to the hash index. Records are always
+    /// appended (never updated in place). A key that can't be published that way (a checkpoint is
+    /// in progress, or another thread won the bucket entry) takes UpsertT()'s path. Returns
+    /// Status::Ok; Status::Pending if some key went pending, and completes (through "callback")
+    /// from CompletePending(); or else the last failing status of a key.
+    template<class UC>
+    inline Status UpsertBatch(UC *contexts, uint32_t num_contexts, AsyncCallback callback,
+                              uint64_t monotonic_serial_num, uint32_t ttl_seconds = 0);
 
     template<class MC>
     inline Status Rmw(MC &context, AsyncCallback callback, uint64_t monotonic_serial_num);
@@ -266,6 +334,13 @@ public:
     template<class DC>
     inline Status Delete(DC &context, AsyncCallback callback, uint64_t monotonic_serial_num);
 
+    /// Atomically updates every key of the transaction context "context" (see transaction.h).
+    /// Returns Status::NotFound if some key does not exist, and Status::Aborted if the transaction
+    /// would cross a checkpoint boundary (or needs a record from disk), or if a key appears twice;
+    /// nothing is updated then.
+    template<class TC>
+    inline Status MultiKeyTransaction(TC &context, uint64_t monotonic_serial_num);
+
     inline bool CompletePending(bool wait = false);
 
     /// Checkpoint/recovery operations.
@@ -280,8 +355,43 @@ public:
 
     bool CheckpointCheck();
 
+    /// Delta checkpoints: hybrid-log checkpoints leave the mutable region mutable, and write only
+    /// the (64 KB) log segments written since the previous checkpoint, to a delta file. Recovering
+    /// one replays the chain of deltas back to the last full checkpoint. Call while no checkpoint
+    /// is in progress.
+    inline void EnableDeltaCheckpoints(bool enable = true) {
+        delta_checkpoints_ = enable;
+        last_delta_token_ = Guid{};
+    }
+
+    /// Recovery maps the hash-table checkpoint into memory (copy-on-write) and uses it as the
+    /// table, so that buckets are read in as they are touched rather than copied up front. The
+    /// (usually much smaller) overflow buckets are still read in. Call before Recover().
+    inline void EnableMappedIndexRecovery(bool enable = true) {
+        mapped_index_recovery_ = enable;
+    }
+
+    /// Recovers the index and the hybrid logs. With "num_threads" > 1, the logs are recovered and
+    /// restored in parallel, one log (and the index partition it covers) at a time per thread.
     Status Recover(const Guid &index_token, const Guid &hybrid_log_token, uint32_t &version,
-                   std::vector<Guid> &session_ids);
+                   std::vector<Guid> &session_ids, uint32_t num_threads = 1);
+
+    /// Availability-first recovery: like Recover(), but returns as soon as the index checkpoint
+    /// has been loaded, so that sessions can start right away. Each log (with the index partition
+    /// it covers) is then replayed by a background sweep on "num_threads" threads, or on demand by
+    /// the first operation on one of its keys, whichever comes first. Checkpoints, GC and index
+    /// growth are refused until the sweep is done.
+    Status RecoverLazy(const Guid &index_token, const Guid &hybrid_log_token, uint32_t &version,
+                       std::vector<Guid> &session_ids, uint32_t num_threads = 1);
+
+    /// True while RecoverLazy() still has logs to replay.
+    inline bool RecoveryPending() const {
+        return num_lanes_pending_recovery_.load() > 0;
+    }
+
+    /// Waits for the sweep started by RecoverLazy(), and returns the first error it (or an
+    /// on-demand replay) hit. Call from one thread at a time.
+    Status WaitForRecovery();
 
     /// Truncating the head of the log.
     bool ShiftBeginAddress(Address address, GcState::truncate_callback_t truncate_callback,
@@ -293,6 +403,30 @@ public:
 
     bool Gcflag = false;
 
+    /// Ordered (secondary) index, for range scans. It holds keys of up to
+    /// OrderedIndexKey::kMaxKeyBytes; returns Status::Aborted (and leaves the index off) if the
+    /// store has a longer key. While the index is on, UpsertT(), UpsertBatch(), Delete() and
+    /// MultiKeyTransaction() reject longer keys with Status::Aborted.
+    Status EnableOrderedIndex();
+
+    /// Reads every key in [begin, end), through Read(). Calls visitor(const RC &context, Status
+    /// result) for each key read right away (with a context on the stack, good for the call only);
+    /// a key whose read goes pending reaches "callback" from CompletePending(), like any other
+    /// read. Returns Status::Pending if any read went pending, else Status::Ok, or the first
+    /// failed read's status (the scan goes on past it).
+    template<class RC, class F>
+    inline Status RangeScan(const key_t &begin, const key_t &end, F visitor, AsyncCallback callback,
+                            uint64_t monotonic_serial_num);
+
+    Status RebuildOrderedIndex();
+
+    /// Expiration: clears the bucket entries of expired records in the next chunk of the hash
+    /// tables, and returns how many it cleared. Once any record has been given a TTL, every 64th
+    /// Refresh() of a session calls it, so that sessions share the sweep without each refresh
+    /// paying for it; it can also be called from a session thread. A session that owns a partition
+    /// (see OwnPartition()) sweeps only that partition's table.
+    uint64_t SweepExpiredEntries();
+
     //atomic<uint64_t >  record_number;
     /// Make the hash table larger.
     bool GrowIndex(GrowState::callback_t caller_callback);
@@ -302,11 +436,81 @@ public:
         return hlog.GetTailAddress().control();
     }
 
+    /// Latency histograms, by operation and outcome (see latency_histogram.h): each session times
+    /// every "sample_every"-th operation it issues. Call while no sessions are running.
+    inline void EnableLatencyStats(uint32_t sample_every = 1) {
+        latency_stats_.reset(new LatencyStats{epoch_.num_entries(), sample_every});
+    }
+
+    /// Merges the sessions' histograms for "op" and "outcome", in TscClock ticks; empty if latency
+    /// stats are off.
+    inline LatencyHistogram GetLatencyHistogram(LatencyOp op, LatencyOutcome outcome) const {
+        return latency_stats_ ? latency_stats_->Get(op, outcome) : LatencyHistogram{};
+    }
+
+    /// Bytes appended to the (per-partition) logs so far, in total.
+    inline uint64_t LogBytes() const {
+        uint64_t bytes = 0;
+        for (int lane = 0; lane < tlog_number; ++lane) {
+            Address tail = thlog[lane]->GetTailAddress();
+            bytes += tail.page() * hlog_t::kPageSize + tail.offset();
+        }
+        return bytes;
+    }
+
+    /// Replication (see LogShipper): log "lane" is on disk from its begin address until its
+    /// flushed-until address.
+    inline Address LogBeginAddress(uint32_t lane) const {
+        return thlog[lane]->begin_address.load();
+    }
+
+    inline Address FlushedUntilAddress(uint32_t lane) const {
+        return thlog[lane]->flushed_until_address.load();
+    }
+
+    /// Copies [from_address, until_address) of log "lane", which must be below its flushed-until
+    /// address, to "dest": from memory, or, for the part that has been evicted already, from the
+    /// log file (synchronously).
+    Status CopyFlushedLog(uint32_t lane, Address from_address, Address until_address, uint8_t *dest);
+
     inline void DumpDistribution() {
         state_[resize_info_.version].DumpDistribution(
                 overflow_buckets_allocator_[resize_info_.version]);
     }
 
+    /// Keys are partitioned by hash; each partition has its own hash table and log lane.
+    inline uint32_t NumPartitions() const {
+        return static_cast<uint32_t>(tlog_number);
+    }
+
+    inline uint32_t Partition(const key_t &key) const {
+        KeyHash hash = key.GetHash();
+        return static_cast<uint32_t>(hash.idx(min_table_size_) / (min_table_size_ / tlog_number));
+    }
+
+    /// Partition-owner mode: declares that this session is the only one that reads or writes keys
+    /// in "partition" (e.g., because other threads delegate to it through a PartitionExecutor), so
+    /// that its Read()s and UpsertT()s there can use plain loads and stores instead of atomics.
+    /// Call it after StartSession(); StopSession() gives the partition up.
+    inline void OwnPartition(uint32_t partition) {
+        thread_contexts_[Thread::id()].set_owned_partition(partition);
+    }
+
+    /// This session's operations that are waiting on I/O or for a retry.
+    inline uint64_t NumPendingRequests() const {
+        return thread_ctx().pending_ios.size() + thread_ctx().retry_requests.size();
+    }
+
+    /// Phase of this session; anything but REST means a checkpoint (or recovery) is in progress.
+    inline Phase SessionPhase() const {
+        return thread_ctx().phase;
+    }
+
+    /// ID of this session (as returned by StartSession()).
+    inline const Guid &SessionId() const {
+        return thread_ctx().guid;
+    }
+
 private:
     typedef Record<key_t, value_t> record_t;
 
@@ -319,7 +523,7 @@ private:
     inline OperationStatus InternalUpsert(C &pending_context);
 
     template<class C>
-    inline OperationStatus InternalUpsertT(C &pending_context, uint16_t number);
+    inline OperationStatus InternalUpsertT(C &pending_context);
 
     template<class C>
     inline OperationStatus InternalRmw(C &pending_context, bool retrying);
@@ -329,6 +533,20 @@ private:
 
     inline OperationStatus InternalRetryPendingRmw(async_pending_rmw_context_t &pending_context);
 
+    /// Brings the (first) hash bucket for "hash" into the cache.
+    inline void PrefetchBucket(KeyHash hash) const;
+
+    /// Waits until no transaction holds "atomic_entry", then reloads "entry" and "info".
+    inline void WaitForUnlock(const AtomicHashBucketEntry *atomic_entry, HashBucketEntry &entry,
+                              HashInfo &info) const;
+
+    /// Releases the transaction locks in write_set[0, count), leaving the entries unchanged.
+    inline void ReleaseTransactionLocks(std::vector<TransactionWriteSetEntry> &write_set, size_t count);
+
+    /// After an in-place write: whether the entry was locked, or updated, since it was read.
+    inline bool EntryChanged(const AtomicHashBucketEntry *atomic_entry, HashBucketEntry expected_entry,
+                             HashInfo expected_info) const;
+
     OperationStatus InternalContinuePendingRead(ExecutionContext &ctx,
                                                 AsyncIOContext &io_context);
 
@@ -371,6 +589,32 @@ private:
 
     inline Address BlockAllocateT(uint32_t record_size, uint32_t j);
 
+    /// Latency sampling: sets the operation's start time, if it is sampled.
+    inline void StartLatencySample(pending_context_t &pending_context) {
+        if (latency_stats_) {
+            pending_context.start_ticks = latency_stats_->Start(Thread::id());
+        }
+    }
+
+    /// ...and records it, once the operation has completed, if it was.
+    inline void EndLatencySample(const pending_context_t &pending_context, LatencyOutcome outcome) {
+        if (pending_context.start_ticks != 0) {
+            LatencyOp op = pending_context.type == OperationType::Read ? LatencyOp::Read :
+                           pending_context.type == OperationType::RMW ? LatencyOp::Rmw :
+                           pending_context.type == OperationType::Delete ? LatencyOp::Delete : LatencyOp::Upsert;
+            latency_stats_->End(Thread::id(), pending_context.start_ticks, op, outcome);
+        }
+    }
+
+    /// Outcome of an operation that completed in the call that issued it.
+    static inline LatencyOutcome SyncLatencyOutcome(const pending_context_t &pending_context,
+                                                    OperationStatus internal_status) {
+        if (internal_status != OperationStatus::SUCCESS && internal_status != OperationStatus::NOT_FOUND) {
+            return LatencyOutcome::Retry;
+        }
+        return pending_context.appended ? LatencyOutcome::Rcu : LatencyOutcome::InPlace;
+    }
+
     inline Status HandleOperationStatus(ExecutionContext &ctx,
                                         pending_context_t &pending_context,
                                         OperationStatus internal_status, bool &async);
@@ -411,6 +655,13 @@ private:
 
     Status RecoverFuzzyIndexComplete(bool wait);
 
+    Status CheckpointIndexTable(uint32_t lane);
+
+    /// Each partition's hash table is checkpointed to its own file.
+    static std::string IndexTableFileName(uint32_t lane) {
+        return lane == 0 ? "ht.dat" : std::to_string(lane) + "ht.dat";
+    }
+
     Status WriteIndexMetadata();
 
     Status ReadIndexMetadata(const Guid &token);
@@ -419,9 +670,22 @@ private:
 
     Status ReadCprMetadata(const Guid &token);
 
+    Status ReadLogMetadata(const Guid &token, LogMetadata &metadata);
+
+    void InitializeDeltaCheckpoint();
+
+    void IssueDeltaCheckpoint();
+
+    Status ReplayDeltaCheckpoints();
+
+    Status CopyDeltaSegment(file_t &delta_file, uint32_t file_idx, Address address, uint8_t *buffer);
+
+    /// CopyFlushedLog(), for a range that has been evicted: reads it back from the log file.
+    Status ReadFlushedLog(uint32_t lane, Address from_address, Address until_address, uint8_t *dest);
+
     Status WriteCprContext();
 
-    Status ReadCprContexts(const Guid &token, const Guid *guids);
+    Status ReadCprContexts(const Guid &token, const std::vector<Guid> &guids);
 
     Status RecoverHybridLog();
 
@@ -437,12 +701,48 @@ private:
 
     Status RestoreHybridLog1(uint16_t rec);
 
+    /// Recover() and RecoverLazy(): reads the checkpoint metadata and the session contexts, and
+    /// loads the fuzzy index checkpoint.
+    Status RecoverIndexAndMetadata(const Guid &index_token, const Guid &hybrid_log_token);
+
+    /// RecoverLazy(): replays and restores log "rec", unless that has been done already; waits if
+    /// another thread is doing it. A whole log is replayed at once, even for one key: records carry
+    /// their keys, but the log is not ordered by them, so finding one key's (or bucket's) records
+    /// would mean reading the log's whole replay range anyway, and one replay serves every key of
+    /// the partition.
+    Status RecoverLane(uint16_t rec);
+
+    /// Operations call this before they touch a key in "lane"; it costs one load once recovery
+    /// is over.
+    inline void EnsureLaneRecovered(uint32_t lane) {
+        if (num_lanes_pending_recovery_.load(std::memory_order_acquire) > 0) {
+            RecoverLane(static_cast<uint16_t>(lane));
+        }
+    }
+
+    Status AddLaneToOrderedIndex(uint32_t lane);
+
+    /// While the ordered index is on, keys it can't hold are rejected (see OrderedIndexKey).
+    inline bool OrderedIndexRejects(const key_t &key) const {
+        return ordered_index_ && !OrderedIndexKey::Fits(key);
+    }
+
+    /// Runs fn(rec) for every hybrid log, on up to "num_threads" threads; returns the first error.
+    template<class F>
+    Status ForEachLogLane(uint32_t num_threads, F fn);
+
+    /// Waits until a page being recovered reaches "status", completing I/Os meanwhile.
+    inline void WaitForPageStatus(RecoveryStatus &recovery_status, uint32_t page,
+                                  PageRecoveryStatus status);
+
     void MarkAllPendingRequests();
 
     inline void HeavyEnter();
 
     bool CleanHashTableBuckets();
 
+    uint64_t ClearExpiredEntries(HashBucket *bucket, uint8_t version, uint32_t now);
+
     void SplitHashTableBuckets();
 
     void AddHashEntry(HashBucket *&bucket, uint32_t &next_idx, uint8_t version,
@@ -461,6 +761,10 @@ private:
         return thread_contexts_[Thread::id()].prev();
     }
 
+    inline bool OwnsPartition(uint32_t partition) const {
+        return thread_contexts_[Thread::id()].owned_partition() == partition;
+    }
+
 private:
     LightEpoch epoch_;
 
@@ -472,9 +776,39 @@ private:
     static constexpr bool kCopyReadsToTail = false;
     static constexpr uint64_t kGcHashTableChunkSize = 16384;
     static constexpr uint64_t kGrowHashTableChunkSize = 16384;
+    /// SweepExpiredEntries() visits this many hash buckets per call...
+    static constexpr uint64_t kExpirySweepChunkSize = 1024;
+    /// ...and Refresh() calls it once every this many refreshes of a session.
+    static constexpr uint32_t kExpirySweepRefreshInterval = 64;
+    /// UpsertBatch() reserves log space for at most this many bytes of records at a time.
+    static constexpr uint32_t kUpsertBatchRunSize = 64 * 1024;
+    /// ...and looks up the hash bucket of the key this many records ahead.
+    static constexpr uint32_t kUpsertBatchPrefetchDistance = 8;
 
     bool fold_over_snapshot = true;
 
+    /// With fold_over_snapshot: copy only the log segments written since the previous checkpoint
+    /// to a delta file, instead of folding the mutable region over (see EnableDeltaCheckpoints()).
+    bool delta_checkpoints_ = false;
+    /// The latest delta checkpoint, which the next one builds on; Guid{} if there is none.
+    Guid last_delta_token_;
+
+    /// See EnableMappedIndexRecovery().
+    bool mapped_index_recovery_ = false;
+
+    /// RecoverLazy() state of each log: replayed (or never part of the checkpoint), waiting for
+    /// the sweep, or being replayed.
+    enum LaneRecoveryState : uint8_t {
+        kLaneRecovered = 0,
+        kLanePending,
+        kLaneRecovering
+    };
+    std::atomic<uint8_t> lane_recovery_[128] = {};
+    std::atomic<uint32_t> num_lanes_pending_recovery_{0};
+    std::atomic<Status> lazy_recovery_status_{Status::Ok};
+    /// The background sweep.
+    std::thread recovery_thread_;
+
     /// Initial size of the table
     uint64_t min_table_size_;
 
@@ -504,13 +838,28 @@ private:
     /// Global count of pending I/Os, used for throttling.
     std::atomic<uint64_t> num_pending_ios;
 
-    /// Space for two contexts per thread, stored inline.
-    ThreadContext thread_contexts_[Thread::kMaxNumThreads];
+    /// Optional ordered index over the keys; nullptr unless EnableOrderedIndex() was called.
+    std::unique_ptr<OrderedIndex> ordered_index_;
+
+    /// See EnableLatencyStats().
+    std::unique_ptr<LatencyStats> latency_stats_;
+
+    /// Next chunk of hash buckets for SweepExpiredEntries() to visit.
+    std::atomic<uint64_t> expiry_sweep_chunk_{0};
+    /// Set by the first upsert with a TTL; until then, Refresh() doesn't sweep.
+    std::atomic<bool> ttl_used_{false};
+
+    /// Space for two contexts per thread, one (cache-line padded) slot per session.
+    PerThreadArray<ThreadContext> thread_contexts_;
 };
 
 // Implementations.
 template<class K, class V, class D>
 inline Guid FasterKv<K, V, D>::StartSession() {
+    if (Thread::id() >= thread_contexts_.size()) {
+        // (Another store raised the thread-ID space past this store's max_sessions.)
+        throw std::runtime_error{"Too many sessions for this store!"};
+    }
     SystemState state = system_state_.load();
     if (state.phase != Phase::REST) {
         throw std::runtime_error{"Can acquire only in REST phase!"};
@@ -522,6 +871,9 @@ inline Guid FasterKv<K, V, D>::StartSession() {
 
 template<class K, class V, class D>
 inline uint64_t FasterKv<K, V, D>::ContinueSession(const Guid &session_id) {
+    if (Thread::id() >= thread_contexts_.size()) {
+        throw std::runtime_error{"Too many sessions for this store!"};
+    }
     auto iter = checkpoint_.continue_tokens.find(session_id);
     if (iter == checkpoint_.continue_tokens.end()) {
         throw std::invalid_argument{"Unknown session ID"};
@@ -542,6 +894,11 @@ inline void FasterKv<K, V, D>::Refresh() {
     // We check if we are in normal mode
     SystemState new_state = system_state_.load();
     if (thread_ctx().phase == Phase::REST && new_state.phase == Phase::REST) {
+        if (ttl_used_.load(std::memory_order_relaxed) &&
+            thread_contexts_[Thread::id()].ExpirySweepDue(kExpirySweepRefreshInterval)) {
+            // Every so often, a refresh sweeps one chunk of the index for expired records.
+            SweepExpiredEntries();
+        }
         return;
     }
     HandleSpecialPhases();
@@ -576,6 +933,7 @@ inline void FasterKv<K, V, D>::StopSession() {
     assert(thread_ctx().retry_requests.empty());
     assert(thread_ctx().pending_ios.empty());
     assert(thread_ctx().io_responses.empty());
+    thread_contexts_[Thread::id()].set_owned_partition(ThreadContext::kNoPartition);
 
     assert(prev_thread_ctx().retry_requests.empty());
     assert(prev_thread_ctx().pending_ios.empty());
@@ -672,6 +1030,7 @@ inline AtomicHashBucketEntry *FasterKv<K, V, D>::FindTentativeEntry(const key_t
             }
             // We didn't find any free slots, so allocate new bucket.
             FixedPageAddress new_bucket_addr = overflow_buckets_allocator_[version].Allocate();
+            Stats::Increment(StatCounter::IndexOverflowBuckets);
             bool success;
             do {
                 HashBucketOverflowEntry new_bucket_entry{new_bucket_addr};
@@ -756,6 +1115,9 @@ inline AtomicHashBucketEntry *FasterKv<K, V, D>::FindOrCreateEntry(const key_t &
         compared[1] = 0;
         //expected[0]=entry
         if (atomic_entry->compare_exchange_strong(exchanged, compared)) {
+            // The slot is ours while it is tentative (lookups and the expiry sweep skip it), so this
+            // is where its key is written; nothing writes it once the entry is published.
+            key.Copy(atomic_entry->GetKey());
             // See if some other thread is also trying to install this tag.
             if (HasConflictingEntry(key, hash, bucket, version, atomic_entry)) {
                 // Back off and try again.
@@ -768,6 +1130,7 @@ inline AtomicHashBucketEntry *FasterKv<K, V, D>::FindOrCreateEntry(const key_t &
                 return atomic_entry;
             }
         }
+        Stats::Increment(StatCounter::IndexEntryCasFailures);
     }
     assert(false);
     return nullptr; // NOT REACHED
@@ -784,7 +1147,9 @@ inline Status FasterKv<K, V, D>::Read(RC &context, AsyncCallback callback,
     static_assert(alignof(value_t) == alignof(typename read_context_t::value_t),
                   "alignof(value_t) != alignof(typename read_context_t::value_t)");
 
+    EnsureLaneRecovered(Partition(context.key()));
     pending_read_context_t pending_context{context, callback};
+    StartLatencySample(pending_context);
     OperationStatus internal_status = InternalRead(pending_context);
     Status status;
     if (internal_status == OperationStatus::SUCCESS) {
@@ -796,6 +1161,9 @@ inline Status FasterKv<K, V, D>::Read(RC &context, AsyncCallback callback,
         bool async;
         status = HandleOperationStatus(thread_ctx(), pending_context, internal_status, async);
     }
+    if (status != Status::Pending) {
+        EndLatencySample(pending_context, SyncLatencyOutcome(pending_context, internal_status));
+    }
     thread_ctx().serial_num = monotonic_serial_num;
     return status;
 }
@@ -812,6 +1180,7 @@ inline Status FasterKv<K, V, D>::Upsert(UC &context, AsyncCallback callback,
                   "alignof(value_t) != alignof(typename upsert_context_t::value_t)");
 
     pending_upsert_context_t pending_context{context, callback};
+    StartLatencySample(pending_context);
     OperationStatus internal_status = InternalUpsert(pending_context);
     Status status;
 
@@ -821,6 +1190,9 @@ inline Status FasterKv<K, V, D>::Upsert(UC &context, AsyncCallback callback,
         bool async;
         status = HandleOperationStatus(thread_ctx(), pending_context, internal_status, async);
     }
+    if (status != Status::Pending) {
+        EndLatencySample(pending_context, SyncLatencyOutcome(pending_context, internal_status));
+    }
     thread_ctx().serial_num = monotonic_serial_num;
     return status;
 }
@@ -828,7 +1200,8 @@ inline Status FasterKv<K, V, D>::Upsert(UC &context, AsyncCallback callback,
 template<class K, class V, class D>
 template<class UC>
 inline Status
-FasterKv<K, V, D>::UpsertT(UC &context, AsyncCallback callback, uint64_t monotonic_serial_num, uint16_t thread_number) {
+FasterKv<K, V, D>::UpsertT(UC &context, AsyncCallback callback, uint64_t monotonic_serial_num, uint16_t thread_number,
+                           uint32_t ttl_seconds) {
     typedef UC upsert_context_t;
     typedef PendingUpsertContext<UC> pending_upsert_context_t;
     static_assert(std::is_base_of<value_t, typename upsert_context_t::value_t>::value,
@@ -836,16 +1209,145 @@ FasterKv<K, V, D>::UpsertT(UC &context, AsyncCallback callback, uint64_t monoton
     static_assert(alignof(value_t) == alignof(typename upsert_context_t::value_t),
                   "alignof(value_t) != alignof(typename upsert_context_t::value_t)");
 
+    if (OrderedIndexRejects(context.key())) {
+        return Status::Aborted;
+    }
+    EnsureLaneRecovered(Partition(context.key()));
     pending_upsert_context_t pending_context{context, callback};
+    StartLatencySample(pending_context);
     //OperationStatus internal_status = InternalUpsert(pending_context);
-    OperationStatus internal_status = InternalUpsertT(pending_context, thread_number);
+    pending_context.expiry = ttl_seconds == 0 ? HashInfo::kNoExpiry : Utility::NowSeconds() + ttl_seconds;
+    if (ttl_seconds != 0 && !ttl_used_.load(std::memory_order_relaxed)) {
+        ttl_used_.store(true);
+    }
+    OperationStatus internal_status = InternalUpsertT(pending_context);
     Status status;
 
     if (internal_status == OperationStatus::SUCCESS) {
         status = Status::Ok;
     } else {
+        // A checkpoint is in progress: the upsert is retried now, or goes pending and completes
+        // (through "callback") from CompletePending().
         bool async;
-        //status = HandleOperationStatus(thread_ctx(), pending_context, internal_status, async);
+        status = HandleOperationStatus(thread_ctx(), pending_context, internal_status, async);
+    }
+    if (status != Status::Pending) {
+        EndLatencySample(pending_context, SyncLatencyOutcome(pending_context, internal_status));
+    }
+    thread_ctx().serial_num = monotonic_serial_num;
+    return status;
+}
+
+template<class K, class V, class D>
+template<class UC>
+inline Status FasterKv<K, V, D>::UpsertBatch(UC *contexts, uint32_t num_contexts, AsyncCallback callback,
+                                             uint64_t monotonic_serial_num, uint32_t ttl_seconds) {
+    typedef UC upsert_context_t;
+    static_assert(std::is_base_of<value_t, typename upsert_context_t::value_t>::value,
+                  "value_t is not a base class of upsert_context_t::value_t");
+    static_assert(alignof(value_t) == alignof(typename upsert_context_t::value_t),
+                  "alignof(value_t) != alignof(typename upsert_context_t::value_t)");
+    typedef Record<key_t, typename upsert_context_t::value_t> upsert_record_t;
+
+    struct BatchEntry {
+        uint32_t idx;
+        uint32_t lane;
+        uint32_t record_size;
+        KeyHash hash;
+    };
+
+    for (uint32_t idx = 0; idx < num_contexts; ++idx) {
+        if (OrderedIndexRejects(contexts[idx].key())) {
+            // Nothing is written.
+            return Status::Aborted;
+        }
+    }
+    uint32_t expiry = ttl_seconds == 0 ? HashInfo::kNoExpiry : Utility::NowSeconds() + ttl_seconds;
+    if (ttl_seconds != 0 && !ttl_used_.load(std::memory_order_relaxed)) {
+        ttl_used_.store(true);
+    }
+    std::vector<BatchEntry> batch(num_contexts);
+    for (uint32_t idx = 0; idx < num_contexts; ++idx) {
+        const key_t &key = contexts[idx].key();
+        KeyHash hash = key.GetHash();
+        batch[idx] = BatchEntry{idx, static_cast<uint32_t>(hash.idx(min_table_size_) /
+                                                           (min_table_size_ / tlog_number)),
+                                upsert_record_t::size(key, contexts[idx].value_size()), hash};
+    }
+    // Group by lane; a stable sort keeps repeated keys (which share a lane) in order.
+    std::stable_sort(batch.begin(), batch.end(), [](const BatchEntry &lhs, const BatchEntry &rhs) {
+        return lhs.lane < rhs.lane;
+    });
+
+    Status status = Status::Ok;
+    uint32_t begin = 0;
+    while (begin < num_contexts) {
+        // Reserve space for a run of records, all in the same lane.
+        uint32_t lane = batch[begin].lane;
+        uint32_t end = begin + 1;
+        uint32_t run_size = batch[begin].record_size;
+        while (end < num_contexts && batch[end].lane == lane &&
+               run_size + batch[end].record_size <= kUpsertBatchRunSize) {
+            run_size += batch[end].record_size;
+            ++end;
+        }
+        EnsureLaneRecovered(lane);
+        Address new_address = BlockAllocateT(run_size, lane);
+        Address run_address = new_address;
+
+        for (uint32_t pos = begin; pos < end; ++pos) {
+            if (pos + kUpsertBatchPrefetchDistance < num_contexts) {
+                PrefetchBucket(batch[pos + kUpsertBatchPrefetchDistance].hash);
+            }
+            upsert_context_t &context = contexts[batch[pos].idx];
+            const key_t &key = context.key();
+            HashBucketEntry expected_entry;
+            HashInfo expected_info;
+            AtomicHashBucketEntry *atomic_entry = nullptr;
+            if (thread_ctx().phase == Phase::REST) {
+                atomic_entry = FindOrCreateEntry(key, batch[pos].hash, expected_entry, expected_info);
+                if (expected_info.locked()) {
+                    WaitForUnlock(atomic_entry, expected_entry, expected_info);
+                }
+            }
+
+            upsert_record_t *record = reinterpret_cast<upsert_record_t *>(thlog[lane]->Get(new_address));
+            new(record) upsert_record_t{
+                    RecordInfo{
+                            static_cast<uint16_t>(thread_ctx().version), true, false, false,
+                            expected_entry.address()},
+                    key};
+            context.Put(record->value());
+
+            bool published = false;
+            if (atomic_entry) {
+                HashBucketEntry updated_entry{new_address, batch[pos].hash.tag(), false};
+                HashInfo updated_info{static_cast<uint16_t>(thread_ctx().version), context.value_length(),
+                                      key.length(), 0, expiry};
+                atom_t compared[2], exchanged[2];
+                exchanged[0] = updated_entry.control_;
+                exchanged[1] = updated_info.control_;
+                compared[0] = expected_entry.control_;
+                compared[1] = expected_info.control_;
+                published = atomic_entry->compare_exchange_strong(exchanged, compared);
+            }
+            if (published) {
+                if (ordered_index_) {
+                    ordered_index_->Upsert(key, new_address);
+                }
+            } else {
+                // Lost a race for the bucket entry, or a checkpoint started while the run was being
+                // allocated; take the single-key path, which handles both.
+                record->header.invalid = true;
+                Status result = UpsertT(context, callback, monotonic_serial_num, tlog_number, ttl_seconds);
+                if (result != Status::Ok && (status == Status::Ok || status == Status::Pending)) {
+                    status = result;
+                }
+            }
+            new_address += batch[pos].record_size;
+        }
+        thlog[lane]->MarkDirty(run_address, run_size);
+        begin = end;
     }
     thread_ctx().serial_num = monotonic_serial_num;
     return status;
@@ -863,6 +1365,7 @@ inline Status FasterKv<K, V, D>::Rmw(MC &context, AsyncCallback callback,
                   "alignof(value_t) != alignof(typename rmw_context_t::value_t)");
 
     pending_rmw_context_t pending_context{context, callback};
+    StartLatencySample(pending_context);
     OperationStatus internal_status = InternalRmw(pending_context, false);
     Status status;
     if (internal_status == OperationStatus::SUCCESS) {
@@ -871,6 +1374,9 @@ inline Status FasterKv<K, V, D>::Rmw(MC &context, AsyncCallback callback,
         bool async;
         status = HandleOperationStatus(thread_ctx(), pending_context, internal_status, async);
     }
+    if (status != Status::Pending) {
+        EndLatencySample(pending_context, SyncLatencyOutcome(pending_context, internal_status));
+    }
     thread_ctx().serial_num = monotonic_serial_num;
     return status;
 }
@@ -886,7 +1392,12 @@ inline Status FasterKv<K, V, D>::Delete(DC &context, AsyncCallback callback,
     static_assert(alignof(value_t) == alignof(typename delete_context_t::value_t),
                   "alignof(value_t) != alignof(typename delete_context_t::value_t)");
 
+    if (OrderedIndexRejects(context.key())) {
+        return Status::Aborted;
+    }
+    EnsureLaneRecovered(Partition(context.key()));
     pending_delete_context_t pending_context{context, callback};
+    StartLatencySample(pending_context);
     OperationStatus internal_status = InternalDelete(pending_context);
     Status status;
     if (internal_status == OperationStatus::SUCCESS) {
@@ -897,10 +1408,285 @@ inline Status FasterKv<K, V, D>::Delete(DC &context, AsyncCallback callback,
         bool async;
         status = HandleOperationStatus(thread_ctx(), pending_context, internal_status, async);
     }
+    if (status != Status::Pending) {
+        EndLatencySample(pending_context, SyncLatencyOutcome(pending_context, internal_status));
+    }
     thread_ctx().serial_num = monotonic_serial_num;
     return status;
 }
 
+template<class K, class V, class D>
+template<class TC>
+inline Status FasterKv<K, V, D>::MultiKeyTransaction(TC &context, uint64_t monotonic_serial_num) {
+    typedef TC transaction_context_t;
+    static_assert(std::is_base_of<value_t, typename transaction_context_t::value_t>::value,
+                  "value_t is not a base class of transaction_context_t::value_t");
+    static_assert(alignof(value_t) == alignof(typename transaction_context_t::value_t),
+                  "alignof(value_t) != alignof(typename transaction_context_t::value_t)");
+    typedef Record<key_t, typename transaction_context_t::value_t> transaction_record_t;
+
+    if (thread_ctx().phase != Phase::REST) {
+        // A checkpoint (or index resize) is in progress; let this session catch up first.
+        return Status::Aborted;
+    }
+
+    std::vector<TransactionWriteSetEntry> write_set(context.num_keys());
+    for (uint32_t idx = 0; idx < context.num_keys(); ++idx) {
+        const key_t &key = context.key(idx);
+        if (OrderedIndexRejects(key)) {
+            return Status::Aborted;
+        }
+        EnsureLaneRecovered(Partition(key));
+        HashBucketEntry entry;
+        HashInfo info;
+        write_set[idx].idx = idx;
+        write_set[idx].atomic_entry = const_cast<AtomicHashBucketEntry *>(
+                FindEntry(key, key.GetHash(), entry, info));
+        if (!write_set[idx].atomic_entry) {
+            return Status::NotFound;
+        }
+        // A record that is read-only already, or too short for the new value, will need RCU.
+        Address address = entry.address();
+        write_set[idx].rcu_address = Address::kInvalidAddress;
+        write_set[idx].needs_rcu = address < thlog[address.h()]->read_only_address.load() ||
+                                   context.value_length(idx) > info.value_length();
+    }
+    // Lock in address order, so that concurrent transactions can't deadlock.
+    std::sort(write_set.begin(), write_set.end(),
+              [](const TransactionWriteSetEntry &lhs, const TransactionWriteSetEntry &rhs) {
+                  return lhs.atomic_entry < rhs.atomic_entry;
+              });
+    for (size_t pos = 1; pos < write_set.size(); ++pos) {
+        if (write_set[pos].atomic_entry == write_set[pos - 1].atomic_entry) {
+            // The same key twice; locking it the second time would spin forever.
+            return Status::Aborted;
+        }
+    }
+    // Reserve the RCU records before taking any lock.
+    for (TransactionWriteSetEntry &write : write_set) {
+        if (!write.needs_rcu) {
+            continue;
+        }
+        const key_t &key = context.key(write.idx);
+        uint32_t lane = Partition(key);
+        uint32_t record_size = transaction_record_t::size(key, context.value_size(write.idx));
+        write.rcu_address = BlockAllocateT(record_size, lane);
+        // Invalid unless the transaction commits a value to it.
+        new(thlog[lane]->Get(write.rcu_address)) transaction_record_t{
+                RecordInfo{
+                        static_cast<uint16_t>(thread_ctx().version), true, false, true,
+                        Address::kInvalidAddress},
+                key};
+        thlog[lane]->MarkDirty(write.rcu_address, record_size);
+    }
+    if (thread_ctx().phase != Phase::REST) {
+        // Allocating refreshed the epoch, and a checkpoint has started.
+        return Status::Aborted;
+    }
+
+    uint32_t now = Utility::NowSeconds();
+    for (size_t pos = 0; pos < write_set.size(); ++pos) {
+        TransactionWriteSetEntry &write = write_set[pos];
+        GenLockBackoff backoff;
+        while (true) {
+            HashBucketEntry entry = write.atomic_entry->load();
+            HashInfo info = write.atomic_entry->GetInfo();
+            if (info.locked()) {
+                backoff.Pause();
+                continue;
+            }
+            if (entry.unused() || info.tombtone() || info.expired(now)) {
+                ReleaseTransactionLocks(write_set, pos);
+                return Status::NotFound;
+            }
+            if (entry.address() < thlog[entry.address().h()]->head_address.load()) {
+                ReleaseTransactionLocks(write_set, pos);
+                return Status::Aborted;
+            }
+            atom_t compared[2], exchanged[2];
+            exchanged[0] = entry.control_;
+            exchanged[1] = info.Locked().control_;
+            compared[0] = entry.control_;
+            compared[1] = info.control_;
+            if (write.atomic_entry->compare_exchange_strong(exchanged, compared)) {
+                write.entry = entry;
+                write.info = info.Locked();
+                break;
+            }
+        }
+    }
+    if (system_state_.load().phase != Phase::REST) {
+        // A checkpoint started while we were locking; its version boundary must not fall inside the
+        // transaction.
+        ReleaseTransactionLocks(write_set, write_set.size());
+        return Status::Aborted;
+    }
+    for (TransactionWriteSetEntry &write : write_set) {
+        Address address = write.entry.address();
+        write.needs_rcu = address < thlog[address.h()]->read_only_address.load() ||
+                          context.value_length(write.idx) > write.info.value_length();
+        if (write.needs_rcu && write.rcu_address == Address::kInvalidAddress) {
+            // The record became read-only (or was replaced by a shorter one) before we locked it, and
+            // no record was reserved for it; start over, reserving one this time.
+            ReleaseTransactionLocks(write_set, write_set.size());
+            return MultiKeyTransaction(context, monotonic_serial_num);
+        }
+    }
+
+    // Every key is locked; read the current values...
+    for (const TransactionWriteSetEntry &write : write_set) {
+        Address address = write.entry.address();
+        const transaction_record_t *record = reinterpret_cast<const transaction_record_t *>(
+                thlog[address.h()]->Get(address));
+        context.Get(write.idx, record->value());
+    }
+    // ...write the new ones...
+    for (TransactionWriteSetEntry &write : write_set) {
+        Address address = write.entry.address();
+        uint16_t k = address.h();
+        HashInfo unlocked_info = write.info.Unlocked();
+        if (!write.needs_rcu) {
+            // Mutable region (as of locking, and we haven't refreshed since); update in place.
+            transaction_record_t *record = reinterpret_cast<transaction_record_t *>(thlog[k]->Get(address));
+            bool updated = context.PutAtomic(write.idx, record->value());
+            // (Without a reserved record, the new value fits; see transaction.h.)
+            assert(updated || write.rcu_address != Address::kInvalidAddress);
+            if (updated) {
+                thlog[k]->MarkDirty(address, transaction_record_t::size(context.key(write.idx),
+                                                                        context.value_size(write.idx)));
+                write.new_entry = write.entry;
+                write.new_info = unlocked_info.TransactionUpdated();
+                continue;
+            }
+        }
+        // Read-only region, or the new value does not fit; copy it to the reserved record.
+        const key_t &key = context.key(write.idx);
+        KeyHash hash = key.GetHash();
+        uint16_t j = write.rcu_address.h();
+        uint32_t record_size = transaction_record_t::size(key, context.value_size(write.idx));
+        transaction_record_t *record = reinterpret_cast<transaction_record_t *>(
+                thlog[j]->Get(write.rcu_address));
+        new(record) transaction_record_t{
+                RecordInfo{
+                        static_cast<uint16_t>(thread_ctx().version), true, false, false, address},
+                key};
+        context.Put(write.idx, record->value());
+        thlog[j]->MarkDirty(write.rcu_address, record_size);
+        write.new_entry = HashBucketEntry{write.rcu_address, hash.tag(), false};
+        write.new_info = HashInfo{static_cast<uint16_t>(thread_ctx().version), context.value_length(write.idx),
+                                  key.length(), 0, unlocked_info.expiry()};
+    }
+    // ...and publish them, releasing the locks.
+    for (TransactionWriteSetEntry &write : write_set) {
+        atom_t compared[2], exchanged[2];
+        exchanged[0] = write.new_entry.control_;
+        exchanged[1] = write.new_info.control_;
+        compared[0] = write.entry.control_;
+        compared[1] = write.info.control_;
+        // Nobody else modifies a locked entry.
+        bool success = write.atomic_entry->compare_exchange_strong(exchanged, compared);
+        assert(success);
+        (void) success;
+        if (ordered_index_ && write.new_entry != write.entry) {
+            ordered_index_->Upsert(context.key(write.idx), write.new_entry.address());
+        }
+    }
+    thread_ctx().serial_num = monotonic_serial_num;
+    return Status::Ok;
+}
+
+template<class K, class V, class D>
+inline void FasterKv<K, V, D>::PrefetchBucket(KeyHash hash) const {
+    uint64_t hash_number = hash.idx(min_table_size_) % (min_table_size_ / tlog_number);
+    uint64_t v = hash.idx(min_table_size_) / (min_table_size_ / tlog_number);
+#if defined(__x86_64__) || defined(_M_X64)
+    _mm_prefetch(reinterpret_cast<const char *>(&state_[v].bucket(hash_number)), _MM_HINT_T0);
+#endif
+}
+
+template<class K, class V, class D>
+inline void FasterKv<K, V, D>::WaitForUnlock(const AtomicHashBucketEntry *atomic_entry, HashBucketEntry &entry,
+                                             HashInfo &info) const {
+    GenLockBackoff backoff;
+    do {
+        backoff.Pause();
+        entry = atomic_entry->load();
+        info = atomic_entry->GetInfo();
+    } while (info.locked());
+}
+
+template<class K, class V, class D>
+inline bool FasterKv<K, V, D>::EntryChanged(const AtomicHashBucketEntry *atomic_entry,
+                                            HashBucketEntry expected_entry, HashInfo expected_info) const {
+    // (A transaction that updates the record in place flips the info's parity bit.)
+    return atomic_entry->load() != expected_entry || atomic_entry->GetInfo() != expected_info;
+}
+
+template<class K, class V, class D>
+inline void FasterKv<K, V, D>::ReleaseTransactionLocks(std::vector<TransactionWriteSetEntry> &write_set,
+                                                       size_t count) {
+    for (size_t pos = 0; pos < count; ++pos) {
+        TransactionWriteSetEntry &write = write_set[pos];
+        atom_t compared[2], exchanged[2];
+        exchanged[0] = write.entry.control_;
+        exchanged[1] = write.info.Unlocked().control_;
+        compared[0] = write.entry.control_;
+        compared[1] = write.info.control_;
+        bool success = write.atomic_entry->compare_exchange_strong(exchanged, compared);
+        assert(success);
+        (void) success;
+    }
+}
+
+template<class K, class V, class D>
+inline Status FasterKv<K, V, D>::EnableOrderedIndex() {
+    // Call while no sessions are running; the index is seeded from the current hash tables.
+    if (ordered_index_) {
+        return Status::Ok;
+    }
+    ordered_index_.reset(new OrderedIndex{});
+    Status result = RebuildOrderedIndex();
+    if (result != Status::Ok) {
+        ordered_index_.reset();
+    }
+    return result;
+}
+
+template<class K, class V, class D>
+template<class RC, class F>
+inline Status FasterKv<K, V, D>::RangeScan(const key_t &begin, const key_t &end, F visitor,
+                                           AsyncCallback callback, uint64_t monotonic_serial_num) {
+    typedef RC read_context_t;
+
+    if (!ordered_index_ || !OrderedIndexKey::Fits(begin) || !OrderedIndexKey::Fits(end)) {
+        return Status::Aborted;
+    }
+    // After RecoverLazy(), a log's keys join the ordered index once the log has been replayed.
+    for (uint32_t lane = 0; lane < NumPartitions(); ++lane) {
+        EnsureLaneRecovered(lane);
+    }
+    // Every key in [begin, end) is resolved through Read(), so the scan sees the same version and
+    // on-disk handling as a point read.
+    Status result = Status::Ok;
+    ordered_index_->Scan(OrderedIndexKey::FromKey(begin), OrderedIndexKey::FromKey(end),
+                         [&](uint8_t *key_bytes, uint32_t key_length, Address address) {
+                             read_context_t context{key_t{key_bytes, key_length}};
+                             Status status = Read(context, callback, monotonic_serial_num);
+                             if (status == Status::Pending) {
+                                 if (result == Status::Ok) {
+                                     result = Status::Pending;
+                                 }
+                                 return;
+                             }
+                             if (status != Status::Ok && status != Status::NotFound &&
+                                 (result == Status::Ok || result == Status::Pending)) {
+                                 result = status;
+                             }
+                             visitor(const_cast<const read_context_t &>(context), status);
+                         });
+    return result;
+}
+
 template<class K, class V, class D>
 inline bool FasterKv<K, V, D>::CompletePending(bool wait) {
     do {
@@ -959,6 +1745,7 @@ inline void FasterKv<K, V, D>::CompleteIoPendingRequests(ExecutionContext &conte
                                            pending_context.async);
         }
         if (!pending_context.async) {
+            EndLatencySample(*pending_context.get(), LatencyOutcome::Pending);
             pending_context->caller_callback(pending_context->caller_context, result);
         }
     }
@@ -980,7 +1767,7 @@ inline void FasterKv<K, V, D>::CompleteRetryRequests(ExecutionContext &context)
                         *static_cast<async_pending_rmw_context_t *>(pending_context.get()));
                 break;
             case OperationType::Upsert:
-                internal_status = InternalUpsert(
+                internal_status = InternalUpsertT(
                         *static_cast<async_pending_upsert_context_t *>(pending_context.get()));
                 break;
             default:
@@ -998,6 +1785,7 @@ inline void FasterKv<K, V, D>::CompleteRetryRequests(ExecutionContext &context)
 
         // If done, callback user code.
         if (!pending_context.async) {
+            EndLatencySample(*pending_context.get(), LatencyOutcome::Retry);
             pending_context->caller_callback(pending_context->caller_context, result);
         }
     }
@@ -1021,6 +1809,14 @@ inline OperationStatus FasterKv<K, V, D>::InternalRead(C &pending_context) const
         // no record found
         return OperationStatus::NOT_FOUND;
     }
+    if (info.locked()) {
+        // A transaction is updating the key; read its result.
+        WaitForUnlock(atomic_entry, entry, info);
+    }
+    if (info.expiry() != HashInfo::kNoExpiry && info.expired(Utility::NowSeconds())) {
+        // The bucket entry says the record has expired; no need to look at the record itself.
+        return OperationStatus::NOT_FOUND;
+    }
 
     // HashBucketEntry entry = atomic_entry->load();
     Address address = entry.address();
@@ -1063,7 +1859,12 @@ inline OperationStatus FasterKv<K, V, D>::InternalRead(C &pending_context) const
         if (info.tombtone()) {
             return OperationStatus::NOT_FOUND;
         }
-        pending_context.GetAtomic(thlog[k]->Get(address));
+        if (OwnsPartition(k)) {
+            // No other thread writes the partition.
+            pending_context.Get(thlog[k]->Get(address));
+        } else {
+            pending_context.GetAtomic(thlog[k]->Get(address));
+        }
         return OperationStatus::SUCCESS;
     } else if (address >= head_address) {
         // Immutable region
@@ -1145,6 +1946,7 @@ inline OperationStatus FasterKv<K, V, D>::InternalUpsert(C &pending_context) {
             return OperationStatus::SUCCESS;
         } else {
             // Must retry as RCU.
+            Stats::Increment(StatCounter::RcuFallbacks);
             goto create_record;
         }
     }
@@ -1213,12 +2015,14 @@ inline OperationStatus FasterKv<K, V, D>::InternalUpsert(C &pending_context) {
             return OperationStatus::SUCCESS;
         } else {
             // Must retry as RCU.
+            Stats::Increment(StatCounter::RcuFallbacks);
             goto create_record;
         }
     }
 
     // Create a record and attempt RCU.
     create_record:
+    pending_context.appended = true;
     uint32_t record_size = record_t::size(key, pending_context.value_size());
     Address new_address = BlockAllocateT(record_size, j);
     record_t *record = reinterpret_cast<record_t *>(thlog[j]->Get(new_address));
@@ -1245,7 +2049,7 @@ inline OperationStatus FasterKv<K, V, D>::InternalUpsert(C &pending_context) {
 
 template<class K, class V, class D>
 template<class C>
-inline OperationStatus FasterKv<K, V, D>::InternalUpsertT(C &pending_context, uint16_t number) {
+inline OperationStatus FasterKv<K, V, D>::InternalUpsertT(C &pending_context) {
     typedef C pending_upsert_context_t;
 
     if (thread_ctx().phase != Phase::REST) {
@@ -1261,6 +2065,9 @@ inline OperationStatus FasterKv<K, V, D>::InternalUpsertT(C &pending_context, ui
     HashBucket *bucket;
     HashInfo expected_info;
     AtomicHashBucketEntry *atomic_entry = FindOrCreateEntry(key, hash, expected_entry, expected_info);   //entry ？？
+    if (expected_info.locked()) {
+        WaitForUnlock(atomic_entry, expected_entry, expected_info);
+    }
 
     // (Note that address will be Address::kInvalidAddress, if the atomic_entry was created.)
     Address address = expected_entry.address();
@@ -1273,7 +2080,6 @@ inline OperationStatus FasterKv<K, V, D>::InternalUpsertT(C &pending_context, ui
     //Address head_address = hlog.head_address.load();
     //Address read_only_address = hlog.read_only_address.load();
     uint64_t latest_record_version = 0;
-    int key_flag = 0;
 
     if (address >= head_address) {
         // Multiple keys may share the same hash. Try to find the most recent record with a matching
@@ -1281,7 +2087,6 @@ inline OperationStatus FasterKv<K, V, D>::InternalUpsertT(C &pending_context, ui
         //record_t *record = reinterpret_cast<record_t *>(thlog[k]->Get(address));
         //latest_record_version = record->header.checkpoint_version;
         latest_record_version = expected_info.version();
-        key_flag = 1;
         /*
         if(latest_record_version != 0){
             cout<<"fails"<<latest_record_version<<endl;
@@ -1303,16 +2108,32 @@ inline OperationStatus FasterKv<K, V, D>::InternalUpsertT(C &pending_context, ui
 
     // The common case
     if (thread_ctx().phase == Phase::REST && address >= read_only_address) {
-        if (!expected_info.tombtone() && pending_context.value_length() <= expected_info.value_length()) {
+        // A different expiry has to be published through the bucket entry, so it needs RCU. (Expiries
+        // are compared exactly, so nearly every upsert with a TTL takes this path.)
+        if (!expected_info.tombtone() && expected_info.expiry() == pending_context.expiry &&
+            pending_context.value_length() <= expected_info.value_length()) {
             record_t *record = reinterpret_cast<record_t *>(thlog[k]->Get(address));
-            if (pending_context.PutAtomic(record)) {
+            if (OwnsPartition(k)) {
+                // No other thread reads or writes the partition; the new value fits.
+                pending_context.Put(record);
+                thlog[k]->MarkDirty(address, record_t::size(key, pending_context.value_size()));
+                return OperationStatus::SUCCESS;
+            } else if (pending_context.PutAtomic(record)) {
+                thlog[k]->MarkDirty(address, record_t::size(key, pending_context.value_size()));
+                if (EntryChanged(atomic_entry, expected_entry, expected_info)) {
+                    // A transaction may have read the old value, and overwritten ours.
+                    Stats::Increment(StatCounter::RcuFallbacks);
+                    goto create_record;
+                }
                 return OperationStatus::SUCCESS;
             } else {
                 // Must retry as RCU.
+                Stats::Increment(StatCounter::RcuFallbacks);
                 goto create_record;
             }
         } else {
             // Must retry as RCU.
+            Stats::Increment(StatCounter::RcuFallbacks);
             goto create_record;
         }
     }
@@ -1376,33 +2197,51 @@ inline OperationStatus FasterKv<K, V, D>::InternalUpsertT(C &pending_context, ui
         }
         // We acquired the necessary locks, so so we can update the record's bucket atomically.
         record_t *record = reinterpret_cast<record_t *>(thlog[k]->Get(address));
-        if (!record->header.tombstone && pending_context.PutAtomic(record)) {
+        if (!record->header.tombstone && expected_info.expiry() == pending_context.expiry && pending_context.PutAtomic(record)) {
             // Host successfully replaced record, atomically.
+            thlog[k]->MarkDirty(address, record_t::size(key, pending_context.value_size()));
+            if (EntryChanged(atomic_entry, expected_entry, expected_info)) {
+                // A transaction may have read the old value, and overwritten ours.
+                Stats::Increment(StatCounter::RcuFallbacks);
+                goto create_record;
+            }
             return OperationStatus::SUCCESS;
         } else {
             // Must retry as RCU.
+            Stats::Increment(StatCounter::RcuFallbacks);
             goto create_record;
         }
     }
 
     // Create a record and attempt RCU.
     create_record:
+    pending_context.appended = true;
     //record_number.fetch_add(1);
     uint32_t record_size = record_t::size(key, pending_context.value_size());
     Address new_address = BlockAllocateT(record_size, j);
     record_t *record = reinterpret_cast<record_t *>(thlog[j]->Get(new_address));
+    // (The hash table keeps a copy of the key; the record's is for recovery, and for reads that go
+    // to disk.)
     new(record) record_t{
             RecordInfo{
                     static_cast<uint16_t>(thread_ctx().version), true, false, false,
-                    expected_entry.address()}};
+                    expected_entry.address()},
+            key};
     pending_context.Put(record);   //put ？？？
-    if (!key_flag)
-        key.Copy(atomic_entry->GetKey());
+    thlog[j]->MarkDirty(new_address, record_size);
     //std::memcpy(buf, buf_, len_);
     // new_address+=Address{0,0,j}.control();
     //HashBucketEntry updated_entry{new_address, hash.tag(), false};
     HashBucketEntry updated_entry{new_address, hash.tag(), false};
-    HashInfo updated_info{static_cast<uint16_t>(thread_ctx().version), pending_context.value_length(), key.length(), 0};
+    HashInfo updated_info{static_cast<uint16_t>(thread_ctx().version), pending_context.value_length(), key.length(), 0,
+                          pending_context.expiry};
+    if (OwnsPartition(j)) {
+        atomic_entry->store(updated_entry, updated_info);
+        if (ordered_index_) {
+            ordered_index_->Upsert(key, new_address);
+        }
+        return OperationStatus::SUCCESS;
+    }
     atom_t compared[2], exchanged[2];
     exchanged[0] = updated_entry.control_;
     exchanged[1] = updated_info.control_;
@@ -1410,11 +2249,16 @@ inline OperationStatus FasterKv<K, V, D>::InternalUpsertT(C &pending_context, ui
     compared[1] = expected_info.control_;
     if (atomic_entry->compare_exchange_strong(exchanged, compared)) {
         // Installed the new record in the hash table.
+        if (ordered_index_) {
+            ordered_index_->Upsert(key, new_address);
+        }
         return OperationStatus::SUCCESS;
     } else {
         // Try again.
+        Stats::Increment(StatCounter::RecordInstallRetries);
         record->header.invalid = true;
-        return InternalUpsertT(pending_context, number);
+        thlog[j]->MarkDirty(new_address, sizeof(RecordInfo));
+        return InternalUpsertT(pending_context);
         //return InternalUpsert(pending_context);
     }
 }
@@ -1466,6 +2310,7 @@ inline OperationStatus FasterKv<K, V, D>::InternalRmw(C &pending_context, bool r
             return OperationStatus::SUCCESS;
         } else {
             // Must retry as RCU.
+            Stats::Increment(StatCounter::RcuFallbacks);
             goto create_record;
         }
     }
@@ -1547,6 +2392,7 @@ inline OperationStatus FasterKv<K, V, D>::InternalRmw(C &pending_context, bool r
             return OperationStatus::SUCCESS;
         } else {
             // Must retry as RCU.
+            Stats::Increment(StatCounter::RcuFallbacks);
             goto create_record;
         }
     } else if (address >= safe_read_only_address &&
@@ -1575,6 +2421,7 @@ inline OperationStatus FasterKv<K, V, D>::InternalRmw(C &pending_context, bool r
 
     // Create a record and attempt RCU.
     create_record:
+    pending_context.appended = true;
     const record_t *old_record = nullptr;
     if (address >= head_address) {
         old_record = reinterpret_cast<const record_t *>(hlog.Get(address));
@@ -1655,26 +2502,29 @@ inline OperationStatus FasterKv<K, V, D>::InternalDelete(C &pending_context) {
 
     const key_t &key = pending_context.key();
     KeyHash hash = key.GetHash();
+    uint16_t j = hash.idx(min_table_size_) / (min_table_size_ / tlog_number);
     HashBucketEntry expected_entry;
-    AtomicHashBucketEntry *atomic_entry;
-    //= const_cast<AtomicHashBucketEntry *>(FindEntry(hash, expected_entry));
-    if (!atomic_entry) {
+    HashInfo expected_info;
+    AtomicHashBucketEntry *atomic_entry = const_cast<AtomicHashBucketEntry *>(
+            FindEntry(key, hash, expected_entry, expected_info));
+    if (atomic_entry && expected_info.locked()) {
+        WaitForUnlock(atomic_entry, expected_entry, expected_info);
+    }
+    if (!atomic_entry || expected_info.tombtone() ||
+        (expected_info.expiry() != HashInfo::kNoExpiry && expected_info.expired(Utility::NowSeconds()))) {
         // no record found
         return OperationStatus::NOT_FOUND;
     }
 
     Address address = expected_entry.address();
-    Address head_address = hlog.head_address.load();
-    Address read_only_address = hlog.read_only_address.load();
-    Address begin_address = hlog.begin_address.load();
+    uint16_t k = address.h();
+    Address head_address = thlog[k]->head_address.load();
+    Address read_only_address = thlog[k]->read_only_address.load();
     uint64_t latest_record_version = 0;
 
     if (address >= head_address) {
-        const record_t *record = reinterpret_cast<const record_t *>(hlog.Get(address));
-        latest_record_version = record->header.checkpoint_version;
-        if (key != record->key()) {
-            address = TraceBackForKeyMatch(key, record->header.previous_address(), head_address);
-        }
+        // The bucket entry carries the key and the record's version.
+        latest_record_version = expected_info.version();
     }
 
     CheckpointLockGuard lock_guard{checkpoint_locks_, hash};
@@ -1732,39 +2582,57 @@ inline OperationStatus FasterKv<K, V, D>::InternalDelete(C &pending_context) {
 
     // Mutable Region: Update the record in-place
     if (address >= read_only_address) {
-        record_t *record = reinterpret_cast<record_t *>(hlog.Get(address));
-        // If the record is the head of the hash chain, try to update the hash chain and completely
-        // elide record only if the previous address points to invalid address
-        if (expected_entry.address() == address) {
-            Address previous_address = record->header.previous_address();
-            if (previous_address < begin_address) {
-                //atomic_entry->compare_exchange_strong(expected_entry, HashBucketEntry::kInvalidEntry);
-            }
+        // Readers check the tombstone in the bucket entry, so publish it there.
+        HashInfo updated_info{expected_info.version(), expected_info.value_length(), expected_info.key_length(), 1};
+        atom_t compared[2], exchanged[2];
+        exchanged[0] = expected_entry.control_;
+        exchanged[1] = updated_info.control_;
+        compared[0] = expected_entry.control_;
+        compared[1] = expected_info.control_;
+        if (!atomic_entry->compare_exchange_strong(exchanged, compared)) {
+            return OperationStatus::RETRY_NOW;
         }
+        record_t *record = reinterpret_cast<record_t *>(thlog[k]->Get(address));
         record->header.tombstone = true;
+        thlog[k]->MarkDirty(address, sizeof(RecordInfo));
+        if (ordered_index_) {
+            ordered_index_->Delete(key, address);
+        }
         return OperationStatus::SUCCESS;
     }
 
     create_record:
+    pending_context.appended = true;
     uint32_t record_size = record_t::size(key, pending_context.value_size());
-    Address new_address = BlockAllocate(record_size);
-    record_t *record = reinterpret_cast<record_t *>(hlog.Get(new_address));
+    Address new_address = BlockAllocateT(record_size, j);
+    record_t *record = reinterpret_cast<record_t *>(thlog[j]->Get(new_address));
     new(record) record_t{
             RecordInfo{
                     static_cast<uint16_t>(thread_ctx().version), true, true, false,
                     expected_entry.address()},
             key};
+    thlog[j]->MarkDirty(new_address, record_size);
 
     HashBucketEntry updated_entry{new_address, hash.tag(), false};
-
-    /*if (atomic_entry->compare_exchange_strong(expected_entry, updated_entry)) {
+    HashInfo updated_info{static_cast<uint16_t>(thread_ctx().version), 0, key.length(), 1};
+    atom_t compared[2], exchanged[2];
+    exchanged[0] = updated_entry.control_;
+    exchanged[1] = updated_info.control_;
+    compared[0] = expected_entry.control_;
+    compared[1] = expected_info.control_;
+    if (atomic_entry->compare_exchange_strong(exchanged, compared)) {
         // Installed the new record in the hash table.
+        if (ordered_index_) {
+            ordered_index_->Delete(key, new_address);
+        }
         return OperationStatus::SUCCESS;
     } else {
         // Try again.
+        Stats::Increment(StatCounter::RecordInstallRetries);
         record->header.invalid = true;
+        thlog[j]->MarkDirty(new_address, sizeof(RecordInfo));
         return OperationStatus::RETRY_NOW;
-    }*/
+    }
 }
 
 template<class K, class V, class D>
@@ -1849,7 +2717,7 @@ inline Status FasterKv<K, V, D>::HandleOperationStatus(ExecutionContext &ctx,
                 case OperationType::Upsert: {
                     async_pending_upsert_context_t &upsert_context =
                             *static_cast<async_pending_upsert_context_t *>(&pending_context);
-                    internal_status = InternalUpsert(upsert_context);
+                    internal_status = InternalUpsertT(upsert_context);
                     break;
                 }
                 case OperationType::Delete: {
@@ -1899,6 +2767,7 @@ inline Status FasterKv<K, V, D>::HandleOperationStatus(ExecutionContext &ctx,
             checkpoint_locks_.get_lock(pending_context.key().GetHash()).unlock_old();
             return Status::NotFound;
         case OperationStatus::CPR_SHIFT_DETECTED:
+            Stats::Increment(StatCounter::CprShiftRetries);
             return PivotAndRetry(ctx, pending_context, async);
     }
     // not reached
@@ -1927,6 +2796,7 @@ inline Status FasterKv<K, V, D>::RetryLater(ExecutionContext &ctx,
     IAsyncContext *context_copy;
     Status result = pending_context.DeepCopy(context_copy);
     if (result == Status::Ok) {
+        Stats::Increment(StatCounter::RetryLaterOperations);
         async = true;
         ctx.retry_requests.push_back(context_copy);
         return Status::Pending;
@@ -1949,6 +2819,7 @@ inline Status FasterKv<K, V, D>::IssueAsyncIoRequest(ExecutionContext &ctx,
     // Issue asynchronous I/O request
     uint64_t io_id = thread_ctx().io_id++;
     thread_ctx().pending_ios.insert({io_id, pending_context.key().GetHash()});
+    Stats::Increment(StatCounter::PendingIosIssued);
     async = true;
     AsyncIOContext io_request{this, pending_context.address, &pending_context,
                               &thread_ctx().io_responses, io_id};
@@ -1967,6 +2838,9 @@ inline Address FasterKv<K, V, D>::BlockAllocate(uint32_t record_size) {
         bool page_closed = (retval == Address::kInvalidAddress);
         while (page_closed) {
             page_closed = !hlog.NewPage(page);
+            if (page_closed) {
+                Stats::Increment(StatCounter::NewPageStalls);
+            }
             Refresh();
         }
         retval = hlog.Allocate(record_size, page);
@@ -1987,6 +2861,9 @@ inline Address FasterKv<K, V, D>::BlockAllocateT(uint32_t record_size, uint32_t
         bool page_closed = (retval == test);
         while (page_closed) {
             page_closed = !thlog[j]->NewPage(page);
+            if (page_closed) {
+                Stats::Increment(StatCounter::NewPageStalls);
+            }
             Refresh();
         }
         retval = thlog[j]->Allocate(record_size, page);
@@ -2000,6 +2877,9 @@ void FasterKv<K, V, D>::AsyncGetFromDisk(Address address, uint32_t num_records,
                                          AsyncIOCallback callback, AsyncIOContext &context) {
     if (epoch_.IsProtected()) {
         /// Throttling. (Thread pool, unprotected threads are not throttled.)
+        if (num_pending_ios.load() > 120) {
+            Stats::Increment(StatCounter::PendingIoThrottles);
+        }
         while (num_pending_ios.load() > 120) {
             disk.TryComplete();
             std::this_thread::yield();
@@ -2214,9 +3094,10 @@ Status FasterKv<K, V, D>::WriteCprMetadata() {
     if (!file) {
         return Status::IOError;
     }
-    if (std::fwrite(&checkpoint_.log_metadata, sizeof(checkpoint_.log_metadata), 1, file) != 1) {
+    Status result = checkpoint_.log_metadata.Write(file);
+    if (result != Status::Ok) {
         std::fclose(file);
-        return Status::IOError;
+        return result;
     }
     if (std::fclose(file) != 0) {
         return Status::IOError;
@@ -2226,6 +3107,11 @@ Status FasterKv<K, V, D>::WriteCprMetadata() {
 
 template<class K, class V, class D>
 Status FasterKv<K, V, D>::ReadCprMetadata(const Guid &token) {
+    return ReadLogMetadata(token, checkpoint_.log_metadata);
+}
+
+template<class K, class V, class D>
+Status FasterKv<K, V, D>::ReadLogMetadata(const Guid &token, LogMetadata &metadata) {
     std::string filename = disk.cpr_checkpoint_path(token) + "info.dat";
     // (This code will need to be refactored into the disk_t interface, if we want to support
     // unformatted disks.)
@@ -2233,9 +3119,10 @@ Status FasterKv<K, V, D>::ReadCprMetadata(const Guid &token) {
     if (!file) {
         return Status::IOError;
     }
-    if (std::fread(&checkpoint_.log_metadata, sizeof(checkpoint_.log_metadata), 1, file) != 1) {
+    Status result = metadata.Read(file);
+    if (result != Status::Ok) {
         std::fclose(file);
-        return Status::IOError;
+        return result;
     }
     if (std::fclose(file) != 0) {
         return Status::IOError;
@@ -2267,9 +3154,8 @@ Status FasterKv<K, V, D>::WriteCprContext() {
 }
 
 template<class K, class V, class D>
-Status FasterKv<K, V, D>::ReadCprContexts(const Guid &token, const Guid *guids) {
-    for (size_t idx = 0; idx < Thread::kMaxNumThreads; ++idx) {
-        const Guid &guid = guids[idx];
+Status FasterKv<K, V, D>::ReadCprContexts(const Guid &token, const std::vector<Guid> &guids) {
+    for (const Guid &guid : guids) {
         if (guid == Guid{}) {
             continue;
         }
@@ -2303,12 +3189,10 @@ Status FasterKv<K, V, D>::ReadCprContexts(const Guid &token, const Guid *guids)
 template<class K, class V, class D>
 Status FasterKv<K, V, D>::CheckpointFuzzyIndex() {
     uint32_t hash_table_version = resize_info_.version;
-    // Checkpoint the main hash table.
-    file_t ht_file = disk.NewFile(disk.relative_index_checkpoint_path(checkpoint_.index_token) +
-                                  "ht.dat");
-    RETURN_NOT_OK(ht_file.Open(&disk.handler()));
-    RETURN_NOT_OK(state_[hash_table_version].Checkpoint(disk, std::move(ht_file),
-                                                        checkpoint_.index_metadata.num_ht_bytes));
+    // Checkpoint the first partition's hash table; CheckpointFuzzyIndexComplete() moves on to the
+    // others.
+    checkpoint_.index_checkpoint_lane = 0;
+    RETURN_NOT_OK(CheckpointIndexTable(0));
     // Checkpoint the hash table's overflow buckets.
     file_t ofb_file = disk.NewFile(disk.relative_index_checkpoint_path(checkpoint_.index_token) +
                                    "ofb.dat");
@@ -2326,14 +3210,37 @@ Status FasterKv<K, V, D>::CheckpointFuzzyIndexComplete() {
         return Status::Pending;
     }
     uint32_t hash_table_version = resize_info_.version;
-    Status result = state_[hash_table_version].CheckpointComplete(false);
-    if (result == Status::Pending) {
-        return Status::Pending;
-    } else if (result != Status::Ok) {
+    // The partitions' hash tables are written one after another, so that their writes don't
+    // overrun the I/O queue; whichever thread sees one finish issues the next.
+    uint32_t lane = checkpoint_.index_checkpoint_lane.load();
+    while (lane + 1 < static_cast<uint32_t>(tlog_number) || lane == CheckpointState<file_t>::kIssuingLane) {
+        if (lane == CheckpointState<file_t>::kIssuingLane) {
+            return Status::Pending;
+        }
+        Status result = state_[lane].CheckpointComplete(false);
+        if (result != Status::Ok) {
+            return result;
+        }
+        if (checkpoint_.index_checkpoint_lane.compare_exchange_strong(lane, CheckpointState<file_t>::kIssuingLane)) {
+            result = CheckpointIndexTable(lane + 1);
+            checkpoint_.index_checkpoint_lane = lane + 1;
+            return result == Status::Ok ? Status::Pending : result;
+        }
+    }
+    Status result = state_[lane].CheckpointComplete(false);
+    if (result != Status::Ok) {
         return result;
-    } else {
-        return overflow_buckets_allocator_[hash_table_version].CheckpointComplete(false);
     }
+    return overflow_buckets_allocator_[hash_table_version].CheckpointComplete(false);
+}
+
+template<class K, class V, class D>
+Status FasterKv<K, V, D>::CheckpointIndexTable(uint32_t lane) {
+    file_t ht_file = disk.NewFile(disk.relative_index_checkpoint_path(checkpoint_.index_token) +
+                                  IndexTableFileName(lane));
+    RETURN_NOT_OK(ht_file.Open(&disk.handler()));
+    // (All the tables are the same size.)
+    return state_[lane].Checkpoint(disk, std::move(ht_file), checkpoint_.index_metadata.num_ht_bytes);
 }
 
 template<class K, class V, class D>
@@ -2341,12 +3248,22 @@ Status FasterKv<K, V, D>::RecoverFuzzyIndex() {
     uint8_t hash_table_version = resize_info_.version;
     assert(state_[hash_table_version].size() == checkpoint_.index_metadata.table_size);
 
-    // Recover the main hash table.
-    file_t ht_file = disk.NewFile(disk.relative_index_checkpoint_path(checkpoint_.index_token) +
-                                  "ht.dat");
-    RETURN_NOT_OK(ht_file.Open(&disk.handler()));
-    RETURN_NOT_OK(state_[hash_table_version].Recover(disk, std::move(ht_file),
-                                                     checkpoint_.index_metadata.num_ht_bytes));
+    // Recover each partition's hash table.
+    for (int lane = 0; lane < tlog_number; ++lane) {
+        if (mapped_index_recovery_) {
+            RETURN_NOT_OK(state_[lane].RecoverMapped(
+                    disk, disk.index_checkpoint_path(checkpoint_.index_token) + IndexTableFileName(lane),
+                    checkpoint_.index_metadata.num_ht_bytes));
+        } else {
+            file_t ht_file = disk.NewFile(disk.relative_index_checkpoint_path(checkpoint_.index_token) +
+                                          IndexTableFileName(lane));
+            RETURN_NOT_OK(ht_file.Open(&disk.handler()));
+            RETURN_NOT_OK(state_[lane].Recover(disk, std::move(ht_file),
+                                               checkpoint_.index_metadata.num_ht_bytes));
+            // One table at a time, so as not to overrun the I/O queue.
+            RETURN_NOT_OK(state_[lane].RecoverComplete(true));
+        }
+    }
     // Recover the hash table's overflow buckets.
     file_t ofb_file = disk.NewFile(disk.relative_index_checkpoint_path(checkpoint_.index_token) +
                                    "ofb.dat");
@@ -2359,37 +3276,177 @@ Status FasterKv<K, V, D>::RecoverFuzzyIndex() {
 template<class K, class V, class D>
 Status FasterKv<K, V, D>::RecoverFuzzyIndexComplete(bool wait) {
     uint8_t hash_table_version = resize_info_.version;
-    Status result = state_[hash_table_version].RecoverComplete(true);
-    if (result != Status::Ok) {
-        return result;
+    for (int lane = 0; lane < tlog_number; ++lane) {
+        Status result = state_[lane].RecoverComplete(true);
+        if (result != Status::Ok) {
+            return result;
+        }
     }
-    result = overflow_buckets_allocator_[hash_table_version].RecoverComplete(true);
+    Status result = overflow_buckets_allocator_[hash_table_version].RecoverComplete(true);
     if (result != Status::Ok) {
         return result;
     }
 
-    // Clear all tentative entries.
-    for (uint64_t bucket_idx = 0; bucket_idx < state_[hash_table_version].size(); ++bucket_idx) {
-        HashBucket *bucket = &state_[hash_table_version].bucket(bucket_idx);
-        while (true) {
-            for (uint32_t entry_idx = 0; entry_idx < HashBucket::kNumEntries; ++entry_idx) {
-                if (bucket->entries[entry_idx].load().tentative()) {
-                    bucket->entries[entry_idx].store(HashBucketEntry::kInvalidEntry);
+    // Clear all tentative entries. (A mapped table is read through once here, but only the pages
+    // that hold tentative entries get private copies.)
+    for (int lane = 0; lane < tlog_number; ++lane) {
+        for (uint64_t bucket_idx = 0; bucket_idx < state_[lane].size(); ++bucket_idx) {
+            HashBucket *bucket = &state_[lane].bucket(bucket_idx);
+            while (true) {
+                for (uint32_t entry_idx = 0; entry_idx < HashBucket::kNumEntries; ++entry_idx) {
+                    if (bucket->entries[entry_idx].load().tentative()) {
+                        bucket->entries[entry_idx].store(HashBucketEntry::kInvalidEntry);
+                    }
                 }
+                // Go to next bucket in the chain
+                HashBucketOverflowEntry entry = bucket->overflow_entry.load();
+                if (entry.unused()) {
+                    // No more buckets in the chain.
+                    break;
+                }
+                bucket = &overflow_buckets_allocator_[hash_table_version].Get(entry.address());
+                assert(reinterpret_cast<size_t>(bucket) % Constants::kCacheLineBytes == 0);
             }
-            // Go to next bucket in the chain
-            HashBucketOverflowEntry entry = bucket->overflow_entry.load();
-            if (entry.unused()) {
-                // No more buckets in the chain.
-                break;
-            }
-            bucket = &overflow_buckets_allocator_[hash_table_version].Get(entry.address());
-            assert(reinterpret_cast<size_t>(bucket) % Constants::kCacheLineBytes == 0);
         }
     }
     return Status::Ok;
 }
 
+template<class K, class V, class D>
+void FasterKv<K, V, D>::InitializeDeltaCheckpoint() {
+    if (delta_checkpoints_) {
+        checkpoint_.log_metadata.use_delta = true;
+        checkpoint_.log_metadata.previous_delta_token = last_delta_token_;
+        // Until IssueDeltaCheckpoint() knows how many segments there are.
+        checkpoint_.flush_pending = UINT32_MAX;
+    }
+}
+
+template<class K, class V, class D>
+void FasterKv<K, V, D>::IssueDeltaCheckpoint() {
+    // The mutable region stays mutable. Everything below the read-only address reaches the log
+    // anyway; above it, copy the segments written since the previous checkpoint to a delta file.
+    LogMetadata &metadata = checkpoint_.log_metadata;
+    metadata.final_address = thlog[0]->GetTailAddress();
+    uint32_t lane_begin[LogMetadata::kNumTlogs + 1];
+    for (int i = 0; i < tlog_number; i++) {
+        lane_begin[i] = static_cast<uint32_t>(metadata.delta_segments.size());
+        Address read_only_address = thlog[i]->read_only_address.load();
+        Address tail_address = thlog[i]->GetTailAddress();
+        metadata.tdelta_address[i] = read_only_address;
+        metadata.tfinal_address[i] = tail_address;
+        if (read_only_address < tail_address) {
+            thlog[i]->CollectDirtySegments(read_only_address, tail_address, metadata.delta_segments);
+        }
+    }
+    lane_begin[tlog_number] = static_cast<uint32_t>(metadata.delta_segments.size());
+    last_delta_token_ = checkpoint_.hybrid_log_token;
+
+    checkpoint_.snapshot_file = disk.NewFile(disk.relative_cpr_checkpoint_path(
+            checkpoint_.hybrid_log_token) + "delta.dat");
+    if (checkpoint_.snapshot_file.Open(&disk.handler()) != Status::Ok) {
+        checkpoint_.failed = true;
+        checkpoint_.flush_pending = 0;
+        return;
+    }
+    checkpoint_.flush_pending = lane_begin[tlog_number];
+    for (int i = 0; i < tlog_number; i++) {
+        uint32_t num_segments = lane_begin[i + 1] - lane_begin[i];
+        if (num_segments > 0 &&
+            thlog[i]->AsyncFlushSegmentsToFile(metadata.delta_segments.data() + lane_begin[i], num_segments,
+                                               lane_begin[i], checkpoint_.snapshot_file,
+                                               checkpoint_.flush_pending) != Status::Ok) {
+            checkpoint_.failed = true;
+        }
+    }
+}
+
+template<class K, class V, class D>
+Status FasterKv<K, V, D>::ReplayDeltaCheckpoints() {
+    // Newest delta first. Segments that start a whole segment below where the newest delta starts
+    // are in the log already; and a segment saved by a newer delta supersedes older copies of it.
+    // Recovery then proceeds as if the checkpoint had folded the logs over.
+    const LogMetadata &newest = checkpoint_.log_metadata;
+    LogMetadata older;
+    const LogMetadata *delta = &newest;
+    Guid token = checkpoint_.hybrid_log_token;
+    std::unordered_set<uint64_t> copied;
+    auto buffer = alloc_aligned<uint8_t>(thlog[0]->sector_size, DirtySegments::kSegmentSize);
+    while (true) {
+        file_t delta_file = disk.NewFile(disk.relative_cpr_checkpoint_path(token) + "delta.dat");
+        RETURN_NOT_OK(delta_file.Open(&disk.handler()));
+        for (uint32_t idx = 0; idx < delta->delta_segments.size(); ++idx) {
+            Address address = delta->delta_segments[idx];
+            uint16_t lane = address.h();
+            if (address.control() + DirtySegments::kSegmentSize <= newest.tdelta_address[lane].control() ||
+                address >= newest.tfinal_address[lane] || !copied.insert(address.control()).second) {
+                continue;
+            }
+            Status result = CopyDeltaSegment(delta_file, idx, address, buffer.get());
+            if (result != Status::Ok) {
+                delta_file.Close();
+                return result;
+            }
+        }
+        delta_file.Close();
+        if (delta->previous_delta_token == Guid{}) {
+            return Status::Ok;
+        }
+        token = delta->previous_delta_token;
+        RETURN_NOT_OK(ReadLogMetadata(token, older));
+        delta = &older;
+    }
+}
+
+template<class K, class V, class D>
+Status FasterKv<K, V, D>::CopyDeltaSegment(file_t &delta_file, uint32_t file_idx, Address address,
+                                           uint8_t *buffer) {
+    class Context : public IAsyncContext {
+    public:
+        Context(std::atomic<bool> &done_, Status &result_)
+                : done{&done_}, result{&result_} {
+        }
+
+        /// The deep-copy constructor
+        Context(const Context &other)
+                : done{other.done}, result{other.result} {
+        }
+
+    protected:
+        Status DeepCopy_Internal(IAsyncContext *&context_copy) final {
+            return IAsyncContext::DeepCopy_Internal(*this, context_copy);
+        }
+
+    public:
+        std::atomic<bool> *done;
+        Status *result;
+    };
+
+    auto callback = [](IAsyncContext *ctxt, Status result, size_t bytes_transferred) {
+        CallbackContext<Context> context{ctxt};
+        *context->result = result;
+        context->done->store(true);
+    };
+
+    std::atomic<bool> done{false};
+    Status result = Status::Ok;
+    Context context{done, result};
+    RETURN_NOT_OK(delta_file.ReadAsync(static_cast<uint64_t>(file_idx) * DirtySegments::kSegmentSize, buffer,
+                                       DirtySegments::kSegmentSize, callback, context));
+    while (!done.load()) {
+        disk.TryComplete();
+    }
+    RETURN_NOT_OK(result);
+
+    done = false;
+    RETURN_NOT_OK(thlog[address.h()]->file->WriteAsync(buffer, hlog_t::kPageSize * address.page() + address.offset(),
+                                                       DirtySegments::kSegmentSize, callback, context));
+    while (!done.load()) {
+        disk.TryComplete();
+    }
+    return result;
+}
+
 template<class K, class V, class D>
 Status FasterKv<K, V, D>::RecoverHybridLog() {
     class Context : public IAsyncContext {
@@ -2440,10 +3497,7 @@ Status FasterKv<K, V, D>::RecoverHybridLog() {
     RETURN_NOT_OK(thlog[0]->AsyncReadPagesFromLog(start_page, pages_to_read_first, recovery_status));
 
     for (uint32_t page = start_page; page < end_page; ++page) {
-        while (recovery_status.page_status(page) != PageRecoveryStatus::ReadDone) {
-            disk.TryComplete();
-            std::this_thread::sleep_for(10ms);
-        }
+        WaitForPageStatus(recovery_status, page, PageRecoveryStatus::ReadDone);
 
         // handle start and end at non-page boundaries
         RETURN_NOT_OK(RecoverFromPage(page == start_page ? from_address : Address{page, 0},
@@ -2460,10 +3514,7 @@ Status FasterKv<K, V, D>::RecoverHybridLog() {
     }
     // Wait until all pages have been flushed
     for (uint32_t page = start_page; page < end_page; ++page) {
-        while (recovery_status.page_status(page) != PageRecoveryStatus::FlushDone) {
-            disk.TryComplete();
-            std::this_thread::sleep_for(10ms);
-        }
+        WaitForPageStatus(recovery_status, page, PageRecoveryStatus::FlushDone);
     }
     return Status::Ok;
 }
@@ -2518,10 +3569,7 @@ Status FasterKv<K, V, D>::RecoverHybridLog1(uint16_t rec) {
     RETURN_NOT_OK(thlog[rec]->AsyncReadPagesFromLog(start_page, pages_to_read_first, recovery_status));
 
     for (uint32_t page = start_page; page < end_page; ++page) {
-        while (recovery_status.page_status(page) != PageRecoveryStatus::ReadDone) {
-            disk.TryComplete();
-            std::this_thread::sleep_for(10ms);
-        }
+        WaitForPageStatus(recovery_status, page, PageRecoveryStatus::ReadDone);
 
         // handle start and end at non-page boundaries
         //  RETURN_NOT_OK(RecoverFromPage(page == start_page ? from_address : Address{page, 0},
@@ -2541,10 +3589,7 @@ Status FasterKv<K, V, D>::RecoverHybridLog1(uint16_t rec) {
     }
     // Wait until all pages have been flushed
     for (uint32_t page = start_page; page < end_page; ++page) {
-        while (recovery_status.page_status(page) != PageRecoveryStatus::FlushDone) {
-            disk.TryComplete();
-            std::this_thread::sleep_for(10ms);
-        }
+        WaitForPageStatus(recovery_status, page, PageRecoveryStatus::FlushDone);
     }
     return Status::Ok;
 }
@@ -2605,10 +3650,7 @@ Status FasterKv<K, V, D>::RecoverHybridLogFromSnapshotFile() {
                                                   pages_to_read_first, recovery_status));
 
     for (uint32_t page = start_page; page < end_page; ++page) {
-        while (recovery_status.page_status(page) != PageRecoveryStatus::ReadDone) {
-            disk.TryComplete();
-            std::this_thread::sleep_for(10ms);
-        }
+        WaitForPageStatus(recovery_status, page, PageRecoveryStatus::ReadDone);
 
         // Perform recovery if page in fuzzy portion of the log
         if (Address{page + 1, 0} > from_address) {
@@ -2630,10 +3672,7 @@ Status FasterKv<K, V, D>::RecoverHybridLogFromSnapshotFile() {
     }
     // Wait until all pages have been flushed
     for (uint32_t page = start_page; page < end_page; ++page) {
-        while (recovery_status.page_status(page) != PageRecoveryStatus::FlushDone) {
-            disk.TryComplete();
-            std::this_thread::sleep_for(10ms);
-        }
+        WaitForPageStatus(recovery_status, page, PageRecoveryStatus::FlushDone);
     }
     return Status::Ok;
 }
@@ -2654,7 +3693,8 @@ Status FasterKv<K, V, D>::RecoverFromPage(Address from_address, Address to_addre
         const key_t &key = record->key();
         KeyHash hash = key.GetHash();
         HashBucketEntry expected_entry;
-        AtomicHashBucketEntry *atomic_entry = FindOrCreateEntry(hash, expected_entry);
+        HashInfo expected_info;
+        AtomicHashBucketEntry *atomic_entry = FindOrCreateEntry(key, hash, expected_entry, expected_info);
 
         if (record->header.checkpoint_version <= checkpoint_.log_metadata.version) {
             HashBucketEntry new_entry{address, hash.tag(), false};
@@ -2697,17 +3737,23 @@ Status FasterKv<K, V, D>::RecoverFromPage1(Address from_address, Address to_addr
         const key_t &key = record->key();
         KeyHash hash = key.GetHash();
         HashBucketEntry expected_entry;
-        HashBucket *bucket;
-        AtomicHashBucketEntry *atomic_entry = FindOrCreateEntry(hash, expected_entry);
+        HashInfo expected_info;
+        AtomicHashBucketEntry *atomic_entry = FindOrCreateEntry(key, hash, expected_entry, expected_info);
 
+        // The log doesn't record value lengths, or TTLs: a value length of 0 makes the first
+        // update after recovery go through RCU, and a replayed record doesn't expire.
         if (record->header.checkpoint_version <= checkpoint_.log_metadata.version) {
             HashBucketEntry new_entry{address, hash.tag(), false};
-            atomic_entry->store(new_entry);
+            HashInfo new_info{record->header.checkpoint_version, 0, key.length(), record->header.tombstone};
+            atomic_entry->store(new_entry, new_info);
         } else {
             record->header.invalid = true;
             if (record->header.previous_address() < checkpoint_.index_metadata.thlog_checkpoint_address[rec]) {
+                // Back to the record the index had; keep its info, apart from the value length.
                 HashBucketEntry new_entry{record->header.previous_address(), hash.tag(), false};
-                atomic_entry->store(new_entry);
+                HashInfo new_info{expected_info.version(), 0, key.length(), expected_info.tombtone(),
+                                  expected_info.expiry()};
+                atomic_entry->store(new_entry, new_info);
             }
         }
         address += record->size();
@@ -2735,10 +3781,7 @@ Status FasterKv<K, V, D>::RestoreHybridLog() {
 
     // Wait until all pages have been read.
     for (uint32_t page = start_page; page < end_page; ++page) {
-        while (recovery_status.page_status(page) != PageRecoveryStatus::ReadDone) {
-            disk.TryComplete();
-            std::this_thread::sleep_for(10ms);
-        }
+        WaitForPageStatus(recovery_status, page, PageRecoveryStatus::ReadDone);
     }
     // Skip the null page.
     Address head_address = start_page == 0 ? Address{0, Constants::kCacheLineBytes} :
@@ -2766,19 +3809,69 @@ Status FasterKv<K, V, D>::RestoreHybridLog1(uint16_t rec) {
 
     // Wait until all pages have been read.
     for (uint32_t page = start_page; page < end_page; ++page) {
-        while (recovery_status.page_status(page) != PageRecoveryStatus::ReadDone) {
-            disk.TryComplete();
-            std::this_thread::sleep_for(10ms);
-        }
+        WaitForPageStatus(recovery_status, page, PageRecoveryStatus::ReadDone);
     }
     // Skip the null page.
     Address head_address = start_page == 0 ? Address{0, Constants::kCacheLineBytes} :
                            Address{start_page, 0};
     head_address += Address{0, 0, rec}.control();
     thlog[rec]->RecoveryReset(checkpoint_.index_metadata.thlog_begin_address[rec], head_address, tail_address);
+    // The lane was just read back from its log file, up to the tail. (Otherwise the next checkpoint
+    // would wait for a flush that a lane with no new records never issues.)
+    thlog[rec]->flushed_until_address.store(tail_address);
     return Status::Ok;
 }
 
+template<class K, class V, class D>
+template<class F>
+Status FasterKv<K, V, D>::ForEachLogLane(uint32_t num_threads, F fn) {
+    uint32_t num_lanes = checkpoint_.index_metadata.size;
+    num_threads = std::max(std::min(num_threads, num_lanes), 1u);
+    if (num_threads == 1) {
+        for (uint32_t rec = 0; rec < num_lanes; ++rec) {
+            RETURN_NOT_OK(fn(static_cast<uint16_t>(rec)));
+        }
+        return Status::Ok;
+    }
+
+    std::atomic<uint32_t> next_lane{0};
+    std::atomic<Status> first_error{Status::Ok};
+    auto worker = [&]() {
+        for (uint32_t rec = next_lane++; rec < num_lanes; rec = next_lane++) {
+            if (first_error.load() != Status::Ok) {
+                return;
+            }
+            Status result = fn(static_cast<uint16_t>(rec));
+            if (result != Status::Ok) {
+                Status expected = Status::Ok;
+                first_error.compare_exchange_strong(expected, result);
+                return;
+            }
+        }
+    };
+    std::vector<std::thread> threads;
+    for (uint32_t idx = 1; idx < num_threads; ++idx) {
+        threads.emplace_back(worker);
+    }
+    worker();
+    for (auto &thread : threads) {
+        thread.join();
+    }
+    return first_error.load();
+}
+
+template<class K, class V, class D>
+inline void FasterKv<K, V, D>::WaitForPageStatus(RecoveryStatus &recovery_status, uint32_t page,
+                                                 PageRecoveryStatus status) {
+    // I/O callbacks wake us up as soon as they move a page along; but some devices only run their
+    // callbacks from TryComplete(), so keep polling while nothing completes.
+    while (recovery_status.page_status(page) != status) {
+        if (!disk.TryComplete()) {
+            recovery_status.WaitFor(page, status, std::chrono::microseconds{100});
+        }
+    }
+}
+
 template<class K, class V, class D>
 void FasterKv<K, V, D>::HeavyEnter() {
     if (thread_ctx().phase == Phase::GC_IO_PENDING || thread_ctx().phase == Phase::GC_IN_PROGRESS) {
@@ -2813,8 +3906,11 @@ bool FasterKv<K, V, D>::CleanHashTableBuckets() {
         // Last chunk might contain more or fewer elements.
         upper_bound = state_[version].size() - (chunk * kGcHashTableChunkSize);
     }
+    uint32_t now = Utility::NowSeconds();
     for (uint64_t idx = 0; idx < upper_bound; ++idx) {
         HashBucket *bucket = &state_[version].bucket(chunk * kGcHashTableChunkSize + idx);
+        // Expired records are dropped rather than copied forward.
+        ClearExpiredEntries(bucket, version, now);
         /*
         if (chunk * kGcHashTableChunkSize + idx == 54895135)
             int jj = 0;
@@ -2873,6 +3969,82 @@ bool FasterKv<K, V, D>::CleanHashTableBuckets() {
     return true;
 }
 
+template<class K, class V, class D>
+uint64_t FasterKv<K, V, D>::ClearExpiredEntries(HashBucket *bucket, uint8_t version, uint32_t now) {
+    uint64_t cleared = 0;
+    while (true) {
+        for (uint32_t entry_idx = 0; entry_idx < HashBucket::kNumEntries; ++entry_idx) {
+            AtomicHashBucketEntry &atomic_entry = bucket->entries[entry_idx];
+            HashBucketEntry expected_entry = atomic_entry.load();
+            HashInfo expected_info = atomic_entry.GetInfo();
+            if (expected_entry.unused() || expected_entry.tentative() || expected_info.locked() ||
+                !expected_info.expired(now)) {
+                continue;
+            }
+            // Once freed, the slot can be taken (and its key overwritten) by another key; so its key
+            // is read first.
+            OrderedIndexKey key;
+            if (ordered_index_) {
+                key = OrderedIndexKey{atomic_entry.GetKey(), expected_info.key_length()};
+            }
+            // Free the slot; this fails if some thread has just written a new record for the key.
+            atom_t compared[2], exchanged[2];
+            exchanged[0] = HashBucketEntry::kInvalidEntry;
+            exchanged[1] = HashInfo::kInvalidInfo;
+            compared[0] = expected_entry.control_;
+            compared[1] = expected_info.control_;
+            if (atomic_entry.compare_exchange_strong(exchanged, compared)) {
+                if (ordered_index_) {
+                    ordered_index_->Delete(key, expected_entry.address());
+                }
+                ++cleared;
+            }
+        }
+        // Go to next bucket in the chain.
+        HashBucketOverflowEntry overflow_entry = bucket->overflow_entry.load();
+        if (overflow_entry.unused()) {
+            // No more buckets in the chain.
+            break;
+        }
+        bucket = &overflow_buckets_allocator_[version].Get(overflow_entry.address());
+    }
+    return cleared;
+}
+
+template<class K, class V, class D>
+uint64_t FasterKv<K, V, D>::SweepExpiredEntries() {
+    if (thread_ctx().phase != Phase::REST) {
+        // Leave the index alone while a checkpoint, GC or grow is in progress.
+        return 0;
+    }
+    // Each call sweeps the next chunk of one log's hash table, round-robin over all of them, so
+    // that sessions can share the work between operations.
+    uint8_t version = resize_info_.version;
+    uint64_t chunks_per_table = std::max(state_[0].size() / kExpirySweepChunkSize, (uint64_t) 1);
+    ThreadContext &context = thread_contexts_[Thread::id()];
+    uint64_t chunk;
+    if (context.owned_partition() != ThreadContext::kNoPartition) {
+        // Other partitions belong to other owners, which write them with plain stores.
+        chunk = context.owned_partition() * chunks_per_table + context.NextOwnedSweepChunk() % chunks_per_table;
+    } else {
+        chunk = expiry_sweep_chunk_++ % (chunks_per_table * tlog_number);
+    }
+    if (lane_recovery_[chunk / chunks_per_table].load() != kLaneRecovered) {
+        // Still to be replayed by RecoverLazy().
+        return 0;
+    }
+    InternalHashTable<disk_t> &table = state_[chunk / chunks_per_table];
+    uint64_t begin = (chunk % chunks_per_table) * kExpirySweepChunkSize;
+    uint64_t end = (chunk % chunks_per_table) + 1 < chunks_per_table ? begin + kExpirySweepChunkSize :
+                   table.size();
+    uint32_t now = Utility::NowSeconds();
+    uint64_t cleared = 0;
+    for (uint64_t idx = begin; idx < end; ++idx) {
+        cleared += ClearExpiredEntries(&table.bucket(idx), version, now);
+    }
+    return cleared;
+}
+
 template<class K, class V, class D>
 void FasterKv<K, V, D>::AddHashEntry(HashBucket *&bucket, uint32_t &next_idx, uint8_t version,
                                      HashBucketEntry entry) {
@@ -3064,7 +4236,9 @@ bool FasterKv<K, V, D>::GlobalMoveToNextState(SystemState current_state) {
                 case Phase::WAIT_FLUSH:
                     assert(next_state.action != Action::CheckpointIndex);
                     // WAIT_PENDING -> WAIT_FLUSH
-                    if (fold_over_snapshot) {
+                    if (checkpoint_.log_metadata.use_delta) {
+                        IssueDeltaCheckpoint();
+                    } else if (fold_over_snapshot) {
                         Address tail_address;
                         Address read_only_address;
                         //Address tail_address = hlog.ShiftReadOnlyToTail();
@@ -3072,17 +4246,19 @@ bool FasterKv<K, V, D>::GlobalMoveToNextState(SystemState current_state) {
                         //tail_address = thlog[0]->GetTailAddress();
                         checkpoint_.log_metadata.final_address = thlog[0]->GetTailAddress();
                         //checkpoint_.log_metadata.final_address = thlog[0]->GetTailAddress();
-                        for (int i = 0; i < 40; i++) {
-                            if (thlog[i]->GetTailAddress().page() == thlog[i]->read_only_address.page() &&
-                                thlog[i]->GetTailAddress().offset() == thlog[i]->read_only_address.offset())
+                        for (int i = 0; i < tlog_number; i++) {
+                            tail_address = thlog[i]->GetTailAddress();
+                            checkpoint_.log_metadata.tfinal_address[i] = tail_address;
+                            if (tail_address.page() == thlog[i]->read_only_address.page() &&
+                                tail_address.offset() == thlog[i]->read_only_address.offset())
                                 continue;
                             else {
                                 read_only_address = thlog[i]->read_only_address.load();
-                                tail_address = thlog[i]->GetTailAddress();
-                                checkpoint_.log_metadata.tfinal_address[i] = tail_address;
                                 thlog[i]->ShiftReadOnlyToTail();
                             }
                         }
+                        // Everything is in the log now; the next delta checkpoint starts a new chain.
+                        last_delta_token_ = Guid{};
                     } else {
                         Address tail_address = hlog.GetTailAddress();
                         // Get final address for CPR
@@ -3160,7 +4336,7 @@ bool FasterKv<K, V, D>::GlobalMoveToNextState(SystemState current_state) {
                     if (gc_.complete_callback) {
                         gc_.complete_callback();
                     }
-                    for (int i = 0; i < 40; i++) {
+                    for (int i = 0; i < tlog_number; i++) {
                         if (thlog[i]->GetTailAddress().page() == thlog[i]->head_address.page() &&
                             thlog[i]->GetTailAddress().offset() == thlog[i]->head_address.offset())
                             continue;
@@ -3331,12 +4507,22 @@ void FasterKv<K, V, D>::HandleSpecialPhases() {
                         // Handle WAIT_PENDING -> WAIT_FLUSH and WAIT_FLUSH -> WAIT_FLUSH
                         if (!epoch_.HasThreadFinishedPhase(Phase::WAIT_FLUSH)) {
                             bool flushed;
-                            if (fold_over_snapshot) {
+                            if (checkpoint_.log_metadata.use_delta) {
+                                // (A log whose read-only address has not moved yet has nothing to flush.)
+                                flushed = checkpoint_.flush_pending.load() == 0;
+                                for (int i = 0; i < tlog_number; i++)
+                                    if (thlog[i]->flushed_until_address.load() <
+                                        checkpoint_.log_metadata.tdelta_address[i] &&
+                                        checkpoint_.log_metadata.tdelta_address[i] > thlog[i]->begin_address.load())
+                                        flushed = false;
+                            } else if (fold_over_snapshot) {
                                 //flushed = hlog.flushed_until_address.load() >= checkpoint_.log_metadata.final_address;
+                                // (An empty log has nothing to flush.)
                                 flushed = true;
-                                for (int i = 0; i < checkpoint_.index_metadata.size; i++)
+                                for (int i = 0; i < tlog_number; i++)
                                     if (thlog[i]->flushed_until_address.load() <
-                                        checkpoint_.log_metadata.tfinal_address[i])
+                                        checkpoint_.log_metadata.tfinal_address[i] &&
+                                        checkpoint_.log_metadata.tfinal_address[i] > thlog[i]->begin_address.load())
                                         flushed = false;
 
                             } else {
@@ -3463,16 +4649,12 @@ bool FasterKv<K, V, D>::Checkpoint(void(*index_persistence_callback)(Status resu
     disk.CreateCprCheckpointDirectory(token);
     Address a[40];
     Address b[40];
-    int h_size = 0;
-    for (int i = 0; i < 40; i++) {
-        if (thlog[i]->GetTailAddress().page() == thlog[i]->read_only_address.page() &&
-            thlog[i]->GetTailAddress().offset() == thlog[i]->read_only_address.offset())
-            continue;
-        else {
-            a[i] = thlog[i]->begin_address.load();
-            b[i] = thlog[i]->GetTailAddress();
-            h_size++;
-        }
+    // Every lane goes in the checkpoint, even one with nothing new since the last: recovery
+    // restores lanes [0, h_size).
+    int h_size = tlog_number;
+    for (int i = 0; i < tlog_number; i++) {
+        a[i] = thlog[i]->begin_address.load();
+        b[i] = thlog[i]->GetTailAddress();
     }
     // Obtain tail address for fuzzy index checkpoint
     if (!fold_over_snapshot) {
@@ -3496,6 +4678,7 @@ bool FasterKv<K, V, D>::Checkpoint(void(*index_persistence_callback)(Status resu
                                           a, b, h_size, false,
                                           Address::kInvalidAddress, index_persistence_callback,
                                           hybrid_log_persistence_callback);
+        InitializeDeltaCheckpoint();
     }
     InitializeCheckpointLocks();
     // Let other threads know that the checkpoint has started.
@@ -3560,6 +4743,7 @@ bool FasterKv<K, V, D>::CheckpointHybridLog(void(*hybrid_log_persistence_callbac
     } else {
         checkpoint_.InitializeHybridLogCheckpoint(token, desired.version, false,
                                                   Address::kInvalidAddress, hybrid_log_persistence_callback);
+        InitializeDeltaCheckpoint();
     }
     InitializeCheckpointLocks();
     // Let other threads know that the checkpoint has started.
@@ -3570,7 +4754,7 @@ bool FasterKv<K, V, D>::CheckpointHybridLog(void(*hybrid_log_persistence_callbac
 template<class K, class V, class D>
 Status FasterKv<K, V, D>::Recover(const Guid &index_token, const Guid &hybrid_log_token,
                                   uint32_t &version,
-                                  std::vector<Guid> &session_ids) {
+                                  std::vector<Guid> &session_ids, uint32_t num_threads) {
     version = 0;
     session_ids.clear();
     SystemState expected = SystemState{Action::None, Phase::REST, system_state_.load().version};
@@ -3585,44 +4769,27 @@ Status FasterKv<K, V, D>::Recover(const Guid &index_token, const Guid &hybrid_lo
     if (status != Status::Ok) break
 
     do {
-        // Index and log metadata.
-        BREAK_NOT_OK(ReadIndexMetadata(index_token));
-        BREAK_NOT_OK(ReadCprMetadata(hybrid_log_token));
-        if (checkpoint_.index_metadata.version != checkpoint_.log_metadata.version) {
-            // Index and hybrid-log checkpoints should have the same version.
-            status = Status::Corruption;
-            break;
-        }
-
-        system_state_.store(SystemState{Action::Recover, Phase::REST,
-                                        checkpoint_.log_metadata.version + 1});
-
-        BREAK_NOT_OK(ReadCprContexts(hybrid_log_token, checkpoint_.log_metadata.guids));
-        // The index itself (including overflow buckets).
-        BREAK_NOT_OK(RecoverFuzzyIndex());
-        BREAK_NOT_OK(RecoverFuzzyIndexComplete(true));
-        uint16_t r = 0;
-        // Any changes made to the log while the index was being fuzzy-checkpointed.
+        BREAK_NOT_OK(RecoverIndexAndMetadata(index_token, hybrid_log_token));
+        // Any changes made to the log while the index was being fuzzy-checkpointed. Each log's
+        // records hash into its own partition of the index, so the logs are recovered, and then
+        // restored, independently of each other.
         if (fold_over_snapshot) {
             //BREAK_NOT_OK(RecoverHybridLog());
-            for (int i = 0; i < checkpoint_.index_metadata.size; i++) {
-                BREAK_NOT_OK(RecoverHybridLog1(r));
-                r++;
-            }
-            if (status != Status::Ok)
-                break;
+            BREAK_NOT_OK(ForEachLogLane(num_threads, [this](uint16_t rec) {
+                Status result = RecoverHybridLog1(rec);
+                return result == Status::Ok ? RestoreHybridLog1(rec) : result;
+            }));
         } else {
             BREAK_NOT_OK(RecoverHybridLogFromSnapshotFile());
+            //BREAK_NOT_OK(RestoreHybridLog());
+            BREAK_NOT_OK(ForEachLogLane(num_threads, [this](uint16_t rec) {
+                return RestoreHybridLog1(rec);
+            }));
         }
-        r = 0;
-        //BREAK_NOT_OK(RestoreHybridLog());
-        for (int i = 0; i < checkpoint_.index_metadata.size; i++) {
-            BREAK_NOT_OK(RestoreHybridLog1(r));
-            r++;
-        }
-        if (status != Status::Ok)
-            break;
     } while (false);
+    if (status == Status::Ok && ordered_index_) {
+        status = RebuildOrderedIndex();
+    }
     if (status == Status::Ok) {
         for (const auto &token : checkpoint_.continue_tokens) {
             session_ids.push_back(token.first);
@@ -3636,6 +4803,278 @@ Status FasterKv<K, V, D>::Recover(const Guid &index_token, const Guid &hybrid_lo
 #undef BREAK_NOT_OK
 }
 
+template<class K, class V, class D>
+Status FasterKv<K, V, D>::RecoverIndexAndMetadata(const Guid &index_token, const Guid &hybrid_log_token) {
+    // Index and log metadata.
+    RETURN_NOT_OK(ReadIndexMetadata(index_token));
+    RETURN_NOT_OK(ReadCprMetadata(hybrid_log_token));
+    if (checkpoint_.index_metadata.version != checkpoint_.log_metadata.version) {
+        // Index and hybrid-log checkpoints should have the same version.
+        return Status::Corruption;
+    }
+
+    system_state_.store(SystemState{Action::Recover, Phase::REST,
+                                    checkpoint_.log_metadata.version + 1});
+    if (checkpoint_.log_metadata.use_delta) {
+        // Put the segments that delta checkpoints saved back into the logs.
+        RETURN_NOT_OK(ReplayDeltaCheckpoints());
+    }
+
+    RETURN_NOT_OK(ReadCprContexts(hybrid_log_token, checkpoint_.log_metadata.guids));
+    // The index itself (including overflow buckets).
+    RETURN_NOT_OK(RecoverFuzzyIndex());
+    return RecoverFuzzyIndexComplete(true);
+}
+
+template<class K, class V, class D>
+Status FasterKv<K, V, D>::RecoverLazy(const Guid &index_token, const Guid &hybrid_log_token,
+                                      uint32_t &version,
+                                      std::vector<Guid> &session_ids, uint32_t num_threads) {
+    if (!fold_over_snapshot) {
+        // The snapshot file holds every log; it is read back in one piece.
+        return Recover(index_token, hybrid_log_token, version, session_ids, num_threads);
+    }
+    version = 0;
+    session_ids.clear();
+    SystemState expected = SystemState{Action::None, Phase::REST, system_state_.load().version};
+    if (!system_state_.compare_exchange_strong(expected,
+                                               SystemState{Action::Recover, Phase::REST, expected.version})) {
+        return Status::Aborted;
+    }
+    if (recovery_thread_.joinable()) {
+        // (The previous sweep is over, since the store was back to Action::None.)
+        recovery_thread_.join();
+    }
+    checkpoint_.InitializeRecover(index_token, hybrid_log_token);
+    Status status = RecoverIndexAndMetadata(index_token, hybrid_log_token);
+    if (status != Status::Ok) {
+        checkpoint_.RecoverDone();
+        system_state_.store(SystemState{Action::None, Phase::REST,
+                                        checkpoint_.log_metadata.version + 1});
+        return status;
+    }
+    for (const auto &token : checkpoint_.continue_tokens) {
+        session_ids.push_back(token.first);
+    }
+    version = checkpoint_.log_metadata.version;
+
+    // The index is loaded, but entries may still point past what each log's fuzzy checkpoint
+    // covers. Every log is marked pending; whoever gets to it first (the sweep, or an operation on
+    // one of its keys) replays it with RecoverHybridLog1() and restores it.
+    if (ordered_index_) {
+        ordered_index_->Clear();
+    }
+    lazy_recovery_status_.store(Status::Ok);
+    uint32_t num_lanes = checkpoint_.index_metadata.size;
+    for (uint32_t rec = 0; rec < num_lanes; ++rec) {
+        lane_recovery_[rec].store(kLanePending);
+    }
+    num_lanes_pending_recovery_.store(num_lanes);
+
+    // The store stays at Action::Recover, Phase::REST: sessions can start, but checkpoints, GC and
+    // index growth can't, until the sweep is done.
+    recovery_thread_ = std::thread{[this, num_threads, version]() {
+        ForEachLogLane(num_threads, [this](uint16_t rec) {
+            // Errors are reported by WaitForRecovery(); keep going, so that no log is left pending.
+            RecoverLane(rec);
+            return Status::Ok;
+        });
+        checkpoint_.RecoverDone();
+        system_state_.store(SystemState{Action::None, Phase::REST, version + 1});
+    }};
+    return Status::Ok;
+}
+
+template<class K, class V, class D>
+Status FasterKv<K, V, D>::WaitForRecovery() {
+    if (recovery_thread_.joinable()) {
+        recovery_thread_.join();
+    }
+    return lazy_recovery_status_.load();
+}
+
+template<class K, class V, class D>
+Status FasterKv<K, V, D>::RecoverLane(uint16_t rec) {
+    uint8_t expected = kLanePending;
+    if (!lane_recovery_[rec].compare_exchange_strong(expected, kLaneRecovering)) {
+        // Already replayed, or being replayed by another thread.
+        while (lane_recovery_[rec].load() != kLaneRecovered) {
+            std::this_thread::yield();
+        }
+        return Status::Ok;
+    }
+    Status result = RecoverHybridLog1(rec);
+    if (result == Status::Ok) {
+        result = RestoreHybridLog1(rec);
+    }
+    if (result == Status::Ok && ordered_index_) {
+        result = AddLaneToOrderedIndex(rec);
+    }
+    if (result != Status::Ok) {
+        Status ok = Status::Ok;
+        lazy_recovery_status_.compare_exchange_strong(ok, result);
+    }
+    lane_recovery_[rec].store(kLaneRecovered);
+    --num_lanes_pending_recovery_;
+    return result;
+}
+
+template<class K, class V, class D>
+Status FasterKv<K, V, D>::RebuildOrderedIndex() {
+    if (!ordered_index_) {
+        return Status::Aborted;
+    }
+    ordered_index_->Clear();
+    for (int lane = 0; lane < tlog_number; ++lane) {
+        RETURN_NOT_OK(AddLaneToOrderedIndex(lane));
+    }
+    return Status::Ok;
+}
+
+template<class K, class V, class D>
+Status FasterKv<K, V, D>::AddLaneToOrderedIndex(uint32_t lane) {
+    // Each live key has one hash bucket entry, which holds the key and its latest address; so the
+    // ordered index is rebuilt from the (recovered) hash table of each log, rather than from the
+    // log, where superseded and invalid records would have to be filtered out.
+    uint32_t version = resize_info_.version;
+    for (uint64_t idx = 0; idx < state_[lane].size(); ++idx) {
+        const HashBucket *bucket = &state_[lane].bucket(idx);
+        while (true) {
+            for (uint32_t entry_idx = 0; entry_idx < HashBucket::kNumEntries; ++entry_idx) {
+                const AtomicHashBucketEntry &atomic_entry = bucket->entries[entry_idx];
+                HashBucketEntry entry = atomic_entry.load();
+                if (entry.unused() || entry.tentative() || entry.address() == Address::kInvalidAddress) {
+                    continue;
+                }
+                HashInfo info = atomic_entry.GetInfo();
+                if (info.key_length() > OrderedIndexKey::kMaxKeyBytes) {
+                    return Status::Aborted;
+                }
+                if (!info.tombtone()) {
+                    ordered_index_->Upsert(OrderedIndexKey{atomic_entry.GetKey(), info.key_length()},
+                                           entry.address());
+                }
+            }
+            // Go to next bucket in the chain
+            HashBucketOverflowEntry overflow_entry = bucket->overflow_entry.load();
+            if (overflow_entry.unused()) {
+                break;
+            }
+            bucket = &overflow_buckets_allocator_[version].Get(overflow_entry.address());
+        }
+    }
+    return Status::Ok;
+}
+
+template<class K, class V, class D>
+Status FasterKv<K, V, D>::CopyFlushedLog(uint32_t lane, Address from_address, Address until_address,
+                                         uint8_t *dest) {
+    if (until_address <= from_address) {
+        // (Nothing flushed yet: the flushed-until address starts out behind the begin address.)
+        return Status::Ok;
+    }
+    assert(until_address <= thlog[lane]->flushed_until_address.load());
+    while (true) {
+        // Flushed pages are read-only; holding the epoch keeps them from being closed (and cleared)
+        // under us. (A session thread already holds it.)
+        bool protect = !epoch_.IsProtected();
+        if (protect) {
+            epoch_.Protect();
+        }
+        Address head_address = thlog[lane]->head_address.load();
+        if (from_address >= head_address) {
+            for (uint32_t page = from_address.page(); page <= until_address.page(); ++page) {
+                uint32_t begin = page == from_address.page() ? from_address.offset() : 0;
+                uint32_t end = page == until_address.page() ? until_address.offset() :
+                               static_cast<uint32_t>(hlog_t::kPageSize);
+                std::memcpy(dest, thlog[lane]->Page(page) + begin, end - begin);
+                dest += end - begin;
+            }
+        }
+        if (protect) {
+            epoch_.Unprotect();
+        }
+        if (from_address >= head_address) {
+            return Status::Ok;
+        }
+        // The evicted part is on disk. (Without the epoch, since the reads can take a while; the head
+        // may move on meanwhile, in which case the next round reads more from disk.)
+        Address read_until = std::min(until_address, head_address);
+        RETURN_NOT_OK(ReadFlushedLog(lane, from_address, read_until, dest));
+        dest += (read_until - from_address).control();
+        from_address = read_until;
+        if (from_address == until_address) {
+            return Status::Ok;
+        }
+    }
+}
+
+template<class K, class V, class D>
+Status FasterKv<K, V, D>::ReadFlushedLog(uint32_t lane, Address from_address, Address until_address,
+                                         uint8_t *dest) {
+    class Context : public IAsyncContext {
+    public:
+        Context(std::atomic<bool> &done_, Status &result_)
+                : done{&done_}, result{&result_} {
+        }
+
+        /// The deep-copy constructor
+        Context(const Context &other)
+                : done{other.done}, result{other.result} {
+        }
+
+    protected:
+        Status DeepCopy_Internal(IAsyncContext *&context_copy) final {
+            return IAsyncContext::DeepCopy_Internal(*this, context_copy);
+        }
+
+    public:
+        std::atomic<bool> *done;
+        Status *result;
+    };
+
+    auto callback = [](IAsyncContext *ctxt, Status result, size_t bytes_transferred) {
+        CallbackContext<Context> context{ctxt};
+        *context->result = result;
+        context->done->store(true);
+    };
+
+    // Reads are whole sectors, and one page at a time (so that none crosses a file segment).
+    uint32_t sector_size = thlog[lane]->sector_size;
+    uint8_t *buffer = reinterpret_cast<uint8_t *>(aligned_alloc(sector_size, hlog_t::kPageSize));
+    if (!buffer) {
+        return Status::OutOfMemory;
+    }
+    Status result = Status::Ok;
+    for (uint32_t page = from_address.page(); page <= until_address.page() && result == Status::Ok; ++page) {
+        uint32_t begin = page == from_address.page() ? from_address.offset() : 0;
+        uint32_t end = page == until_address.page() ? until_address.offset() :
+                       static_cast<uint32_t>(hlog_t::kPageSize);
+        if (begin == end) {
+            continue;
+        }
+        uint32_t begin_read = begin & ~(sector_size - 1);
+        uint32_t end_read = std::min((end + sector_size - 1) & ~(sector_size - 1),
+                                     static_cast<uint32_t>(hlog_t::kPageSize));
+        std::atomic<bool> done{false};
+        Context context{done, result};
+        result = thlog[lane]->file->ReadAsync(hlog_t::kPageSize * page + begin_read, buffer, end_read - begin_read,
+                                              callback, context);
+        if (result != Status::Ok) {
+            break;
+        }
+        while (!done.load()) {
+            disk.TryComplete();
+        }
+        if (result == Status::Ok) {
+            std::memcpy(dest, buffer + (begin - begin_read), end - begin);
+            dest += end - begin;
+        }
+    }
+    aligned_free(buffer);
+    return result;
+}
+
 template<class K, class V, class D>
 bool FasterKv<K, V, D>::ShiftBeginAddress(Address address,
                                           GcState::truncate_callback_t truncate_callback,
@@ -3671,7 +5110,7 @@ bool FasterKv<K, V, D>::GrabageCollecton(Address address,
     Address a(0, 112, 0);
     const record_t *record = reinterpret_cast<const record_t *>(thlog[0]->Get(a));
     //hlog.begin_address.store(address);
-    for (int i = 0; i < 40; i++) {
+    for (int i = 0; i < tlog_number; i++) {
         //    a=address;
         //  a += Address{0, 0, k}.control();
         thlog[i]->gc_address.store(thlog[i]->flushed_until_address.load());
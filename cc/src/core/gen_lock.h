@@ -0,0 +1,238 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT license.
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#include <immintrin.h>
+#endif
+
+namespace FASTER {
+namespace core {
+
+/// Generation lock word for values that are updated in place: a 62-bit generation number, bumped
+/// by every writer, plus "locked" and "replaced" bits.
+class GenLock {
+public:
+    GenLock() : control_{0} {}
+
+    GenLock(uint64_t control) : control_{control} {}
+
+    inline GenLock &operator=(const GenLock &other) {
+        control_ = other.control_;
+        return *this;
+    }
+
+    union {
+        struct {
+            uint64_t gen_number : 62;
+            uint64_t locked : 1;
+            uint64_t replaced : 1;
+        };
+        uint64_t control_;
+    };
+};
+
+static_assert(sizeof(GenLock) == 8, "sizeof(GenLock) != 8");
+
+/// Counters for GenLock-protected values. Each thread bumps only its own counters, so the hot path
+/// pays for a relaxed store, not for a shared atomic.
+class GenLockStats {
+public:
+    struct Counts {
+        /// Optimistic reads that had to be re-run because a writer got in the way.
+        uint64_t read_retries;
+        /// Times a writer found the lock held and had to back off.
+        uint64_t lock_waits;
+    };
+
+    static inline void RecordReadRetry() {
+        Bump(Local().read_retries);
+    }
+
+    static inline void RecordLockWait() {
+        Bump(Local().lock_waits);
+    }
+
+    /// Totals over all threads, past and present.
+    static Counts Snapshot() {
+        Registry &registry = GetRegistry();
+        std::lock_guard<std::mutex> lock{registry.mutex};
+        Counts result = registry.retired;
+        for (const ThreadCounts *counts : registry.threads) {
+            result.read_retries += counts->read_retries.load(std::memory_order_relaxed);
+            result.lock_waits += counts->lock_waits.load(std::memory_order_relaxed);
+        }
+        return result;
+    }
+
+private:
+    struct ThreadCounts;
+
+    struct Registry {
+        std::mutex mutex;
+        std::vector<const ThreadCounts *> threads;
+        Counts retired{0, 0};
+    };
+
+    struct ThreadCounts {
+        ThreadCounts()
+                : read_retries{0}, lock_waits{0} {
+            Registry &registry = GetRegistry();
+            std::lock_guard<std::mutex> lock{registry.mutex};
+            registry.threads.push_back(this);
+        }
+
+        ~ThreadCounts() {
+            // Fold this thread's counts into the totals before it goes away.
+            Registry &registry = GetRegistry();
+            std::lock_guard<std::mutex> lock{registry.mutex};
+            registry.retired.read_retries += read_retries.load(std::memory_order_relaxed);
+            registry.retired.lock_waits += lock_waits.load(std::memory_order_relaxed);
+            for (auto it = registry.threads.begin(); it != registry.threads.end(); ++it) {
+                if (*it == this) {
+                    registry.threads.erase(it);
+                    break;
+                }
+            }
+        }
+
+        std::atomic<uint64_t> read_retries;
+        std::atomic<uint64_t> lock_waits;
+    };
+
+    static inline void Bump(std::atomic<uint64_t> &counter) {
+        counter.store(counter.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    }
+
+    static Registry &GetRegistry() {
+        static Registry registry;
+        return registry;
+    }
+
+    static ThreadCounts &Local() {
+        static thread_local ThreadCounts counts;
+        return counts;
+    }
+};
+
+/// Bounded exponential backoff: spins for 1, 2, 4, ... pause instructions, up to kMaxSpins, then
+/// yields the processor on every further call.
+class GenLockBackoff {
+public:
+    static constexpr uint32_t kMaxSpins = 1024;
+
+    GenLockBackoff()
+            : spins_{1} {
+    }
+
+    inline void Pause() {
+        if (spins_ > kMaxSpins) {
+            std::this_thread::yield();
+            return;
+        }
+        for (uint32_t idx = 0; idx < spins_; ++idx) {
+#if defined(__x86_64__) || defined(_M_X64)
+            _mm_pause();
+#else
+            std::atomic_signal_fence(std::memory_order_seq_cst);
+#endif
+        }
+        spins_ <<= 1;
+    }
+
+private:
+    uint32_t spins_;
+};
+
+class AtomicGenLock {
+public:
+    AtomicGenLock() : control_{0} {}
+
+    AtomicGenLock(uint64_t control) : control_{control} {}
+
+    inline GenLock load() const {
+        return GenLock{control_.load()};
+    }
+
+    inline void store(GenLock desired) {
+        control_.store(desired.control_);
+    }
+
+    inline bool try_lock(bool &replaced) {
+        replaced = false;
+        GenLock expected{control_.load()};
+        expected.locked = 0;
+        expected.replaced = 0;
+        GenLock desired{expected.control_};
+        desired.locked = 1;
+
+        if (control_.compare_exchange_strong(expected.control_, desired.control_)) {
+            return true;
+        }
+        if (expected.replaced) {
+            replaced = true;
+        }
+        return false;
+    }
+
+    /// Acquires the lock, backing off while another writer holds it. Returns false (without the
+    /// lock) if the value has been replaced.
+    inline bool lock(bool &replaced) {
+        GenLockBackoff backoff;
+        while (!try_lock(replaced)) {
+            if (replaced) {
+                return false;
+            }
+            GenLockStats::RecordLockWait();
+            backoff.Pause();
+        }
+        return true;
+    }
+
+    inline void unlock(bool replaced) {
+        if (!replaced) {
+            // Just turn off "locked" bit and increase gen number.
+            uint64_t sub_delta = ((uint64_t) 1 << 62) - 1;
+            control_.fetch_sub(sub_delta);
+        } else {
+            // Turn off "locked" bit, turn on "replaced" bit, and increase gen number
+            uint64_t add_delta = ((uint64_t) 1 << 63) - ((uint64_t) 1 << 62) + 1;
+            control_.fetch_add(add_delta);
+        }
+    }
+
+    /// Seqlock-style optimistic read: "reader" copies the value without taking the lock, and is
+    /// re-run (with backoff) until no writer held the lock or finished an update while it ran.
+    template<class F>
+    inline void read(F reader) const {
+        GenLockBackoff backoff;
+        while (true) {
+            GenLock before = load();
+            if (!before.locked) {
+                reader();
+                // Keep the copy from being reordered after the validating load.
+                std::atomic_thread_fence(std::memory_order_acquire);
+                if (control_.load() == before.control_) {
+                    return;
+                }
+            }
+            GenLockStats::RecordReadRetry();
+            backoff.Pause();
+        }
+    }
+
+private:
+    std::atomic<uint64_t> control_;
+};
+
+static_assert(sizeof(AtomicGenLock) == 8, "sizeof(AtomicGenLock) != 8");
+
+}
+} // namespace FASTER::core
@@ -90,15 +90,18 @@ static_assert(sizeof(HashBucketEntry) == 8, "sizeof(HashBucketEntry) != 8");
 
 struct HashInfo {
     static constexpr uint64_t kInvalidInfo = 0;
+    /// Records written without a TTL never expire.
+    static constexpr uint32_t kNoExpiry = 0;
 
     HashInfo()
             : control_{0} {
 
     }
 
-    HashInfo(uint64_t version, uint64_t value_length, uint64_t key_length, uint64_t tombtone) :
+    HashInfo(uint64_t version, uint64_t value_length, uint64_t key_length, uint64_t tombtone,
+             uint64_t expiry = kNoExpiry) :
             checkpoint_version_{version}, value_length_{value_length}, key_length_{key_length}, tombtone_{tombtone},
-            reserved{0} {
+            expiry_{expiry}, locked_{0}, transaction_parity_{0} {
 
     }
 
@@ -140,13 +143,50 @@ struct HashInfo {
         return static_cast<uint16_t>(tombtone_);
     }
 
+    /// Expiration time, in seconds since the Unix epoch (kNoExpiry if the record does not expire).
+    inline uint32_t expiry() const {
+        return static_cast<uint32_t>(expiry_);
+    }
+
+    inline bool expired(uint32_t now) const {
+        return expiry_ != kNoExpiry && expiry_ <= now;
+    }
+
+    /// Set while a multi-key transaction holds the entry; other writers (and readers) wait for it
+    /// to be released.
+    inline bool locked() const {
+        return locked_ != 0;
+    }
+
+    inline HashInfo Locked() const {
+        HashInfo info{control_};
+        info.locked_ = 1;
+        return info;
+    }
+
+    inline HashInfo Unlocked() const {
+        HashInfo info{control_};
+        info.locked_ = 0;
+        return info;
+    }
+
+    /// Flipped by a transaction that updates the record in place, so that an in-place writer that
+    /// raced with it sees the info change, even after the lock has been released.
+    inline HashInfo TransactionUpdated() const {
+        HashInfo info{control_};
+        info.transaction_parity_ ^= 1;
+        return info;
+    }
+
     union {
         struct {
             uint64_t checkpoint_version_ : 13;
             uint64_t value_length_ : 8;
             uint64_t key_length_ : 8;
             uint64_t tombtone_ : 1;
-            uint64_t reserved : 34;
+            uint64_t expiry_ : 32;
+            uint64_t locked_ : 1;
+            uint64_t transaction_parity_ : 1;
         };
         uint64_t control_;
     };
@@ -174,6 +214,12 @@ public:
         control_[0] = desired.control_;
     }
 
+    /// Not atomic: only for a partition owner, the entry's only reader and writer.
+    inline void store(const HashBucketEntry &desired, const HashInfo &desired_info) {
+        control_[0] = desired.control_;
+        control_[1] = desired_info.control_;
+    }
+
     inline HashInfo GetInfo() const{
         return HashInfo{control_[1]};
     }
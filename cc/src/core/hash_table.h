@@ -6,7 +6,9 @@
 #include <atomic>
 #include <cinttypes>
 #include <cstdint>
+#include <string>
 
+#include "../environment/file.h"
 #include "hash_bucket.h"
 #include "key_hash.h"
 
@@ -26,9 +28,7 @@ public:
     }
 
     ~InternalHashTable() {
-        if (buckets_) {
-            aligned_free(buckets_);
-        }
+        FreeBuckets();
     }
 
     inline void Initialize(uint64_t new_size, uint64_t alignment) {
@@ -36,11 +36,9 @@ public:
         assert(Utility::IsPowerOfTwo(new_size));
         assert(Utility::IsPowerOfTwo(alignment));
         assert(alignment >= Constants::kCacheLineBytes);
-        if (size_ != new_size) {
+        if (size_ != new_size || mapping_.data()) {
             size_ = new_size;
-            if (buckets_) {
-                aligned_free(buckets_);
-            }
+            FreeBuckets();
             buckets_ = reinterpret_cast<HashBucket *>(aligned_alloc(alignment,
                                                                     size_ * sizeof(HashBucket)));
         }
@@ -54,10 +52,7 @@ public:
     }
 
     inline void Uninitialize() {
-        if (buckets_) {
-            aligned_free(buckets_);
-            buckets_ = nullptr;
-        }
+        FreeBuckets();
         size_ = 0;
         assert(pending_checkpoint_writes_ == 0);
         assert(pending_recover_reads_ == 0);
@@ -101,6 +96,16 @@ public:
 
     inline Status RecoverComplete(bool wait);
 
+    /// Instead of Recover(): uses the checkpoint file "filename" itself, mapped copy-on-write, as
+    /// the table. (A checkpoint is the plain bucket array, and overflow entries hold allocator
+    /// addresses rather than pointers, so no conversion is needed.) Buckets are read in as they are
+    /// first touched, and buckets that are written get private copies; the file is never changed.
+    Status RecoverMapped(disk_t &disk, const std::string &filename, uint64_t checkpoint_size);
+
+    inline bool mapped() const {
+        return mapping_.data() != nullptr;
+    }
+
     void DumpDistribution(MallocFixedPageSize<HashBucket, disk_t> &overflow_buckets_allocator);
 
 private:
@@ -126,8 +131,19 @@ private:
     };
 
 private:
+    inline void FreeBuckets() {
+        if (mapping_.data()) {
+            mapping_.Unmap();
+        } else if (buckets_) {
+            aligned_free(buckets_);
+        }
+        buckets_ = nullptr;
+    }
+
     uint64_t size_;
     HashBucket *buckets_;
+    /// Backs buckets_ after RecoverMapped().
+    environment::FileMapping mapping_;
 
     /// State for ongoing checkpoint/recovery.
     disk_t *disk_;
@@ -251,6 +267,22 @@ inline Status InternalHashTable<D>::RecoverComplete(bool wait) {
     }
 }
 
+template<class D>
+Status InternalHashTable<D>::RecoverMapped(disk_t &disk, const std::string &filename,
+                                           uint64_t checkpoint_size) {
+    assert(checkpoint_size > 0);
+    assert(checkpoint_size % sizeof(HashBucket) == 0);
+    assert(!recover_pending_);
+    FreeBuckets();
+    size_ = 0;
+    disk_ = &disk;
+    recover_failed_ = false;
+    RETURN_NOT_OK(mapping_.Map(filename, checkpoint_size));
+    size_ = checkpoint_size / sizeof(HashBucket);
+    buckets_ = reinterpret_cast<HashBucket *>(mapping_.data());
+    return Status::Ok;
+}
+
 template<class D>
 inline void InternalHashTable<D>::DumpDistribution(
         MallocFixedPageSize<HashBucket, disk_t> &overflow_buckets_allocator) {
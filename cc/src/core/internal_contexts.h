@@ -53,7 +53,7 @@ protected:
                    AsyncCallback caller_callback_)
             : type{type_}, caller_context{&caller_context_}, caller_callback{caller_callback_}, version{UINT32_MAX},
               phase{Phase::INVALID}, result{Status::Pending}, address{Address::kInvalidAddress},
-              entry{HashBucketEntry::kInvalidEntry} {
+              entry{HashBucketEntry::kInvalidEntry}, start_ticks{0}, appended{false} {
     }
 
 public:
@@ -61,7 +61,7 @@ public:
     PendingContext(const PendingContext &other, IAsyncContext *caller_context_)
             : type{other.type}, caller_context{caller_context_}, caller_callback{other.caller_callback},
               version{other.version}, phase{other.phase}, result{other.result}, address{other.address},
-              entry{other.entry} {
+              entry{other.entry}, start_ticks{other.start_ticks}, appended{other.appended} {
     }
 
 public:
@@ -97,6 +97,10 @@ public:
     Address address;
     /// Hash table entry that (indirectly) leads to the record being read or modified.
     HashBucketEntry entry;
+    /// When the operation was issued (TscClock), if its latency is sampled; else 0.
+    uint64_t start_ticks;
+    /// The operation appended a record, rather than updating one in place.
+    bool appended;
 };
 
 /// FASTER's internal Read() context.
@@ -181,12 +185,13 @@ public:
     typedef K key_t;
 protected:
     AsyncPendingUpsertContext(IAsyncContext &caller_context_, AsyncCallback caller_callback_)
-            : PendingContext<key_t>(OperationType::Upsert, caller_context_, caller_callback_) {
+            : PendingContext<key_t>(OperationType::Upsert, caller_context_, caller_callback_),
+              expiry{HashInfo::kNoExpiry} {
     }
 
     /// The deep copy constructor.
     AsyncPendingUpsertContext(AsyncPendingUpsertContext &other, IAsyncContext *caller_context)
-            : PendingContext<key_t>(other, caller_context) {
+            : PendingContext<key_t>(other, caller_context), expiry{other.expiry} {
     }
 
 public:
@@ -197,6 +202,9 @@ public:
     virtual uint32_t value_size() const = 0;
 
     virtual uint32_t value_length() const = 0;
+
+    /// Expiry the record is published with (see FasterKv::UpsertT()); kept for a retry.
+    uint32_t expiry;
 };
 
 /// A synchronous Upsert() context preserves its type information.
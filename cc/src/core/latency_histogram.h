@@ -0,0 +1,346 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT license.
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#ifdef _WIN32
+#include <intrin.h>
+#else
+#include <x86intrin.h>
+#endif
+#endif
+
+namespace FASTER {
+namespace core {
+
+/// Timestamps for latency measurements: the CPU's time-stamp counter where there is one (x86-64,
+/// where it ticks at a constant rate), and the steady clock in nanoseconds elsewhere.
+class TscClock {
+public:
+    static inline uint64_t Now() {
+#if defined(__x86_64__) || defined(_M_X64)
+        return __rdtsc();
+#else
+        return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()).count());
+#endif
+    }
+
+    /// Measured (once, over about 10 ms) against the steady clock.
+    static double NanosecondsPerTick() {
+#if defined(__x86_64__) || defined(_M_X64)
+        static const double nanoseconds_per_tick = Calibrate();
+        return nanoseconds_per_tick;
+#else
+        return 1.0;
+#endif
+    }
+
+    static inline double ToNanoseconds(uint64_t ticks) {
+        return static_cast<double>(ticks) * NanosecondsPerTick();
+    }
+
+private:
+    static double Calibrate() {
+        auto start_time = std::chrono::steady_clock::now();
+        uint64_t start_ticks = Now();
+        std::chrono::steady_clock::time_point end_time;
+        do {
+            end_time = std::chrono::steady_clock::now();
+        } while (end_time - start_time < std::chrono::milliseconds{10});
+        uint64_t end_ticks = Now();
+        double nanoseconds = static_cast<double>(
+                std::chrono::duration_cast<std::chrono::nanoseconds>(end_time - start_time).count());
+        return end_ticks > start_ticks ? nanoseconds / static_cast<double>(end_ticks - start_ticks) : 1.0;
+    }
+};
+
+/// A log-linear (HDR-style) histogram of latencies, in TscClock ticks. Values below 16 get a
+/// bucket each; above that, each power of two is split into 16 buckets, so a value is known to
+/// within 1/16 (6.25%). Values of 2^44 and more share the last bucket.
+///
+/// Only one thread may Record() into a histogram at a time, which it does with plain (relaxed)
+/// loads and stores; any thread may read it, or copy it, meanwhile, and see a recent count.
+class LatencyHistogram {
+public:
+    static constexpr uint32_t kSubBucketBits = 4;
+    static constexpr uint32_t kSubBuckets = 1 << kSubBucketBits;
+    static constexpr uint32_t kMaxExponent = 44;
+    static constexpr uint32_t kNumBuckets = (kMaxExponent - kSubBucketBits + 1) * kSubBuckets;
+
+    LatencyHistogram()
+            : buckets_{}, count_{0}, sum_{0}, max_{0} {
+    }
+
+    LatencyHistogram(const LatencyHistogram &other)
+            : LatencyHistogram() {
+        Merge(other);
+    }
+
+    LatencyHistogram &operator=(const LatencyHistogram &other) {
+        if (this != &other) {
+            Clear();
+            Merge(other);
+        }
+        return *this;
+    }
+
+    inline void Record(uint64_t value) {
+        Increment(buckets_[BucketIndex(value)], 1);
+        Increment(count_, 1);
+        Increment(sum_, value);
+        if (value > max_.load(std::memory_order_relaxed)) {
+            max_.store(value, std::memory_order_relaxed);
+        }
+    }
+
+    /// Adds "other"'s samples to this one's (with the same single-writer rule as Record()).
+    void Merge(const LatencyHistogram &other) {
+        for (uint32_t idx = 0; idx < kNumBuckets; ++idx) {
+            uint64_t count = other.buckets_[idx].load(std::memory_order_relaxed);
+            if (count > 0) {
+                Increment(buckets_[idx], count);
+            }
+        }
+        Increment(count_, other.count_.load(std::memory_order_relaxed));
+        Increment(sum_, other.sum_.load(std::memory_order_relaxed));
+        uint64_t other_max = other.max_.load(std::memory_order_relaxed);
+        if (other_max > max_.load(std::memory_order_relaxed)) {
+            max_.store(other_max, std::memory_order_relaxed);
+        }
+    }
+
+    void Clear() {
+        for (uint32_t idx = 0; idx < kNumBuckets; ++idx) {
+            buckets_[idx].store(0, std::memory_order_relaxed);
+        }
+        count_.store(0, std::memory_order_relaxed);
+        sum_.store(0, std::memory_order_relaxed);
+        max_.store(0, std::memory_order_relaxed);
+    }
+
+    inline uint64_t count() const {
+        return count_.load(std::memory_order_relaxed);
+    }
+
+    inline uint64_t max() const {
+        return max_.load(std::memory_order_relaxed);
+    }
+
+    inline double Mean() const {
+        uint64_t count = this->count();
+        return count == 0 ? 0.0 : static_cast<double>(sum_.load(std::memory_order_relaxed)) / count;
+    }
+
+    /// The largest value that falls in the same bucket as the "percentile"-th (0..100) smallest
+    /// sample, capped at the largest sample; 0 if there are none.
+    uint64_t ValueAtPercentile(double percentile) const {
+        uint64_t count = this->count();
+        if (count == 0) {
+            return 0;
+        }
+        percentile = std::min(std::max(percentile, 0.0), 100.0);
+        auto rank = static_cast<uint64_t>(percentile / 100.0 * static_cast<double>(count) + 0.5);
+        rank = std::min(std::max<uint64_t>(rank, 1), count);
+        uint64_t seen = 0;
+        for (uint32_t idx = 0; idx < kNumBuckets; ++idx) {
+            seen += buckets_[idx].load(std::memory_order_relaxed);
+            if (seen >= rank) {
+                return std::min(BucketHighestValue(idx), max());
+            }
+        }
+        return max();
+    }
+
+    inline uint64_t bucket_count(uint32_t idx) const {
+        return buckets_[idx].load(std::memory_order_relaxed);
+    }
+
+    static inline uint32_t BucketIndex(uint64_t value) {
+        if (value < kSubBuckets) {
+            return static_cast<uint32_t>(value);
+        }
+        uint32_t exponent = HighestBit(value);
+        if (exponent >= kMaxExponent) {
+            return kNumBuckets - 1;
+        }
+        uint32_t sub_bucket = static_cast<uint32_t>(value >> (exponent - kSubBucketBits)) & (kSubBuckets - 1);
+        return (exponent - kSubBucketBits + 1) * kSubBuckets + sub_bucket;
+    }
+
+    /// The largest value counted in bucket "idx".
+    static inline uint64_t BucketHighestValue(uint32_t idx) {
+        if (idx < kSubBuckets) {
+            return idx;
+        }
+        if (idx == kNumBuckets - 1) {
+            return UINT64_MAX;
+        }
+        uint32_t shift = idx / kSubBuckets - 1;
+        uint64_t lowest = static_cast<uint64_t>(kSubBuckets + idx % kSubBuckets) << shift;
+        return lowest + (uint64_t{1} << shift) - 1;
+    }
+
+private:
+    static inline void Increment(std::atomic<uint64_t> &counter, uint64_t delta) {
+        counter.store(counter.load(std::memory_order_relaxed) + delta, std::memory_order_relaxed);
+    }
+
+    static inline uint32_t HighestBit(uint64_t value) {
+        assert(value != 0);
+#ifdef _WIN32
+        unsigned long index;
+        _BitScanReverse64(&index, value);
+        return static_cast<uint32_t>(index);
+#else
+        return 63 - static_cast<uint32_t>(__builtin_clzll(value));
+#endif
+    }
+
+    std::atomic<uint64_t> buckets_[kNumBuckets];
+    std::atomic<uint64_t> count_;
+    std::atomic<uint64_t> sum_;
+    std::atomic<uint64_t> max_;
+};
+
+/// Operations whose latencies the store tracks. (Upsert covers UpsertT().)
+enum class LatencyOp : uint8_t {
+    Read = 0,
+    Upsert,
+    Rmw,
+    Delete,
+};
+
+static constexpr uint32_t kNumLatencyOps = 4;
+
+inline const char *LatencyOpName(LatencyOp op) {
+    switch (op) {
+        case LatencyOp::Read:
+            return "read";
+        case LatencyOp::Upsert:
+            return "upsert";
+        case LatencyOp::Rmw:
+            return "rmw";
+        case LatencyOp::Delete:
+            return "delete";
+    }
+    return "unknown";
+}
+
+/// How an operation completed.
+enum class LatencyOutcome : uint8_t {
+    /// Synchronously, without appending a record: an in-place update, or a read from memory.
+    InPlace = 0,
+    /// Synchronously, by appending a new record (read-copy-update).
+    Rcu,
+    /// From CompletePending(), after reading a record from disk.
+    Pending,
+    /// After a retry: from CompletePending(), or synchronously after a CPR shift or a lost race.
+    Retry,
+};
+
+static constexpr uint32_t kNumLatencyOutcomes = 4;
+
+inline const char *LatencyOutcomeName(LatencyOutcome outcome) {
+    switch (outcome) {
+        case LatencyOutcome::InPlace:
+            return "in-place";
+        case LatencyOutcome::Rcu:
+            return "rcu";
+        case LatencyOutcome::Pending:
+            return "pending";
+        case LatencyOutcome::Retry:
+            return "retry";
+    }
+    return "unknown";
+}
+
+/// The store's per-session latency histograms, by operation and outcome. Each session times
+/// every "sample_every"-th operation it issues (a countdown, so the rest cost one decrement), and
+/// records into its own histograms; Get() merges them on demand.
+class LatencyStats {
+public:
+    LatencyStats(uint32_t num_threads, uint32_t sample_every)
+            : sample_every_{std::max<uint32_t>(sample_every, 1)}, num_threads_{num_threads},
+              threads_{new std::atomic<ThreadLatency *>[num_threads]} {
+        for (uint32_t idx = 0; idx < num_threads_; ++idx) {
+            threads_[idx].store(nullptr);
+        }
+    }
+
+    ~LatencyStats() {
+        for (uint32_t idx = 0; idx < num_threads_; ++idx) {
+            delete threads_[idx].load();
+        }
+    }
+
+    /// Called by thread "thread_id" as it starts an operation; returns its start time if the
+    /// operation is sampled, else 0.
+    inline uint64_t Start(uint32_t thread_id) {
+        ThreadLatency &thread = this->thread(thread_id);
+        if (--thread.countdown > 0) {
+            return 0;
+        }
+        thread.countdown = sample_every_;
+        return TscClock::Now();
+    }
+
+    /// Called by thread "thread_id" as a sampled operation (started at "start") completes.
+    inline void End(uint32_t thread_id, uint64_t start, LatencyOp op, LatencyOutcome outcome) {
+        assert(start != 0);
+        uint64_t now = TscClock::Now();
+        thread(thread_id).histograms[static_cast<uint8_t>(op)][static_cast<uint8_t>(outcome)].Record(
+                now > start ? now - start : 0);
+    }
+
+    LatencyHistogram Get(LatencyOp op, LatencyOutcome outcome) const {
+        LatencyHistogram result;
+        for (uint32_t idx = 0; idx < num_threads_; ++idx) {
+            const ThreadLatency *thread = threads_[idx].load(std::memory_order_acquire);
+            if (thread) {
+                result.Merge(thread->histograms[static_cast<uint8_t>(op)][static_cast<uint8_t>(outcome)]);
+            }
+        }
+        return result;
+    }
+
+    inline uint32_t sample_every() const {
+        return sample_every_;
+    }
+
+private:
+    struct ThreadLatency {
+        ThreadLatency(uint32_t sample_every)
+                : countdown{sample_every} {
+        }
+
+        uint32_t countdown;
+        LatencyHistogram histograms[kNumLatencyOps][kNumLatencyOutcomes];
+    };
+
+    /// A thread's histograms are allocated by its first operation.
+    inline ThreadLatency &thread(uint32_t thread_id) {
+        assert(thread_id < num_threads_);
+        ThreadLatency *thread = threads_[thread_id].load(std::memory_order_relaxed);
+        if (!thread) {
+            thread = new ThreadLatency{sample_every_};
+            threads_[thread_id].store(thread, std::memory_order_release);
+        }
+        return *thread;
+    }
+
+    uint32_t sample_every_;
+    uint32_t num_threads_;
+    std::unique_ptr<std::atomic<ThreadLatency *>[]> threads_;
+};
+
+}
+} // namespace FASTER::core
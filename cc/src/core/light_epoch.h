@@ -9,12 +9,14 @@
 #include <cstring>
 #include <functional>
 #include <memory>
+#include <stdexcept>
 #include <thread>
 
 #include "alloc.h"
 #include "async.h"
 #include "constants.h"
 #include "phase.h"
+#include "stats.h"
 #include "thread.h"
 #include "utility.h"
 
@@ -107,6 +109,30 @@ private:
         IAsyncContext *context;
     };
 
+    /// Block of drain-list actions. The drain list starts with one block, inline, and grows by
+    /// chaining more blocks when every slot is taken, instead of waiting for one to drain.
+    struct DrainBlock {
+        static constexpr uint32_t kNumActions = 256;
+
+        DrainBlock()
+                : next{nullptr} {
+        }
+
+        EpochAction actions[kNumActions];
+        std::atomic<DrainBlock *> next;
+    };
+
+    /// Active-entry bitmap for one shard of the epoch table. Each shard covers a contiguous range
+    /// of thread IDs and lives on its own cache line, so threads in different shards (e.g., pinned
+    /// to different NUMA nodes) never write the same line when they enter or leave.
+    struct alignas(Constants::kCacheLineBytes) Shard {
+        Shard()
+                : active{0} {
+        }
+
+        std::atomic<uint64_t> active;
+    };
+
 public:
     /// Default invalid page_index entry.
     static constexpr uint32_t kInvalidIndex = 0;
@@ -114,18 +140,28 @@ public:
     static constexpr uint64_t kUnprotected = 0;
 
 private:
-    /// Default number of entries in the entries table
-    static constexpr uint32_t kTableSize = Thread::kMaxNumThreads;
-    /// Default drainlist size
-    static constexpr uint32_t kDrainListSize = 256;
+    /// Default drainlist (block) size
+    static constexpr uint32_t kDrainListSize = DrainBlock::kNumActions;
+    /// Entries per shard: one bit each in the shard's bitmap word.
+    static constexpr uint32_t kEntriesPerShard = 64;
+    /// The top-level bitmap has one bit per shard.
+    static constexpr uint32_t kMaxNumShards = 64;
+    static_assert(kMaxNumShards * kEntriesPerShard >= Thread::kMaxNumThreads,
+                  "Epoch table cannot cover every thread ID");
     /// Epoch table
     Entry *table_;
     /// Number of entries in epoch table.
     uint32_t num_entries_;
+    /// Per-shard active-entry bitmaps.
+    Shard *shards_;
+    uint32_t num_shards_;
+    /// Bit i is set once shard i has had an active entry. (Never cleared: clearing it could race
+    /// with a thread entering the shard, and sessions are long-lived anyway.)
+    std::atomic<uint64_t> used_shards_;
 
     /// List of action, epoch pairs containing actions to performed when an epoch becomes
     /// safe to reclaim.
-    EpochAction drain_list_[kDrainListSize];
+    DrainBlock drain_list_;
     /// Count of drain actions
     std::atomic<uint32_t> drain_count_;
 
@@ -135,8 +171,10 @@ public:
     /// Cached value of epoch that is safe to reclaim
     std::atomic<uint64_t> safe_to_reclaim_epoch;
 
-    LightEpoch(uint32_t size = kTableSize)
-            : table_{nullptr}, num_entries_{0}, drain_count_{0}, drain_list_{} {
+    /// By default, the table covers every thread ID handed out so far.
+    LightEpoch(uint32_t size = Thread::capacity())
+            : table_{nullptr}, num_entries_{0}, shards_{nullptr}, num_shards_{0}, used_shards_{0},
+              drain_list_{}, drain_count_{0} {
         Initialize(size);
     }
 
@@ -144,33 +182,92 @@ public:
         Uninitialize();
     }
 
+    /// Number of entries in the epoch table (the size requested, rounded up to whole shards).
+    inline uint32_t num_entries() const {
+        return num_entries_;
+    }
+
 private:
     void Initialize(uint32_t size) {
-        num_entries_ = size;
+        num_shards_ = (size + kEntriesPerShard - 1) / kEntriesPerShard;
+        if (num_shards_ > kMaxNumShards) {
+            throw std::invalid_argument{"Epoch table is too large"};
+        }
+        num_entries_ = num_shards_ * kEntriesPerShard;
         // do cache-line alignment
         table_ = reinterpret_cast<Entry *>(aligned_alloc(Constants::kCacheLineBytes,
-                                                         (size + 2) * sizeof(Entry)));
-        new(table_) Entry[size + 2];
+                                                         num_entries_ * sizeof(Entry)));
+        new(table_) Entry[num_entries_];
+        shards_ = reinterpret_cast<Shard *>(aligned_alloc(Constants::kCacheLineBytes,
+                                                          num_shards_ * sizeof(Shard)));
+        new(shards_) Shard[num_shards_];
+        used_shards_ = 0;
         current_epoch = 1;
         safe_to_reclaim_epoch = 0;
         for (uint32_t idx = 0; idx < kDrainListSize; ++idx) {
-            drain_list_[idx].Initialize();
+            drain_list_.actions[idx].Initialize();
         }
         drain_count_ = 0;
     }
 
     void Uninitialize() {
+        DrainBlock *block = drain_list_.next.load();
+        while (block) {
+            DrainBlock *next = block->next.load();
+            delete block;
+            block = next;
+        }
+        drain_list_.next = nullptr;
         aligned_free(table_);
         table_ = nullptr;
         num_entries_ = 0;
+        aligned_free(shards_);
+        shards_ = nullptr;
+        num_shards_ = 0;
         current_epoch = 1;
         safe_to_reclaim_epoch = 0;
     }
 
+    /// The entry is about to protect an epoch; publish it in the bitmaps first, so that a thread
+    /// scanning the table sees either the bit or nothing at all.
+    inline void MarkActive(uint32_t entry) {
+        uint32_t shard = entry / kEntriesPerShard;
+        shards_[shard].active.fetch_or((uint64_t) 1 << (entry % kEntriesPerShard));
+        uint64_t shard_bit = (uint64_t) 1 << shard;
+        if ((used_shards_.load() & shard_bit) == 0) {
+            used_shards_.fetch_or(shard_bit);
+        }
+    }
+
+    inline void MarkInactive(uint32_t entry) {
+        shards_[entry / kEntriesPerShard].active.fetch_and(~((uint64_t) 1 << (entry % kEntriesPerShard)));
+    }
+
+    /// Calls visitor(index) for every entry that is (or may be) protecting an epoch.
+    template<class F>
+    inline void ForEachActiveEntry(F visitor) const {
+        uint64_t used_shards = used_shards_.load();
+        while (used_shards) {
+            unsigned long shard;
+            _BitScanForward64(&shard, used_shards);
+            used_shards &= used_shards - 1;
+            uint64_t active = shards_[shard].active.load();
+            while (active) {
+                unsigned long bit;
+                _BitScanForward64(&bit, active);
+                active &= active - 1;
+                visitor(shard * kEntriesPerShard + bit);
+            }
+        }
+    }
+
 public:
     /// Enter the thread into the protected code region
     inline uint64_t Protect() {
         uint32_t entry = Thread::id();
+        if (table_[entry].local_current_epoch == kUnprotected) {
+            MarkActive(entry);
+        }
         table_[entry].local_current_epoch = current_epoch.load();
         return table_[entry].local_current_epoch;
     }
@@ -179,17 +276,25 @@ public:
     /// Process entries in drain list if possible
     inline uint64_t ProtectAndDrain() {
         uint32_t entry = Thread::id();
-        table_[entry].local_current_epoch = current_epoch.load();
+        uint64_t epoch = current_epoch.load();
+        if (table_[entry].local_current_epoch != epoch) {
+            // Most refreshes find the epoch unchanged; skip dirtying the entry's line for those.
+            if (table_[entry].local_current_epoch == kUnprotected) {
+                MarkActive(entry);
+            }
+            table_[entry].local_current_epoch = epoch;
+        }
         if (drain_count_.load() > 0) {
-            Drain(table_[entry].local_current_epoch);
+            Drain(epoch);
         }
-        return table_[entry].local_current_epoch;
+        return epoch;
     }
 
     uint64_t ReentrantProtect() {
         uint32_t entry = Thread::id();
         if (table_[entry].local_current_epoch != kUnprotected)
             return table_[entry].local_current_epoch;
+        MarkActive(entry);
         table_[entry].local_current_epoch = current_epoch.load();
         table_[entry].reentrant++;
         return table_[entry].local_current_epoch;
@@ -202,24 +307,29 @@ public:
 
     /// Exit the thread from the protected code region.
     void Unprotect() {
-        table_[Thread::id()].local_current_epoch = kUnprotected;
+        uint32_t entry = Thread::id();
+        table_[entry].local_current_epoch = kUnprotected;
+        MarkInactive(entry);
     }
 
     void ReentrantUnprotect() {
         uint32_t entry = Thread::id();
         if (--(table_[entry].reentrant) == 0) {
             table_[entry].local_current_epoch = kUnprotected;
+            MarkInactive(entry);
         }
     }
 
     void Drain(uint64_t nextEpoch) {
         ComputeNewSafeToReclaimEpoch(nextEpoch);
-        for (uint32_t idx = 0; idx < kDrainListSize; ++idx) {
-            uint64_t trigger_epoch = drain_list_[idx].epoch.load();
-            if (trigger_epoch <= safe_to_reclaim_epoch) {
-                if (drain_list_[idx].TryPop(trigger_epoch)) {
-                    if (--drain_count_ == 0) {
-                        break;
+        for (DrainBlock *block = &drain_list_; block; block = block->next.load()) {
+            for (uint32_t idx = 0; idx < kDrainListSize; ++idx) {
+                uint64_t trigger_epoch = block->actions[idx].epoch.load();
+                if (trigger_epoch <= safe_to_reclaim_epoch) {
+                    if (block->actions[idx].TryPop(trigger_epoch)) {
+                        if (--drain_count_ == 0) {
+                            return;
+                        }
                     }
                 }
             }
@@ -239,38 +349,65 @@ public:
     /// a trigger action for when older epoch becomes safe to reclaim
     uint64_t BumpCurrentEpoch(EpochAction::callback_t callback, IAsyncContext *context) {
         uint64_t prior_epoch = BumpCurrentEpoch() - 1;
-        uint32_t i = 0, j = 0;
+        DrainBlock *block = &drain_list_;
         while (true) {
-            uint64_t trigger_epoch = drain_list_[i].epoch.load();
-            if (trigger_epoch == EpochAction::kFree) {
-                if (drain_list_[i].TryPush(prior_epoch, callback, context)) {
-                    ++drain_count_;
-                    break;
-                }
-            } else if (trigger_epoch <= safe_to_reclaim_epoch.load()) {
-                if (drain_list_[i].TrySwap(trigger_epoch, prior_epoch, callback, context)) {
-                    break;
+            for (uint32_t idx = 0; idx < kDrainListSize; ++idx) {
+                EpochAction &action = block->actions[idx];
+                uint64_t trigger_epoch = action.epoch.load();
+                if (trigger_epoch == EpochAction::kFree) {
+                    if (action.TryPush(prior_epoch, callback, context)) {
+                        ++drain_count_;
+                        Stats::Increment(StatCounter::EpochActionsQueued);
+                        return prior_epoch + 1;
+                    }
+                } else if (trigger_epoch <= safe_to_reclaim_epoch.load()) {
+                    if (action.TrySwap(trigger_epoch, prior_epoch, callback, context)) {
+                        Stats::Increment(StatCounter::EpochActionsQueued);
+                        return prior_epoch + 1;
+                    }
                 }
             }
-            if (++i == kDrainListSize) {
-                i = 0;
-                if (++j == 500) {
-                    j = 0;
-                    std::this_thread::sleep_for(std::chrono::seconds(1));
-                    fprintf(stderr, "Slowdown: Unable to add trigger to epoch\n");
+            DrainBlock *next = block->next.load();
+            if (!next) {
+                // Every slot is taken: grow the list. Blocks are only freed with the epoch itself.
+                DrainBlock *new_block = new DrainBlock{};
+                for (uint32_t idx = 0; idx < kDrainListSize; ++idx) {
+                    new_block->actions[idx].Initialize();
+                }
+                if (block->next.compare_exchange_strong(next, new_block)) {
+                    next = new_block;
+                    Stats::Increment(StatCounter::EpochDrainListGrowths);
+                } else {
+                    // Another thread grew the list first.
+                    delete new_block;
                 }
             }
+            block = next;
         }
-        return prior_epoch + 1;
     }
 
-    /// Compute latest epoch that is safe to reclaim, by scanning the epoch table
+    /// Compute latest epoch that is safe to reclaim, by scanning the active entries of the epoch
+    /// table: the minimum is taken per shard, then across shards.
     uint64_t ComputeNewSafeToReclaimEpoch(uint64_t current_epoch_) {
         uint64_t oldest_ongoing_call = current_epoch_;
-        for (uint32_t index = 1; index <= num_entries_; ++index) {
-            uint64_t entry_epoch = table_[index].local_current_epoch;
-            if (entry_epoch != kUnprotected && entry_epoch < oldest_ongoing_call) {
-                oldest_ongoing_call = entry_epoch;
+        uint64_t used_shards = used_shards_.load();
+        while (used_shards) {
+            unsigned long shard;
+            _BitScanForward64(&shard, used_shards);
+            used_shards &= used_shards - 1;
+            uint64_t active = shards_[shard].active.load();
+            uint64_t shard_oldest = current_epoch_;
+            while (active) {
+                unsigned long bit;
+                _BitScanForward64(&bit, active);
+                active &= active - 1;
+                uint64_t entry_epoch = table_[shard * kEntriesPerShard + bit].local_current_epoch;
+                if (entry_epoch != kUnprotected && entry_epoch < shard_oldest) {
+                    shard_oldest = entry_epoch;
+                }
+            }
+            if (shard_oldest < oldest_ongoing_call) {
+                oldest_ongoing_call = shard_oldest;
             }
         }
         safe_to_reclaim_epoch = oldest_ongoing_call - 1;
@@ -289,7 +426,7 @@ public:
 
     /// CPR checkpoint functions.
     inline void ResetPhaseFinished() {
-        for (uint32_t idx = 1; idx <= num_entries_; ++idx) {
+        for (uint32_t idx = 0; idx < num_entries_; ++idx) {
             assert(table_[idx].phase_finished.load() == Phase::REST ||
                    table_[idx].phase_finished.load() == Phase::INDEX_CHKPT ||
                    table_[idx].phase_finished.load() == Phase::PERSISTENCE_CALLBACK ||
@@ -303,15 +440,16 @@ public:
     inline bool FinishThreadPhase(Phase phase) {
         uint32_t entry = Thread::id();
         table_[entry].phase_finished = phase;
-        // Check if other threads have reported complete.
-        for (uint32_t idx = 1; idx <= num_entries_; ++idx) {
+        // Check if other (active) threads have reported complete.
+        bool finished = true;
+        ForEachActiveEntry([&](uint32_t idx) {
             Phase entry_phase = table_[idx].phase_finished.load();
             uint64_t entry_epoch = table_[idx].local_current_epoch;
             if (entry_epoch != 0 && entry_phase != phase) {
-                return false;
+                finished = false;
             }
-        }
-        return true;
+        });
+        return finished;
     }
 
     /// Has this thread completed the specified phase (i.e., is it waiting for other threads to
@@ -286,6 +286,8 @@ public:
         alignment_ = alignment;
         count_.store(0);
         epoch_ = &epoch;
+        // One free list per thread that can enter the epoch.
+        free_list_.Resize(epoch.num_entries());
         disk_ = nullptr;
         pending_checkpoint_writes_ = 0;
         pending_recover_reads_ = 0;
@@ -391,7 +393,7 @@ private:
     std::atomic<bool> recover_pending_;
     std::atomic<bool> recover_failed_;
 
-    FreeList free_list_[Thread::kMaxNumThreads];
+    PerThreadArray<FreeList> free_list_;
 };
 
 /// Implementations.
@@ -0,0 +1,261 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT license.
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+
+#include "address.h"
+
+namespace FASTER {
+namespace core {
+
+/// Key as seen by the ordered index: the key's bytes, as the hash bucket entry keeps them inline,
+/// plus the key's length. Only keys of up to kMaxKeyBytes fit; a longer key would be truncated,
+/// and collide with (and sort among) the keys that share its prefix, so the store rejects such
+/// keys while the ordered index is enabled (see Fits()). Keys are ordered lexicographically on
+/// their bytes, with a shorter key ordered before every longer key it is a prefix of.
+struct OrderedIndexKey {
+    static constexpr uint32_t kMaxKeyBytes = 16;
+
+    OrderedIndexKey()
+            : length{0} {
+        std::memset(bytes, 0, kMaxKeyBytes);
+    }
+
+    OrderedIndexKey(const uint8_t *key, uint32_t length_)
+            : length{length_} {
+        assert(length <= kMaxKeyBytes);
+        std::memset(bytes, 0, kMaxKeyBytes);
+        std::memcpy(bytes, key, length);
+    }
+
+    /// Requires the same key interface that the hash bucket entry uses (Copy() + length()).
+    template<class K>
+    static inline bool Fits(const K &key) {
+        return key.length() <= kMaxKeyBytes;
+    }
+
+    template<class K>
+    static inline OrderedIndexKey FromKey(const K &key) {
+        assert(Fits(key));
+        uint8_t buffer[kMaxKeyBytes];
+        key.Copy(buffer);
+        return OrderedIndexKey{buffer, key.length()};
+    }
+
+    inline int Compare(const OrderedIndexKey &other) const {
+        int result = std::memcmp(bytes, other.bytes, std::min(length, other.length));
+        if (result != 0) {
+            return result;
+        }
+        return length < other.length ? -1 : (length > other.length ? 1 : 0);
+    }
+
+    inline bool operator<(const OrderedIndexKey &other) const {
+        return Compare(other) < 0;
+    }
+
+    inline bool operator==(const OrderedIndexKey &other) const {
+        return Compare(other) == 0;
+    }
+
+    uint8_t bytes[kMaxKeyBytes];
+    uint32_t length;
+};
+
+/// Ordered secondary index, mapping keys to the log address of their latest record. It is a
+/// latch-free skip list: nodes are linked with CAS and never unlinked while the index is live, so
+/// readers need no epoch protection. Deletes leave a tombstoned node behind; Clear() (used when
+/// rebuilding the index) reclaims everything and must not run concurrently with other calls.
+class OrderedIndex {
+public:
+    static constexpr uint32_t kMaxHeight = 12;
+    static constexpr uint32_t kBranching = 4;
+
+private:
+    /// A node's control word packs the record's address with a tombstone bit.
+    static constexpr uint64_t kTombstone = (uint64_t) 1 << 63;
+
+    struct Node {
+        Node(const OrderedIndexKey &key_, uint64_t control_, uint32_t height_)
+                : key{key_}, control{control_}, height{height_} {
+        }
+
+        inline std::atomic<Node *> &next(uint32_t level) {
+            assert(level < height);
+            return next_[level];
+        }
+
+        OrderedIndexKey key;
+        std::atomic<uint64_t> control;
+        uint32_t height;
+        /// Variable-length: "height" links are allocated inline.
+        std::atomic<Node *> next_[1];
+    };
+
+public:
+    OrderedIndex()
+            : head_{NewNode(OrderedIndexKey{}, Address::kInvalidAddress, kMaxHeight)}, size_{0} {
+    }
+
+    ~OrderedIndex() {
+        Clear();
+        std::free(head_);
+    }
+
+    // No copy constructor.
+    OrderedIndex(const OrderedIndex &other) = delete;
+
+    /// The record for "key" now lives at "address".
+    template<class K>
+    inline void Upsert(const K &key, Address address) {
+        Apply(OrderedIndexKey::FromKey(key), address.control());
+    }
+
+    inline void Upsert(const OrderedIndexKey &key, Address address) {
+        Apply(key, address.control());
+    }
+
+    /// The record for "key", at "address", has been deleted.
+    template<class K>
+    inline void Delete(const K &key, Address address) {
+        Apply(OrderedIndexKey::FromKey(key), address.control() | kTombstone);
+    }
+
+    inline void Delete(const OrderedIndexKey &key, Address address) {
+        Apply(key, address.control() | kTombstone);
+    }
+
+    /// Calls visitor(uint8_t *key, uint32_t key_length, Address address) for every live key in
+    /// [begin, end), in key order. The key bytes are owned by the index and stay valid until the
+    /// next Clear().
+    template<class F>
+    void Scan(const OrderedIndexKey &begin, const OrderedIndexKey &end, F visitor) const {
+        Node *node = FindGreaterOrEqual(begin, nullptr, nullptr);
+        while (node && node->key < end) {
+            uint64_t control = node->control.load();
+            if ((control & kTombstone) == 0) {
+                visitor(node->key.bytes, node->key.length, Address{control});
+            }
+            node = node->next(0).load();
+        }
+    }
+
+    /// Removes every key. Not thread-safe.
+    void Clear() {
+        Node *node = head_->next(0).load();
+        while (node) {
+            Node *next = node->next(0).load();
+            std::free(node);
+            node = next;
+        }
+        for (uint32_t level = 0; level < kMaxHeight; ++level) {
+            head_->next(level).store(nullptr);
+        }
+        size_.store(0);
+    }
+
+    /// Number of keys tracked, including deleted ones that have not been cleared yet.
+    inline uint64_t size() const {
+        return size_.load();
+    }
+
+private:
+    static Node *NewNode(const OrderedIndexKey &key, uint64_t control, uint32_t height) {
+        void *buffer = std::malloc(sizeof(Node) + (height - 1) * sizeof(std::atomic<Node *>));
+        Node *node = new(buffer) Node{key, control, height};
+        for (uint32_t level = 0; level < height; ++level) {
+            new(&node->next_[level]) std::atomic<Node *>{nullptr};
+        }
+        return node;
+    }
+
+    static uint32_t RandomHeight() {
+        // Thread-local xorshift; the skip list only needs a cheap, roughly geometric distribution.
+        static thread_local uint64_t seed = reinterpret_cast<uint64_t>(&seed) | 1;
+        uint32_t height = 1;
+        while (height < kMaxHeight) {
+            seed ^= seed << 13;
+            seed ^= seed >> 7;
+            seed ^= seed << 17;
+            if (seed % kBranching != 0) {
+                break;
+            }
+            ++height;
+        }
+        return height;
+    }
+
+    /// Returns the first node whose key is >= "key" (or nullptr), and optionally the predecessor
+    /// and successor at each level.
+    Node *FindGreaterOrEqual(const OrderedIndexKey &key, Node **preds, Node **succs) const {
+        Node *pred = head_;
+        Node *succ = nullptr;
+        for (int32_t level = kMaxHeight - 1; level >= 0; --level) {
+            succ = pred->next(level).load();
+            while (succ && succ->key < key) {
+                pred = succ;
+                succ = pred->next(level).load();
+            }
+            if (preds) {
+                preds[level] = pred;
+                succs[level] = succ;
+            }
+        }
+        return succ;
+    }
+
+    /// Installs "control" for "key", inserting a node if needed. The same key always maps to the
+    /// same log, where addresses grow monotonically, so an older address never overwrites a newer
+    /// one even when the hash-table CAS and the index update race.
+    void Apply(const OrderedIndexKey &key, uint64_t control) {
+        Node *preds[kMaxHeight];
+        Node *succs[kMaxHeight];
+        while (true) {
+            Node *found = FindGreaterOrEqual(key, preds, succs);
+            if (found && found->key == key) {
+                uint64_t current = found->control.load();
+                do {
+                    if ((current & ~kTombstone) > (control & ~kTombstone)) {
+                        // Stale update.
+                        return;
+                    }
+                } while (!found->control.compare_exchange_weak(current, control));
+                return;
+            }
+
+            uint32_t height = RandomHeight();
+            Node *node = NewNode(key, control, height);
+            node->next(0).store(succs[0]);
+            if (!preds[0]->next(0).compare_exchange_strong(succs[0], node)) {
+                // Lost the race at the bottom level; nothing points to the node yet.
+                std::free(node);
+                continue;
+            }
+            ++size_;
+            for (uint32_t level = 1; level < height; ++level) {
+                while (true) {
+                    node->next(level).store(succs[level]);
+                    if (preds[level]->next(level).compare_exchange_strong(succs[level], node)) {
+                        break;
+                    }
+                    FindGreaterOrEqual(key, preds, succs);
+                }
+            }
+            return;
+        }
+    }
+
+    Node *head_;
+    std::atomic<uint64_t> size_;
+};
+
+}
+} // namespace FASTER::core
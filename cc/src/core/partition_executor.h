@@ -0,0 +1,247 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT license.
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+#include "constants.h"
+#include "phase.h"
+#include "thread.h"
+
+namespace FASTER {
+namespace core {
+
+/// Bounded single-producer/single-consumer ring. The consumer advances past an item only once it
+/// is done with it (Front(), then Pop()), so an empty ring means every item has been handled.
+template<class T, uint32_t N>
+class SpscRing {
+public:
+    static_assert((N & (N - 1)) == 0, "N must be a power of two");
+
+    SpscRing()
+            : head_{0}, cached_tail_{0}, tail_{0}, cached_head_{0} {
+    }
+
+    /// Producer side.
+    inline bool TryPush(const T &item) {
+        uint64_t tail = tail_.load(std::memory_order_relaxed);
+        if (tail - cached_head_ == N) {
+            cached_head_ = head_.load(std::memory_order_acquire);
+            if (tail - cached_head_ == N) {
+                return false;
+            }
+        }
+        items_[tail & (N - 1)] = item;
+        tail_.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    /// Consumer side: the oldest item, or nullptr if the ring is empty.
+    inline T *Front() {
+        uint64_t head = head_.load(std::memory_order_relaxed);
+        if (head == cached_tail_) {
+            cached_tail_ = tail_.load(std::memory_order_acquire);
+            if (head == cached_tail_) {
+                return nullptr;
+            }
+        }
+        return &items_[head & (N - 1)];
+    }
+
+    inline void Pop() {
+        head_.store(head_.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+
+    inline bool empty() const {
+        return head_.load(std::memory_order_acquire) == tail_.load(std::memory_order_acquire);
+    }
+
+private:
+    /// Consumer's cache line.
+    alignas(Constants::kCacheLineBytes) std::atomic<uint64_t> head_;
+    uint64_t cached_tail_;
+    /// Producer's cache line.
+    alignas(Constants::kCacheLineBytes) std::atomic<uint64_t> tail_;
+    uint64_t cached_head_;
+    alignas(Constants::kCacheLineBytes) T items_[N];
+};
+
+/// Shared-nothing execution: each of the store's partitions (see FasterKv::Partition()) belongs to
+/// one owner thread, pinned to its own core, which holds a session on the store and has called
+/// OwnPartition(). Client threads do not touch the store; they send operations to the owner of the
+/// key's partition, through one SPSC ring per (owner, client) pair, and the owner runs them with
+/// plain loads and stores. Under heavy update contention on a few keys, this keeps each key's
+/// cache lines on one core instead of bouncing them between cores.
+///
+/// While an executor is running, no other session may operate on the store's keys, and
+/// MultiKeyTransaction() must not be used.
+template<class S>
+class PartitionExecutor {
+public:
+    typedef S store_t;
+
+    /// One operation: op(store, arg), called on the owner thread, inside its session.
+    typedef void(*operation_t)(store_t &, void *);
+
+    static constexpr uint32_t kRingSize = 256;
+    /// Owners Refresh() every kRefreshInterval operations, and CompletePending() once
+    /// kMaxPendingRequests requests are pending.
+    static constexpr uint64_t kRefreshInterval = 256;
+    static constexpr uint64_t kMaxPendingRequests = 64;
+
+private:
+    struct Message {
+        operation_t op;
+        void *arg;
+    };
+
+    typedef SpscRing<Message, kRingSize> ring_t;
+
+    struct alignas(Constants::kCacheLineBytes) Owner {
+        std::thread thread;
+    };
+
+public:
+    /// Starts one owner thread per partition. Client threads are numbered [0, "num_clients");
+    /// each must use its own number. With "pin_threads", the owner of partition i runs on CPU i
+    /// (mod the number of CPUs); only implemented on Linux.
+    PartitionExecutor(store_t &store, uint32_t num_clients, bool pin_threads = true)
+            : store_{store}, num_partitions_{store.NumPartitions()}, num_clients_{num_clients},
+              rings_{num_partitions_ * num_clients}, owners_{num_partitions_}, stop_{false} {
+        for (uint32_t partition = 0; partition < num_partitions_; ++partition) {
+            owners_[partition].thread = std::thread{&PartitionExecutor::Run, this, partition, pin_threads};
+        }
+    }
+
+    ~PartitionExecutor() {
+        stop_ = true;
+        for (uint32_t partition = 0; partition < num_partitions_; ++partition) {
+            owners_[partition].thread.join();
+        }
+    }
+
+    // No copy constructor.
+    PartitionExecutor(const PartitionExecutor &other) = delete;
+
+    /// Sends op(store, arg) to the owner of "partition"; fails if the ring to it is full.
+    inline bool TrySend(uint32_t client, uint32_t partition, operation_t op, void *arg) {
+        return ring(partition, client).TryPush(Message{op, arg});
+    }
+
+    /// Sends op(store, arg) to the owner of "partition", waiting for room if necessary.
+    inline void Send(uint32_t client, uint32_t partition, operation_t op, void *arg) {
+        while (!TrySend(client, partition, op, arg)) {
+            std::this_thread::yield();
+        }
+    }
+
+    /// Blocks until the owners have run every operation "client" sent. (Operations that went
+    /// pending complete later, on the owner thread.)
+    void Flush(uint32_t client) {
+        for (uint32_t partition = 0; partition < num_partitions_; ++partition) {
+            while (!ring(partition, client).empty()) {
+                std::this_thread::yield();
+            }
+        }
+    }
+
+    inline uint32_t num_partitions() const {
+        return num_partitions_;
+    }
+
+    inline uint32_t num_clients() const {
+        return num_clients_;
+    }
+
+private:
+    inline ring_t &ring(uint32_t partition, uint32_t client) {
+        return rings_[partition * num_clients_ + client];
+    }
+
+    static void Pin(uint32_t partition) {
+#ifdef __linux__
+        uint32_t num_cpus = std::max(std::thread::hardware_concurrency(), 1u);
+        cpu_set_t cpus;
+        CPU_ZERO(&cpus);
+        CPU_SET(partition % num_cpus, &cpus);
+        pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+#endif
+    }
+
+    void Run(uint32_t partition, bool pin_threads) {
+        if (pin_threads) {
+            Pin(partition);
+        }
+        store_.StartSession();
+        store_.OwnPartition(partition);
+        uint64_t ops_since_refresh = 0;
+        uint32_t idle_rounds = 0;
+
+        while (!stop_) {
+            bool ran = false;
+            for (uint32_t client = 0; client < num_clients_; ++client) {
+                ring_t &from = ring(partition, client);
+                // Drain what this client has sent so far, then move on to the next one.
+                for (Message *message = from.Front(); message; message = from.Front()) {
+                    message->op(store_, message->arg);
+                    from.Pop();
+                    ran = true;
+                    if (++ops_since_refresh >= kRefreshInterval) {
+                        store_.Refresh();
+                        ops_since_refresh = 0;
+                    }
+                }
+            }
+            if (store_.NumPendingRequests() >= kMaxPendingRequests ||
+                (!ran && (store_.NumPendingRequests() > 0 || store_.SessionPhase() != Phase::REST))) {
+                store_.CompletePending(false);
+                ops_since_refresh = 0;
+            }
+            if (ran) {
+                idle_rounds = 0;
+                continue;
+            }
+
+            // Idle; keep the session (and with it, the epoch) moving.
+            store_.Refresh();
+            if (++idle_rounds < 64) {
+                std::this_thread::yield();
+            } else {
+                std::this_thread::sleep_for(std::chrono::microseconds{50});
+            }
+        }
+        // Run whatever was sent before the executor was destroyed.
+        for (uint32_t client = 0; client < num_clients_; ++client) {
+            ring_t &from = ring(partition, client);
+            for (Message *message = from.Front(); message; message = from.Front()) {
+                message->op(store_, message->arg);
+                from.Pop();
+            }
+        }
+        store_.StopSession();
+    }
+
+    store_t &store_;
+    uint32_t num_partitions_;
+    uint32_t num_clients_;
+    /// Ring from client c to the owner of partition p is rings_[p * num_clients_ + c]. (The rings
+    /// are cache-line aligned, like per-thread structures.)
+    PerThreadArray<ring_t> rings_;
+    PerThreadArray<Owner> owners_;
+    std::atomic<bool> stop_;
+};
+
+}
+} // namespace FASTER::core
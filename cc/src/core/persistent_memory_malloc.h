@@ -3,12 +3,14 @@
 
 #pragma once
 
+#include <algorithm>
 #include <atomic>
 #include <cassert>
 #include <cstdint>
 #include <cstring>
 #include <mutex>
 #include <thread>
+#include <vector>
 
 #include "device/file_system_disk.h"
 #include "address.h"
@@ -121,6 +123,43 @@ struct FullPageStatus {
 
 static_assert(sizeof(FullPageStatus) == 16, "sizeof(FullPageStatus) != 16");
 
+/// Which segments of a page have been written since they were last copied to a delta checkpoint.
+/// A page is split into kNumSegments segments of kSegmentSize bytes, one bit each.
+struct DirtySegments {
+    static constexpr uint32_t kSegmentBits = 16;
+    static constexpr uint32_t kSegmentSize = (uint32_t) 1 << kSegmentBits;
+    static constexpr uint32_t kNumSegments = (Address::kMaxOffset + 1) >> kSegmentBits;
+    static constexpr uint32_t kNumWords = kNumSegments / 64;
+
+    DirtySegments() {
+        Clear();
+    }
+
+    inline void Mark(uint32_t segment) {
+        uint64_t mask = (uint64_t) 1 << (segment % 64);
+        std::atomic<uint64_t> &word = words[segment / 64];
+        // Most writes hit a segment that is already dirty; don't bounce the cache line for those.
+        if ((word.load(std::memory_order_relaxed) & mask) == 0) {
+            word.fetch_or(mask);
+        }
+    }
+
+    /// Clears the segment's bit; returns whether it was set.
+    inline bool TestAndClear(uint32_t segment) {
+        uint64_t mask = (uint64_t) 1 << (segment % 64);
+        std::atomic<uint64_t> &word = words[segment / 64];
+        return (word.load(std::memory_order_relaxed) & mask) != 0 && (word.fetch_and(~mask) & mask) != 0;
+    }
+
+    inline void Clear() {
+        for (uint32_t idx = 0; idx < kNumWords; ++idx) {
+            words[idx].store(0);
+        }
+    }
+
+    std::atomic<uint64_t> words[kNumWords];
+};
+
 /// Page and offset of the tail of the log. Can reserve space within the current page or move to a
 /// new page.
 class PageOffset {
@@ -254,7 +293,9 @@ public:
               read_only_address{start_address}, safe_read_only_address{start_address},
               head_address{start_address}, safe_head_address{start_address},
               flushed_until_address{start_address}, begin_address{start_address}, gc_address{start_address},
-              tail_page_offset_{start_address}, buffer_size_{0}, pages_{nullptr}, page_status_{nullptr} {
+              tail_page_offset_{start_address}, buffer_size_{0}, pre_allocate_log_{false}, pages_{nullptr},
+              page_status_{nullptr},
+              dirty_segments_{nullptr} {
         assert(start_address.page() <= Address::kMaxPage);
 
         if (log_size % kPageSize != 0) {
@@ -283,6 +324,7 @@ public:
         }
 
         page_status_ = new FullPageStatus[buffer_size_];
+        dirty_segments_ = new DirtySegments[buffer_size_];
 
         PageOffset tail_page_offset = tail_page_offset_.load();
         AllocatePage(tail_page_offset.page());
@@ -323,6 +365,9 @@ public:
         if (page_status_) {
             delete[] page_status_;
         }
+        if (dirty_segments_) {
+            delete[] dirty_segments_;
+        }
     }
 
     inline const uint8_t *Page(uint32_t page) const {
@@ -369,6 +414,17 @@ public:
         return Page(address.page()) + address.offset();
     }
 
+    /// Records that [address, address + size) was written. Call after the write, so that a delta
+    /// checkpoint that clears the bit meanwhile is followed by one that sees it set again.
+    inline void MarkDirty(Address address, uint32_t size) {
+        DirtySegments &dirty = dirty_segments_[address.page() % buffer_size_];
+        uint32_t last_segment = (address.offset() + std::max(size, 1u) - 1) >> DirtySegments::kSegmentBits;
+        for (uint32_t segment = address.offset() >> DirtySegments::kSegmentBits;
+             segment <= std::min(last_segment, DirtySegments::kNumSegments - 1); ++segment) {
+            dirty.Mark(segment);
+        }
+    }
+
     /// Key function used to allocate memory for a specified number of items. If the current page is
     /// full, returns Address::kInvalidAddress and sets closed_page to the current page index. The
     /// caller should Refresh() the epoch and call NewPage() until successful, before trying to
@@ -489,6 +545,15 @@ public:
     Status AsyncFlushPagesToFile(uint32_t start_page, Address until_address, file_t &file,
                                  std::atomic<uint32_t> &flush_pending);
 
+    /// Delta checkpoints: clears the dirty bits of the segments in [from_address, until_address), and
+    /// appends the (start addresses of the) ones that were set to "segments".
+    void CollectDirtySegments(Address from_address, Address until_address, std::vector<Address> &segments);
+
+    /// Writes segments[idx] to "file" at offset (file_start_idx + idx) * kSegmentSize, for every idx
+    /// in [0, num_segments); decrements "flush_pending" once per completed write.
+    Status AsyncFlushSegmentsToFile(const Address *segments, uint32_t num_segments, uint32_t file_start_idx,
+                                    file_t &file, std::atomic<uint32_t> &flush_pending);
+
     /// Recovery.
     Status AsyncReadPagesFromLog(uint32_t start_page, uint32_t num_pages,
                                  RecoveryStatus &recovery_status);
@@ -579,6 +644,9 @@ private:
     // Array that indicates the status of each buffer page
     FullPageStatus *page_status_;
 
+    // Dirty segments of each buffer page, for delta checkpoints
+    DirtySegments *dirty_segments_;
+
     // Global address of the current tail (next element to be allocated from the circular buffer)
     AtomicPageOffset tail_page_offset_;
 
@@ -711,6 +779,7 @@ void PersistentMemoryMalloc<D>::OnPagesClosed(IAsyncContext *ctxt) {
                 // We closed the page after it was flushed, so we are responsible for clearing and
                 // reopening it.
                 std::memset(context->allocator->Page(idx), 0, kPageSize);
+                context->allocator->dirty_segments_[idx % context->allocator->buffer_size_].Clear();
                 context->allocator->PageStatus(idx).status.store(FlushStatus::Flushed, CloseStatus::Open);
                 //aligned_free(context->allocator->Page(idx));
             }
@@ -773,6 +842,7 @@ Status PersistentMemoryMalloc<D>::AsyncFlushPages(uint32_t start_page, Address u
             // We finished flushing the page after it was closed, so we are responsible for clearing and
             // reopening it.
             std::memset(context->allocator->Page(context->page), 0, kPageSize);
+            context->allocator->dirty_segments_[context->page % context->allocator->buffer_size_].Clear();
             context->allocator->PageStatus(context->page).status.store(FlushStatus::Flushed,
                                                                        CloseStatus::Open);
         }
@@ -855,6 +925,73 @@ Status PersistentMemoryMalloc<D>::AsyncFlushPagesToFile(uint32_t start_page, Add
     return Status::Ok;
 }
 
+template<class D>
+void PersistentMemoryMalloc<D>::CollectDirtySegments(Address from_address, Address until_address,
+                                                     std::vector<Address> &segments) {
+    uint16_t h = until_address.h();
+    for (uint32_t page = from_address.page(); page <= until_address.page(); ++page) {
+        DirtySegments &dirty = dirty_segments_[page % buffer_size_];
+        uint32_t begin_segment = page == from_address.page() ?
+                                 from_address.offset() >> DirtySegments::kSegmentBits : 0;
+        uint32_t end_segment = page == until_address.page() ?
+                               (until_address.offset() + DirtySegments::kSegmentSize - 1) >>
+                                                                                        DirtySegments::kSegmentBits :
+                               DirtySegments::kNumSegments;
+        for (uint32_t segment = begin_segment; segment < end_segment; ++segment) {
+            if (dirty.TestAndClear(segment)) {
+                segments.push_back(Address{page, segment << DirtySegments::kSegmentBits, h});
+            }
+        }
+    }
+}
+
+template<class D>
+Status PersistentMemoryMalloc<D>::AsyncFlushSegmentsToFile(const Address *segments, uint32_t num_segments,
+                                                           uint32_t file_start_idx, file_t &file,
+                                                           std::atomic<uint32_t> &flush_pending) {
+    class Context : public IAsyncContext {
+    public:
+        Context(std::atomic<uint32_t> &flush_pending_)
+                : flush_pending{flush_pending_} {
+        }
+
+        /// The deep-copy constructor
+        Context(Context &other)
+                : flush_pending{other.flush_pending} {
+        }
+
+    protected:
+        Status DeepCopy_Internal(IAsyncContext *&context_copy) final {
+            return IAsyncContext::DeepCopy_Internal(*this, context_copy);
+        }
+
+    public:
+        std::atomic<uint32_t> &flush_pending;
+    };
+
+    auto callback = [](IAsyncContext *ctxt, Status result, size_t bytes_transferred) {
+        CallbackContext<Context> context{ctxt};
+        if (result != Status::Ok) {
+            fprintf(stderr, "AsyncFlushSegmentsToFile(), error: %u\n", static_cast<uint8_t>(result));
+        }
+        assert(context->flush_pending > 0);
+        --context->flush_pending;
+    };
+
+    for (uint32_t idx = 0; idx < num_segments; ++idx) {
+        Context context{flush_pending};
+        Status result = file.WriteAsync(Get(segments[idx]),
+                                        static_cast<uint64_t>(file_start_idx + idx) * DirtySegments::kSegmentSize,
+                                        DirtySegments::kSegmentSize, callback, context);
+        if (result != Status::Ok) {
+            // The writes that were not issued will not complete, either.
+            flush_pending -= num_segments - idx;
+            return result;
+        }
+    }
+    return Status::Ok;
+}
+
 template<class D>
 Status PersistentMemoryMalloc<D>::AsyncReadPagesFromLog(uint32_t start_page, uint32_t num_pages,
                                                         RecoveryStatus &recovery_status) {
@@ -876,13 +1013,13 @@ Status PersistentMemoryMalloc<D>::AsyncReadPages(F &read_file, uint32_t file_sta
                                                  RecoveryStatus &recovery_status) {
     class Context : public IAsyncContext {
     public:
-        Context(std::atomic<PageRecoveryStatus> &page_status_)
-                : page_status{&page_status_} {
+        Context(RecoveryStatus &recovery_status_, uint32_t page_)
+                : recovery_status{&recovery_status_}, page{page_} {
         }
 
         /// The deep-copy constructor
         Context(const Context &other)
-                : page_status{other.page_status} {
+                : recovery_status{other.recovery_status}, page{other.page} {
         }
 
     protected:
@@ -891,7 +1028,8 @@ Status PersistentMemoryMalloc<D>::AsyncReadPages(F &read_file, uint32_t file_sta
         }
 
     public:
-        std::atomic<PageRecoveryStatus> *page_status;
+        RecoveryStatus *recovery_status;
+        uint32_t page;
     };
 
     auto callback = [](IAsyncContext *ctxt, Status result, size_t bytes_transferred) {
@@ -899,8 +1037,8 @@ Status PersistentMemoryMalloc<D>::AsyncReadPages(F &read_file, uint32_t file_sta
         if (result != Status::Ok) {
             fprintf(stderr, "Error: %u\n", static_cast<uint8_t>(result));
         }
-        assert(context->page_status->load() == PageRecoveryStatus::IssuedRead);
-        context->page_status->store(PageRecoveryStatus::ReadDone);
+        assert(context->recovery_status->page_status(context->page) == PageRecoveryStatus::IssuedRead);
+        context->recovery_status->Set(context->page, PageRecoveryStatus::ReadDone);
     };
 
     for (uint32_t read_page = start_page; read_page < start_page + num_pages; ++read_page) {
@@ -914,7 +1052,7 @@ Status PersistentMemoryMalloc<D>::AsyncReadPages(F &read_file, uint32_t file_sta
         assert(recovery_status.page_status(read_page) == PageRecoveryStatus::NotStarted);
         recovery_status.page_status(read_page).store(PageRecoveryStatus::IssuedRead);
         PageStatus(read_page).LastFlushedUntilAddress.store(Address{read_page + 1, 0});
-        Context context{recovery_status.page_status(read_page)};
+        Context context{recovery_status, read_page};
         RETURN_NOT_OK(read_file.ReadAsync(kPageSize * (read_page - file_start_page), Page(read_page),
                                           kPageSize, callback, context));
     }
@@ -926,14 +1064,15 @@ Status PersistentMemoryMalloc<D>::AsyncFlushPage(uint32_t page, RecoveryStatus &
                                                  AsyncCallback caller_callback, IAsyncContext *caller_context) {
     class Context : public IAsyncContext {
     public:
-        Context(std::atomic<PageRecoveryStatus> &page_status_, AsyncCallback caller_callback_,
+        Context(RecoveryStatus &recovery_status_, uint32_t page_, AsyncCallback caller_callback_,
                 IAsyncContext *caller_context_)
-                : page_status{&page_status_}, caller_callback{caller_callback_}, caller_context{caller_context_} {
+                : recovery_status{&recovery_status_}, page{page_}, caller_callback{caller_callback_},
+                  caller_context{caller_context_} {
         }
 
         /// The deep-copy constructor
         Context(const Context &other, IAsyncContext *caller_context_copy)
-                : page_status{other.page_status}, caller_callback{other.caller_callback},
+                : recovery_status{other.recovery_status}, page{other.page}, caller_callback{other.caller_callback},
                   caller_context{caller_context_copy} {
         }
 
@@ -947,7 +1086,8 @@ Status PersistentMemoryMalloc<D>::AsyncFlushPage(uint32_t page, RecoveryStatus &
         }
 
     public:
-        std::atomic<PageRecoveryStatus> *page_status;
+        RecoveryStatus *recovery_status;
+        uint32_t page;
         AsyncCallback caller_callback;
         IAsyncContext *caller_context;
     };
@@ -957,8 +1097,8 @@ Status PersistentMemoryMalloc<D>::AsyncFlushPage(uint32_t page, RecoveryStatus &
         if (result != Status::Ok) {
             fprintf(stderr, "Error: %u\n", static_cast<uint8_t>(result));
         }
-        assert(context->page_status->load() == PageRecoveryStatus::IssuedFlush);
-        context->page_status->store(PageRecoveryStatus::FlushDone);
+        assert(context->recovery_status->page_status(context->page) == PageRecoveryStatus::IssuedFlush);
+        context->recovery_status->Set(context->page, PageRecoveryStatus::FlushDone);
         if (context->caller_callback) {
             context->caller_callback(context->caller_context, result);
         }
@@ -967,7 +1107,7 @@ Status PersistentMemoryMalloc<D>::AsyncFlushPage(uint32_t page, RecoveryStatus &
     assert(recovery_status.page_status(page) == PageRecoveryStatus::ReadDone);
     recovery_status.page_status(page).store(PageRecoveryStatus::IssuedFlush);
     PageStatus(page).LastFlushedUntilAddress.store(Address{page + 1, 0});
-    Context context{recovery_status.page_status(page), caller_callback, caller_context};
+    Context context{recovery_status, page, caller_callback, caller_context};
     return file->WriteAsync(Page(page), kPageSize * page, kPageSize, callback, context);
 }
 
@@ -4,7 +4,10 @@
 #pragma once
 
 #include <atomic>
+#include <chrono>
+#include <condition_variable>
 #include <cstdint>
+#include <mutex>
 
 namespace FASTER {
 namespace core {
@@ -30,7 +33,7 @@ public:
     }
 
     ~RecoveryStatus() {
-        delete page_status_;
+        delete[] page_status_;
     }
 
     const std::atomic<PageRecoveryStatus> &page_status(uint32_t page) const {
@@ -45,11 +48,31 @@ public:
         return page_status_[page - start_page];
     }
 
+    /// Moves "page" to "status", and wakes up any thread waiting for that.
+    void Set(uint32_t page, PageRecoveryStatus status) {
+        {
+            std::lock_guard<std::mutex> lock{mutex_};
+            page_status(page).store(status);
+        }
+        changed_.notify_all();
+    }
+
+    /// Waits until "page" reaches "status", or "timeout" expires. Returns true if it did.
+    template<class R, class P>
+    bool WaitFor(uint32_t page, PageRecoveryStatus status, std::chrono::duration<R, P> timeout) {
+        std::unique_lock<std::mutex> lock{mutex_};
+        return changed_.wait_for(lock, timeout, [&]() {
+            return page_status(page).load() == status;
+        });
+    }
+
     uint32_t start_page;
     uint32_t end_page;
 
 private:
     std::atomic<PageRecoveryStatus> *page_status_;
+    std::mutex mutex_;
+    std::condition_variable changed_;
 };
 
 }
@@ -0,0 +1,975 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT license.
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "address.h"
+#include "alloc.h"
+#include "async.h"
+#include "checkpoint_state.h"
+#include "guid.h"
+#include "light_epoch.h"
+#include "record.h"
+#include "status.h"
+#include "../environment/socket.h"
+
+namespace FASTER {
+namespace core {
+
+/// Log shipping: a primary store's LogShipper streams the flushed part of each of its logs, plus
+/// checkpoint markers, to a LogFollower in another process. Every message is a ReplicationHeader
+/// followed by "length" bytes of payload, in the primary's byte order (so both ends must run on
+/// the same architecture).
+enum class ReplicationMessage : uint32_t {
+    /// Shipper -> follower, on connecting; "lane" is the number of logs.
+    Hello = 0,
+    /// Follower -> shipper, in reply: where each log resumes (one address per log; 0 for "from its
+    /// begin address").
+    Resume,
+    /// Bytes of log "lane", starting at "address".
+    LogData,
+    /// The log shipped so far covers checkpoint version "address". Payload: its token, then where
+    /// each log ends for it.
+    Checkpoint,
+    /// Ends a batch; "address" is its sequence number.
+    BatchEnd,
+    /// Follower -> shipper: the batches up to sequence number "address" are on the follower's disk.
+    Ack
+};
+
+struct ReplicationHeader {
+    ReplicationMessage type;
+    uint32_t lane;
+    uint64_t address;
+    uint64_t length;
+};
+static_assert(sizeof(ReplicationHeader) == 24, "sizeof(ReplicationHeader) != 24");
+/// (Checkpoint tokens go over the wire as is.)
+static_assert(sizeof(Guid) == 16, "sizeof(Guid) != 16");
+
+/// Number of log bytes in [from_address, until_address), which must be addresses in the same log.
+inline uint64_t LogBytesBetween(Address from_address, Address until_address) {
+    return (static_cast<uint64_t>(until_address.page()) - from_address.page()) * (Address::kMaxOffset + 1) +
+           until_address.offset() - from_address.offset();
+}
+
+/// The address "bytes" past "address", in the same log.
+inline Address LogAddressAfter(Address address, uint64_t bytes) {
+    uint64_t offset = address.offset() + bytes;
+    return Address{address.page() + static_cast<uint32_t>(offset >> Address::kOffsetBits),
+                   static_cast<uint32_t>(offset & Address::kMaxOffset), address.h()};
+}
+
+struct ReplicationOptions {
+    /// How often the shipper looks for newly flushed log.
+    std::chrono::milliseconds poll_interval{1};
+    /// A batch carries at most this many log bytes.
+    uint32_t max_batch_bytes = 4 << 20;
+    /// The shipper holds off once this many batches are waiting to be acked.
+    uint32_t max_unacked_batches = 4;
+};
+
+struct ReplicationStats {
+    uint64_t batches;
+    uint64_t batches_acked;
+    uint64_t log_bytes;
+    uint64_t checkpoints;
+};
+
+/// A checkpoint, as the follower learned of it.
+struct ReplicatedCheckpoint {
+    Guid token;
+    uint32_t version;
+    /// Where each log ends, for this checkpoint.
+    std::vector<Address> until_addresses;
+};
+
+/// The primary's end: a background thread ships each log from where the follower left off up to
+/// its flushed-until address, in batches of up to max_batch_bytes, with up to
+/// max_unacked_batches in flight. Log still in memory is copied from there, and log evicted before
+/// it could be shipped is read back from the log file; so a follower that has fallen behind
+/// catches up, as long as the primary has not truncated the log it needs.
+template<class S>
+class LogShipper {
+public:
+    typedef S store_t;
+
+    LogShipper(store_t &store, const ReplicationOptions &options = ReplicationOptions{})
+            : store_{store}, options_{options}, num_lanes_{0}, next_lane_{0}, stop_{false}, status_{Status::Ok},
+              num_markers_{0}, stats_{} {
+    }
+
+    ~LogShipper() {
+        Stop();
+    }
+
+    // No copy constructor.
+    LogShipper(const LogShipper &other) = delete;
+
+    /// Connects to the follower listening at "endpoint", and starts shipping.
+    Status Start(const std::string &endpoint) {
+        RETURN_NOT_OK(socket_.Connect(endpoint));
+        num_lanes_ = store_.NumPartitions();
+        ReplicationHeader hello{ReplicationMessage::Hello, num_lanes_, 0, 0};
+        RETURN_NOT_OK(socket_.Send(&hello, sizeof(hello)));
+        ReplicationHeader resume;
+        RETURN_NOT_OK(socket_.Receive(&resume, sizeof(resume)));
+        if (resume.type != ReplicationMessage::Resume || resume.length != num_lanes_ * sizeof(uint64_t)) {
+            return Status::Corruption;
+        }
+        std::vector<uint64_t> resume_addresses(num_lanes_);
+        RETURN_NOT_OK(socket_.Receive(resume_addresses.data(), resume.length));
+
+        shipped_.clear();
+        for (uint32_t lane = 0; lane < num_lanes_; ++lane) {
+            Address address{resume_addresses[lane]};
+            if (address == Address{0}) {
+                address = store_.LogBeginAddress(lane);
+            } else if (address.h() != lane) {
+                return Status::Corruption;
+            }
+            shipped_.push_back(address);
+        }
+        {
+            std::lock_guard<std::mutex> lock{mutex_};
+            acked_ = shipped_;
+            stop_ = false;
+            status_ = Status::Ok;
+        }
+        thread_ = std::thread{&LogShipper::Run, this};
+        return Status::Ok;
+    }
+
+    /// Stops shipping and disconnects; batches not acked yet may or may not have reached the
+    /// follower's disk.
+    void Stop() {
+        {
+            std::lock_guard<std::mutex> lock{mutex_};
+            stop_ = true;
+        }
+        stop_cv_.notify_all();
+        if (thread_.joinable()) {
+            thread_.join();
+        }
+        socket_.Close();
+    }
+
+    /// Ships a marker for checkpoint "token" (at "version") right after the log flushed as of now.
+    /// Call once the checkpoint has completed (CheckpointCheck()), so that this log covers it.
+    void MarkCheckpoint(const Guid &token, uint32_t version) {
+        ReplicatedCheckpoint marker{token, version, {}};
+        for (uint32_t lane = 0; lane < store_.NumPartitions(); ++lane) {
+            marker.until_addresses.push_back(store_.FlushedUntilAddress(lane));
+        }
+        std::lock_guard<std::mutex> lock{mutex_};
+        markers_.push_back(marker);
+        ++num_markers_;
+    }
+
+    /// True once the follower has acked all of the log flushed as of now, and every marker.
+    bool CaughtUp() const {
+        std::lock_guard<std::mutex> lock{mutex_};
+        if (acked_.empty() || stats_.checkpoints < num_markers_ || !markers_.empty()) {
+            return false;
+        }
+        for (uint32_t lane = 0; lane < num_lanes_; ++lane) {
+            if (acked_[lane] < store_.FlushedUntilAddress(lane)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    /// How far the follower has acked log "lane".
+    Address AckedUntil(uint32_t lane) const {
+        std::lock_guard<std::mutex> lock{mutex_};
+        return acked_[lane];
+    }
+
+    /// Shipping stops at the first error.
+    Status status() const {
+        std::lock_guard<std::mutex> lock{mutex_};
+        return status_;
+    }
+
+    /// (Here "checkpoints" counts the markers acked.)
+    ReplicationStats GetStats() const {
+        std::lock_guard<std::mutex> lock{mutex_};
+        return stats_;
+    }
+
+private:
+    /// A batch waiting to be acked.
+    struct InFlightBatch {
+        uint64_t sequence;
+        std::vector<Address> until_addresses;
+        uint32_t num_markers;
+    };
+
+    void Run() {
+        std::deque<InFlightBatch> in_flight;
+        std::vector<uint8_t> batch;
+        uint64_t sequence = 0;
+        Status result = Status::Ok;
+        while (result == Status::Ok) {
+            {
+                std::lock_guard<std::mutex> lock{mutex_};
+                if (stop_) {
+                    return;
+                }
+            }
+            // With the window full, wait (a little) for an ack.
+            bool window_full = in_flight.size() >= options_.max_unacked_batches;
+            result = ReceiveAcks(in_flight, window_full ? static_cast<uint32_t>(options_.poll_interval.count()) : 0);
+            if (result != Status::Ok || window_full) {
+                continue;
+            }
+
+            uint32_t num_markers;
+            result = BuildBatch(batch, sequence + 1, num_markers);
+            if (result == Status::Pending) {
+                // Nothing new was flushed.
+                result = Status::Ok;
+                std::unique_lock<std::mutex> lock{mutex_};
+                stop_cv_.wait_for(lock, options_.poll_interval, [this]() {
+                    return stop_;
+                });
+                continue;
+            }
+            if (result == Status::Ok) {
+                result = socket_.Send(batch.data(), batch.size());
+            }
+            if (result == Status::Ok) {
+                in_flight.push_back(InFlightBatch{++sequence, shipped_, num_markers});
+                std::lock_guard<std::mutex> lock{mutex_};
+                ++stats_.batches;
+            }
+        }
+        std::lock_guard<std::mutex> lock{mutex_};
+        status_ = result;
+    }
+
+    Status ReceiveAcks(std::deque<InFlightBatch> &in_flight, uint32_t timeout_ms) {
+        while (!in_flight.empty()) {
+            Status result = socket_.Poll(timeout_ms);
+            if (result == Status::Pending) {
+                return Status::Ok;
+            }
+            RETURN_NOT_OK(result);
+            ReplicationHeader ack;
+            RETURN_NOT_OK(socket_.Receive(&ack, sizeof(ack)));
+            if (ack.type != ReplicationMessage::Ack) {
+                return Status::Corruption;
+            }
+            std::lock_guard<std::mutex> lock{mutex_};
+            while (!in_flight.empty() && in_flight.front().sequence <= ack.address) {
+                acked_ = in_flight.front().until_addresses;
+                stats_.checkpoints += in_flight.front().num_markers;
+                ++stats_.batches_acked;
+                in_flight.pop_front();
+            }
+            timeout_ms = 0;
+        }
+        return Status::Ok;
+    }
+
+    /// Returns Status::Pending if there is nothing to ship.
+    Status BuildBatch(std::vector<uint8_t> &batch, uint64_t sequence, uint32_t &num_markers) {
+        batch.clear();
+        num_markers = 0;
+        uint64_t budget = options_.max_batch_bytes;
+        uint64_t log_bytes = 0;
+        // Start at a different log each time, so that none of them starves when the budget runs out.
+        for (uint32_t idx = 0; idx < num_lanes_ && budget > 0; ++idx) {
+            uint32_t lane = (next_lane_ + idx) % num_lanes_;
+            Address from_address = shipped_[lane];
+            Address until_address = store_.FlushedUntilAddress(lane);
+            if (until_address <= from_address) {
+                continue;
+            }
+            uint64_t length = std::min(LogBytesBetween(from_address, until_address), budget);
+            until_address = LogAddressAfter(from_address, length);
+            size_t offset = Append(batch, ReplicationHeader{ReplicationMessage::LogData, lane,
+                                                           from_address.control(), length});
+            batch.resize(offset + length);
+            RETURN_NOT_OK(store_.CopyFlushedLog(lane, from_address, until_address, batch.data() + offset));
+            shipped_[lane] = until_address;
+            budget -= length;
+            log_bytes += length;
+        }
+        next_lane_ = (next_lane_ + 1) % std::max(num_lanes_, 1u);
+
+        {
+            // Markers go out once all of the log they cover has.
+            std::lock_guard<std::mutex> lock{mutex_};
+            while (!markers_.empty()) {
+                const ReplicatedCheckpoint &marker = markers_.front();
+                bool covered = true;
+                for (uint32_t lane = 0; lane < num_lanes_; ++lane) {
+                    covered = covered && marker.until_addresses[lane] <= shipped_[lane];
+                }
+                if (!covered) {
+                    break;
+                }
+                size_t offset = Append(batch, ReplicationHeader{ReplicationMessage::Checkpoint, num_lanes_,
+                                                               marker.version,
+                                                               sizeof(Guid) + num_lanes_ * sizeof(uint64_t)});
+                batch.resize(offset + sizeof(Guid) + num_lanes_ * sizeof(uint64_t));
+                std::memcpy(batch.data() + offset, &marker.token, sizeof(Guid));
+                for (uint32_t lane = 0; lane < num_lanes_; ++lane) {
+                    uint64_t control = marker.until_addresses[lane].control();
+                    std::memcpy(batch.data() + offset + sizeof(Guid) + lane * sizeof(uint64_t), &control,
+                                sizeof(control));
+                }
+                markers_.pop_front();
+                ++num_markers;
+            }
+            stats_.log_bytes += log_bytes;
+        }
+        if (batch.empty()) {
+            return Status::Pending;
+        }
+        Append(batch, ReplicationHeader{ReplicationMessage::BatchEnd, 0, sequence, 0});
+        return Status::Ok;
+    }
+
+    /// Appends "header" to "batch"; returns where its payload goes.
+    static size_t Append(std::vector<uint8_t> &batch, const ReplicationHeader &header) {
+        size_t offset = batch.size();
+        batch.resize(offset + sizeof(header));
+        std::memcpy(batch.data() + offset, &header, sizeof(header));
+        return offset + sizeof(header);
+    }
+
+    store_t &store_;
+    ReplicationOptions options_;
+    environment::Socket socket_;
+    uint32_t num_lanes_;
+    /// (Owned by the shipping thread.)
+    std::vector<Address> shipped_;
+    uint32_t next_lane_;
+
+    mutable std::mutex mutex_;
+    std::condition_variable stop_cv_;
+    bool stop_;
+    Status status_;
+    std::vector<Address> acked_;
+    std::deque<ReplicatedCheckpoint> markers_;
+    uint64_t num_markers_;
+    ReplicationStats stats_;
+
+    std::thread thread_;
+};
+
+/// The follower's end: listens for a primary, and writes the log it ships to the same offsets of
+/// this follower's own log files (under "root_path", which must exist), so that they mirror the
+/// primary's. A batch is acked once it is on disk; a checkpoint marker is published (see
+/// LastCheckpoint()) once the log it covers is. If the primary reconnects, shipping resumes where
+/// it left off.
+///
+/// Every record carries its key, so the shipped log is enough to build an index from: pass an
+/// "apply" callback, which sees each range of log as it arrives, to a LogReplayer.
+template<class D>
+class LogFollower {
+public:
+    typedef D disk_t;
+    typedef std::function<void(uint32_t lane, Address address, const uint8_t *data, uint32_t length)>
+            apply_callback_t;
+
+    LogFollower(const std::string &root_path, apply_callback_t apply_callback = nullptr)
+            : epoch_{}, disk_{root_path, epoch_}, apply_callback_{apply_callback}, num_lanes_{0}, stop_{false},
+              status_{Status::Ok}, has_checkpoint_{false}, pending_writes_{0}, write_status_{Status::Ok},
+              stats_{} {
+        lanes_.resize(kMaxLanes);
+        for (auto &lane : lanes_) {
+            lane.tail_sector.resize(disk_.sector_size());
+        }
+    }
+
+    ~LogFollower() {
+        Stop();
+    }
+
+    // No copy constructor.
+    LogFollower(const LogFollower &other) = delete;
+
+    /// Listens at "endpoint"; a background thread then serves one primary at a time.
+    Status Start(const std::string &endpoint) {
+        RETURN_NOT_OK(listener_.Listen(endpoint));
+        stop_ = false;
+        thread_ = std::thread{&LogFollower::Run, this};
+        return Status::Ok;
+    }
+
+    void Stop() {
+        stop_ = true;
+        if (thread_.joinable()) {
+            thread_.join();
+        }
+        listener_.Close();
+    }
+
+    /// The listening socket (for its port()).
+    const environment::Socket &listener() const {
+        return listener_;
+    }
+
+    /// Log "lane" is on this follower's disk up to here; 0 if none of it is yet.
+    Address AppliedUntil(uint32_t lane) const {
+        std::lock_guard<std::mutex> lock{mutex_};
+        return lanes_[lane].applied_until;
+    }
+
+    /// The latest checkpoint whose log is all on this follower's disk; false if there is none yet.
+    bool LastCheckpoint(ReplicatedCheckpoint &checkpoint) const {
+        std::lock_guard<std::mutex> lock{mutex_};
+        if (has_checkpoint_) {
+            checkpoint = last_checkpoint_;
+        }
+        return has_checkpoint_;
+    }
+
+    /// How the last connection ended: Status::Aborted if the primary disconnected.
+    Status status() const {
+        std::lock_guard<std::mutex> lock{mutex_};
+        return status_;
+    }
+
+    ReplicationStats GetStats() const {
+        std::lock_guard<std::mutex> lock{mutex_};
+        return stats_;
+    }
+
+    disk_t &disk() {
+        return disk_;
+    }
+
+private:
+    /// As many logs as the disk has.
+    static constexpr uint32_t kMaxLanes = LogMetadata::kNumTlogs;
+    static constexpr uint64_t kPageSize = Address::kMaxOffset + 1;
+    static constexpr uint32_t kPollIntervalMs = 10;
+
+    struct Lane {
+        /// On disk (under mutex_).
+        Address applied_until;
+        /// Written or being written.
+        Address issued_until;
+        /// End of the last write issued, as a file offset.
+        uint64_t issued_until_offset = 0;
+        /// Writes are whole sectors: the last, partial sector written, to start the next write.
+        std::vector<uint8_t> tail_sector;
+    };
+
+    class WriteContext : public IAsyncContext {
+    public:
+        WriteContext(LogFollower *follower_, void *buffer_)
+                : follower{follower_}, buffer{buffer_} {
+        }
+
+        /// The deep-copy constructor.
+        WriteContext(const WriteContext &other)
+                : follower{other.follower}, buffer{other.buffer} {
+        }
+
+    protected:
+        Status DeepCopy_Internal(IAsyncContext *&context_copy) final {
+            return IAsyncContext::DeepCopy_Internal(*this, context_copy);
+        }
+
+    public:
+        LogFollower *follower;
+        void *buffer;
+    };
+
+    static void WriteCallback(IAsyncContext *ctxt, Status result, size_t bytes_transferred) {
+        CallbackContext<WriteContext> context{ctxt};
+        aligned_free(context->buffer);
+        if (result != Status::Ok) {
+            context->follower->write_status_ = result;
+        }
+        --context->follower->pending_writes_;
+    }
+
+    void Run() {
+        epoch_.Protect();
+        while (!stop_) {
+            epoch_.ProtectAndDrain();
+            if (listener_.Poll(kPollIntervalMs) != Status::Ok) {
+                continue;
+            }
+            environment::Socket connection;
+            if (listener_.Accept(connection) != Status::Ok) {
+                continue;
+            }
+            Status result = Serve(connection);
+            // Whatever was written is on disk now.
+            Status write_result = WaitForWrites();
+            std::lock_guard<std::mutex> lock{mutex_};
+            for (uint32_t lane = 0; lane < num_lanes_; ++lane) {
+                lanes_[lane].applied_until = lanes_[lane].issued_until;
+            }
+            status_ = result != Status::Ok ? result : write_result;
+        }
+        epoch_.Unprotect();
+    }
+
+    Status Serve(environment::Socket &connection) {
+        ReplicationHeader hello;
+        RETURN_NOT_OK(ReceiveHeader(connection, hello));
+        if (hello.type != ReplicationMessage::Hello || hello.lane > kMaxLanes) {
+            return Status::Corruption;
+        }
+        if (num_lanes_ != 0 && hello.lane != num_lanes_) {
+            // A different store.
+            return Status::Corruption;
+        }
+        num_lanes_ = hello.lane;
+        std::vector<uint64_t> resume_addresses(num_lanes_);
+        for (uint32_t lane = 0; lane < num_lanes_; ++lane) {
+            resume_addresses[lane] = lanes_[lane].issued_until.control();
+        }
+        ReplicationHeader resume{ReplicationMessage::Resume, 0, 0, num_lanes_ * sizeof(uint64_t)};
+        RETURN_NOT_OK(connection.Send(&resume, sizeof(resume)));
+        RETURN_NOT_OK(connection.Send(resume_addresses.data(), resume.length));
+
+        std::vector<uint8_t> payload;
+        bool has_pending_checkpoint = false;
+        ReplicatedCheckpoint pending_checkpoint;
+        while (true) {
+            ReplicationHeader header;
+            RETURN_NOT_OK(ReceiveHeader(connection, header));
+            payload.resize(header.length);
+            RETURN_NOT_OK(connection.Receive(payload.data(), header.length));
+            switch (header.type) {
+                case ReplicationMessage::LogData:
+                    if (header.lane >= num_lanes_ || header.length > UINT32_MAX) {
+                        return Status::Corruption;
+                    }
+                    RETURN_NOT_OK(Apply(header.lane, Address{header.address}, payload.data(),
+                                        static_cast<uint32_t>(header.length)));
+                    break;
+                case ReplicationMessage::Checkpoint:
+                    if (header.lane != num_lanes_ || header.length != sizeof(Guid) + num_lanes_ * sizeof(uint64_t)) {
+                        return Status::Corruption;
+                    }
+                    pending_checkpoint.version = static_cast<uint32_t>(header.address);
+                    std::memcpy(&pending_checkpoint.token, payload.data(), sizeof(Guid));
+                    pending_checkpoint.until_addresses.clear();
+                    for (uint32_t lane = 0; lane < num_lanes_; ++lane) {
+                        uint64_t control;
+                        std::memcpy(&control, payload.data() + sizeof(Guid) + lane * sizeof(uint64_t),
+                                    sizeof(control));
+                        pending_checkpoint.until_addresses.push_back(Address{control});
+                    }
+                    has_pending_checkpoint = true;
+                    break;
+                case ReplicationMessage::BatchEnd: {
+                    RETURN_NOT_OK(WaitForWrites());
+                    {
+                        std::lock_guard<std::mutex> lock{mutex_};
+                        for (uint32_t lane = 0; lane < num_lanes_; ++lane) {
+                            lanes_[lane].applied_until = lanes_[lane].issued_until;
+                        }
+                        if (has_pending_checkpoint) {
+                            last_checkpoint_ = pending_checkpoint;
+                            has_checkpoint_ = true;
+                            has_pending_checkpoint = false;
+                            ++stats_.checkpoints;
+                        }
+                        ++stats_.batches;
+                    }
+                    ReplicationHeader ack{ReplicationMessage::Ack, 0, header.address, 0};
+                    RETURN_NOT_OK(connection.Send(&ack, sizeof(ack)));
+                    std::lock_guard<std::mutex> lock{mutex_};
+                    ++stats_.batches_acked;
+                    break;
+                }
+                default:
+                    return Status::Corruption;
+            }
+        }
+    }
+
+    /// Waits for the next message; Status::Aborted if asked to stop meanwhile.
+    Status ReceiveHeader(environment::Socket &connection, ReplicationHeader &header) {
+        Status result;
+        do {
+            if (stop_) {
+                return Status::Aborted;
+            }
+            epoch_.ProtectAndDrain();
+            result = connection.Poll(kPollIntervalMs);
+        } while (result == Status::Pending);
+        RETURN_NOT_OK(result);
+        return connection.Receive(&header, sizeof(header));
+    }
+
+    Status Apply(uint32_t lane_idx, Address address, const uint8_t *data, uint32_t length) {
+        Lane &lane = lanes_[lane_idx];
+        if (address.h() != lane_idx ||
+            (lane.issued_until != Address{0} && address != lane.issued_until)) {
+            // Not where this log left off.
+            return Status::Corruption;
+        }
+        if (apply_callback_) {
+            apply_callback_(lane_idx, address, data, length);
+        }
+        uint32_t sector_size = disk_.sector_size();
+        while (length > 0) {
+            // Pages map to the same offsets of the file as on the primary; a write never crosses one.
+            uint32_t chunk = static_cast<uint32_t>(std::min<uint64_t>(length, kPageSize - address.offset()));
+            uint64_t file_offset = address.page() * kPageSize + address.offset();
+            uint64_t begin_offset = file_offset & ~static_cast<uint64_t>(sector_size - 1);
+            uint32_t prefix = static_cast<uint32_t>(file_offset - begin_offset);
+            uint32_t write_length = (prefix + chunk + sector_size - 1) & ~(sector_size - 1);
+            if (begin_offset < lane.issued_until_offset) {
+                // This write rewrites the previous one's last sector; keep them in order.
+                RETURN_NOT_OK(WaitForWrites());
+            }
+
+            uint8_t *buffer = reinterpret_cast<uint8_t *>(aligned_alloc(sector_size, write_length));
+            if (!buffer) {
+                return Status::OutOfMemory;
+            }
+            std::memcpy(buffer, lane.tail_sector.data(), prefix);
+            std::memcpy(buffer + prefix, data, chunk);
+            std::memset(buffer + prefix + chunk, 0, write_length - prefix - chunk);
+            uint32_t tail = (prefix + chunk) % sector_size;
+            std::memcpy(lane.tail_sector.data(), buffer + prefix + chunk - tail, tail);
+
+            WriteContext context{this, buffer};
+            ++pending_writes_;
+            Status result = disk_.tlog(lane_idx).WriteAsync(buffer, begin_offset, write_length, WriteCallback,
+                                                             context);
+            if (result != Status::Ok) {
+                --pending_writes_;
+                aligned_free(buffer);
+                return result;
+            }
+            lane.issued_until_offset = begin_offset + write_length;
+            address = LogAddressAfter(address, chunk);
+            data += chunk;
+            length -= chunk;
+            {
+                std::lock_guard<std::mutex> lock{mutex_};
+                stats_.log_bytes += chunk;
+            }
+        }
+        lane.issued_until = address;
+        return Status::Ok;
+    }
+
+    Status WaitForWrites() {
+        while (pending_writes_ > 0) {
+            disk_.TryComplete();
+        }
+        Status result = write_status_;
+        write_status_ = Status::Ok;
+        return result;
+    }
+
+    LightEpoch epoch_;
+    disk_t disk_;
+    apply_callback_t apply_callback_;
+    environment::Socket listener_;
+    uint32_t num_lanes_;
+    /// (Owned by the serving thread, but for applied_until.)
+    std::vector<Lane> lanes_;
+    std::atomic<bool> stop_;
+
+    mutable std::mutex mutex_;
+    Status status_;
+    bool has_checkpoint_;
+    ReplicatedCheckpoint last_checkpoint_;
+    std::atomic<uint32_t> pending_writes_;
+    std::atomic<Status> write_status_;
+    ReplicationStats stats_;
+
+    std::thread thread_;
+};
+
+/// Keeps a follower's index: replays the log a LogFollower receives (pass Apply() as its "apply"
+/// callback) into a FasterKv "store" of the same key and value types, on a thread of its own that
+/// holds a session on the store. The store can serve reads meanwhile; once the follower and the
+/// replayer have been stopped, it can take over as the primary.
+///
+/// Every valid record is upserted (or, for a tombstone, deleted) in log order, which is each key's
+/// update order, since a key's records are all in one log. Values are copied byte for byte, and
+/// always to a new record, so that readers never see half a value.
+template<class S>
+class LogReplayer {
+public:
+    typedef S store_t;
+    typedef Record<typename S::key_t, typename S::value_t> record_t;
+
+    explicit LogReplayer(store_t &store)
+            : store_{store}, lanes_(kMaxLanes), stop_{false}, status_{Status::Ok}, num_records_{0},
+              serial_num_{0} {
+        thread_ = std::thread{&LogReplayer::Run, this};
+    }
+
+    ~LogReplayer() {
+        Stop();
+    }
+
+    // No copy constructor.
+    LogReplayer(const LogReplayer &other) = delete;
+
+    /// Queues log "lane" from "address" on for replay. Ranges of a log must follow one another.
+    void Apply(uint32_t lane, Address address, const uint8_t *data, uint32_t length) {
+        {
+            std::lock_guard<std::mutex> lock{mutex_};
+            chunks_.push_back(Chunk{lane, address, std::vector<uint8_t>(data, data + length)});
+        }
+        cv_.notify_all();
+    }
+
+    /// Replays whatever has been queued, then stops.
+    void Stop() {
+        {
+            std::lock_guard<std::mutex> lock{mutex_};
+            stop_ = true;
+        }
+        cv_.notify_all();
+        if (thread_.joinable()) {
+            thread_.join();
+        }
+    }
+
+    /// Log "lane" has been replayed into the store up to here; 0 if none of it has yet.
+    Address ReplayedUntil(uint32_t lane) const {
+        std::lock_guard<std::mutex> lock{mutex_};
+        return lanes_[lane].replayed_until;
+    }
+
+    uint64_t num_records() const {
+        std::lock_guard<std::mutex> lock{mutex_};
+        return num_records_;
+    }
+
+    /// The first error an upsert or delete hit, or Status::Corruption if a range did not follow on
+    /// from the previous one.
+    Status status() const {
+        std::lock_guard<std::mutex> lock{mutex_};
+        return status_;
+    }
+
+private:
+    static constexpr uint32_t kMaxLanes = LogMetadata::kNumTlogs;
+    /// How often an idle replayer refreshes its session.
+    static constexpr uint32_t kPollIntervalMs = 10;
+
+    struct Chunk {
+        uint32_t lane;
+        Address address;
+        std::vector<uint8_t> data;
+    };
+
+    struct Lane {
+        /// (Under mutex_.)
+        Address replayed_until;
+        /// Log from replayed_until on that does not hold a whole record yet.
+        std::vector<uint8_t> partial;
+    };
+
+    class ReplayUpsertContext : public IAsyncContext {
+    public:
+        typedef typename S::key_t key_t;
+        typedef typename S::value_t value_t;
+
+        ReplayUpsertContext(LogReplayer *replayer_, const record_t *record_)
+                : replayer{replayer_}, record{record_} {
+        }
+
+        /// The deep-copy constructor.
+        ReplayUpsertContext(const ReplayUpsertContext &other)
+                : replayer{other.replayer}, record{other.record} {
+        }
+
+        inline const key_t &key() const {
+            return record->key();
+        }
+
+        inline uint32_t value_size() const {
+            return record->value().size();
+        }
+
+        inline uint32_t value_length() const {
+            return record->value().size();
+        }
+
+        inline void Put(value_t &value) {
+            std::memcpy(&value, &record->value(), record->value().size());
+        }
+
+        inline bool PutAtomic(value_t &value) {
+            return false;
+        }
+
+    protected:
+        Status DeepCopy_Internal(IAsyncContext *&context_copy) {
+            return IAsyncContext::DeepCopy_Internal(*this, context_copy);
+        }
+
+    public:
+        LogReplayer *replayer;
+        const record_t *record;
+    };
+
+    class ReplayDeleteContext : public IAsyncContext {
+    public:
+        typedef typename S::key_t key_t;
+        typedef typename S::value_t value_t;
+
+        ReplayDeleteContext(LogReplayer *replayer_, const record_t *record_)
+                : replayer{replayer_}, record{record_} {
+        }
+
+        /// The deep-copy constructor.
+        ReplayDeleteContext(const ReplayDeleteContext &other)
+                : replayer{other.replayer}, record{other.record} {
+        }
+
+        inline const key_t &key() const {
+            return record->key();
+        }
+
+        inline uint32_t value_size() const {
+            return record->value().size();
+        }
+
+    protected:
+        Status DeepCopy_Internal(IAsyncContext *&context_copy) {
+            return IAsyncContext::DeepCopy_Internal(*this, context_copy);
+        }
+
+    public:
+        LogReplayer *replayer;
+        const record_t *record;
+    };
+
+    template<class C>
+    static void ReplayCallback(IAsyncContext *ctxt, Status result) {
+        CallbackContext<C> context{ctxt};
+        context->replayer->Check(result);
+    }
+
+    void Check(Status result) {
+        if (result != Status::Ok && result != Status::Pending && result != Status::NotFound) {
+            std::lock_guard<std::mutex> lock{mutex_};
+            if (status_ == Status::Ok) {
+                status_ = result;
+            }
+        }
+    }
+
+    void Run() {
+        store_.StartSession();
+        while (true) {
+            Chunk chunk;
+            {
+                std::unique_lock<std::mutex> lock{mutex_};
+                if (!cv_.wait_for(lock, std::chrono::milliseconds{kPollIntervalMs}, [this]() {
+                    return stop_ || !chunks_.empty();
+                })) {
+                    // Idle; keep the session (and with it, the epoch) moving.
+                    lock.unlock();
+                    store_.Refresh();
+                    continue;
+                }
+                if (chunks_.empty()) {
+                    break;
+                }
+                chunk = std::move(chunks_.front());
+                chunks_.pop_front();
+            }
+            Replay(chunk);
+            store_.Refresh();
+        }
+        store_.StopSession();
+    }
+
+    void Replay(Chunk &chunk) {
+        Lane &lane = lanes_[chunk.lane];
+        Address address = ReplayedUntil(chunk.lane);
+        if (address != Address{0} && LogAddressAfter(address, lane.partial.size()) != chunk.address) {
+            // Not where this log left off.
+            Check(Status::Corruption);
+            return;
+        }
+        if (lane.partial.empty()) {
+            lane.partial.swap(chunk.data);
+            address = chunk.address;
+        } else {
+            lane.partial.insert(lane.partial.end(), chunk.data.begin(), chunk.data.end());
+        }
+
+        // Records never cross a page, and the rest of a page is left zeroed; but a range can end in
+        // the middle of a record, which then waits for the next range.
+        uint64_t offset = 0;
+        uint64_t num_records = 0;
+        while (lane.partial.size() - offset >= sizeof(RecordInfo)) {
+            uint64_t available = lane.partial.size() - offset;
+            const record_t *record = reinterpret_cast<const record_t *>(lane.partial.data() + offset);
+            if (record->header.IsNull()) {
+                offset += sizeof(RecordInfo);
+                continue;
+            }
+            if (available < record_t::min_disk_key_size() || available < record->min_disk_value_size() ||
+                available < record->size()) {
+                break;
+            }
+            if (!record->header.invalid) {
+                if (record->header.tombstone) {
+                    ReplayDeleteContext context{this, record};
+                    Check(store_.Delete(context, ReplayCallback<ReplayDeleteContext>, ++serial_num_));
+                } else {
+                    ReplayUpsertContext context{this, record};
+                    Check(store_.UpsertT(context, ReplayCallback<ReplayUpsertContext>, ++serial_num_, 1));
+                }
+                ++num_records;
+            }
+            offset += record->size();
+        }
+        // The contexts of pending operations point into the records; let them complete before the
+        // records replayed are dropped.
+        store_.CompletePending(true);
+        lane.partial.erase(lane.partial.begin(), lane.partial.begin() + offset);
+
+        std::lock_guard<std::mutex> lock{mutex_};
+        lane.replayed_until = LogAddressAfter(address, offset);
+        num_records_ += num_records;
+    }
+
+    store_t &store_;
+    /// (Owned by the replay thread, but for replayed_until.)
+    std::vector<Lane> lanes_;
+
+    mutable std::mutex mutex_;
+    std::condition_variable cv_;
+    std::deque<Chunk> chunks_;
+    bool stop_;
+    Status status_;
+    uint64_t num_records_;
+    /// (Owned by the replay thread.)
+    uint64_t serial_num_;
+
+    std::thread thread_;
+};
+
+}
+} // namespace FASTER::core
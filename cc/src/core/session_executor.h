@@ -0,0 +1,227 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT license.
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+#include "constants.h"
+#include "phase.h"
+#include "thread.h"
+
+namespace FASTER {
+namespace core {
+
+/// Runs batches of store operations on a pool of worker threads, each holding a session on the
+/// store for its whole lifetime. Batches are queued on per-worker deques; an idle worker steals the
+/// oldest batch from another worker, so skewed batches do not leave cores idle. Workers own the
+/// session cadence: they call Refresh() and CompletePending() as needed, more often while many
+/// requests are pending or a checkpoint is in progress, so callers need not.
+template<class S>
+class SessionExecutor {
+public:
+    typedef S store_t;
+
+    /// One operation: called as op(store, index) on a worker thread, inside its session.
+    typedef std::function<void(store_t &, uint64_t)> operation_t;
+
+    /// Refresh() every kRefreshInterval operations (kMinRefreshInterval while the session is not
+    /// in REST phase, to help the checkpoint along).
+    static constexpr uint64_t kRefreshInterval = 256;
+    static constexpr uint64_t kMinRefreshInterval = 16;
+    /// CompletePending() every kCompletePendingInterval operations, if anything is pending; or as
+    /// soon as kMaxPendingRequests requests are pending.
+    static constexpr uint64_t kCompletePendingInterval = 4096;
+    static constexpr uint64_t kMaxPendingRequests = 64;
+
+private:
+    /// Operations [begin, end) of one submitted operation.
+    struct Batch {
+        std::shared_ptr<operation_t> op;
+        uint64_t begin;
+        uint64_t end;
+    };
+
+    struct alignas(Constants::kCacheLineBytes) Worker {
+        Worker()
+                : drained_generation{0} {
+        }
+
+        std::mutex mutex;
+        std::deque<Batch> batches;
+        /// Latest Wait() generation at which this worker had nothing pending.
+        std::atomic<uint64_t> drained_generation;
+        std::thread thread;
+    };
+
+public:
+    /// Starts "num_workers" threads. With "pin_threads", worker i runs on CPU i (mod the number of
+    /// CPUs); only implemented on Linux.
+    SessionExecutor(store_t &store, uint32_t num_workers, bool pin_threads = true)
+            : store_{store}, workers_{num_workers}, stop_{false}, num_outstanding_{0},
+              generation_{0}, next_worker_{0} {
+        for (uint32_t idx = 0; idx < workers_.size(); ++idx) {
+            workers_[idx].thread = std::thread{&SessionExecutor::Run, this, idx, pin_threads};
+        }
+    }
+
+    ~SessionExecutor() {
+        Wait();
+        stop_ = true;
+        for (uint32_t idx = 0; idx < workers_.size(); ++idx) {
+            workers_[idx].thread.join();
+        }
+    }
+
+    // No copy constructor.
+    SessionExecutor(const SessionExecutor &other) = delete;
+
+    /// Queues op(store, idx) for every idx in [begin, end), in batches of (at most) "batch_size"
+    /// operations, spread across the workers.
+    void Submit(operation_t op, uint64_t begin, uint64_t end, uint64_t batch_size = 1024) {
+        auto shared_op = std::make_shared<operation_t>(std::move(op));
+        batch_size = std::max(batch_size, (uint64_t) 1);
+        for (uint64_t batch_begin = begin; batch_begin < end; batch_begin += batch_size) {
+            Worker &worker = workers_[next_worker_++ % workers_.size()];
+            ++num_outstanding_;
+            std::lock_guard<std::mutex> lock{worker.mutex};
+            worker.batches.push_back(Batch{shared_op, batch_begin, std::min(batch_begin + batch_size, end)});
+        }
+    }
+
+    /// Blocks until every submitted operation has been issued, and every operation that went
+    /// pending has completed.
+    void Wait() {
+        uint64_t generation = ++generation_;
+        while (true) {
+            bool drained = num_outstanding_.load() == 0;
+            for (uint32_t idx = 0; idx < workers_.size(); ++idx) {
+                drained = drained && workers_[idx].drained_generation.load() >= generation;
+            }
+            if (drained) {
+                return;
+            }
+            std::this_thread::sleep_for(std::chrono::microseconds{100});
+        }
+    }
+
+    inline uint32_t num_workers() const {
+        return workers_.size();
+    }
+
+private:
+    static void Pin(uint32_t worker_idx) {
+#ifdef __linux__
+        uint32_t num_cpus = std::max(std::thread::hardware_concurrency(), 1u);
+        cpu_set_t cpus;
+        CPU_ZERO(&cpus);
+        CPU_SET(worker_idx % num_cpus, &cpus);
+        pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+#endif
+    }
+
+    /// Takes a batch from the back of this worker's deque, or else from the front of another's.
+    bool NextBatch(uint32_t worker_idx, Batch &batch) {
+        for (uint32_t offset = 0; offset < workers_.size(); ++offset) {
+            Worker &worker = workers_[(worker_idx + offset) % workers_.size()];
+            std::lock_guard<std::mutex> lock{worker.mutex};
+            if (worker.batches.empty()) {
+                continue;
+            }
+            if (offset == 0) {
+                batch = std::move(worker.batches.back());
+                worker.batches.pop_back();
+            } else {
+                batch = std::move(worker.batches.front());
+                worker.batches.pop_front();
+            }
+            return true;
+        }
+        return false;
+    }
+
+    void Run(uint32_t worker_idx, bool pin_threads) {
+        if (pin_threads) {
+            Pin(worker_idx);
+        }
+        Worker &worker = workers_[worker_idx];
+        store_.StartSession();
+        uint64_t refresh_interval = kRefreshInterval;
+        uint64_t ops_since_refresh = 0;
+        uint64_t ops_since_complete = 0;
+        uint32_t idle_rounds = 0;
+
+        while (!stop_) {
+            Batch batch;
+            if (NextBatch(worker_idx, batch)) {
+                idle_rounds = 0;
+                for (uint64_t idx = batch.begin; idx < batch.end; ++idx) {
+                    (*batch.op)(store_, idx);
+                    ++ops_since_refresh;
+                    ++ops_since_complete;
+                    uint64_t num_pending = store_.NumPendingRequests();
+                    if (num_pending >= kMaxPendingRequests ||
+                        (num_pending > 0 && ops_since_complete >= kCompletePendingInterval)) {
+                        // (CompletePending() refreshes, too.)
+                        store_.CompletePending(false);
+                        ops_since_complete = 0;
+                        ops_since_refresh = 0;
+                    } else if (ops_since_refresh >= refresh_interval) {
+                        store_.Refresh();
+                        ops_since_refresh = 0;
+                    } else {
+                        continue;
+                    }
+                    refresh_interval = store_.SessionPhase() == Phase::REST ? kRefreshInterval :
+                                       kMinRefreshInterval;
+                }
+                --num_outstanding_;
+                continue;
+            }
+
+            // Idle. Keep the session moving (a worker that stops refreshing would hold back the
+            // epoch, and with it checkpoints and log truncation), and report when it is drained.
+            uint64_t generation = generation_.load();
+            if (num_outstanding_.load() == 0 && store_.NumPendingRequests() == 0) {
+                worker.drained_generation = generation;
+            }
+            if (store_.NumPendingRequests() > 0 || store_.SessionPhase() != Phase::REST) {
+                store_.CompletePending(false);
+                idle_rounds = 0;
+            } else {
+                store_.Refresh();
+                if (++idle_rounds < 64) {
+                    std::this_thread::yield();
+                } else {
+                    std::this_thread::sleep_for(std::chrono::microseconds{50});
+                }
+            }
+        }
+        store_.StopSession();
+    }
+
+    store_t &store_;
+    PerThreadArray<Worker> workers_;
+    std::atomic<bool> stop_;
+    /// Batches submitted but not yet run.
+    std::atomic<uint64_t> num_outstanding_;
+    /// Bumped by each Wait() call.
+    std::atomic<uint64_t> generation_;
+    std::atomic<uint64_t> next_worker_;
+};
+
+}
+} // namespace FASTER::core
@@ -0,0 +1,14 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT license.
+
+#include "stats.h"
+
+namespace FASTER {
+namespace core {
+
+/// Defined whether or not FASTER_STATS is, so that the library works with either setting. (Unused
+/// static storage costs no memory until it is touched.)
+Stats::ThreadCounters Stats::threads_[Thread::kMaxNumThreads] = {};
+
+}
+} // namespace FASTER::core
@@ -0,0 +1,240 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT license.
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <ostream>
+#include <sstream>
+#include <string>
+#include <thread>
+
+#include "constants.h"
+#include "thread.h"
+
+namespace FASTER {
+namespace core {
+
+/// Hot-path events the store counts, to explain changes in throughput.
+enum class StatCounter : uint8_t {
+    /// FindOrCreateEntry() lost the race to install a tentative entry in a free slot (or found a
+    /// conflicting one, and backed off).
+    IndexEntryCasFailures = 0,
+    /// Overflow buckets allocated when a hash bucket chain was full.
+    IndexOverflowBuckets,
+    /// Updates of a record in the mutable region that had to append a new record instead (no
+    /// room for the value, a different expiry, or a failed in-place write).
+    RcuFallbacks,
+    /// A new record was appended, but another thread changed the bucket entry first.
+    RecordInstallRetries,
+    /// Operations that saw a record from a later checkpoint version, and were retried.
+    CprShiftRetries,
+    /// Operations queued to be retried later (by CompletePending()).
+    RetryLaterOperations,
+    /// NewPage() calls that could not open the next log page yet (it was not flushed and closed,
+    /// or the in-memory log was full), so the allocating thread had to wait.
+    NewPageStalls,
+    /// Disk reads issued for records below the head address.
+    PendingIosIssued,
+    /// Disk reads that had to wait because too many were outstanding.
+    PendingIoThrottles,
+    /// Epoch actions queued (with BumpCurrentEpoch()), to run once the epoch is safe.
+    EpochActionsQueued,
+    /// Times the epoch's drain list was full and had to grow.
+    EpochDrainListGrowths,
+};
+
+static constexpr uint32_t kNumStatCounters = 11;
+
+inline const char *StatCounterName(StatCounter counter) {
+    switch (counter) {
+        case StatCounter::IndexEntryCasFailures:
+            return "index_entry_cas_failures";
+        case StatCounter::IndexOverflowBuckets:
+            return "index_overflow_buckets";
+        case StatCounter::RcuFallbacks:
+            return "rcu_fallbacks";
+        case StatCounter::RecordInstallRetries:
+            return "record_install_retries";
+        case StatCounter::CprShiftRetries:
+            return "cpr_shift_retries";
+        case StatCounter::RetryLaterOperations:
+            return "retry_later_operations";
+        case StatCounter::NewPageStalls:
+            return "new_page_stalls";
+        case StatCounter::PendingIosIssued:
+            return "pending_ios_issued";
+        case StatCounter::PendingIoThrottles:
+            return "pending_io_throttles";
+        case StatCounter::EpochActionsQueued:
+            return "epoch_actions_queued";
+        case StatCounter::EpochDrainListGrowths:
+            return "epoch_drain_list_growths";
+    }
+    return "unknown";
+}
+
+/// The counters, summed over all threads at some point in time.
+struct StatsSnapshot {
+    StatsSnapshot()
+            : counters{} {
+    }
+
+    inline uint64_t operator[](StatCounter counter) const {
+        return counters[static_cast<uint8_t>(counter)];
+    }
+
+    /// Events between "earlier" and this snapshot.
+    StatsSnapshot operator-(const StatsSnapshot &earlier) const {
+        StatsSnapshot result;
+        for (uint32_t idx = 0; idx < kNumStatCounters; ++idx) {
+            result.counters[idx] = counters[idx] - earlier.counters[idx];
+        }
+        return result;
+    }
+
+    /// One "name value" line per counter.
+    void WriteText(std::ostream &out) const {
+        for (uint32_t idx = 0; idx < kNumStatCounters; ++idx) {
+            out << StatCounterName(static_cast<StatCounter>(idx)) << " " << counters[idx] << "\n";
+        }
+    }
+
+    /// A single-line JSON object.
+    void WriteJson(std::ostream &out) const {
+        out << "{";
+        for (uint32_t idx = 0; idx < kNumStatCounters; ++idx) {
+            out << (idx > 0 ? ", " : "") << "\"" << StatCounterName(static_cast<StatCounter>(idx)) << "\": " <<
+                counters[idx];
+        }
+        out << "}";
+    }
+
+    uint64_t counters[kNumStatCounters];
+};
+
+/// Per-thread event counters. They are compiled in only with FASTER_STATS (the CMake option of
+/// the same name); otherwise Increment() is empty, and Snapshot() is all zeros.
+///
+/// Each thread (by Thread::id()) has its own cache-line-aligned block of counters, which only
+/// it writes, with plain (relaxed) loads and stores; Snapshot() sums the blocks, as of roughly
+/// the time it is called.
+class Stats {
+public:
+#ifdef FASTER_STATS
+    static constexpr bool kEnabled = true;
+#else
+    static constexpr bool kEnabled = false;
+#endif
+
+    static inline void Increment(StatCounter counter) {
+#ifdef FASTER_STATS
+        std::atomic<uint64_t> &value = threads_[Thread::id()].counters[static_cast<uint8_t>(counter)];
+        value.store(value.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+#else
+        (void) counter;
+#endif
+    }
+
+    static StatsSnapshot Snapshot() {
+        StatsSnapshot result;
+#ifdef FASTER_STATS
+        uint32_t capacity = Thread::capacity();
+        for (uint32_t thread = 0; thread < capacity; ++thread) {
+            for (uint32_t idx = 0; idx < kNumStatCounters; ++idx) {
+                result.counters[idx] += threads_[thread].counters[idx].load(std::memory_order_relaxed);
+            }
+        }
+#endif
+        return result;
+    }
+
+private:
+    struct alignas(Constants::kCacheLineBytes) ThreadCounters {
+        std::atomic<uint64_t> counters[kNumStatCounters];
+    };
+
+    /// Indexed by thread ID (and so sized for Thread::kMaxNumThreads).
+    static ThreadCounters threads_[Thread::kMaxNumThreads];
+};
+
+/// Output format of StatsExporter.
+enum class StatsFormat : uint8_t {
+    Text = 0,
+    Json,
+};
+
+/// Exports a snapshot of the counters every "interval", from a background thread, by handing it
+/// (formatted as text or as a line of JSON) to "sink". Each export covers the events since the
+/// previous one, and is prefixed with the time since the exporter started.
+class StatsExporter {
+public:
+    typedef std::function<void(const std::string &)> sink_t;
+
+    StatsExporter(std::chrono::milliseconds interval, StatsFormat format, sink_t sink)
+            : interval_{interval}, format_{format}, sink_{sink}, stop_{false},
+              start_{std::chrono::steady_clock::now()}, previous_{Stats::Snapshot()} {
+        thread_ = std::thread{&StatsExporter::Run, this};
+    }
+
+    ~StatsExporter() {
+        {
+            std::lock_guard<std::mutex> lock{mutex_};
+            stop_ = true;
+        }
+        stopped_.notify_one();
+        thread_.join();
+    }
+
+    StatsExporter(const StatsExporter &other) = delete;
+
+    /// Formats the events between "previous" and "current", "elapsed" into the run.
+    static std::string Format(StatsFormat format, std::chrono::milliseconds elapsed, const StatsSnapshot &previous,
+                              const StatsSnapshot &current) {
+        std::ostringstream out;
+        double elapsed_s = static_cast<double>(elapsed.count()) / 1000.0;
+        if (format == StatsFormat::Json) {
+            out << "{\"elapsed_s\": " << elapsed_s << ", \"counters\": ";
+            (current - previous).WriteJson(out);
+            out << "}\n";
+        } else {
+            out << "elapsed_s " << elapsed_s << "\n";
+            (current - previous).WriteText(out);
+        }
+        return out.str();
+    }
+
+private:
+    void Run() {
+        std::unique_lock<std::mutex> lock{mutex_};
+        while (!stopped_.wait_for(lock, interval_, [this] { return stop_; })) {
+            StatsSnapshot current = Stats::Snapshot();
+            auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+                    std::chrono::steady_clock::now() - start_);
+            lock.unlock();
+            sink_(Format(format_, elapsed, previous_, current));
+            lock.lock();
+            previous_ = current;
+        }
+    }
+
+    std::chrono::milliseconds interval_;
+    StatsFormat format_;
+    sink_t sink_;
+
+    std::mutex mutex_;
+    std::condition_variable stopped_;
+    bool stop_;
+    std::chrono::steady_clock::time_point start_;
+    /// As of the previous export (or the start).
+    StatsSnapshot previous_;
+    std::thread thread_;
+};
+
+}
+} // namespace FASTER::core
@@ -6,11 +6,11 @@
 namespace FASTER {
 namespace core {
 
-/// The first thread will have index 0.
-std::atomic<uint32_t> Thread::next_index_{0};
+/// Stores raise the capacity (up to kMaxNumThreads) when they are constructed.
+std::atomic<uint32_t> Thread::capacity_{kDefaultNumThreads};
 
 /// No thread IDs have been used yet.
-std::atomic<bool> Thread::id_used_[kMaxNumThreads] = {};
+std::atomic<uint64_t> Thread::id_used_[kMaxNumThreads / kIdsPerWord] = {};
 
 #ifdef COUNT_ACTIVE_THREADS
 std::atomic<int32_t> Thread::current_num_threads_ { 0 };
@@ -3,12 +3,33 @@
 
 #pragma once
 
+#include <algorithm>
 #include <atomic>
 #include <cassert>
 #include <cstddef>
 #include <cstdint>
+#include <new>
 #include <stdexcept>
 
+#include "alloc.h"
+#include "constants.h"
+
+#ifdef _WIN32
+#include <intrin.h>
+#pragma intrinsic(_BitScanForward64)
+#else
+namespace FASTER {
+/// Convert GCC's __builtin_ctzll() to Microsoft's _BitScanForward64().
+inline uint8_t _BitScanForward64(unsigned long *index, uint64_t mask) {
+    if (mask == 0) {
+        return 0;
+    }
+    *index = __builtin_ctzll(mask);
+    return 1;
+}
+}
+#endif
+
 /// Turn this on to have Thread::current_num_threads_ keep a count of currently-active threads.
 #undef COUNT_ACTIVE_THREADS
 
@@ -18,12 +39,17 @@ namespace core {
 /// Gives every thread a unique, numeric thread ID, and recycles IDs when threads exit.
 class Thread {
 public:
-    /// The number of entries in table. Currently, this is fixed at 96 and never changes or grows.
-    /// If the table runs out of entries, then the current implementation will throw a
-    /// std::runtime_error.
-    static constexpr size_t kMaxNumThreads = 128;
+    /// Hard limit on the thread-ID space; static per-thread tables (and the epoch table's bitmaps)
+    /// are sized for it. Stores size their own per-thread structures to the (smaller) number of
+    /// sessions they were constructed for.
+    static constexpr size_t kMaxNumThreads = 4096;
+    /// Number of thread IDs available until a store asks for more.
+    static constexpr size_t kDefaultNumThreads = 128;
 
 private:
+    /// Thread IDs are tracked in a bitmap, 64 per word.
+    static constexpr uint32_t kIdsPerWord = 64;
+
     /// Encapsulates a thread ID, getting a free ID from the Thread class when the thread starts, and
     /// releasing it back to the Thread class, when the thread exits.
     class ThreadId {
@@ -48,6 +74,23 @@ public:
         return id_.id();
     }
 
+    /// Number of thread IDs currently handed out from; thread IDs are always < capacity().
+    inline static uint32_t capacity() {
+        return capacity_.load();
+    }
+
+    /// Grows the thread-ID space to at least "num_threads" IDs (it never shrinks), and returns the
+    /// resulting capacity.
+    static uint32_t ReserveCapacity(uint32_t num_threads) {
+        if (num_threads > kMaxNumThreads) {
+            throw std::invalid_argument{"Too many threads requested"};
+        }
+        uint32_t capacity = capacity_.load();
+        while (capacity < num_threads && !capacity_.compare_exchange_weak(capacity, num_threads)) {
+        }
+        return std::max(capacity, num_threads);
+    }
+
 private:
     /// Methods ReserveEntry() and ReleaseEntry() do the real work.
     inline static uint32_t ReserveEntry() {
@@ -55,22 +98,31 @@ private:
         int32_t result = ++current_num_threads_;
         assert(result < kMaxNumThreads);
 #endif
-        uint32_t start = next_index_++;
-        uint32_t end = start + 2 * kMaxNumThreads;
-        for (uint32_t id = start; id < end; ++id) {
-            bool expected = false;
-            if (id_used_[id % kMaxNumThreads].compare_exchange_strong(expected, true)) {
-                return id % kMaxNumThreads;
+        // Take the lowest free ID, so that IDs stay dense (the epoch table scans them by shard). A
+        // full word is skipped with one load, instead of probing its IDs one at a time.
+        uint32_t capacity = capacity_.load();
+        for (uint32_t word = 0; word * kIdsPerWord < capacity; ++word) {
+            uint32_t ids_in_word = std::min(capacity - word * kIdsPerWord, kIdsPerWord);
+            uint64_t valid = ids_in_word == kIdsPerWord ? UINT64_MAX : ((uint64_t) 1 << ids_in_word) - 1;
+            uint64_t used = id_used_[word].load();
+            uint64_t free;
+            while ((free = ~used & valid) != 0) {
+                uint64_t bit = free & (~free + 1);
+                if (id_used_[word].compare_exchange_weak(used, used | bit)) {
+                    unsigned long bit_idx;
+                    _BitScanForward64(&bit_idx, bit);
+                    return word * kIdsPerWord + static_cast<uint32_t>(bit_idx);
+                }
             }
         }
-        // Already have 64 active threads.
         throw std::runtime_error{"Too many threads!"};
     }
 
     inline static void ReleaseEntry(uint32_t id) {
         assert(id != ThreadId::kInvalidId);
-        assert(id_used_[id].load());
-        id_used_[id] = false;
+        uint64_t bit = (uint64_t) 1 << (id % kIdsPerWord);
+        assert(id_used_[id / kIdsPerWord].load() & bit);
+        id_used_[id / kIdsPerWord].fetch_and(~bit);
 #ifdef COUNT_ACTIVE_THREADS
         int32_t result = --current_num_threads_;
 #endif
@@ -79,10 +131,10 @@ private:
     /// The current thread's page_index.
     static thread_local ThreadId id_;
 
-    /// Next thread index to consider.
-    static std::atomic<uint32_t> next_index_;
+    /// Size of the thread-ID space.
+    static std::atomic<uint32_t> capacity_;
     /// Which thread IDs have already been taken.
-    static std::atomic<bool> id_used_[kMaxNumThreads];
+    static std::atomic<uint64_t> id_used_[kMaxNumThreads / kIdsPerWord];
 
 #ifdef COUNT_ACTIVE_THREADS
     static std::atomic<int32_t> current_num_threads_;
@@ -100,5 +152,66 @@ inline Thread::ThreadId::~ThreadId() {
     Thread::ReleaseEntry(id_);
 }
 
+/// Array with one cache-line-aligned slot per thread ID, sized at run time (normally to the number
+/// of sessions a store was constructed for).
+template<class T>
+class PerThreadArray {
+public:
+    static_assert(alignof(T) >= Constants::kCacheLineBytes, "per-thread slots must be cache-line padded");
+
+    PerThreadArray()
+            : slots_{nullptr}, size_{0} {
+    }
+
+    explicit PerThreadArray(uint32_t size)
+            : slots_{nullptr}, size_{0} {
+        Resize(size);
+    }
+
+    ~PerThreadArray() {
+        Free();
+    }
+
+    // No copy constructor.
+    PerThreadArray(const PerThreadArray &other) = delete;
+
+    /// Reallocates the array; existing slots are destroyed.
+    void Resize(uint32_t size) {
+        Free();
+        slots_ = reinterpret_cast<T *>(aligned_alloc(alignof(T), size * sizeof(T)));
+        for (uint32_t idx = 0; idx < size; ++idx) {
+            new(&slots_[idx]) T{};
+        }
+        size_ = size;
+    }
+
+    inline T &operator[](uint32_t idx) {
+        assert(idx < size_);
+        return slots_[idx];
+    }
+
+    inline const T &operator[](uint32_t idx) const {
+        assert(idx < size_);
+        return slots_[idx];
+    }
+
+    inline uint32_t size() const {
+        return size_;
+    }
+
+private:
+    void Free() {
+        for (uint32_t idx = 0; idx < size_; ++idx) {
+            slots_[idx].~T();
+        }
+        aligned_free(slots_);
+        slots_ = nullptr;
+        size_ = 0;
+    }
+
+    T *slots_;
+    uint32_t size_;
+};
+
 }
 } // namespace FASTER::core
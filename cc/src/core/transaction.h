@@ -0,0 +1,66 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT license.
+
+#pragma once
+
+#include <cstdint>
+
+#include "address.h"
+#include "hash_bucket.h"
+
+namespace FASTER {
+namespace core {
+
+/// Multi-key transactions: FasterKv::MultiKeyTransaction() atomically updates a small set of
+/// existing keys. A transaction context TC provides:
+///
+///   typedef ... key_t;
+///   typedef ... value_t;
+///   uint32_t num_keys() const;
+///   const key_t &key(uint32_t idx) const;   // keys must be distinct
+///   /// Called once per key, after every key has been locked: the current values.
+///   void Get(uint32_t idx, const value_t &value);
+///   /// Then, once per key: the new values, in place (false if the new value does not fit, which
+///   /// is to say value_length(idx) exceeds the current record's) or into a new record.
+///   bool PutAtomic(uint32_t idx, value_t &value);
+///   void Put(uint32_t idx, value_t &value);
+///   uint32_t value_size(uint32_t idx) const;
+///   uint32_t value_length(uint32_t idx) const;
+///
+/// The transaction first reserves a record at the tail of the log for every key whose record is
+/// read-only (or too short for the new value) when it is looked up: allocating can Refresh() the
+/// epoch and wait for a new page, which must not happen while other threads wait for the
+/// transaction's locks. It then locks every key's hash bucket entry, in address order, by
+/// DCASing a lock bit into the entry's HashInfo word; readers and single-key writers that find the
+/// bit set wait for it to clear. Records in the mutable region are then updated in place (and the
+/// reserved record is left invalid); records in the read-only region are copied to the reserved
+/// record (RCU) while still locked; if a record that got no reservation has become read-only by
+/// then, the transaction releases its locks and starts over. Releasing a lock publishes the new (address, info) pair with
+/// the same DCAS, so the write set commits without any further validation. An in-place Upsert()
+/// that passed its lock check just before the transaction locked the key re-checks the entry after
+/// writing, and redoes its write as RCU if the entry was locked or updated meanwhile.
+///
+/// A transaction runs entirely inside one CPR version: it is rejected with Status::Aborted unless
+/// both the session and the store are in Phase::REST, and the session does not refresh while it
+/// holds locks. Records that have been evicted to disk are not fetched (Status::Aborted too); the
+/// caller should Refresh() or CompletePending() and retry.
+
+/// One key of a transaction's write set.
+struct TransactionWriteSetEntry {
+    /// Index of the key in the transaction context.
+    uint32_t idx;
+    AtomicHashBucketEntry *atomic_entry;
+    /// Entry and info as locked by the transaction.
+    HashBucketEntry entry;
+    HashInfo info;
+    /// Entry and info to publish on commit.
+    HashBucketEntry new_entry;
+    HashInfo new_info;
+    /// Whether the record needs RCU: as of the lookup, and then as of locking.
+    bool needs_rcu;
+    /// Record reserved for RCU, before locking (Address::kInvalidAddress if none was).
+    Address rcu_address;
+};
+
+}
+} // namespace FASTER::core
@@ -3,6 +3,7 @@
 
 #pragma once
 
+#include <chrono>
 #include <cstdint>
 #include <cstring>
 #include <stdexcept>
@@ -50,6 +51,13 @@ public:
     static constexpr inline bool IsPowerOfTwo(uint64_t x) {
         return (x > 0) && ((x & (x - 1)) == 0);
     }
+
+    /// Wall-clock time in seconds since the Unix epoch; the clock that record expiry times use, so
+    /// that they stay meaningful across recovery.
+    static inline uint32_t NowSeconds() {
+        return static_cast<uint32_t>(std::chrono::duration_cast<std::chrono::seconds>(
+                std::chrono::system_clock::now().time_since_epoch()).count());
+    }
 };
 
 }
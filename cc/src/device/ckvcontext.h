@@ -5,6 +5,7 @@
 #ifndef HASHCOMP_CCKVCONTEXT_H
 #define HASHCOMP_CCKVCONTEXT_H
 
+#include "../core/gen_lock.h"
 #include "../misc/utility.h"
 
 using namespace FASTER::misc;
@@ -47,7 +48,7 @@ class ReadContext;
 
 class alignas(16) Value {
 public:
-    Value() : length_{0}, value_{0} {}
+    Value() : gen_lock_{0}, value_{0}, length_{0} {}
 
     inline static constexpr uint32_t size() {
         return static_cast<uint32_t>(sizeof(Value));
@@ -60,8 +61,9 @@ public:
     friend class ReadContext;
 
 private:
+    AtomicGenLock gen_lock_;
     uint8_t value_[31];
-    std::atomic <uint8_t> length_;
+    uint8_t length_;
 };
 
 class UpsertContext : public IAsyncContext {
@@ -85,25 +87,21 @@ public:
 
     /// Non-atomic and atomic Put() methods.
     inline void Put(Value &value) {
+        value.gen_lock_.store(0);
         value.length_ = 5;
         std::memset(value.value_, 23, 5);
     }
 
     inline bool PutAtomic(Value &value) {
-        // Get the lock on the value.
-        bool success;
-        do {
-            uint8_t expected_length;
-            do {
-                // Spin until other the thread releases the lock.
-                expected_length = value.length_.load();
-            } while (expected_length == UINT8_MAX);
-            // Try to get the lock.
-            success = value.length_.compare_exchange_weak(expected_length, UINT8_MAX);
-        } while (!success);
-
+        // Short critical section: only the copy itself runs under the lock.
+        bool replaced;
+        if (!value.gen_lock_.lock(replaced)) {
+            // Some other thread replaced this record.
+            return false;
+        }
         std::memset(value.value_, 42, 7);
-        value.length_.store(7);
+        value.length_ = 7;
+        value.gen_lock_.unlock(false);
         return true;
     }
 
@@ -173,12 +171,12 @@ public:
     }
 
     inline void GetAtomic(const Value &value) {
-        do {
-            output_length = value.length_.load();
-            //ASSERT_EQ(0, reinterpret_cast<size_t>(value.value_) % 16);
+        // Optimistic read; the generation number (unlike the length) changes on every update.
+        value.gen_lock_.read([&]() {
+            output_length = value.length_;
             output_pt1 = *reinterpret_cast<const uint64_t *>(value.value_);
             output_pt2 = *reinterpret_cast<const uint64_t *>(value.value_ + 8);
-        } while (output_length != value.length_.load());
+        });
     }
 
 protected:
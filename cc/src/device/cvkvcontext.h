@@ -5,6 +5,11 @@
 #ifndef HASHCOMP_CVKVCONTEXT_H
 #define HASHCOMP_CVKVCONTEXT_H
 
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+#include "../core/gen_lock.h"
 #include "../misc/utility.h"
 
 using namespace FASTER::misc;
@@ -44,78 +49,6 @@ class DeleteContext;
 
 class ReadContext;
 
-class GenLock {
-public:
-    GenLock() : control_{0} {}
-
-    GenLock(uint64_t control) : control_{control} {}
-
-    inline GenLock &operator=(const GenLock &other) {
-        control_ = other.control_;
-        return *this;
-    }
-
-    union {
-        struct {
-            uint64_t gen_number : 62;
-            uint64_t locked : 1;
-            uint64_t replaced : 1;
-        };
-        uint64_t control_;
-    };
-};
-
-static_assert(sizeof(GenLock) == 8, "sizeof(GenLock) != 8");
-
-class AtomicGenLock {
-public:
-    AtomicGenLock() : control_{0} {}
-
-    AtomicGenLock(uint64_t control) : control_{control} {}
-
-    inline GenLock load() const {
-        return GenLock{control_.load()};
-    }
-
-    inline void store(GenLock desired) {
-        control_.store(desired.control_);
-    }
-
-    inline bool try_lock(bool &replaced) {
-        replaced = false;
-        GenLock expected{control_.load()};
-        expected.locked = 0;
-        expected.replaced = 0;
-        GenLock desired{expected.control_};
-        desired.locked = 1;
-
-        if (control_.compare_exchange_strong(expected.control_, desired.control_)) {
-            return true;
-        }
-        if (expected.replaced) {
-            replaced = true;
-        }
-        return false;
-    }
-
-    inline void unlock(bool replaced) {
-        if (!replaced) {
-            // Just turn off "locked" bit and increase gen number.
-            uint64_t sub_delta = ((uint64_t) 1 << 62) - 1;
-            control_.fetch_sub(sub_delta);
-        } else {
-            // Turn off "locked" bit, turn on "replaced" bit, and increase gen number
-            uint64_t add_delta = ((uint64_t) 1 << 63) - ((uint64_t) 1 << 62) + 1;
-            control_.fetch_add(add_delta);
-        }
-    }
-
-private:
-    std::atomic <uint64_t> control_;
-};
-
-static_assert(sizeof(AtomicGenLock) == 8, "sizeof(AtomicGenLock) != 8");
-
 class Value {
 public:
 
@@ -201,10 +134,7 @@ public:
 
     inline bool PutAtomic(Value &value) {
         bool replaced;
-        while (!value.gen_lock_.try_lock(replaced) && !replaced) {
-            std::this_thread::yield();
-        }
-        if (replaced) {
+        if (!value.gen_lock_.lock(replaced)) {
             // Some other thread replaced this record.
             return false;
         }
@@ -293,20 +223,19 @@ public:
     }
 
     inline void GetAtomic(const Value &value) {
-        GenLock before, after;
-        do {
-            //do{
-            //std::this_thread::yield();
-            before = value.gen_lock_.load();
-            // } while(before.locked||before.replaced);
-            output_length = value.length_;
-            output_bytes = new uint8_t[output_length];
-            std::memcpy(output_bytes, value.buffer(), output_length);
-            do {
-                //std::this_thread::yield();
-                after = value.gen_lock_.load();
-            } while (after.locked || after.replaced);
-        } while (before.gen_number != after.gen_number);
+        // Optimistic read into a stack buffer; re-copies if a writer updated the value in the
+        // meantime. A length read mid-update may be garbage, so it is clamped to the buffer (the
+        // copy is thrown away then), and the output is allocated once the read has succeeded.
+        uint8_t buffer[UINT8_MAX];
+        uint32_t length;
+        value.gen_lock_.read([&]() {
+            length = std::min<uint32_t>(value.length_, sizeof(buffer));
+            std::memcpy(buffer, value.buffer(), length);
+        });
+        delete[] output_bytes;
+        output_length = static_cast<uint8_t>(length);
+        output_bytes = new uint8_t[output_length];
+        std::memcpy(output_bytes, buffer, output_length);
     }
 
 protected:
@@ -320,7 +249,7 @@ private:
 public:
     uint8_t output_length;
     // Extract two bytes of output.
-    uint8_t *output_bytes;
+    uint8_t *output_bytes = nullptr;
 };
 }
 }
@@ -13,6 +13,7 @@
 #include "../core/light_epoch.h"
 #include "../core/utility.h"
 #include "../environment/file.h"
+#include "io_scheduler.h"
 
 /// Wrapper that exposes files to FASTER. Encapsulates segmented files, etc.
 
@@ -30,22 +31,28 @@ public:
 
     /// Default constructor
     FileSystemFile()
-            : file_{}, file_options_{} {
+            : file_{}, file_options_{}, scheduler_{nullptr}, write_class_{IoClass::Checkpoint} {
     }
 
-    FileSystemFile(const std::string &filename, const environment::FileOptions &file_options)
-            : file_{filename}, file_options_{file_options} {
+    /// With a "scheduler", writes are throttled as "write_class" (and must not move the file while
+    /// some are still queued).
+    FileSystemFile(const std::string &filename, const environment::FileOptions &file_options,
+                   IoScheduler *scheduler = nullptr, IoClass write_class = IoClass::Checkpoint)
+            : file_{filename}, file_options_{file_options}, scheduler_{scheduler}, write_class_{write_class} {
     }
 
     /// Move constructor.
     FileSystemFile(FileSystemFile &&other)
-            : file_{std::move(other.file_)}, file_options_{other.file_options_} {
+            : file_{std::move(other.file_)}, file_options_{other.file_options_}, scheduler_{other.scheduler_},
+              write_class_{other.write_class_} {
     }
 
     /// Move assignment operator.
     FileSystemFile &operator=(FileSystemFile &&other) {
         file_ = std::move(other.file_);
         file_options_ = other.file_options_;
+        scheduler_ = other.scheduler_;
+        write_class_ = other.write_class_;
         return *this;
     }
 
@@ -71,11 +78,17 @@ public:
 
     Status ReadAsync(uint64_t source, void *dest, uint32_t length,
                      AsyncIOCallback callback, IAsyncContext &context) const {
+        if (scheduler_ && scheduler_->enabled()) {
+            scheduler_->NoteRead(length);
+        }
         return file_.Read(source, length, reinterpret_cast<uint8_t *>(dest), context, callback);
     }
 
     Status WriteAsync(const void *source, uint64_t dest, uint32_t length,
                       AsyncIOCallback callback, IAsyncContext &context) {
+        if (scheduler_ && scheduler_->enabled()) {
+            return scheduler_->Write(write_class_, IssueWrite, this, source, dest, length, callback, context);
+        }
         return file_.Write(dest, length, reinterpret_cast<const uint8_t *>(source), context, callback);
     }
 
@@ -84,8 +97,17 @@ public:
     }
 
 private:
+    static Status IssueWrite(void *file, const void *source, uint64_t dest, uint32_t length,
+                             AsyncIOCallback callback, IAsyncContext &context) {
+        return static_cast<FileSystemFile *>(file)->file_.Write(dest, length,
+                                                                reinterpret_cast<const uint8_t *>(source),
+                                                                context, callback);
+    }
+
     file_t file_;
     environment::FileOptions file_options_;
+    IoScheduler *scheduler_;
+    IoClass write_class_;
 };
 
 /// Manages a bundle of segment files.
@@ -210,10 +232,12 @@ public:
     static constexpr uint64_t kSegmentSize = S;
     static_assert(Utility::IsPowerOfTwo(S), "template parameter S is not a power of two!");
 
+    /// With a "scheduler", writes are throttled as "write_class".
     FileSystemSegmentedFile(const std::string &filename,
-                            const environment::FileOptions &file_options, LightEpoch *epoch)
+                            const environment::FileOptions &file_options, LightEpoch *epoch,
+                            IoScheduler *scheduler = nullptr, IoClass write_class = IoClass::BackgroundFlush)
             : begin_segment_{0}, files_{nullptr}, handler_{nullptr}, filename_{filename}, file_options_{file_options},
-              epoch_{epoch} {
+              epoch_{epoch}, scheduler_{scheduler}, write_class_{write_class} {
     }
 
     ~FileSystemSegmentedFile() {
@@ -257,11 +281,33 @@ public:
             }
             files = files_.load();
         }
+        if (scheduler_ && scheduler_->enabled()) {
+            scheduler_->NoteRead(length);
+        }
         return files->file(segment).ReadAsync(source % kSegmentSize, dest, length, callback, context);
     }
 
     Status WriteAsync(const void *source, uint64_t dest, uint32_t length,
                       AsyncIOCallback callback, IAsyncContext &context) {
+        if (scheduler_ && scheduler_->enabled()) {
+            return scheduler_->Write(write_class_, IssueWrite, this, source, dest, length, callback, context);
+        }
+        return WriteUnthrottled(source, dest, length, callback, context);
+    }
+
+    size_t alignment() const {
+        return 512; // For now, assume all disks have 512-bytes alignment.
+    }
+
+private:
+    static Status IssueWrite(void *file, const void *source, uint64_t dest, uint32_t length,
+                             AsyncIOCallback callback, IAsyncContext &context) {
+        return static_cast<FileSystemSegmentedFile *>(file)->WriteUnthrottled(source, dest, length, callback,
+                                                                              context);
+    }
+
+    Status WriteUnthrottled(const void *source, uint64_t dest, uint32_t length,
+                            AsyncIOCallback callback, IAsyncContext &context) {
         uint64_t segment = dest / kSegmentSize;
         assert(dest % kSegmentSize + length <= kSegmentSize);
 
@@ -277,11 +323,6 @@ public:
         return files->file(segment).WriteAsync(source, dest % kSegmentSize, length, callback, context);
     }
 
-    size_t alignment() const {
-        return 512; // For now, assume all disks have 512-bytes alignment.
-    }
-
-private:
     Status OpenSegment(uint64_t segment) {
         class Context : public IAsyncContext {
         public:
@@ -416,6 +457,8 @@ private:
     environment::FileOptions file_options_;
     LightEpoch *epoch_;
     std::mutex mutex_;
+    IoScheduler *scheduler_;
+    IoClass write_class_;
 };
 
 template<class H, uint64_t S>
@@ -438,12 +481,13 @@ public:
                    bool unbuffered = true, bool delete_on_close = false)
             : root_path_{NormalizePath(root_path)}, handler_{16 /*max threads*/ },
               default_file_options_{unbuffered, delete_on_close},
-              log_{root_path_ + "tlog.log", default_file_options_, &epoch},
-              log_1{root_path_ + std::to_string(1) + "log.log", default_file_options_, &epoch},
-              log_2{root_path_ + "tlog2.log", default_file_options_, &epoch},
-              log_3{root_path_ + "tlog3.log", default_file_options_, &epoch} {
+              log_{root_path_ + "tlog.log", default_file_options_, &epoch, &io_scheduler_},
+              log_1{root_path_ + std::to_string(1) + "log.log", default_file_options_, &epoch, &io_scheduler_},
+              log_2{root_path_ + "tlog2.log", default_file_options_, &epoch, &io_scheduler_},
+              log_3{root_path_ + "tlog3.log", default_file_options_, &epoch, &io_scheduler_} {
         for (int i = 0; i < 40; i++) {
-            log_t[i] = new log_file_t(root_path_ + std::to_string(i) + "log.log", default_file_options_, &epoch);
+            log_t[i] = new log_file_t(root_path_ + std::to_string(i) + "log.log", default_file_options_, &epoch,
+                                      &io_scheduler_);
             log_t[i]->Open(&handler_);
         }
         Status result = log_.Open(&handler_);
@@ -528,8 +572,10 @@ public:
         std::experimental::filesystem::create_directories(path);
     }
 
-    file_t NewFile(const std::string &relative_path) {
-        return file_t{root_path_ + relative_path, default_file_options_};
+    /// Files for checkpoints and the like; their writes are throttled as "write_class". (The logs'
+    /// writes are throttled as IoClass::BackgroundFlush.)
+    file_t NewFile(const std::string &relative_path, IoClass write_class = IoClass::Checkpoint) {
+        return file_t{root_path_ + relative_path, default_file_options_, &io_scheduler_, write_class};
     }
 
     /// Implementation-specific accessor.
@@ -537,8 +583,15 @@ public:
         return handler_;
     }
 
+    /// Write throttling; off until some I/O class gets a budget.
+    IoScheduler &io_scheduler() {
+        return io_scheduler_;
+    }
+
     bool TryComplete() {
-        return handler_.TryComplete();
+        // Also issue the throttled writes whose budget has come in.
+        bool issued = io_scheduler_.Pump();
+        return handler_.TryComplete() || issued;
     }
 
 private:
@@ -546,6 +599,8 @@ private:
     handler_t handler_;
 
     environment::FileOptions default_file_options_;
+    /// (Before the logs, which point to it.)
+    IoScheduler io_scheduler_;
 
     /// Store the log (contains all records).
     log_file_t log_;
@@ -0,0 +1,253 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT license.
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+
+#include "../core/async.h"
+#include "../core/status.h"
+
+namespace FASTER {
+namespace device {
+
+/// What an I/O is for. Foreground reads are always issued right away; writes of the other
+/// classes are subject to their class's bandwidth budget.
+enum class IoClass : uint8_t {
+    ForegroundRead = 0,
+    BackgroundFlush,
+    Checkpoint,
+    Compaction,
+    NumClasses
+};
+
+/// Per-class counters (see IoScheduler::GetStats()).
+struct IoClassStats {
+    /// Writes waiting for budget, now and at most.
+    uint64_t queue_depth;
+    uint64_t max_queue_depth;
+    /// I/Os issued, and their bytes.
+    uint64_t issued_ios;
+    uint64_t issued_bytes;
+    /// Of the issued I/Os, how many had to wait for budget, and for how long.
+    uint64_t deferred_ios;
+    uint64_t total_wait_us;
+    uint64_t max_wait_us;
+};
+
+/// Token-bucket write throttling for a disk, so that background writes (log flushes, checkpoints)
+/// don't saturate the device while foreground reads are waiting on it. Each write class has a
+/// budget in bytes per second (0: unlimited); a write that finds its class out of budget is
+/// queued, in order, and issued from Pump() (which the disk calls from TryComplete()) once the
+/// budget has refilled. With SetAdaptive(), background writes ignore their budgets while there
+/// have been no foreground reads for a while.
+class IoScheduler {
+public:
+    /// Issues a queued write, bypassing the scheduler.
+    typedef core::Status(*issue_t)(void *file, const void *source, uint64_t dest, uint32_t length,
+                                   core::AsyncIOCallback callback, core::IAsyncContext &context);
+
+    /// A class may run this far ahead of its budget (and so issue a burst of this many seconds'
+    /// worth of bytes after being idle).
+    static constexpr double kBurstSeconds = 0.05;
+    /// SetAdaptive(): the device counts as idle once no foreground read has been issued for this
+    /// long.
+    static constexpr uint64_t kIdleReadWindowUs = 10000;
+
+    IoScheduler()
+            : enabled_{false}, adaptive_{false}, last_read_us_{0}, num_queued_{0},
+              read_ios_{0}, read_bytes_{0} {
+        for (auto &bucket : buckets_) {
+            bucket = Bucket{};
+        }
+        for (auto &stats : stats_) {
+            stats = IoClassStats{};
+        }
+    }
+
+    /// Sets the budget for writes of class "io_class", in bytes per second; 0 means unlimited.
+    void SetBudget(IoClass io_class, uint64_t bytes_per_second) {
+        std::lock_guard<std::mutex> lock{mutex_};
+        Bucket &bucket = buckets_[index(io_class)];
+        bucket.rate = bytes_per_second;
+        bucket.tokens = Burst(bucket);
+        bucket.last_refill_us = NowUs();
+        bool enabled = false;
+        for (const auto &b : buckets_) {
+            enabled = enabled || b.rate > 0;
+        }
+        enabled_ = enabled;
+    }
+
+    void SetAdaptive(bool adaptive) {
+        adaptive_ = adaptive;
+    }
+
+    /// False until some class gets a budget; disks skip the scheduler entirely until then.
+    inline bool enabled() const {
+        return enabled_.load(std::memory_order_relaxed);
+    }
+
+    /// Records a foreground read (which is never held back).
+    inline void NoteRead(uint32_t length) {
+        last_read_us_.store(NowUs(), std::memory_order_relaxed);
+        read_ios_.fetch_add(1, std::memory_order_relaxed);
+        read_bytes_.fetch_add(length, std::memory_order_relaxed);
+    }
+
+    /// Issues the write through issue(file, ...) if "io_class" has budget left (and nothing queued
+    /// ahead of it); otherwise queues it, to be issued by Pump().
+    core::Status Write(IoClass io_class, issue_t issue, void *file, const void *source, uint64_t dest,
+                       uint32_t length, core::AsyncIOCallback callback, core::IAsyncContext &context) {
+        uint32_t idx = index(io_class);
+        {
+            std::lock_guard<std::mutex> lock{mutex_};
+            uint64_t now = NowUs();
+            if (queues_[idx].empty() && TryConsume(buckets_[idx], length, now)) {
+                ++stats_[idx].issued_ios;
+                stats_[idx].issued_bytes += length;
+            } else {
+                // The context has to outlive this call.
+                core::IAsyncContext *context_copy;
+                core::Status result = context.DeepCopy(context_copy);
+                if (result != core::Status::Ok) {
+                    return result;
+                }
+                queues_[idx].push_back(QueuedWrite{issue, file, source, dest, length, callback, context_copy,
+                                                   now});
+                ++num_queued_;
+                IoClassStats &stats = stats_[idx];
+                stats.queue_depth = queues_[idx].size();
+                stats.max_queue_depth = std::max(stats.max_queue_depth, stats.queue_depth);
+                return core::Status::Ok;
+            }
+        }
+        return issue(file, source, dest, length, callback, context);
+    }
+
+    /// Issues the queued writes that are within budget now. Returns whether it issued any.
+    bool Pump() {
+        if (num_queued_.load(std::memory_order_relaxed) == 0) {
+            return false;
+        }
+        bool issued = false;
+        for (uint32_t idx = 0; idx < kNumClasses; ++idx) {
+            while (true) {
+                QueuedWrite write;
+                {
+                    std::lock_guard<std::mutex> lock{mutex_};
+                    uint64_t now = NowUs();
+                    if (queues_[idx].empty() || !TryConsume(buckets_[idx], queues_[idx].front().length, now)) {
+                        break;
+                    }
+                    write = queues_[idx].front();
+                    queues_[idx].pop_front();
+                    --num_queued_;
+                    IoClassStats &stats = stats_[idx];
+                    stats.queue_depth = queues_[idx].size();
+                    ++stats.issued_ios;
+                    stats.issued_bytes += write.length;
+                    ++stats.deferred_ios;
+                    uint64_t wait_us = now - write.enqueued_us;
+                    stats.total_wait_us += wait_us;
+                    stats.max_wait_us = std::max(stats.max_wait_us, wait_us);
+                }
+                core::Status result = write.issue(write.file, write.source, write.dest, write.length,
+                                                  write.callback, *write.context);
+                if (result != core::Status::Ok) {
+                    // Nobody is waiting for a return value any more; report it to the callback (which
+                    // also frees the context).
+                    write.callback(write.context, result, 0);
+                }
+                issued = true;
+            }
+        }
+        return issued;
+    }
+
+    IoClassStats GetStats(IoClass io_class) const {
+        std::lock_guard<std::mutex> lock{mutex_};
+        IoClassStats stats = stats_[index(io_class)];
+        if (io_class == IoClass::ForegroundRead) {
+            stats.issued_ios = read_ios_.load();
+            stats.issued_bytes = read_bytes_.load();
+        }
+        return stats;
+    }
+
+private:
+    static constexpr uint32_t kNumClasses = static_cast<uint32_t>(IoClass::NumClasses);
+
+    struct Bucket {
+        /// Budget, in bytes per second; 0 means unlimited.
+        uint64_t rate;
+        /// May go negative: a write is admitted whenever the bucket is not in debt, so writes larger
+        /// than the burst still get through.
+        double tokens;
+        uint64_t last_refill_us;
+    };
+
+    struct QueuedWrite {
+        issue_t issue;
+        void *file;
+        const void *source;
+        uint64_t dest;
+        uint32_t length;
+        core::AsyncIOCallback callback;
+        core::IAsyncContext *context;
+        uint64_t enqueued_us;
+    };
+
+    static inline uint32_t index(IoClass io_class) {
+        return static_cast<uint32_t>(io_class);
+    }
+
+    static inline uint64_t NowUs() {
+        return std::chrono::duration_cast<std::chrono::microseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    static inline double Burst(const Bucket &bucket) {
+        return bucket.rate * kBurstSeconds;
+    }
+
+    /// Called under mutex_.
+    inline bool TryConsume(Bucket &bucket, uint32_t length, uint64_t now) {
+        if (bucket.rate == 0) {
+            return true;
+        }
+        if (adaptive_.load(std::memory_order_relaxed) &&
+            now - last_read_us_.load(std::memory_order_relaxed) > kIdleReadWindowUs) {
+            // No reads to protect.
+            return true;
+        }
+        bucket.tokens = std::min(Burst(bucket),
+                                 bucket.tokens + (now - bucket.last_refill_us) * 1e-6 * bucket.rate);
+        bucket.last_refill_us = now;
+        if (bucket.tokens < 0) {
+            return false;
+        }
+        bucket.tokens -= length;
+        return true;
+    }
+
+    std::atomic<bool> enabled_;
+    std::atomic<bool> adaptive_;
+    std::atomic<uint64_t> last_read_us_;
+    std::atomic<uint64_t> num_queued_;
+    std::atomic<uint64_t> read_ios_;
+    std::atomic<uint64_t> read_bytes_;
+
+    mutable std::mutex mutex_;
+    Bucket buckets_[kNumClasses];
+    std::deque<QueuedWrite> queues_[kNumClasses];
+    IoClassStats stats_[kNumClasses];
+};
+
+}
+} // namespace FASTER::device
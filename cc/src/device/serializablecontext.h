@@ -6,6 +6,7 @@
 #define HASHCOMP_SERIALIZABLECONTEXT_H
 
 #include "core/faster.h"
+#include "core/gen_lock.h"
 #include "core/key_hash.h"
 #include "core/utility.h"
 
@@ -161,78 +162,6 @@ class DeleteContext;
 
 class ReadContext;
 
-class GenLock {
-public:
-    GenLock() : control_{0} {}
-
-    GenLock(uint64_t control) : control_{control} {}
-
-    inline GenLock &operator=(const GenLock &other) {
-        control_ = other.control_;
-        return *this;
-    }
-
-    union {
-        struct {
-            uint64_t gen_number : 62;
-            uint64_t locked : 1;
-            uint64_t replaced : 1;
-        };
-        uint64_t control_;
-    };
-};
-
-static_assert(sizeof(GenLock) == 8, "sizeof(GenLock) != 8");
-
-class AtomicGenLock {
-public:
-    AtomicGenLock() : control_{0} {}
-
-    AtomicGenLock(uint64_t control) : control_{control} {}
-
-    inline GenLock load() const {
-        return GenLock{control_.load()};
-    }
-
-    inline void store(GenLock desired) {
-        control_.store(desired.control_);
-    }
-
-    inline bool try_lock(bool &replaced) {
-        replaced = false;
-        GenLock expected{control_.load()};
-        expected.locked = 0;
-        expected.replaced = 0;
-        GenLock desired{expected.control_};
-        desired.locked = 1;
-
-        if (control_.compare_exchange_strong(expected.control_, desired.control_)) {
-            return true;
-        }
-        if (expected.replaced) {
-            replaced = true;
-        }
-        return false;
-    }
-
-    inline void unlock(bool replaced) {
-        if (!replaced) {
-            // Just turn off "locked" bit and increase gen number.
-            uint64_t sub_delta = ((uint64_t) 1 << 62) - 1;
-            control_.fetch_sub(sub_delta);
-        } else {
-            // Turn off "locked" bit, turn on "replaced" bit, and increase gen number
-            uint64_t add_delta = ((uint64_t) 1 << 63) - ((uint64_t) 1 << 62) + 1;
-            control_.fetch_add(add_delta);
-        }
-    }
-
-private:
-    std::atomic<uint64_t> control_;
-};
-
-static_assert(sizeof(AtomicGenLock) == 8, "sizeof(AtomicGenLock) != 8");
-
 class Value {
 public:
     Value() : gen_lock_{0}, length_{0} {}
@@ -396,10 +325,7 @@ public:
 
     inline bool PutAtomic(Value &value) {
         bool replaced;
-        while (!value.gen_lock_.try_lock(replaced) && !replaced) {
-            std::this_thread::yield();
-        }
-        if (replaced) {
+        if (!value.gen_lock_.lock(replaced)) {
             // Some other thread replaced this record.
             return false;
         }
@@ -517,15 +443,8 @@ public:
     }
 
     inline void GetAtomic(const Value &value) {
-        //value.setLocalBuffer();
-        GenLock before, after;
-        do {
-            before = value.gen_lock_.load();
-            Get(value);
-            do {
-                after = value.gen_lock_.load();
-            } while (after.locked /*|| after.replaced*/);
-        } while (before.gen_number != after.gen_number);
+        // Optimistic read; re-copies if a writer updated the value in the meantime.
+        value.gen_lock_.read([&]() { Get(value); });
     }
 
 protected:
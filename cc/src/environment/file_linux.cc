@@ -7,6 +7,7 @@
 #include <errno.h>
 #include <fcntl.h>
 #include <libgen.h>
+#include <sys/mman.h>
 #include <stdio.h>
 #include <time.h>
 #include "file_linux.h"
@@ -194,6 +195,36 @@ Status QueueFile::ScheduleOperation(FileOperationType operationType, uint8_t *bu
     return Status::Ok;
 }
 
+Status FileMapping::Map(const std::string &filename, uint64_t size) {
+    Unmap();
+    int fd = ::open(filename.c_str(), O_RDONLY);
+    if (fd == -1) {
+        return Status::IOError;
+    }
+    struct stat stat_buffer;
+    if (::fstat(fd, &stat_buffer) == -1 || static_cast<uint64_t>(stat_buffer.st_size) < size) {
+        ::close(fd);
+        return Status::IOError;
+    }
+    // The mapping keeps its own reference to the file.
+    void *data = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (data == MAP_FAILED) {
+        return Status::IOError;
+    }
+    data_ = data;
+    size_ = size;
+    return Status::Ok;
+}
+
+void FileMapping::Unmap() {
+    if (data_) {
+        ::munmap(data_, size_);
+        data_ = nullptr;
+        size_ = 0;
+    }
+}
+
 #undef DCHECK_ALIGNMENT
 
 }
@@ -245,5 +245,40 @@ private:
     io_context_t io_object_;
 };
 
+
+/// A private (copy-on-write) memory mapping of the start of a file: the mapped bytes read as the
+/// file's contents, but writes to them go to anonymous pages and never reach the file. Pages are
+/// read in on first access.
+class FileMapping {
+public:
+    FileMapping()
+            : data_{nullptr}, size_{0} {
+    }
+
+    ~FileMapping() {
+        Unmap();
+    }
+
+    // No copy constructor.
+    FileMapping(const FileMapping &other) = delete;
+
+    /// Maps the first "size" bytes of "filename", which must be at least that long.
+    Status Map(const std::string &filename, uint64_t size);
+
+    void Unmap();
+
+    inline void *data() const {
+        return data_;
+    }
+
+    inline uint64_t size() const {
+        return size_;
+    }
+
+private:
+    void *data_;
+    uint64_t size_;
+};
+
 }
 } // namespace FASTER::environment
@@ -383,6 +383,42 @@ Status QueueFile::ScheduleOperation(FileOperationType operationType, uint8_t *bu
     return Status::Ok;
 }
 
+Status FileMapping::Map(const std::string &filename, uint64_t size) {
+    Unmap();
+    HANDLE file_handle = ::CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+                                       OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file_handle == INVALID_HANDLE_VALUE) {
+        return Status::IOError;
+    }
+    LARGE_INTEGER file_size;
+    if (!::GetFileSizeEx(file_handle, &file_size) || static_cast<uint64_t>(file_size.QuadPart) < size) {
+        ::CloseHandle(file_handle);
+        return Status::IOError;
+    }
+    HANDLE mapping = ::CreateFileMappingA(file_handle, nullptr, PAGE_WRITECOPY, 0, 0, nullptr);
+    ::CloseHandle(file_handle);
+    if (mapping == nullptr) {
+        return Status::IOError;
+    }
+    // The view keeps its own reference to the mapping.
+    void *data = ::MapViewOfFile(mapping, FILE_MAP_COPY, 0, 0, size);
+    ::CloseHandle(mapping);
+    if (data == nullptr) {
+        return Status::IOError;
+    }
+    data_ = data;
+    size_ = size;
+    return Status::Ok;
+}
+
+void FileMapping::Unmap() {
+    if (data_) {
+        ::UnmapViewOfFile(data_);
+        data_ = nullptr;
+        size_ = 0;
+    }
+}
+
 #undef DCHECK_ALIGNMENT
 
 }
@@ -0,0 +1,12 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT license.
+
+#pragma once
+
+#ifdef _WIN32
+#include "socket_windows.h"
+#else
+
+#include "socket_linux.h"
+
+#endif
@@ -0,0 +1,187 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT license.
+
+#include <cstring>
+#include <errno.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include "socket_linux.h"
+
+namespace FASTER {
+namespace environment {
+
+using core::Status;
+
+static constexpr const char *kUnixPrefix = "unix:";
+
+/// Resolves "endpoint" and opens a socket of the right family for it.
+static Status OpenEndpoint(const std::string &endpoint, bool passive, int &fd, sockaddr_storage &address,
+                           socklen_t &address_length) {
+    std::memset(&address, 0, sizeof(address));
+    if (endpoint.compare(0, std::strlen(kUnixPrefix), kUnixPrefix) == 0) {
+        std::string path = endpoint.substr(std::strlen(kUnixPrefix));
+        sockaddr_un *unix_address = reinterpret_cast<sockaddr_un *>(&address);
+        if (path.empty() || path.size() >= sizeof(unix_address->sun_path)) {
+            return Status::IOError;
+        }
+        unix_address->sun_family = AF_UNIX;
+        std::strncpy(unix_address->sun_path, path.c_str(), sizeof(unix_address->sun_path) - 1);
+        address_length = sizeof(sockaddr_un);
+        fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+        return fd == -1 ? Status::IOError : Status::Ok;
+    }
+
+    size_t colon = endpoint.rfind(':');
+    if (colon == std::string::npos) {
+        return Status::IOError;
+    }
+    std::string host = endpoint.substr(0, colon);
+    std::string port = endpoint.substr(colon + 1);
+    addrinfo hints;
+    std::memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags = passive ? AI_PASSIVE : 0;
+    addrinfo *result;
+    if (::getaddrinfo(host.empty() ? nullptr : host.c_str(), port.c_str(), &hints, &result) != 0) {
+        return Status::IOError;
+    }
+    std::memcpy(&address, result->ai_addr, result->ai_addrlen);
+    address_length = result->ai_addrlen;
+    fd = ::socket(result->ai_family, result->ai_socktype, result->ai_protocol);
+    ::freeaddrinfo(result);
+    if (fd == -1) {
+        return Status::IOError;
+    }
+    // Replication batches its own messages.
+    int one = 1;
+    ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    return Status::Ok;
+}
+
+Status Socket::Listen(const std::string &endpoint) {
+    Close();
+    sockaddr_storage address;
+    socklen_t address_length;
+    Status result = OpenEndpoint(endpoint, true, fd_, address, address_length);
+    if (result != Status::Ok) {
+        return result;
+    }
+    if (address.ss_family == AF_UNIX) {
+        ::unlink(reinterpret_cast<sockaddr_un *>(&address)->sun_path);
+    } else {
+        int one = 1;
+        ::setsockopt(fd_, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    }
+    if (::bind(fd_, reinterpret_cast<sockaddr *>(&address), address_length) == -1 ||
+        ::listen(fd_, SOMAXCONN) == -1) {
+        Close();
+        return Status::IOError;
+    }
+    return Status::Ok;
+}
+
+Status Socket::Accept(Socket &connection) {
+    int fd = ::accept(fd_, nullptr, nullptr);
+    if (fd == -1) {
+        return Status::IOError;
+    }
+    int one = 1;
+    ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    connection.Close();
+    connection.fd_ = fd;
+    return Status::Ok;
+}
+
+Status Socket::Connect(const std::string &endpoint) {
+    Close();
+    sockaddr_storage address;
+    socklen_t address_length;
+    Status result = OpenEndpoint(endpoint, false, fd_, address, address_length);
+    if (result != Status::Ok) {
+        return result;
+    }
+    if (::connect(fd_, reinterpret_cast<sockaddr *>(&address), address_length) == -1) {
+        Close();
+        return Status::IOError;
+    }
+    return Status::Ok;
+}
+
+Status Socket::Send(const void *buffer, size_t length) {
+    const uint8_t *bytes = reinterpret_cast<const uint8_t *>(buffer);
+    while (length > 0) {
+        // (A closed peer shows up as EPIPE, not as SIGPIPE.)
+        ssize_t sent = ::send(fd_, bytes, length, MSG_NOSIGNAL);
+        if (sent == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return Status::IOError;
+        }
+        bytes += sent;
+        length -= sent;
+    }
+    return Status::Ok;
+}
+
+Status Socket::Receive(void *buffer, size_t length) {
+    uint8_t *bytes = reinterpret_cast<uint8_t *>(buffer);
+    while (length > 0) {
+        ssize_t received = ::recv(fd_, bytes, length, 0);
+        if (received == 0) {
+            return Status::Aborted;
+        }
+        if (received == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return Status::IOError;
+        }
+        bytes += received;
+        length -= received;
+    }
+    return Status::Ok;
+}
+
+Status Socket::Poll(uint32_t timeout_ms) {
+    pollfd poll_fd;
+    poll_fd.fd = fd_;
+    poll_fd.events = POLLIN;
+    poll_fd.revents = 0;
+    int result = ::poll(&poll_fd, 1, static_cast<int>(timeout_ms));
+    if (result == -1) {
+        return errno == EINTR ? Status::Pending : Status::IOError;
+    }
+    // (A hang-up is readable too: Receive() will report it.)
+    return result == 0 ? Status::Pending : Status::Ok;
+}
+
+void Socket::Close() {
+    if (fd_ != -1) {
+        ::close(fd_);
+        fd_ = -1;
+    }
+}
+
+uint16_t Socket::port() const {
+    sockaddr_storage address;
+    socklen_t address_length = sizeof(address);
+    if (::getsockname(fd_, reinterpret_cast<sockaddr *>(&address), &address_length) == -1) {
+        return 0;
+    }
+    if (address.ss_family == AF_INET) {
+        return ntohs(reinterpret_cast<sockaddr_in *>(&address)->sin_port);
+    } else if (address.ss_family == AF_INET6) {
+        return ntohs(reinterpret_cast<sockaddr_in6 *>(&address)->sin6_port);
+    }
+    return 0;
+}
+
+}
+} // namespace FASTER::environment
@@ -0,0 +1,80 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT license.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "../core/status.h"
+
+namespace FASTER {
+namespace environment {
+
+/// A blocking stream socket: TCP, or a Unix-domain socket. Endpoints are written "host:port" or
+/// "unix:<path>".
+class Socket {
+public:
+    Socket()
+            : fd_{-1} {
+    }
+
+    /// Move constructor.
+    Socket(Socket &&other)
+            : fd_{other.fd_} {
+        other.fd_ = -1;
+    }
+
+    ~Socket() {
+        Close();
+    }
+
+    /// Move assignment operator.
+    Socket &operator=(Socket &&other) {
+        if (this != &other) {
+            Close();
+            fd_ = other.fd_;
+            other.fd_ = -1;
+        }
+        return *this;
+    }
+
+    // No copy constructor.
+    Socket(const Socket &other) = delete;
+
+    /// Binds "endpoint" and listens on it. (A Unix-domain socket's file is replaced; port 0 picks
+    /// a free port, see port().)
+    core::Status Listen(const std::string &endpoint);
+
+    /// Waits for a connection to this listening socket.
+    core::Status Accept(Socket &connection);
+
+    core::Status Connect(const std::string &endpoint);
+
+    /// Sends all "length" bytes.
+    core::Status Send(const void *buffer, size_t length);
+
+    /// Receives exactly "length" bytes. Returns Status::Aborted if the peer closed the connection
+    /// first.
+    core::Status Receive(void *buffer, size_t length);
+
+    /// Waits up to "timeout_ms" for something to Receive() (or Accept()); returns Status::Pending if
+    /// nothing came.
+    core::Status Poll(uint32_t timeout_ms);
+
+    void Close();
+
+    inline bool valid() const {
+        return fd_ != -1;
+    }
+
+    /// The local TCP port; 0 for Unix-domain sockets.
+    uint16_t port() const;
+
+private:
+    int fd_;
+};
+
+}
+} // namespace FASTER::environment
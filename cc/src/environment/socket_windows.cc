@@ -0,0 +1,173 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT license.
+
+#include <algorithm>
+#include <climits>
+#include <cstring>
+#include <mutex>
+#include <WS2tcpip.h>
+#include "socket.h"
+
+using namespace FASTER::core;
+
+namespace FASTER {
+namespace environment {
+
+/// Winsock has to be started once per process, before the first socket is opened.
+static Status StartWinsock() {
+    static std::once_flag once;
+    static int result = 0;
+    std::call_once(once, []() {
+        WSADATA data;
+        result = ::WSAStartup(MAKEWORD(2, 2), &data);
+    });
+    return result == 0 ? Status::Ok : Status::IOError;
+}
+
+/// Resolves "endpoint" and opens a socket of the right family for it.
+static Status OpenEndpoint(const std::string &endpoint, bool passive, SOCKET &socket,
+                          sockaddr_storage &address, int &address_length) {
+    Status result = StartWinsock();
+    if (result != Status::Ok) {
+        return result;
+    }
+    size_t colon = endpoint.rfind(':');
+    if (endpoint.compare(0, 5, "unix:") == 0 || colon == std::string::npos) {
+        return Status::IOError;
+    }
+    std::string host = endpoint.substr(0, colon);
+    std::string port = endpoint.substr(colon + 1);
+    addrinfo hints;
+    std::memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_protocol = IPPROTO_TCP;
+    hints.ai_flags = passive ? AI_PASSIVE : 0;
+    addrinfo *info;
+    if (::getaddrinfo(host.empty() ? nullptr : host.c_str(), port.c_str(), &hints, &info) != 0) {
+        return Status::IOError;
+    }
+    std::memset(&address, 0, sizeof(address));
+    std::memcpy(&address, info->ai_addr, info->ai_addrlen);
+    address_length = static_cast<int>(info->ai_addrlen);
+    socket = ::socket(info->ai_family, info->ai_socktype, info->ai_protocol);
+    ::freeaddrinfo(info);
+    if (socket == INVALID_SOCKET) {
+        return Status::IOError;
+    }
+    // Replication batches its own messages.
+    BOOL one = TRUE;
+    ::setsockopt(socket, IPPROTO_TCP, TCP_NODELAY, reinterpret_cast<const char *>(&one), sizeof(one));
+    return Status::Ok;
+}
+
+Status Socket::Listen(const std::string &endpoint) {
+    Close();
+    sockaddr_storage address;
+    int address_length;
+    Status result = OpenEndpoint(endpoint, true, socket_, address, address_length);
+    if (result != Status::Ok) {
+        return result;
+    }
+    if (::bind(socket_, reinterpret_cast<sockaddr *>(&address), address_length) == SOCKET_ERROR ||
+        ::listen(socket_, SOMAXCONN) == SOCKET_ERROR) {
+        Close();
+        return Status::IOError;
+    }
+    return Status::Ok;
+}
+
+Status Socket::Accept(Socket &connection) {
+    SOCKET socket = ::accept(socket_, nullptr, nullptr);
+    if (socket == INVALID_SOCKET) {
+        return Status::IOError;
+    }
+    BOOL one = TRUE;
+    ::setsockopt(socket, IPPROTO_TCP, TCP_NODELAY, reinterpret_cast<const char *>(&one), sizeof(one));
+    connection.Close();
+    connection.socket_ = socket;
+    return Status::Ok;
+}
+
+Status Socket::Connect(const std::string &endpoint) {
+    Close();
+    sockaddr_storage address;
+    int address_length;
+    Status result = OpenEndpoint(endpoint, false, socket_, address, address_length);
+    if (result != Status::Ok) {
+        return result;
+    }
+    if (::connect(socket_, reinterpret_cast<sockaddr *>(&address), address_length) == SOCKET_ERROR) {
+        Close();
+        return Status::IOError;
+    }
+    return Status::Ok;
+}
+
+Status Socket::Send(const void *buffer, size_t length) {
+    const char *bytes = reinterpret_cast<const char *>(buffer);
+    while (length > 0) {
+        int chunk = static_cast<int>(std::min<size_t>(length, INT_MAX));
+        int sent = ::send(socket_, bytes, chunk, 0);
+        if (sent == SOCKET_ERROR) {
+            return Status::IOError;
+        }
+        bytes += sent;
+        length -= sent;
+    }
+    return Status::Ok;
+}
+
+Status Socket::Receive(void *buffer, size_t length) {
+    char *bytes = reinterpret_cast<char *>(buffer);
+    while (length > 0) {
+        int chunk = static_cast<int>(std::min<size_t>(length, INT_MAX));
+        int received = ::recv(socket_, bytes, chunk, 0);
+        if (received == 0) {
+            return Status::Aborted;
+        }
+        if (received == SOCKET_ERROR) {
+            return Status::IOError;
+        }
+        bytes += received;
+        length -= received;
+    }
+    return Status::Ok;
+}
+
+Status Socket::Poll(uint32_t timeout_ms) {
+    WSAPOLLFD poll_fd;
+    poll_fd.fd = socket_;
+    poll_fd.events = POLLRDNORM;
+    poll_fd.revents = 0;
+    int result = ::WSAPoll(&poll_fd, 1, static_cast<INT>(timeout_ms));
+    if (result == SOCKET_ERROR) {
+        return Status::IOError;
+    }
+    // (A hang-up is readable too: Receive() will report it.)
+    return result == 0 ? Status::Pending : Status::Ok;
+}
+
+void Socket::Close() {
+    if (socket_ != INVALID_SOCKET) {
+        ::closesocket(socket_);
+        socket_ = INVALID_SOCKET;
+    }
+}
+
+uint16_t Socket::port() const {
+    sockaddr_storage address;
+    int address_length = sizeof(address);
+    if (::getsockname(socket_, reinterpret_cast<sockaddr *>(&address), &address_length) == SOCKET_ERROR) {
+        return 0;
+    }
+    if (address.ss_family == AF_INET) {
+        return ntohs(reinterpret_cast<sockaddr_in *>(&address)->sin_port);
+    } else if (address.ss_family == AF_INET6) {
+        return ntohs(reinterpret_cast<sockaddr_in6 *>(&address)->sin6_port);
+    }
+    return 0;
+}
+
+}
+} // namespace FASTER::environment
@@ -0,0 +1,85 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT license.
+
+#pragma once
+
+#ifdef _WIN32
+#define NOMINMAX
+#define _WINSOCKAPI_
+#include <WinSock2.h>
+#endif
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "../core/status.h"
+
+namespace FASTER {
+namespace environment {
+
+/// A blocking stream socket. Endpoints are written "host:port"; Unix-domain ("unix:<path>")
+/// endpoints are not supported on Windows.
+class Socket {
+public:
+    Socket()
+            : socket_{INVALID_SOCKET} {
+    }
+
+    /// Move constructor.
+    Socket(Socket &&other)
+            : socket_{other.socket_} {
+        other.socket_ = INVALID_SOCKET;
+    }
+
+    ~Socket() {
+        Close();
+    }
+
+    /// Move assignment operator.
+    Socket &operator=(Socket &&other) {
+        if (this != &other) {
+            Close();
+            socket_ = other.socket_;
+            other.socket_ = INVALID_SOCKET;
+        }
+        return *this;
+    }
+
+    // No copy constructor.
+    Socket(const Socket &other) = delete;
+
+    /// Binds "endpoint" and listens on it. (Port 0 picks a free port, see port().)
+    core::Status Listen(const std::string &endpoint);
+
+    /// Waits for a connection to this listening socket.
+    core::Status Accept(Socket &connection);
+
+    core::Status Connect(const std::string &endpoint);
+
+    /// Sends all "length" bytes.
+    core::Status Send(const void *buffer, size_t length);
+
+    /// Receives exactly "length" bytes. Returns Status::Aborted if the peer closed the connection
+    /// first.
+    core::Status Receive(void *buffer, size_t length);
+
+    /// Waits up to "timeout_ms" for something to Receive() (or Accept()); returns Status::Pending if
+    /// nothing came.
+    core::Status Poll(uint32_t timeout_ms);
+
+    void Close();
+
+    inline bool valid() const {
+        return socket_ != INVALID_SOCKET;
+    }
+
+    /// The local TCP port.
+    uint16_t port() const;
+
+private:
+    SOCKET socket_;
+};
+
+}
+} // namespace FASTER::environment
@@ -0,0 +1,173 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT license.
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <thread>
+#include "gtest/gtest.h"
+
+#include "core/checkpoint_scheduler.h"
+
+using namespace FASTER::core;
+
+/// Stands in for FasterKv: checkpoints complete when the test says so.
+class MockStore {
+public:
+    typedef void(*index_callback_t)(Status result);
+    typedef void(*log_callback_t)(Status result, uint64_t persistent_serial_num);
+
+    MockStore()
+            : log_bytes{0}, busy{false}, in_progress{false}, hybrid_log_checkpoints{0}, full_checkpoints{0},
+              callback{nullptr} {
+    }
+
+    bool CheckpointHybridLog(log_callback_t callback_, Guid &token) {
+        if (!Start(callback_)) {
+            return false;
+        }
+        ++hybrid_log_checkpoints;
+        return true;
+    }
+
+    bool Checkpoint(index_callback_t index_callback, log_callback_t callback_, Guid &token) {
+        if (!Start(callback_)) {
+            return false;
+        }
+        ++full_checkpoints;
+        return true;
+    }
+
+    bool CheckpointCheck() const {
+        return !in_progress;
+    }
+
+    uint64_t LogBytes() const {
+        return log_bytes;
+    }
+
+    const Guid &SessionId() const {
+        return session_id;
+    }
+
+    /// Plays the part of a session passing the persistence point, then of the store going back to
+    /// rest.
+    void Complete(const Guid &session, uint64_t serial_num) {
+        session_id = session;
+        callback.load()(Status::Ok, serial_num);
+        in_progress = false;
+    }
+
+    std::atomic<uint64_t> log_bytes;
+    /// A GC or GrowIndex() is running.
+    std::atomic<bool> busy;
+    std::atomic<bool> in_progress;
+    std::atomic<uint32_t> hybrid_log_checkpoints;
+    std::atomic<uint32_t> full_checkpoints;
+    std::atomic<log_callback_t> callback;
+
+private:
+    bool Start(log_callback_t callback_) {
+        if (busy || in_progress) {
+            return false;
+        }
+        callback = callback_;
+        in_progress = true;
+        return true;
+    }
+
+    Guid session_id;
+};
+
+typedef CheckpointScheduler<MockStore> scheduler_t;
+
+template<class F>
+static bool WaitFor(F condition) {
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds{10};
+    while (!condition()) {
+        if (std::chrono::steady_clock::now() > deadline) {
+            return false;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds{1});
+    }
+    return true;
+}
+
+TEST(CheckpointScheduler, Interval) {
+    MockStore store;
+    CheckpointPolicy policy;
+    policy.interval = std::chrono::milliseconds{20};
+    policy.poll_interval = std::chrono::milliseconds{1};
+    scheduler_t scheduler{store, policy};
+
+    ASSERT_TRUE(WaitFor([&]() { return store.in_progress.load(); }));
+    ASSERT_EQ(1, store.hybrid_log_checkpoints.load());
+    // Nothing else starts while that one is running.
+    std::this_thread::sleep_for(std::chrono::milliseconds{50});
+    ASSERT_EQ(1, store.hybrid_log_checkpoints.load());
+    ASSERT_EQ(0, scheduler.GetStats().checkpoints_completed);
+
+    Guid session = Guid::Create();
+    store.Complete(session, 42);
+    ASSERT_EQ(42, scheduler.DurableSerialNum(session));
+    ASSERT_TRUE(WaitFor([&]() { return scheduler.GetStats().checkpoints_completed == 1; }));
+    ASSERT_TRUE(WaitFor([&]() { return store.hybrid_log_checkpoints.load() == 2; }));
+    CheckpointSchedulerStats stats = scheduler.GetStats();
+    ASSERT_EQ(2, stats.checkpoints_started);
+    ASSERT_EQ(0, stats.index_checkpoints_started);
+    ASSERT_GE(stats.max_duration, std::chrono::milliseconds{50});
+}
+
+TEST(CheckpointScheduler, LogBytesAndIndex) {
+    MockStore store;
+    CheckpointPolicy policy;
+    policy.interval = std::chrono::milliseconds{0};
+    policy.log_bytes = 1000;
+    policy.index_every = 2;
+    policy.poll_interval = std::chrono::milliseconds{1};
+    uint64_t last_durable = 0;
+    scheduler_t scheduler{store, policy, [&](const Guid &session_id, uint64_t persistent_serial_num) {
+        last_durable = persistent_serial_num;
+    }};
+    Guid session = Guid::Create();
+
+    std::this_thread::sleep_for(std::chrono::milliseconds{20});
+    store.log_bytes = 999;
+    std::this_thread::sleep_for(std::chrono::milliseconds{20});
+    ASSERT_FALSE(store.in_progress.load());
+
+    store.log_bytes = 1000;
+    ASSERT_TRUE(WaitFor([&]() { return store.in_progress.load(); }));
+    ASSERT_EQ(1, store.hybrid_log_checkpoints.load());
+    store.Complete(session, 1);
+    ASSERT_EQ(1, last_durable);
+
+    // The next one also checkpoints the index.
+    store.log_bytes = 2000;
+    ASSERT_TRUE(WaitFor([&]() { return store.in_progress.load(); }));
+    ASSERT_EQ(1, store.full_checkpoints.load());
+    store.Complete(session, 2);
+    ASSERT_EQ(2, last_durable);
+    ASSERT_EQ(2, scheduler.DurableSerialNum(session));
+    ASSERT_EQ(1, scheduler.GetStats().index_checkpoints_started);
+}
+
+TEST(CheckpointScheduler, Postpone) {
+    MockStore store;
+    store.busy = true;
+    CheckpointPolicy policy;
+    policy.interval = std::chrono::milliseconds{1};
+    policy.poll_interval = std::chrono::milliseconds{1};
+    scheduler_t scheduler{store, policy};
+
+    ASSERT_TRUE(WaitFor([&]() { return scheduler.GetStats().checkpoints_postponed >= 3; }));
+    ASSERT_EQ(0, scheduler.GetStats().checkpoints_started);
+    store.busy = false;
+    ASSERT_TRUE(WaitFor([&]() { return store.in_progress.load(); }));
+    ASSERT_EQ(1, scheduler.GetStats().checkpoints_started);
+}
+
+int main(int argc, char **argv) {
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
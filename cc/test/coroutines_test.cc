@@ -0,0 +1,268 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT license.
+
+#include <cstdint>
+#include <deque>
+#include <experimental/filesystem>
+#include <stdexcept>
+#include <utility>
+#include "gtest/gtest.h"
+
+#include "core/coroutines.h"
+#include "core/faster.h"
+#include "device/file_system_disk.h"
+
+#include "test_types.h"
+
+using namespace FASTER::core;
+using FASTER::test::Key;
+
+/// Stands in for FasterKv: odd keys go "to disk", and complete (one per call) from
+/// CompletePending(), the way FASTER hands pending operations back to their callbacks.
+class FakeStore {
+public:
+    template<class RC>
+    Status Read(RC &context, AsyncCallback callback, uint64_t monotonic_serial_num) {
+        if (context.key % 2 == 0) {
+            context.value = context.key * 10;
+            return Status::Ok;
+        }
+        IAsyncContext *context_copy;
+        Status result = context.DeepCopy(context_copy);
+        if (result != Status::Ok) {
+            return result;
+        }
+        if (context_copy == &context) {
+            ++num_in_place;
+        }
+        pending.emplace_back(context_copy, callback);
+        max_pending = std::max(max_pending, static_cast<uint64_t>(pending.size()));
+        return Status::Pending;
+    }
+
+    bool CompletePending(bool wait) {
+        if (!pending.empty()) {
+            auto op = pending.front();
+            pending.pop_front();
+            ReadContext *context = static_cast<ReadContext *>(op.first);
+            context->value = context->key * 10;
+            op.second(op.first, Status::Ok);
+        }
+        return pending.empty();
+    }
+
+    class ReadContext : public IAsyncContext {
+    public:
+        ReadContext(uint64_t key_)
+                : key{key_}, value{0} {
+        }
+
+    protected:
+        Status DeepCopy_Internal(IAsyncContext *&context_copy) {
+            return IAsyncContext::DeepCopy_Internal(*this, context_copy);
+        }
+
+    public:
+        uint64_t key;
+        uint64_t value;
+    };
+
+    std::deque<std::pair<IAsyncContext *, AsyncCallback>> pending;
+    uint64_t max_pending = 0;
+    uint64_t num_in_place = 0;
+};
+
+typedef CoroutineScheduler<FakeStore> scheduler_t;
+
+static StoreTask ReadKeys(scheduler_t &scheduler, uint64_t first_key, uint64_t num_keys,
+                          uint64_t &sum) {
+    for (uint64_t key = first_key; key < first_key + num_keys; ++key) {
+        CoroutineContext<FakeStore::ReadContext> context{key};
+        Status result = co_await ReadAsync(scheduler, context, key);
+        if (result == Status::Ok) {
+            sum += context.value;
+        }
+    }
+}
+
+TEST(Coroutines, ReadsSuspendWithoutCopy) {
+    static constexpr uint64_t kNumTasks = 32;
+    static constexpr uint64_t kKeysPerTask = 100;
+    FakeStore store;
+    scheduler_t scheduler{store};
+    uint64_t sum = 0;
+    for (uint64_t idx = 0; idx < kNumTasks; ++idx) {
+        scheduler.Spawn(ReadKeys(scheduler, idx * kKeysPerTask, kKeysPerTask, sum));
+    }
+    scheduler.Run();
+
+    ASSERT_EQ(0, scheduler.num_live_tasks());
+    uint64_t num_keys = kNumTasks * kKeysPerTask;
+    ASSERT_EQ(10 * (num_keys * (num_keys - 1) / 2), sum);
+    // Every odd key went pending, in place, and all tasks had one outstanding at the same time.
+    ASSERT_EQ(num_keys / 2, store.num_in_place);
+    ASSERT_EQ(kNumTasks, store.max_pending);
+}
+
+static StoreTask Throw(scheduler_t &scheduler) {
+    CoroutineContext<FakeStore::ReadContext> context{1};
+    co_await ReadAsync(scheduler, context, 1);
+    throw std::runtime_error{"task failed"};
+}
+
+TEST(Coroutines, ExceptionPropagates) {
+    FakeStore store;
+    scheduler_t scheduler{store};
+    scheduler.Spawn(Throw(scheduler));
+    ASSERT_THROW(scheduler.Run(), std::runtime_error);
+    ASSERT_EQ(0, scheduler.num_live_tasks());
+}
+
+/// A 1 KB value, so that a few pages of records push the oldest ones out to disk.
+class LargeValue {
+public:
+    LargeValue()
+            : data{} {
+    }
+
+    inline static constexpr uint32_t size() {
+        return static_cast<uint32_t>(sizeof(LargeValue));
+    }
+
+    uint64_t data[128];
+};
+
+class LargeUpsertContext : public IAsyncContext {
+public:
+    typedef Key key_t;
+    typedef LargeValue value_t;
+
+    LargeUpsertContext(uint64_t key)
+            : key_{key}, data_{key} {
+    }
+
+    inline const Key &key() const {
+        return key_;
+    }
+
+    inline static constexpr uint32_t value_size() {
+        return sizeof(value_t);
+    }
+
+    inline static constexpr uint32_t value_length() {
+        return sizeof(value_t);
+    }
+
+    inline void Put(LargeValue &value) {
+        value.data[0] = data_;
+        value.data[127] = data_;
+    }
+
+    inline bool PutAtomic(LargeValue &value) {
+        // Only new records are written.
+        return false;
+    }
+
+protected:
+    Status DeepCopy_Internal(IAsyncContext *&context_copy) {
+        return IAsyncContext::DeepCopy_Internal(*this, context_copy);
+    }
+
+private:
+    Key key_;
+    uint64_t data_;
+};
+
+class LargeReadContext : public IAsyncContext {
+public:
+    typedef Key key_t;
+    typedef LargeValue value_t;
+
+    LargeReadContext(uint64_t key)
+            : key_{key}, first{0}, last{0} {
+    }
+
+    inline const Key &key() const {
+        return key_;
+    }
+
+    inline void Get(const LargeValue &value) {
+        first = value.data[0];
+        last = value.data[127];
+    }
+
+    inline void GetAtomic(const LargeValue &value) {
+        Get(value);
+    }
+
+protected:
+    Status DeepCopy_Internal(IAsyncContext *&context_copy) {
+        return IAsyncContext::DeepCopy_Internal(*this, context_copy);
+    }
+
+private:
+    Key key_;
+public:
+    uint64_t first;
+    uint64_t last;
+};
+
+typedef FASTER::device::FileSystemDisk<FASTER::environment::QueueIoHandler, 33554432L> disk_t;
+typedef FasterKv<Key, LargeValue, disk_t> store_t;
+typedef CoroutineScheduler<store_t> store_scheduler_t;
+
+static StoreTask UpsertKeys(store_scheduler_t &scheduler, uint64_t num_keys, uint64_t &num_ok) {
+    for (uint64_t key = 0; key < num_keys; ++key) {
+        CoroutineContext<LargeUpsertContext> context{key};
+        if (co_await UpsertAsync(scheduler, context, key + 1) == Status::Ok) {
+            ++num_ok;
+        }
+        if (key % 256 == 0) {
+            scheduler.store().Refresh();
+        }
+    }
+}
+
+static StoreTask ReadKeys(store_scheduler_t &scheduler, uint64_t first_key, uint64_t num_keys,
+                          uint64_t stride, uint64_t &num_ok) {
+    for (uint64_t key = first_key; key < num_keys; key += stride) {
+        CoroutineContext<LargeReadContext> context{key};
+        if (co_await ReadAsync(scheduler, context, key + 1) == Status::Ok && context.first == key &&
+            context.last == key) {
+            ++num_ok;
+        }
+    }
+}
+
+TEST(Coroutines, FasterKvReadsFromDisk) {
+    // Five 32 MB pages' worth of records, in a six-page log that is 40% mutable.
+    static constexpr uint64_t kNumRecords = 163840;
+    static constexpr uint64_t kNumTasks = 16;
+
+    std::experimental::filesystem::remove_all("coroutine_storage");
+    std::experimental::filesystem::create_directories("coroutine_storage");
+    store_t store{1, 1024, 201326592, "coroutine_storage", 0.4};
+    store.StartSession();
+    store_scheduler_t scheduler{store};
+
+    uint64_t num_upserted = 0;
+    scheduler.Spawn(UpsertKeys(scheduler, kNumRecords, num_upserted));
+    scheduler.Run();
+    ASSERT_EQ(kNumRecords, num_upserted);
+    // The first keys' records have been evicted, so reading them goes pending on disk I/O.
+    ASSERT_GT(store.thlog[0]->head_address.load().page(), 0);
+
+    uint64_t num_read = 0;
+    for (uint64_t idx = 0; idx < kNumTasks; ++idx) {
+        scheduler.Spawn(ReadKeys(scheduler, idx, kNumRecords, kNumTasks, num_read));
+    }
+    scheduler.Run();
+    ASSERT_EQ(0, scheduler.num_live_tasks());
+    ASSERT_EQ(kNumRecords, num_read);
+    store.StopSession();
+}
+
+int main(int argc, char **argv) {
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,148 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT license.
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <experimental/filesystem>
+#include <vector>
+#include "gtest/gtest.h"
+
+#include "core/faster.h"
+#include "device/file_system_disk.h"
+#include "device/null_disk.h"
+
+#include "test_types.h"
+
+using namespace FASTER::core;
+using FASTER::test::Key;
+using FASTER::test::ReadContext;
+using FASTER::test::UpsertContext;
+using FASTER::test::Value;
+
+typedef FasterKv<Key, Value, FASTER::device::NullDisk> store_t;
+
+/// The store keeps its logs in static storage, so the tests share one instance.
+static store_t &Store() {
+    static store_t store{4, 1024, 1073741824, ""};
+    return store;
+}
+
+static void Upsert(uint64_t key, uint64_t data) {
+    UpsertContext context{key, data};
+    Status result = Store().UpsertT(context, [](IAsyncContext *ctxt, Status result) {
+        ASSERT_TRUE(false);
+    }, 1, 1);
+    ASSERT_EQ(Status::Ok, result);
+}
+
+/// The dirty segments of the mutable region of "key"'s log (clearing them).
+static std::vector<Address> CollectDirtySegments(uint64_t key) {
+    store_t &store = Store();
+    uint32_t lane = store.Partition(Key{key});
+    std::vector<Address> segments;
+    store.thlog[lane]->CollectDirtySegments(store.thlog[lane]->read_only_address.load(),
+                                            store.thlog[lane]->GetTailAddress(), segments);
+    return segments;
+}
+
+TEST(DeltaCheckpoint, DirtySegments) {
+    DirtySegments dirty;
+    dirty.Mark(3);
+    dirty.Mark(3);
+    dirty.Mark(DirtySegments::kNumSegments - 1);
+    ASSERT_FALSE(dirty.TestAndClear(0));
+    ASSERT_TRUE(dirty.TestAndClear(3));
+    ASSERT_FALSE(dirty.TestAndClear(3));
+    ASSERT_TRUE(dirty.TestAndClear(DirtySegments::kNumSegments - 1));
+}
+
+TEST(DeltaCheckpoint, WritesMarkSegmentsDirty) {
+    static constexpr uint64_t kKey = 42;
+    store_t &store = Store();
+    store.StartSession();
+
+    // A new record dirties the segment it was written to; collecting clears it.
+    Upsert(kKey, 1);
+    std::vector<Address> segments = CollectDirtySegments(kKey);
+    ASSERT_FALSE(segments.empty());
+    ASSERT_TRUE(CollectDirtySegments(kKey).empty());
+
+    // So does an in-place update, of just that segment.
+    Upsert(kKey, 2);
+    std::vector<Address> updated = CollectDirtySegments(kKey);
+    ASSERT_EQ(1, updated.size());
+    ASSERT_EQ(segments.back(), updated[0]);
+    ASSERT_EQ(0, updated[0].offset() % DirtySegments::kSegmentSize);
+
+    // Segments that are not dirty are not copied again.
+    ASSERT_TRUE(CollectDirtySegments(kKey).empty());
+    store.StopSession();
+}
+
+TEST(DeltaCheckpoint, RecoverBasePlusDeltas) {
+    typedef FASTER::device::FileSystemDisk<FASTER::environment::QueueIoHandler, 33554432L> disk_t;
+    typedef FasterKv<Key, Value, disk_t> file_store_t;
+    static constexpr uint64_t kNumRecords = 2000;
+
+    auto callback = [](IAsyncContext *ctxt, Status result) {
+        ASSERT_TRUE(false);
+    };
+    auto checkpoint = [](file_store_t &store, bool full, Guid &token) {
+        ASSERT_TRUE(full ? store.Checkpoint(nullptr, nullptr, token) : store.CheckpointHybridLog(nullptr, token));
+        while (!store.CheckpointCheck()) {
+            store.CompletePending(false);
+        }
+    };
+
+    std::experimental::filesystem::remove_all("delta_storage");
+    std::experimental::filesystem::create_directories("delta_storage");
+
+    Guid base_token;
+    Guid delta_token;
+    {
+        file_store_t store{2, 1024, 201326592, "delta_storage"};
+        store.StartSession();
+        uint64_t serial_num = 0;
+        for (uint64_t key = 0; key < kNumRecords; ++key) {
+            UpsertContext context{key, key};
+            ASSERT_EQ(Status::Ok, store.UpsertT(context, callback, ++serial_num, 1));
+        }
+        // The base folds the logs over.
+        checkpoint(store, true, base_token);
+
+        store.EnableDeltaCheckpoints();
+        // Updates of read-only records go to new records at the tail...
+        for (uint64_t key = 0; key < kNumRecords; key += 2) {
+            UpsertContext context{key, key + 1000000};
+            ASSERT_EQ(Status::Ok, store.UpsertT(context, callback, ++serial_num, 1));
+        }
+        checkpoint(store, false, delta_token);
+        // ...which the next delta updates in place, superseding the first delta's copies. (It
+        // checkpoints the index too: recovery needs an index checkpoint of the same version.)
+        for (uint64_t key = 0; key < kNumRecords; key += 4) {
+            UpsertContext context{key, key + 2000000};
+            ASSERT_EQ(Status::Ok, store.UpsertT(context, callback, ++serial_num, 1));
+        }
+        checkpoint(store, true, delta_token);
+        store.StopSession();
+    }
+
+    file_store_t store{2, 1024, 201326592, "delta_storage"};
+    uint32_t version;
+    std::vector<Guid> session_ids;
+    ASSERT_EQ(Status::Ok, store.Recover(delta_token, delta_token, version, session_ids, 2));
+    store.StartSession();
+    for (uint64_t key = 0; key < kNumRecords; ++key) {
+        ReadContext context{key};
+        ASSERT_EQ(Status::Ok, store.Read(context, callback, key + 1)) << key;
+        uint64_t expected = key % 4 == 0 ? key + 2000000 : key % 2 == 0 ? key + 1000000 : key;
+        ASSERT_EQ(expected, context.value) << key;
+    }
+    store.StopSession();
+}
+
+int main(int argc, char **argv) {
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
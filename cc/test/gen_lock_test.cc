@@ -0,0 +1,91 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT license.
+
+#include <atomic>
+#include <cstdint>
+#include <thread>
+#include <vector>
+#include "gtest/gtest.h"
+
+#include "core/gen_lock.h"
+
+using namespace FASTER::core;
+
+/// A value that is only consistent if both halves match.
+struct TornValue {
+    AtomicGenLock gen_lock;
+    volatile uint64_t first;
+    volatile uint64_t second;
+};
+
+TEST(GenLock, LockUnlock) {
+    AtomicGenLock gen_lock;
+    bool replaced;
+    ASSERT_TRUE(gen_lock.lock(replaced));
+    ASSERT_TRUE(gen_lock.load().locked);
+    gen_lock.unlock(false);
+    ASSERT_FALSE(gen_lock.load().locked);
+    ASSERT_EQ(1, gen_lock.load().gen_number);
+
+    // Once replaced, writers must go elsewhere.
+    ASSERT_TRUE(gen_lock.lock(replaced));
+    gen_lock.unlock(true);
+    ASSERT_FALSE(gen_lock.lock(replaced));
+    ASSERT_TRUE(replaced);
+}
+
+TEST(GenLock, OptimisticReadSeesNoTornValues) {
+    static constexpr size_t kNumReaders = 3;
+    static constexpr uint64_t kNumWrites = 200000;
+    TornValue value;
+    value.first = 0;
+    value.second = 0;
+    std::atomic<bool> done{false};
+    std::atomic<uint64_t> torn{0};
+
+    GenLockStats::Counts before = GenLockStats::Snapshot();
+
+    auto writer = [&]() {
+        for (uint64_t idx = 1; idx <= kNumWrites; ++idx) {
+            bool replaced;
+            ASSERT_TRUE(value.gen_lock.lock(replaced));
+            value.first = idx;
+            value.second = idx;
+            value.gen_lock.unlock(false);
+        }
+        done = true;
+    };
+    auto reader = [&]() {
+        while (!done) {
+            uint64_t first, second;
+            value.gen_lock.read([&]() {
+                first = value.first;
+                second = value.second;
+            });
+            if (first != second) {
+                ++torn;
+            }
+        }
+    };
+
+    std::vector<std::thread> threads;
+    threads.emplace_back(writer);
+    for (size_t idx = 0; idx < kNumReaders; ++idx) {
+        threads.emplace_back(reader);
+    }
+    for (auto &thread : threads) {
+        thread.join();
+    }
+
+    ASSERT_EQ(0, torn.load());
+    ASSERT_EQ(kNumWrites, value.gen_lock.load().gen_number);
+    // Counters of exited threads are kept.
+    GenLockStats::Counts after = GenLockStats::Snapshot();
+    ASSERT_GE(after.read_retries, before.read_retries);
+    ASSERT_GE(after.lock_waits, before.lock_waits);
+}
+
+int main(int argc, char **argv) {
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,70 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT license.
+
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include "gtest/gtest.h"
+
+#include "core/hash_table.h"
+#include "core/light_epoch.h"
+#include "device/null_disk.h"
+
+using namespace FASTER::core;
+
+typedef InternalHashTable<FASTER::device::NullDisk> table_t;
+
+static const char *kCheckpointFile = "hash_table_test.dat";
+
+TEST(InternalHashTable, RecoverMapped) {
+    static constexpr uint64_t kTableSize = 1024;
+    LightEpoch epoch;
+    FASTER::device::NullDisk disk{"", epoch};
+
+    table_t table;
+    table.Initialize(kTableSize, Constants::kCacheLineBytes);
+    for (uint64_t idx = 0; idx < kTableSize; ++idx) {
+        table.bucket(idx).entries[0].store(HashBucketEntry{Address{idx + 64}, static_cast<uint16_t>(idx),
+                                                           false});
+    }
+    // A checkpoint is the plain bucket array.
+    {
+        std::ofstream file{kCheckpointFile, std::ios::binary | std::ios::trunc};
+        file.write(reinterpret_cast<const char *>(&table.bucket(uint64_t{0})), kTableSize * sizeof(HashBucket));
+    }
+
+    table_t mapped;
+    ASSERT_EQ(Status::Ok, mapped.RecoverMapped(disk, kCheckpointFile, kTableSize * sizeof(HashBucket)));
+    ASSERT_TRUE(mapped.mapped());
+    ASSERT_EQ(kTableSize, mapped.size());
+    ASSERT_EQ(Status::Ok, mapped.RecoverComplete(true));
+    for (uint64_t idx = 0; idx < kTableSize; ++idx) {
+        HashBucketEntry entry = mapped.bucket(idx).entries[0].load();
+        ASSERT_EQ(idx + 64, entry.address().control());
+        ASSERT_EQ(idx, entry.tag());
+    }
+
+    // Writes go to private copies, not to the checkpoint.
+    mapped.bucket(uint64_t{7}).entries[0].store(HashBucketEntry::kInvalidEntry);
+    ASSERT_TRUE(mapped.bucket(uint64_t{7}).entries[0].load().unused());
+    table_t again;
+    ASSERT_EQ(Status::Ok, again.RecoverMapped(disk, kCheckpointFile, kTableSize * sizeof(HashBucket)));
+    ASSERT_EQ(7 + 64, again.bucket(uint64_t{7}).entries[0].load().address().control());
+
+    // Re-initializing a mapped table gives it ordinary memory again.
+    again.Initialize(kTableSize, Constants::kCacheLineBytes);
+    ASSERT_FALSE(again.mapped());
+    ASSERT_TRUE(again.bucket(uint64_t{7}).entries[0].load().unused());
+
+    // The file must hold the whole table.
+    table_t too_big;
+    ASSERT_EQ(Status::IOError, too_big.RecoverMapped(disk, kCheckpointFile, 2 * kTableSize * sizeof(HashBucket)));
+    ASSERT_FALSE(too_big.mapped());
+
+    std::remove(kCheckpointFile);
+}
+
+int main(int argc, char **argv) {
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
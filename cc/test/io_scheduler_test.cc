@@ -0,0 +1,137 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT license.
+
+#include <chrono>
+#include <cstdint>
+#include <thread>
+#include <vector>
+#include "gtest/gtest.h"
+
+#include "device/io_scheduler.h"
+
+using namespace FASTER::core;
+using namespace FASTER::device;
+
+class WriteContext : public IAsyncContext {
+public:
+    WriteContext(uint32_t id_)
+            : id{id_} {
+    }
+
+    /// The deep-copy constructor.
+    WriteContext(const WriteContext &other)
+            : id{other.id} {
+    }
+
+protected:
+    Status DeepCopy_Internal(IAsyncContext *&context_copy) final {
+        return IAsyncContext::DeepCopy_Internal(*this, context_copy);
+    }
+
+public:
+    uint32_t id;
+};
+
+/// Stands in for a file: records the order in which writes were issued.
+static std::vector<uint32_t> issued;
+
+static Status Issue(void *file, const void *source, uint64_t dest, uint32_t length,
+                    AsyncIOCallback callback, IAsyncContext &context) {
+    issued.push_back(static_cast<WriteContext &>(context).id);
+    // (A real file would free the context once the write completed.)
+    if (context.from_deep_copy()) {
+        callback(&context, Status::Ok, length);
+    }
+    return Status::Ok;
+}
+
+static void Done(IAsyncContext *ctxt, Status result, size_t bytes_transferred) {
+    CallbackContext<WriteContext> context{ctxt};
+}
+
+static void Write(IoScheduler &scheduler, IoClass io_class, uint32_t id, uint32_t length) {
+    WriteContext context{id};
+    ASSERT_EQ(Status::Ok, scheduler.Write(io_class, Issue, nullptr, nullptr, 0, length, Done, context));
+}
+
+TEST(IoScheduler, Unlimited) {
+    IoScheduler scheduler;
+    ASSERT_FALSE(scheduler.enabled());
+    issued.clear();
+    for (uint32_t id = 0; id < 100; ++id) {
+        Write(scheduler, IoClass::BackgroundFlush, id, 1 << 20);
+    }
+    ASSERT_EQ(100, issued.size());
+    ASSERT_EQ(100, scheduler.GetStats(IoClass::BackgroundFlush).issued_ios);
+    ASSERT_FALSE(scheduler.Pump());
+}
+
+TEST(IoScheduler, Budget) {
+    IoScheduler scheduler;
+    // 1 MB/s: a 50 KB burst, then 1 KB per millisecond.
+    scheduler.SetBudget(IoClass::Checkpoint, 1000000);
+    ASSERT_TRUE(scheduler.enabled());
+    issued.clear();
+    for (uint32_t id = 0; id < 4; ++id) {
+        Write(scheduler, IoClass::Checkpoint, id, 32000);
+    }
+    // The burst covers the first write, and the second one puts the bucket in debt.
+    ASSERT_EQ((std::vector<uint32_t>{0, 1}), issued);
+    IoClassStats stats = scheduler.GetStats(IoClass::Checkpoint);
+    ASSERT_EQ(2, stats.queue_depth);
+    ASSERT_EQ(2, stats.issued_ios);
+
+    // Other classes are not affected.
+    Write(scheduler, IoClass::BackgroundFlush, 100, 1 << 20);
+    ASSERT_EQ((std::vector<uint32_t>{0, 1, 100}), issued);
+    scheduler.NoteRead(4096);
+    ASSERT_EQ(1, scheduler.GetStats(IoClass::ForegroundRead).issued_ios);
+    ASSERT_EQ(4096, scheduler.GetStats(IoClass::ForegroundRead).issued_bytes);
+
+    // Queued writes go out, in order, as the budget comes in.
+    auto start = std::chrono::steady_clock::now();
+    while (issued.size() < 5) {
+        scheduler.Pump();
+        std::this_thread::yield();
+    }
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    ASSERT_EQ((std::vector<uint32_t>{0, 1, 100, 2, 3}), issued);
+    // Paying off the debt of the second write, then the third write's 32 KB, takes >= 30 ms.
+    ASSERT_GE(elapsed, std::chrono::milliseconds{30});
+    stats = scheduler.GetStats(IoClass::Checkpoint);
+    ASSERT_EQ(0, stats.queue_depth);
+    ASSERT_EQ(2, stats.max_queue_depth);
+    ASSERT_EQ(4, stats.issued_ios);
+    ASSERT_EQ(128000, stats.issued_bytes);
+    ASSERT_EQ(2, stats.deferred_ios);
+    ASSERT_GE(stats.max_wait_us, 10000);
+}
+
+TEST(IoScheduler, Adaptive) {
+    IoScheduler scheduler;
+    scheduler.SetBudget(IoClass::BackgroundFlush, 1000);
+    scheduler.SetAdaptive(true);
+    issued.clear();
+    // No foreground reads: the budget does not apply.
+    for (uint32_t id = 0; id < 10; ++id) {
+        Write(scheduler, IoClass::BackgroundFlush, id, 1 << 20);
+    }
+    ASSERT_EQ(10, issued.size());
+
+    // Once reads show up, it does.
+    scheduler.NoteRead(4096);
+    Write(scheduler, IoClass::BackgroundFlush, 10, 1 << 20);
+    Write(scheduler, IoClass::BackgroundFlush, 11, 1 << 20);
+    ASSERT_EQ(11, issued.size());
+    ASSERT_EQ(1, scheduler.GetStats(IoClass::BackgroundFlush).queue_depth);
+
+    // ...until they stop again.
+    std::this_thread::sleep_for(std::chrono::milliseconds{20});
+    ASSERT_TRUE(scheduler.Pump());
+    ASSERT_EQ(12, issued.size());
+}
+
+int main(int argc, char **argv) {
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
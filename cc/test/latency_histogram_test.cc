@@ -0,0 +1,125 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT license.
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include "gtest/gtest.h"
+
+#include "core/faster.h"
+#include "core/latency_histogram.h"
+#include "device/null_disk.h"
+
+#include "test_types.h"
+
+using namespace FASTER::core;
+using FASTER::test::Key;
+using FASTER::test::ReadContext;
+using FASTER::test::UpsertContext;
+using FASTER::test::Value;
+
+typedef FasterKv<Key, Value, FASTER::device::NullDisk> store_t;
+
+/// The store keeps its logs in static storage, so the tests share one instance.
+static store_t &Store() {
+    static store_t store{4, 1024, 1073741824, ""};
+    return store;
+}
+
+static void Unexpected(IAsyncContext *ctxt, Status result) {
+    ASSERT_TRUE(false);
+}
+
+static uint64_t ReadValue(uint64_t key) {
+    ReadContext context{key};
+    EXPECT_EQ(Status::Ok, Store().Read(context, Unexpected, 1));
+    return context.value;
+}
+
+TEST(LatencyHistogram, Buckets) {
+    // Small values are exact; larger ones land in a bucket within 1/16 of them.
+    const uint32_t num_sub_buckets = LatencyHistogram::kSubBuckets;
+    const uint32_t num_buckets = LatencyHistogram::kNumBuckets;
+    for (uint64_t value = 0; value < num_sub_buckets; ++value) {
+        ASSERT_EQ(value, LatencyHistogram::BucketHighestValue(LatencyHistogram::BucketIndex(value)));
+    }
+    uint32_t last_idx = 0;
+    for (uint64_t value = 16; value < (uint64_t{1} << 40); value = value * 9 / 8 + 1) {
+        uint32_t idx = LatencyHistogram::BucketIndex(value);
+        ASSERT_GE(idx, last_idx);
+        last_idx = idx;
+        uint64_t highest = LatencyHistogram::BucketHighestValue(idx);
+        ASSERT_GE(highest, value);
+        ASSERT_LE(highest - value, value / 16);
+        ASSERT_EQ(idx, LatencyHistogram::BucketIndex(highest));
+        ASSERT_EQ(idx + 1, LatencyHistogram::BucketIndex(highest + 1));
+    }
+    ASSERT_EQ(num_buckets - 1, LatencyHistogram::BucketIndex(UINT64_MAX));
+}
+
+TEST(LatencyHistogram, Percentiles) {
+    LatencyHistogram histogram;
+    ASSERT_EQ(0, histogram.ValueAtPercentile(50));
+    for (uint64_t value = 1; value <= 10000; ++value) {
+        histogram.Record(value);
+    }
+    ASSERT_EQ(10000, histogram.count());
+    ASSERT_EQ(10000, histogram.max());
+    ASSERT_DOUBLE_EQ(5000.5, histogram.Mean());
+    ASSERT_NEAR(5000, histogram.ValueAtPercentile(50), 5000 / 16);
+    ASSERT_NEAR(9900, histogram.ValueAtPercentile(99), 9900 / 16);
+    ASSERT_EQ(10000, histogram.ValueAtPercentile(100));
+    ASSERT_EQ(1, histogram.ValueAtPercentile(0));
+
+    LatencyHistogram other;
+    other.Record(1000000);
+    LatencyHistogram merged{histogram};
+    merged.Merge(other);
+    ASSERT_EQ(10001, merged.count());
+    ASSERT_EQ(1000000, merged.max());
+    ASSERT_EQ(1000000, merged.ValueAtPercentile(100));
+    ASSERT_EQ(10000, histogram.count());
+}
+
+TEST(LatencyStats, Store) {
+    static constexpr uint64_t kNumKeys = 4000;
+    store_t &store = Store();
+    store.EnableLatencyStats(1);
+    store.StartSession();
+    // New keys are appended; updating them again is done in place.
+    for (uint64_t key = 0; key < kNumKeys; ++key) {
+        UpsertContext context{key, key};
+        ASSERT_EQ(Status::Ok, store.UpsertT(context, Unexpected, 1, 1));
+    }
+    for (uint64_t key = 0; key < kNumKeys; ++key) {
+        UpsertContext context{key, key + 1};
+        ASSERT_EQ(Status::Ok, store.UpsertT(context, Unexpected, 1, 1));
+    }
+    for (uint64_t key = 0; key < kNumKeys; ++key) {
+        ASSERT_EQ(key + 1, ReadValue(key));
+    }
+    store.StopSession();
+
+    ASSERT_EQ(kNumKeys, store.GetLatencyHistogram(LatencyOp::Upsert, LatencyOutcome::Rcu).count());
+    ASSERT_EQ(kNumKeys, store.GetLatencyHistogram(LatencyOp::Upsert, LatencyOutcome::InPlace).count());
+    LatencyHistogram reads = store.GetLatencyHistogram(LatencyOp::Read, LatencyOutcome::InPlace);
+    ASSERT_EQ(kNumKeys, reads.count());
+    ASSERT_GT(reads.max(), 0);
+    ASSERT_LE(reads.ValueAtPercentile(50), reads.ValueAtPercentile(99));
+    ASSERT_EQ(0, store.GetLatencyHistogram(LatencyOp::Read, LatencyOutcome::Pending).count());
+    ASSERT_GT(TscClock::NanosecondsPerTick(), 0);
+
+    // Sampling.
+    store.EnableLatencyStats(8);
+    store.StartSession();
+    for (uint64_t key = 0; key < kNumKeys; ++key) {
+        ReadValue(key);
+    }
+    store.StopSession();
+    ASSERT_EQ(kNumKeys / 8, store.GetLatencyHistogram(LatencyOp::Read, LatencyOutcome::InPlace).count());
+}
+
+int main(int argc, char **argv) {
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,72 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT license.
+
+#include <atomic>
+#include <cstdint>
+#include <thread>
+#include "gtest/gtest.h"
+
+#include "core/light_epoch.h"
+
+using namespace FASTER::core;
+
+static std::atomic<uint32_t> num_actions_run{0};
+
+static void CountAction(IAsyncContext *context) {
+    ++num_actions_run;
+}
+
+TEST(LightEpoch, SafeToReclaim) {
+    LightEpoch epoch;
+    uint64_t protected_epoch = epoch.Protect();
+    ASSERT_TRUE(epoch.IsProtected());
+
+    // Another thread holds back reclamation until it leaves.
+    std::atomic<bool> entered{false};
+    std::atomic<bool> leave{false};
+    uint64_t other_epoch = 0;
+    std::thread other{[&]() {
+        epoch.BumpCurrentEpoch();
+        other_epoch = epoch.Protect();
+        entered = true;
+        while (!leave) {
+            std::this_thread::yield();
+        }
+        epoch.Unprotect();
+    }};
+    while (!entered) {
+        std::this_thread::yield();
+    }
+    ASSERT_EQ(protected_epoch + 1, other_epoch);
+
+    uint64_t current = epoch.BumpCurrentEpoch();
+    epoch.Unprotect();
+    ASSERT_FALSE(epoch.IsProtected());
+    ASSERT_EQ(other_epoch - 1, epoch.ComputeNewSafeToReclaimEpoch(current));
+
+    leave = true;
+    other.join();
+    ASSERT_EQ(current - 1, epoch.ComputeNewSafeToReclaimEpoch(current));
+}
+
+TEST(LightEpoch, DrainListGrows) {
+    static constexpr uint32_t kNumActions = 1000;
+    LightEpoch epoch;
+    num_actions_run = 0;
+    // Keep every action pending, so the list has to grow past its first block.
+    epoch.Protect();
+    for (uint32_t idx = 0; idx < kNumActions; ++idx) {
+        epoch.BumpCurrentEpoch(CountAction, nullptr);
+    }
+    ASSERT_EQ(0, num_actions_run.load());
+
+    epoch.Unprotect();
+    epoch.ProtectAndDrain();
+    epoch.Unprotect();
+    ASSERT_EQ(kNumActions, num_actions_run.load());
+}
+
+int main(int argc, char **argv) {
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
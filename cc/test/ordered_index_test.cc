@@ -0,0 +1,163 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT license.
+
+#include <cinttypes>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+#include "gtest/gtest.h"
+
+#include "core/faster.h"
+#include "core/ordered_index.h"
+#include "device/null_disk.h"
+#include "device/serializablecontext.h"
+
+using namespace FASTER::core;
+
+static OrderedIndexKey MakeKey(const std::string &key) {
+    return OrderedIndexKey{reinterpret_cast<const uint8_t *>(key.data()),
+                           static_cast<uint32_t>(key.size())};
+}
+
+static std::vector<std::string> ScanKeys(const OrderedIndex &index, const std::string &begin,
+                                         const std::string &end) {
+    std::vector<std::string> keys;
+    index.Scan(MakeKey(begin), MakeKey(end), [&](uint8_t *key, uint32_t key_length, Address address) {
+        keys.emplace_back(reinterpret_cast<const char *>(key), key_length);
+    });
+    return keys;
+}
+
+TEST(OrderedIndex, KeyOrder) {
+    ASSERT_TRUE(MakeKey("a") < MakeKey("b"));
+    ASSERT_TRUE(MakeKey("ab") < MakeKey("b"));
+    ASSERT_TRUE(MakeKey("a") < MakeKey("ab"));
+    ASSERT_TRUE(MakeKey("abc") == MakeKey("abc"));
+    ASSERT_FALSE(MakeKey("abc") < MakeKey("abc"));
+}
+
+TEST(OrderedIndex, UpsertScanDelete) {
+    OrderedIndex index;
+    index.Upsert(MakeKey("key03"), Address{300});
+    index.Upsert(MakeKey("key01"), Address{100});
+    index.Upsert(MakeKey("key02"), Address{200});
+    index.Upsert(MakeKey("other"), Address{400});
+    ASSERT_EQ(4, index.size());
+
+    std::vector<std::string> keys = ScanKeys(index, "key", "kez");
+    ASSERT_EQ((std::vector<std::string>{"key01", "key02", "key03"}), keys);
+    // End is exclusive.
+    keys = ScanKeys(index, "key01", "key03");
+    ASSERT_EQ((std::vector<std::string>{"key01", "key02"}), keys);
+
+    index.Delete(MakeKey("key02"), Address{200});
+    keys = ScanKeys(index, "key", "kez");
+    ASSERT_EQ((std::vector<std::string>{"key01", "key03"}), keys);
+
+    // Re-inserting a deleted key makes it visible again.
+    index.Upsert(MakeKey("key02"), Address{500});
+    keys = ScanKeys(index, "key", "kez");
+    ASSERT_EQ((std::vector<std::string>{"key01", "key02", "key03"}), keys);
+
+    index.Clear();
+    ASSERT_EQ(0, index.size());
+    ASSERT_TRUE(ScanKeys(index, "", "zzz").empty());
+}
+
+TEST(OrderedIndex, StaleAddressIgnored) {
+    OrderedIndex index;
+    index.Upsert(MakeKey("key"), Address{200});
+    // An update racing in with an older address (or an older delete) must not win.
+    index.Upsert(MakeKey("key"), Address{100});
+    index.Delete(MakeKey("key"), Address{150});
+    Address found;
+    index.Scan(MakeKey("key"), MakeKey("kez"), [&](uint8_t *key, uint32_t key_length, Address address) {
+        found = address;
+    });
+    ASSERT_EQ(200, found.control());
+}
+
+TEST(OrderedIndex, Concurrent) {
+    static constexpr size_t kNumThreads = 4;
+    static constexpr uint64_t kNumKeysPerThread = 4096;
+    OrderedIndex index;
+
+    auto insert_worker = [&index](size_t thread_idx) {
+        char buffer[16];
+        for (uint64_t idx = 0; idx < kNumKeysPerThread; ++idx) {
+            uint64_t key = idx * kNumThreads + thread_idx;
+            std::snprintf(buffer, sizeof(buffer), "%08" PRIu64, key);
+            index.Upsert(MakeKey(buffer), Address{key + 64});
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for (size_t idx = 0; idx < kNumThreads; ++idx) {
+        threads.emplace_back(insert_worker, idx);
+    }
+    for (auto &thread : threads) {
+        thread.join();
+    }
+
+    ASSERT_EQ(kNumThreads * kNumKeysPerThread, index.size());
+    std::vector<std::string> keys = ScanKeys(index, "", "99999999");
+    ASSERT_EQ(kNumThreads * kNumKeysPerThread, keys.size());
+    for (size_t idx = 1; idx < keys.size(); ++idx) {
+        ASSERT_LT(keys[idx - 1], keys[idx]);
+    }
+}
+
+TEST(OrderedIndex, FasterKvRangeScan) {
+    typedef FasterKv<FASTER::api::Key, FASTER::api::Value, FASTER::device::NullDisk> store_t;
+    auto callback = [](IAsyncContext *ctxt, Status result) {
+        // Everything is in memory.
+        ASSERT_TRUE(false);
+    };
+    // Keys of exactly OrderedIndexKey::kMaxKeyBytes.
+    auto format = [](uint64_t key, char *buffer) {
+        std::snprintf(buffer, 17, "key-%012" PRIu64, key);
+        return FASTER::api::Key{reinterpret_cast<uint8_t *>(buffer), 16};
+    };
+
+    store_t store{1, 1024, 1073741824, ""};
+    ASSERT_EQ(Status::Ok, store.EnableOrderedIndex());
+    store.StartSession();
+    char key_buffer[17];
+    uint64_t data = 0;
+    for (uint64_t key = 0; key < 100; ++key) {
+        data = key;
+        FASTER::api::UpsertContext context{format(key, key_buffer),
+                                           FASTER::api::Value{reinterpret_cast<uint8_t *>(&data), sizeof(data)}};
+        ASSERT_EQ(Status::Ok, store.UpsertT(context, callback, key + 1, 1));
+    }
+    // A longer key would be truncated in the index, so it is rejected.
+    char long_key[] = "key-0000000000010x";
+    FASTER::api::UpsertContext long_context{FASTER::api::Key{reinterpret_cast<uint8_t *>(long_key), 18},
+                                            FASTER::api::Value{reinterpret_cast<uint8_t *>(&data), sizeof(data)}};
+    ASSERT_EQ(Status::Aborted, store.UpsertT(long_context, callback, 101, 1));
+
+    // Keys read right away go to the visitor; none goes pending.
+    char begin_buffer[17];
+    char end_buffer[17];
+    std::vector<uint64_t> scanned;
+    Status result = store.RangeScan<FASTER::api::ReadContext>(
+            format(10, begin_buffer), format(20, end_buffer),
+            [&](const FASTER::api::ReadContext &context, Status status) {
+                ASSERT_EQ(Status::Ok, status);
+                ASSERT_EQ(sizeof(uint64_t), context.output_length);
+                uint64_t value;
+                std::memcpy(&value, context.output_bytes, sizeof(value));
+                scanned.push_back(value);
+            }, callback, 102);
+    ASSERT_EQ(Status::Ok, result);
+    ASSERT_EQ((std::vector<uint64_t>{10, 11, 12, 13, 14, 15, 16, 17, 18, 19}), scanned);
+    store.StopSession();
+}
+
+int main(int argc, char **argv) {
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
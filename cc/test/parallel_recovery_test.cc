@@ -0,0 +1,257 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT license.
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <experimental/filesystem>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "gtest/gtest.h"
+
+#include "core/faster.h"
+#include "core/recovery_status.h"
+#include "core/thread.h"
+#include "device/file_system_disk.h"
+
+#include "test_types.h"
+
+using namespace FASTER::core;
+using FASTER::test::Key;
+using FASTER::test::ReadContext;
+using FASTER::test::UpsertContext;
+using FASTER::test::Value;
+
+typedef FASTER::environment::QueueIoHandler handler_t;
+typedef FASTER::device::FileSystemDisk<handler_t, 33554432L> disk_t;
+typedef FasterKv<Key, Value, disk_t> store_t;
+
+/// Two lanes, each with its own index partition and (6-page) hybrid log.
+static constexpr int kNumLanes = 2;
+static constexpr uint64_t kTableSize = 1024;
+static constexpr uint64_t kLogSize = 201326592;
+
+TEST(ParallelRecovery, WaitForPageStatus) {
+    RecoveryStatus status{10, 12};
+    // Nothing has moved page 10 yet.
+    ASSERT_FALSE(status.WaitFor(10, PageRecoveryStatus::ReadDone, std::chrono::milliseconds(1)));
+
+    // Set() wakes up the waiter, without it having to poll.
+    std::thread setter{[&status]() {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        status.Set(10, PageRecoveryStatus::IssuedRead);
+        status.Set(10, PageRecoveryStatus::ReadDone);
+    }};
+    ASSERT_TRUE(status.WaitFor(10, PageRecoveryStatus::ReadDone, std::chrono::seconds(10)));
+    setter.join();
+    ASSERT_EQ(PageRecoveryStatus::ReadDone, status.page_status(10).load());
+    ASSERT_EQ(PageRecoveryStatus::NotStarted, status.page_status(11).load());
+}
+
+static constexpr uint64_t kNumRecords = 2000;
+static constexpr uint64_t kNumLateRecords = 500;
+
+/// Loads kNumRecords keys (updating the even ones) and checkpoints the store, writing further
+/// keys while the checkpoint runs; "next_key" is the first key not written.
+static void CheckpointWhileWriting(Guid &token, uint64_t &next_key) {
+    auto callback = [](IAsyncContext *ctxt, Status result) {
+        // Upserts don't go to disk.
+        ASSERT_TRUE(false);
+    };
+
+    std::experimental::filesystem::remove_all("storage");
+    std::experimental::filesystem::create_directories("storage");
+
+    next_key = kNumRecords;
+    store_t store{kNumLanes, kTableSize, kLogSize, "storage"};
+    store.StartSession();
+    for (uint64_t key = 0; key < kNumRecords; ++key) {
+        UpsertContext context{key, key * 10};
+        ASSERT_EQ(Status::Ok, store.UpsertT(context, callback, key + 1, 1));
+    }
+    // Update the even keys, so that recovery has to pick the later record.
+    for (uint64_t key = 0; key < kNumRecords; key += 2) {
+        UpsertContext context{key, key * 10 + 1};
+        ASSERT_EQ(Status::Ok, store.UpsertT(context, callback, kNumRecords + key + 1, 1));
+    }
+
+    ASSERT_TRUE(store.Checkpoint(nullptr, nullptr, token));
+    // Keep writing while the checkpoint runs; these records land in the fuzzy region.
+    while (!store.CheckpointCheck()) {
+        store.CompletePending(false);
+        if (next_key < kNumRecords + kNumLateRecords) {
+            UpsertContext context{next_key, next_key * 10};
+            ASSERT_EQ(Status::Ok, store.UpsertT(context, callback, 2 * kNumRecords + next_key, 1));
+            ++next_key;
+        }
+    }
+    store.CompletePending(true);
+    store.StopSession();
+}
+
+/// Reads back what CheckpointWhileWriting() wrote, in a session of the calling thread's.
+static void ReadBack(store_t &store, uint64_t next_key) {
+    store.StartSession();
+    for (uint64_t key = 0; key < next_key; ++key) {
+        ReadContext context{key};
+        Status result = store.Read(context, [](IAsyncContext *ctxt, Status result) {
+            ASSERT_TRUE(false);
+        }, key + 1);
+        if (key >= kNumRecords) {
+            // Written during the checkpoint: recovered only if it made the persisted prefix.
+            ASSERT_TRUE(result == Status::Ok || result == Status::NotFound) << key;
+            if (result == Status::Ok) {
+                ASSERT_EQ(key * 10, context.value) << key;
+            }
+            continue;
+        }
+        ASSERT_EQ(Status::Ok, result) << key;
+        ASSERT_EQ(key % 2 == 0 ? key * 10 + 1 : key * 10, context.value) << key;
+    }
+    store.StopSession();
+}
+
+TEST(ParallelRecovery, CheckpointRecover) {
+    Guid token;
+    uint64_t next_key;
+    CheckpointWhileWriting(token, next_key);
+
+    // Recover both lanes at once.
+    store_t store{kNumLanes, kTableSize, kLogSize, "storage"};
+    uint32_t version;
+    std::vector<Guid> session_ids;
+    ASSERT_EQ(Status::Ok, store.Recover(token, token, version, session_ids, kNumLanes));
+    ASSERT_EQ(1, session_ids.size());
+    ReadBack(store, next_key);
+}
+
+TEST(ParallelRecovery, RecoverLazyWithConcurrentReads) {
+    Guid token;
+    uint64_t next_key;
+    CheckpointWhileWriting(token, next_key);
+
+    // One sweep thread, so readers race it for the other lane and replay that on demand.
+    store_t store{kNumLanes, kTableSize, kLogSize, "storage"};
+    uint32_t version;
+    std::vector<Guid> session_ids;
+    ASSERT_EQ(Status::Ok, store.RecoverLazy(token, token, version, session_ids, 1));
+    ASSERT_EQ(1, session_ids.size());
+    std::vector<std::thread> readers;
+    for (uint32_t idx = 0; idx < 4; ++idx) {
+        readers.emplace_back(ReadBack, std::ref(store), next_key);
+    }
+    for (std::thread &reader : readers) {
+        reader.join();
+    }
+    ASSERT_EQ(Status::Ok, store.WaitForRecovery());
+    ASSERT_FALSE(store.RecoveryPending());
+
+    // Checkpoints are allowed again once the sweep is done.
+    store.StartSession();
+    Guid new_token;
+    ASSERT_TRUE(store.Checkpoint(nullptr, nullptr, new_token));
+    while (!store.CheckpointCheck()) {
+        store.CompletePending(false);
+    }
+    store.StopSession();
+}
+
+TEST(ParallelRecovery, RecoverThenCheckpoint) {
+    auto callback = [](IAsyncContext *ctxt, Status result) {
+        ASSERT_TRUE(false);
+    };
+
+    std::experimental::filesystem::remove_all("storage");
+    std::experimental::filesystem::create_directories("storage");
+
+    // One record, so one lane's log is empty. The checkpoint has the default number of per-thread
+    // slots.
+    Guid token;
+    {
+        store_t store{kNumLanes, kTableSize, kLogSize, "storage"};
+        store.StartSession();
+        UpsertContext context{1, 10};
+        ASSERT_EQ(Status::Ok, store.UpsertT(context, callback, 1, 1));
+        ASSERT_TRUE(store.Checkpoint(nullptr, nullptr, token));
+        while (!store.CheckpointCheck()) {
+            store.CompletePending(false);
+        }
+        store.StopSession();
+    }
+
+    // Checkpoint again after recovering; a lane with no new records has nothing to flush. The store
+    // has more slots than the checkpoint, and its session gets a thread ID beyond the old ones.
+    static constexpr uint32_t kOldSlots = Thread::kDefaultNumThreads;
+    static constexpr uint32_t kMaxSessions = 2 * kOldSlots;
+    Thread::ReserveCapacity(kMaxSessions);
+    std::mutex mutex;
+    std::condition_variable done;
+    bool finished = false;
+    std::atomic<uint32_t> num_parked{0};
+    std::vector<std::thread> parked;
+    for (uint32_t idx = 0; idx < kOldSlots; ++idx) {
+        parked.emplace_back([&]() {
+            Thread::id();
+            ++num_parked;
+            std::unique_lock<std::mutex> lock{mutex};
+            done.wait(lock, [&]() { return finished; });
+        });
+    }
+    while (num_parked < kOldSlots) {
+        std::this_thread::yield();
+    }
+
+    Guid new_token;
+    Guid session_id;
+    {
+        store_t store{kNumLanes, kTableSize, kLogSize, "storage", 0.9, kMaxSessions};
+        uint32_t version;
+        std::vector<Guid> session_ids;
+        ASSERT_EQ(Status::Ok, store.Recover(token, token, version, session_ids, kNumLanes));
+
+        std::thread worker{[&]() {
+            ASSERT_GE(Thread::id(), uint32_t{kOldSlots});
+            session_id = store.StartSession();
+            UpsertContext context{2, 20};
+            ASSERT_EQ(Status::Ok, store.UpsertT(context, callback, 1, 1));
+            ASSERT_TRUE(store.Checkpoint(nullptr, nullptr, new_token));
+            while (!store.CheckpointCheck()) {
+                store.CompletePending(false);
+            }
+            store.StopSession();
+        }};
+        worker.join();
+    }
+    {
+        std::lock_guard<std::mutex> lock{mutex};
+        finished = true;
+    }
+    done.notify_all();
+    for (std::thread &thread : parked) {
+        thread.join();
+    }
+
+    // The second checkpoint kept that session.
+    store_t store{kNumLanes, kTableSize, kLogSize, "storage", 0.9, kMaxSessions};
+    uint32_t version;
+    std::vector<Guid> session_ids;
+    ASSERT_EQ(Status::Ok, store.Recover(new_token, new_token, version, session_ids, kNumLanes));
+    ASSERT_EQ(1, session_ids.size());
+    ASSERT_EQ(session_id, session_ids[0]);
+
+    store.StartSession();
+    for (uint64_t key = 1; key <= 2; ++key) {
+        ReadContext context{key};
+        ASSERT_EQ(Status::Ok, store.Read(context, callback, key)) << key;
+        ASSERT_EQ(key * 10, context.value);
+    }
+    store.StopSession();
+}
+
+int main(int argc, char **argv) {
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,276 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT license.
+
+#include <cstdint>
+#include <thread>
+#include <vector>
+#include "gtest/gtest.h"
+
+#include "core/faster.h"
+#include "core/partition_executor.h"
+#include "device/null_disk.h"
+
+#include "test_types.h"
+
+using namespace FASTER::core;
+using FASTER::test::Key;
+using FASTER::test::ReadContext;
+using FASTER::test::UpsertContext;
+using FASTER::test::Value;
+
+/// Stands in for FasterKv's session and partition interface. Each partition holds plain
+/// (non-atomic) counters, which only the partition's owner may touch.
+class FakeStore {
+public:
+    static constexpr uint32_t kNumPartitions = 4;
+    static constexpr uint32_t kKeysPerPartition = 4;
+
+    FakeStore()
+            : counters{}, owner_ids{}, num_sessions{0}, wrong_owner{0} {
+    }
+
+    void StartSession() {
+        ++num_sessions;
+    }
+
+    void StopSession() {
+        --num_sessions;
+    }
+
+    void Refresh() {
+    }
+
+    bool CompletePending(bool wait) {
+        return true;
+    }
+
+    uint64_t NumPendingRequests() const {
+        return 0;
+    }
+
+    Phase SessionPhase() const {
+        return Phase::REST;
+    }
+
+    uint32_t NumPartitions() const {
+        return kNumPartitions;
+    }
+
+    void OwnPartition(uint32_t partition) {
+        owned_partition() = partition;
+        owner_ids[partition] = std::this_thread::get_id();
+    }
+
+    void Increment(uint32_t key) {
+        uint32_t partition = key % kNumPartitions;
+        if (owned_partition() != partition) {
+            ++wrong_owner;
+        }
+        ++counters[partition][key / kNumPartitions];
+    }
+
+    static uint32_t &owned_partition() {
+        static thread_local uint32_t partition_ = UINT32_MAX;
+        return partition_;
+    }
+
+    uint64_t counters[kNumPartitions][kKeysPerPartition];
+    std::thread::id owner_ids[kNumPartitions];
+    std::atomic<uint32_t> num_sessions;
+    std::atomic<uint64_t> wrong_owner;
+};
+
+typedef PartitionExecutor<FakeStore> executor_t;
+
+TEST(PartitionExecutor, OwnersRunEveryOperation) {
+    static constexpr uint32_t kNumClients = 3;
+    static constexpr uint32_t kOpsPerClient = 100000;
+    static constexpr uint32_t kNumKeys = FakeStore::kNumPartitions * FakeStore::kKeysPerPartition;
+    FakeStore store;
+    // The operation's argument is the key, packed into the pointer.
+    executor_t::operation_t increment = [](FakeStore &store, void *arg) {
+        store.Increment(static_cast<uint32_t>(reinterpret_cast<uintptr_t>(arg)));
+    };
+    {
+        executor_t executor{store, kNumClients, false};
+        std::vector<std::thread> clients;
+        for (uint32_t client = 0; client < kNumClients; ++client) {
+            clients.emplace_back([&, client]() {
+                for (uint32_t idx = 0; idx < kOpsPerClient; ++idx) {
+                    uint32_t key = idx % kNumKeys;
+                    executor.Send(client, key % FakeStore::kNumPartitions, increment,
+                                  reinterpret_cast<void *>(static_cast<uintptr_t>(key)));
+                }
+                executor.Flush(client);
+            });
+        }
+        for (auto &thread : clients) {
+            thread.join();
+        }
+        ASSERT_EQ(store.NumPartitions(), store.num_sessions.load());
+
+        // Flush() returned, so every increment is visible.
+        for (uint32_t key = 0; key < kNumKeys; ++key) {
+            ASSERT_EQ(kNumClients * kOpsPerClient / kNumKeys,
+                      store.counters[key % FakeStore::kNumPartitions][key / FakeStore::kNumPartitions]);
+        }
+        ASSERT_EQ(0, store.wrong_owner.load());
+    }
+    ASSERT_EQ(0, store.num_sessions.load());
+    for (uint32_t partition = 1; partition < FakeStore::kNumPartitions; ++partition) {
+        ASSERT_NE(store.owner_ids[0], store.owner_ids[partition]);
+    }
+}
+
+TEST(PartitionExecutor, RingFillsAndDrains) {
+    SpscRing<uint32_t, 4> ring;
+    ASSERT_TRUE(ring.empty());
+    for (uint32_t idx = 0; idx < 4; ++idx) {
+        ASSERT_TRUE(ring.TryPush(idx));
+    }
+    ASSERT_FALSE(ring.TryPush(4));
+    ASSERT_EQ(0, *ring.Front());
+    // The item stays in the ring until it is popped.
+    ASSERT_FALSE(ring.TryPush(4));
+    ring.Pop();
+    ASSERT_TRUE(ring.TryPush(4));
+    for (uint32_t idx = 1; idx <= 4; ++idx) {
+        ASSERT_EQ(idx, *ring.Front());
+        ring.Pop();
+    }
+    ASSERT_EQ(nullptr, ring.Front());
+    ASSERT_TRUE(ring.empty());
+}
+
+/// Upserts and reads that count which of the plain and atomic accessors the store called.
+class CountingUpsertContext : public UpsertContext {
+public:
+    CountingUpsertContext(uint64_t key, uint64_t value)
+            : UpsertContext{key, value}, puts{0}, put_atomics{0} {
+    }
+
+    inline void Put(Value &value) {
+        ++puts;
+        UpsertContext::Put(value);
+    }
+
+    inline bool PutAtomic(Value &value) {
+        ++put_atomics;
+        return UpsertContext::PutAtomic(value);
+    }
+
+protected:
+    Status DeepCopy_Internal(IAsyncContext *&context_copy) {
+        return IAsyncContext::DeepCopy_Internal(*this, context_copy);
+    }
+
+public:
+    uint32_t puts;
+    uint32_t put_atomics;
+};
+
+class CountingReadContext : public ReadContext {
+public:
+    CountingReadContext(uint64_t key)
+            : ReadContext{key}, gets{0}, get_atomics{0} {
+    }
+
+    inline void Get(const Value &value) {
+        ++gets;
+        ReadContext::Get(value);
+    }
+
+    inline void GetAtomic(const Value &value) {
+        ++get_atomics;
+        ReadContext::GetAtomic(value);
+    }
+
+protected:
+    Status DeepCopy_Internal(IAsyncContext *&context_copy) {
+        return IAsyncContext::DeepCopy_Internal(*this, context_copy);
+    }
+
+public:
+    uint32_t gets;
+    uint32_t get_atomics;
+};
+
+typedef FasterKv<Key, Value, FASTER::device::NullDisk> store_t;
+typedef PartitionExecutor<store_t> store_executor_t;
+
+/// One operation on a key, sent to the key's owner; the owner fills in the results.
+struct KeyOperation {
+    uint64_t key;
+    uint64_t value;
+    uint32_t ttl_seconds;
+    Status result;
+    uint32_t plain_calls;
+    uint32_t atomic_calls;
+};
+
+static void Unexpected(IAsyncContext *ctxt, Status result) {
+    ASSERT_TRUE(false);
+}
+
+TEST(PartitionExecutor, FasterKvOwners) {
+    static constexpr uint64_t kNumKeys = 4096;
+    store_t store{4, 1024, 1073741824, ""};
+    store_executor_t::operation_t upsert = [](store_t &store, void *arg) {
+        KeyOperation &op = *static_cast<KeyOperation *>(arg);
+        CountingUpsertContext context{op.key, op.value};
+        op.result = store.UpsertT(context, Unexpected, 1, 1, op.ttl_seconds);
+        op.plain_calls = context.puts;
+        op.atomic_calls = context.put_atomics;
+    };
+    store_executor_t::operation_t read = [](store_t &store, void *arg) {
+        KeyOperation &op = *static_cast<KeyOperation *>(arg);
+        CountingReadContext context{op.key};
+        op.result = store.Read(context, Unexpected, 1);
+        op.value = context.value;
+        op.plain_calls = context.gets;
+        op.atomic_calls = context.get_atomics;
+    };
+    std::vector<KeyOperation> ops(kNumKeys);
+    store_executor_t executor{store, 1, false};
+    auto run = [&](store_executor_t::operation_t op, uint64_t value, uint32_t ttl_seconds) {
+        for (uint64_t key = 0; key < kNumKeys; ++key) {
+            ops[key] = KeyOperation{key, value + key, ttl_seconds, Status::Pending, 0, 0};
+            executor.Send(0, store.Partition(Key{key}), op, &ops[key]);
+        }
+        executor.Flush(0);
+    };
+
+    // Inserts publish the new record's entry with a plain store...
+    run(upsert, 0, 0);
+    for (const KeyOperation &op : ops) {
+        ASSERT_EQ(Status::Ok, op.result);
+        ASSERT_EQ(1, op.plain_calls);
+    }
+    // ...overwrites of the same length update in place, without atomics...
+    run(upsert, 100000, 0);
+    for (const KeyOperation &op : ops) {
+        ASSERT_EQ(Status::Ok, op.result);
+        ASSERT_EQ(1, op.plain_calls);
+        ASSERT_EQ(0, op.atomic_calls);
+    }
+    // ...and so do reads.
+    run(read, 0, 0);
+    for (const KeyOperation &op : ops) {
+        ASSERT_EQ(Status::Ok, op.result);
+        ASSERT_EQ(100000 + op.key, op.value);
+        ASSERT_EQ(1, op.plain_calls);
+        ASSERT_EQ(0, op.atomic_calls);
+    }
+    // A new expiry goes through RCU, and the plain store of its entry.
+    run(upsert, 200000, 3600);
+    run(read, 0, 0);
+    for (const KeyOperation &op : ops) {
+        ASSERT_EQ(Status::Ok, op.result);
+        ASSERT_EQ(200000 + op.key, op.value);
+    }
+}
+
+int main(int argc, char **argv) {
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
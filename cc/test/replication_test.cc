@@ -0,0 +1,505 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT license.
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <experimental/filesystem>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#ifndef _WIN32
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+#include "gtest/gtest.h"
+
+#include "core/faster.h"
+#include "core/replication.h"
+#include "device/file_system_disk.h"
+#include "environment/socket.h"
+
+#include "test_types.h"
+
+using namespace FASTER::core;
+using FASTER::environment::Socket;
+using FASTER::test::Key;
+
+typedef FASTER::device::FileSystemDisk<FASTER::environment::QueueIoHandler, 1073741824ull> disk_t;
+typedef LogFollower<disk_t> follower_t;
+
+static constexpr uint64_t kPageSize = Address::kMaxOffset + 1;
+static const char *kFollowerPath = "replication_test_follower";
+static const char *kEndpoint = "unix:replication_test.sock";
+
+/// Stands in for FasterKv: each log is a byte array, flushed up to where the test says.
+class MockStore {
+public:
+    MockStore(const std::vector<Address> &begin_addresses)
+            : begin_addresses_{begin_addresses}, logs_(begin_addresses.size()),
+              failed_(begin_addresses.size()), flushed_(begin_addresses.size()) {
+        for (uint32_t lane = 0; lane < begin_addresses.size(); ++lane) {
+            flushed_[lane] = begin_addresses[lane].control();
+        }
+    }
+
+    uint32_t NumPartitions() const {
+        return static_cast<uint32_t>(begin_addresses_.size());
+    }
+
+    Address LogBeginAddress(uint32_t lane) const {
+        return begin_addresses_[lane];
+    }
+
+    Address FlushedUntilAddress(uint32_t lane) const {
+        return Address{flushed_[lane].load()};
+    }
+
+    Status CopyFlushedLog(uint32_t lane, Address from_address, Address until_address, uint8_t *dest) {
+        std::lock_guard<std::mutex> lock{mutex_};
+        if (failed_[lane]) {
+            return Status::IOError;
+        }
+        std::memcpy(dest, logs_[lane].data() + LogBytesBetween(begin_addresses_[lane], from_address),
+                    LogBytesBetween(from_address, until_address));
+        return Status::Ok;
+    }
+
+    /// Appends "length" bytes to log "lane", and flushes them.
+    void Append(uint32_t lane, uint32_t length) {
+        std::lock_guard<std::mutex> lock{mutex_};
+        for (uint32_t idx = 0; idx < length; ++idx) {
+            logs_[lane].push_back(static_cast<uint8_t>(logs_[lane].size() * 7 + lane));
+        }
+        flushed_[lane] = LogAddressAfter(begin_addresses_[lane], logs_[lane].size()).control();
+    }
+
+    /// Makes reads of log "lane" fail, as if its file could no longer be read.
+    void FailReads(uint32_t lane) {
+        std::lock_guard<std::mutex> lock{mutex_};
+        failed_[lane] = true;
+    }
+
+    std::vector<uint8_t> Log(uint32_t lane) {
+        std::lock_guard<std::mutex> lock{mutex_};
+        return logs_[lane];
+    }
+
+private:
+    std::vector<Address> begin_addresses_;
+    std::mutex mutex_;
+    std::vector<std::vector<uint8_t>> logs_;
+    std::vector<bool> failed_;
+    std::vector<std::atomic<uint64_t>> flushed_;
+};
+
+typedef LogShipper<MockStore> shipper_t;
+
+/// Log 0 starts just past the null page; log 1 right before a page boundary, so that its log
+/// spans two pages.
+static std::vector<Address> BeginAddresses() {
+    return {Address{0, 64, 0}, Address{0, static_cast<uint32_t>(kPageSize - 1000), 1}};
+}
+
+template<class F>
+static bool WaitFor(F condition) {
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds{10};
+    while (!condition()) {
+        if (std::chrono::steady_clock::now() > deadline) {
+            return false;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds{1});
+    }
+    return true;
+}
+
+static void ResetFollowerDirectory() {
+    std::experimental::filesystem::remove_all(kFollowerPath);
+    std::experimental::filesystem::create_directories(kFollowerPath);
+}
+
+/// Whether the follower's copy of log "lane" holds "log", from "begin_address" on.
+static bool FollowerLogMatches(uint32_t lane, Address begin_address, const std::vector<uint8_t> &log) {
+    std::ifstream file{std::string{kFollowerPath} + "/" + std::to_string(lane) + "log.log0", std::ios::binary};
+    file.seekg(begin_address.page() * kPageSize + begin_address.offset());
+    std::vector<uint8_t> copy(log.size());
+    file.read(reinterpret_cast<char *>(copy.data()), copy.size());
+    return file.good() && copy == log;
+}
+
+TEST(Socket, SendReceive) {
+    for (std::string endpoint : {"127.0.0.1:0", "unix:replication_test.sock"}) {
+        Socket listener;
+        ASSERT_EQ(Status::Ok, listener.Listen(endpoint));
+        if (endpoint[0] != 'u') {
+            ASSERT_NE(0, listener.port());
+            endpoint = "127.0.0.1:" + std::to_string(listener.port());
+        }
+        ASSERT_EQ(Status::Pending, listener.Poll(0));
+
+        Socket client;
+        ASSERT_EQ(Status::Ok, client.Connect(endpoint));
+        ASSERT_EQ(Status::Ok, listener.Poll(1000));
+        Socket server;
+        ASSERT_EQ(Status::Ok, listener.Accept(server));
+
+        std::vector<uint32_t> sent(100000);
+        for (uint32_t idx = 0; idx < sent.size(); ++idx) {
+            sent[idx] = idx;
+        }
+        // (Larger than the socket buffers.)
+        std::thread sender{[&]() {
+            ASSERT_EQ(Status::Ok, client.Send(sent.data(), sent.size() * sizeof(uint32_t)));
+        }};
+        std::vector<uint32_t> received(sent.size());
+        ASSERT_EQ(Status::Ok, server.Receive(received.data(), received.size() * sizeof(uint32_t)));
+        sender.join();
+        ASSERT_EQ(sent, received);
+
+        ASSERT_EQ(Status::Pending, server.Poll(0));
+        client.Close();
+        ASSERT_EQ(Status::Ok, server.Poll(1000));
+        uint32_t value;
+        ASSERT_EQ(Status::Aborted, server.Receive(&value, sizeof(value)));
+    }
+    std::remove("replication_test.sock");
+}
+
+TEST(Replication, ShipToFollower) {
+    ResetFollowerDirectory();
+    MockStore store{BeginAddresses()};
+    store.Append(0, 5000);
+    store.Append(1, 3000);
+
+    std::atomic<uint64_t> applied_bytes{0};
+    follower_t follower{kFollowerPath, [&](uint32_t lane, Address address, const uint8_t *data, uint32_t length) {
+        applied_bytes += length;
+    }};
+    ASSERT_EQ(Status::Ok, follower.Start(kEndpoint));
+    ReplicationOptions options;
+    // Several batches, so that a few are in flight at once.
+    options.max_batch_bytes = 1000;
+    {
+        shipper_t shipper{store, options};
+        ASSERT_EQ(Status::Ok, shipper.Start(kEndpoint));
+        ASSERT_TRUE(WaitFor([&]() { return shipper.CaughtUp(); }));
+        ASSERT_EQ(8000, applied_bytes.load());
+        ReplicationStats stats = shipper.GetStats();
+        ASSERT_EQ(8000, stats.log_bytes);
+        ASSERT_GE(stats.batches, 8);
+        ASSERT_EQ(stats.batches, stats.batches_acked);
+        for (uint32_t lane = 0; lane < 2; ++lane) {
+            ASSERT_EQ(store.FlushedUntilAddress(lane), shipper.AckedUntil(lane));
+            ASSERT_EQ(store.FlushedUntilAddress(lane), follower.AppliedUntil(lane));
+            ASSERT_TRUE(FollowerLogMatches(lane, store.LogBeginAddress(lane), store.Log(lane)));
+        }
+
+        // A checkpoint marker follows the log flushed before it.
+        ReplicatedCheckpoint checkpoint;
+        ASSERT_FALSE(follower.LastCheckpoint(checkpoint));
+        store.Append(1, 2000);
+        Guid token = Guid::Create();
+        shipper.MarkCheckpoint(token, 7);
+        store.Append(0, 100);
+        ASSERT_TRUE(WaitFor([&]() { return shipper.CaughtUp(); }));
+        ASSERT_TRUE(follower.LastCheckpoint(checkpoint));
+        ASSERT_EQ(token, checkpoint.token);
+        ASSERT_EQ(7, checkpoint.version);
+        ASSERT_EQ(LogAddressAfter(BeginAddresses()[0], 5000), checkpoint.until_addresses[0]);
+        ASSERT_EQ(LogAddressAfter(BeginAddresses()[1], 5000), checkpoint.until_addresses[1]);
+        ASSERT_EQ(1, shipper.GetStats().checkpoints);
+    }
+
+    // A new connection resumes where the last one left off.
+    ASSERT_TRUE(WaitFor([&]() { return follower.status() == Status::Aborted; }));
+    store.Append(0, 40000);
+    {
+        shipper_t shipper{store, options};
+        ASSERT_EQ(Status::Ok, shipper.Start(kEndpoint));
+        ASSERT_TRUE(WaitFor([&]() { return shipper.CaughtUp(); }));
+        ASSERT_EQ(40000, shipper.GetStats().log_bytes);
+    }
+    ASSERT_EQ(50100, applied_bytes.load());
+    for (uint32_t lane = 0; lane < 2; ++lane) {
+        ASSERT_TRUE(FollowerLogMatches(lane, store.LogBeginAddress(lane), store.Log(lane)));
+    }
+    follower.Stop();
+    ASSERT_EQ(50100, follower.GetStats().log_bytes);
+    std::remove("replication_test.sock");
+}
+
+TEST(Replication, ReadError) {
+    ResetFollowerDirectory();
+    MockStore store{BeginAddresses()};
+    follower_t follower{kFollowerPath};
+    ASSERT_EQ(Status::Ok, follower.Start(kEndpoint));
+    shipper_t shipper{store};
+    ASSERT_EQ(Status::Ok, shipper.Start(kEndpoint));
+
+    // The log could not be read; shipping stops.
+    store.FailReads(1);
+    store.Append(1, 100);
+    ASSERT_TRUE(WaitFor([&]() { return shipper.status() != Status::Ok; }));
+    ASSERT_EQ(Status::IOError, shipper.status());
+    std::remove("replication_test.sock");
+}
+
+/// A 1 KB value, so that a few pages of records push the oldest ones out to disk.
+class LargeValue {
+public:
+    LargeValue()
+            : data{} {
+    }
+
+    inline static constexpr uint32_t size() {
+        return static_cast<uint32_t>(sizeof(LargeValue));
+    }
+
+    uint64_t data[128];
+};
+
+class LargeUpsertContext : public IAsyncContext {
+public:
+    typedef Key key_t;
+    typedef LargeValue value_t;
+
+    LargeUpsertContext(uint64_t key, uint64_t data)
+            : key_{key}, data_{data} {
+    }
+
+    inline const Key &key() const {
+        return key_;
+    }
+
+    inline static constexpr uint32_t value_size() {
+        return sizeof(value_t);
+    }
+
+    inline static constexpr uint32_t value_length() {
+        return sizeof(value_t);
+    }
+
+    inline void Put(LargeValue &value) {
+        value.data[0] = data_;
+        value.data[127] = data_;
+    }
+
+    inline bool PutAtomic(LargeValue &value) {
+        // Only new records are written.
+        return false;
+    }
+
+protected:
+    Status DeepCopy_Internal(IAsyncContext *&context_copy) {
+        return IAsyncContext::DeepCopy_Internal(*this, context_copy);
+    }
+
+private:
+    Key key_;
+    uint64_t data_;
+};
+
+class LargeReadContext : public IAsyncContext {
+public:
+    typedef Key key_t;
+    typedef LargeValue value_t;
+
+    LargeReadContext(uint64_t key, uint64_t expected_)
+            : key_{key}, expected{expected_} {
+    }
+
+    inline const Key &key() const {
+        return key_;
+    }
+
+    inline void Get(const LargeValue &value) {
+        ASSERT_EQ(expected, value.data[0]);
+        ASSERT_EQ(expected, value.data[127]);
+    }
+
+    inline void GetAtomic(const LargeValue &value) {
+        Get(value);
+    }
+
+protected:
+    Status DeepCopy_Internal(IAsyncContext *&context_copy) {
+        return IAsyncContext::DeepCopy_Internal(*this, context_copy);
+    }
+
+private:
+    Key key_;
+public:
+    uint64_t expected;
+};
+
+class LargeDeleteContext : public IAsyncContext {
+public:
+    typedef Key key_t;
+    typedef LargeValue value_t;
+
+    LargeDeleteContext(uint64_t key)
+            : key_{key} {
+    }
+
+    inline const Key &key() const {
+        return key_;
+    }
+
+    inline static constexpr uint32_t value_size() {
+        return sizeof(value_t);
+    }
+
+protected:
+    Status DeepCopy_Internal(IAsyncContext *&context_copy) {
+        return IAsyncContext::DeepCopy_Internal(*this, context_copy);
+    }
+
+private:
+    Key key_;
+};
+
+typedef FasterKv<Key, LargeValue, disk_t> store_t;
+
+static void Unexpected(IAsyncContext *ctxt, Status result) {
+    ASSERT_TRUE(false);
+}
+
+TEST(Replication, FasterKvFollower) {
+    // Five 32 MB pages' worth of records, in a six-page log that is 40% mutable.
+    static constexpr uint64_t kNumRecords = 163840;
+    static constexpr uint64_t kNumUpdated = 1000;
+    static constexpr uint64_t kNumDeleted = 100;
+    static const char *kPrimaryPath = "replication_test_primary";
+    static const char *kReplicaPath = "replication_test_replica";
+    ResetFollowerDirectory();
+    for (const char *path : {kPrimaryPath, kReplicaPath}) {
+        std::experimental::filesystem::remove_all(path);
+        std::experimental::filesystem::create_directories(path);
+    }
+    store_t primary{1, 1024, 201326592, kPrimaryPath, 0.4};
+    store_t replica{1, 1024, 201326592, kReplicaPath, 0.4};
+    LogReplayer<store_t> replayer{replica};
+    follower_t follower{kFollowerPath, [&](uint32_t lane, Address address, const uint8_t *data, uint32_t length) {
+        replayer.Apply(lane, address, data, length);
+    }};
+    ASSERT_EQ(Status::Ok, follower.Start(kEndpoint));
+
+    primary.StartSession();
+    for (uint64_t key = 0; key < kNumRecords; ++key) {
+        LargeUpsertContext context{key, key};
+        ASSERT_EQ(Status::Ok, primary.UpsertT(context, Unexpected, key + 1, 1));
+        if (key % 256 == 0) {
+            primary.Refresh();
+        }
+    }
+    // The follower starts out behind the primary's head: the first records have to be read back
+    // from the primary's log file.
+    ASSERT_GT(primary.thlog[0]->head_address.load().page(), 0);
+    LogShipper<store_t> shipper{primary};
+    ASSERT_EQ(Status::Ok, shipper.Start(kEndpoint));
+
+    for (uint64_t key = 0; key < kNumUpdated; ++key) {
+        LargeUpsertContext context{key, key + 1};
+        ASSERT_EQ(Status::Ok, primary.UpsertT(context, Unexpected, kNumRecords + key + 1, 1));
+    }
+    for (uint64_t key = kNumUpdated; key < kNumUpdated + kNumDeleted; ++key) {
+        LargeDeleteContext context{key};
+        ASSERT_EQ(Status::Ok, primary.Delete(context, Unexpected, 2 * kNumRecords + key + 1));
+    }
+    // Flush all of the log, so that all of it ships.
+    primary.thlog[0]->ShiftReadOnlyToTail();
+    Address tail_address = primary.thlog[0]->GetTailAddress();
+    ASSERT_TRUE(WaitFor([&]() {
+        primary.CompletePending(false);
+        return primary.FlushedUntilAddress(0) >= tail_address && shipper.CaughtUp();
+    }));
+    ASSERT_TRUE(WaitFor([&]() {
+        primary.Refresh();
+        return replayer.ReplayedUntil(0) == primary.FlushedUntilAddress(0);
+    }));
+    ASSERT_EQ(Status::Ok, shipper.status());
+    shipper.Stop();
+    primary.StopSession();
+    follower.Stop();
+    replayer.Stop();
+    ASSERT_EQ(Status::Ok, replayer.status());
+    ASSERT_EQ(kNumRecords + kNumUpdated + kNumDeleted, replayer.num_records());
+
+    // The replica has the primary's latest values (reading the oldest ones back from its own disk),
+    // and can take over as the primary.
+    replica.StartSession();
+    auto read_callback = [](IAsyncContext *ctxt, Status result) {
+        CallbackContext<LargeReadContext> context{ctxt};
+        ASSERT_EQ(Status::Ok, result);
+    };
+    for (uint64_t key = 0; key < kNumRecords; key += key < kNumUpdated + kNumDeleted ? 1 : 97) {
+        LargeReadContext context{key, key < kNumUpdated ? key + 1 : key};
+        Status result = replica.Read(context, read_callback, key + 1);
+        if (key >= kNumUpdated && key < kNumUpdated + kNumDeleted) {
+            ASSERT_EQ(Status::NotFound, result);
+        } else {
+            ASSERT_TRUE(result == Status::Ok || result == Status::Pending);
+        }
+    }
+    ASSERT_TRUE(replica.CompletePending(true));
+    LargeUpsertContext upsert_context{kNumRecords, 42};
+    ASSERT_EQ(Status::Ok, replica.UpsertT(upsert_context, Unexpected, kNumRecords + 1, 1));
+    LargeReadContext read_context{kNumRecords, 42};
+    ASSERT_EQ(Status::Ok, replica.Read(read_context, Unexpected, kNumRecords + 2));
+    replica.StopSession();
+    std::remove("replication_test.sock");
+}
+
+#ifndef _WIN32
+TEST(Replication, TwoProcesses) {
+    ResetFollowerDirectory();
+    MockStore store{BeginAddresses()};
+    store.Append(0, 20000);
+    store.Append(1, 20000);
+    Guid token = Guid::Create();
+
+    pid_t pid = ::fork();
+    ASSERT_NE(-1, pid);
+    if (pid == 0) {
+        // The follower: exits once it has the checkpoint, and its log checks out.
+        follower_t follower{kFollowerPath};
+        if (follower.Start(kEndpoint) != Status::Ok) {
+            ::_exit(1);
+        }
+        ReplicatedCheckpoint checkpoint;
+        if (!WaitFor([&]() { return follower.LastCheckpoint(checkpoint); }) || !(checkpoint.token == token)) {
+            ::_exit(2);
+        }
+        for (uint32_t lane = 0; lane < 2; ++lane) {
+            if (follower.AppliedUntil(lane) != store.FlushedUntilAddress(lane) ||
+                !FollowerLogMatches(lane, store.LogBeginAddress(lane), store.Log(lane))) {
+                ::_exit(3);
+            }
+        }
+        ::_exit(0);
+    }
+
+    // The primary.
+    shipper_t shipper{store};
+    ASSERT_TRUE(WaitFor([&]() { return shipper.Start(kEndpoint) == Status::Ok; }));
+    shipper.MarkCheckpoint(token, 1);
+    ASSERT_TRUE(WaitFor([&]() { return shipper.CaughtUp(); }));
+    int status;
+    ASSERT_EQ(pid, ::waitpid(pid, &status, 0));
+    ASSERT_TRUE(WIFEXITED(status));
+    ASSERT_EQ(0, WEXITSTATUS(status));
+    std::remove("replication_test.sock");
+}
+#endif
+
+int main(int argc, char **argv) {
+    ::testing::InitGoogleTest(&argc, argv);
+    int result = RUN_ALL_TESTS();
+    std::experimental::filesystem::remove_all(kFollowerPath);
+    std::experimental::filesystem::remove_all("replication_test_primary");
+    std::experimental::filesystem::remove_all("replication_test_replica");
+    return result;
+}
@@ -0,0 +1,127 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT license.
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <thread>
+#include <vector>
+#include "gtest/gtest.h"
+
+#include "core/session_executor.h"
+
+using namespace FASTER::core;
+
+/// Stands in for FasterKv's session interface. Operations can leave requests "pending" on the
+/// calling thread's session; CompletePending() completes them.
+class FakeStore {
+public:
+    FakeStore()
+            : num_sessions{0}, num_started{0}, num_completed{0}, num_refreshes{0} {
+    }
+
+    void StartSession() {
+        ++num_sessions;
+        ++num_started;
+    }
+
+    void StopSession() {
+        while (NumPendingRequests() > 0) {
+            CompletePending(false);
+        }
+        --num_sessions;
+    }
+
+    void Refresh() {
+        ++num_refreshes;
+    }
+
+    bool CompletePending(bool wait) {
+        num_completed += pending();
+        pending() = 0;
+        return true;
+    }
+
+    uint64_t NumPendingRequests() const {
+        return pending();
+    }
+
+    Phase SessionPhase() const {
+        return Phase::REST;
+    }
+
+    void GoPending() {
+        ++pending();
+    }
+
+    static uint64_t &pending() {
+        static thread_local uint64_t pending_ = 0;
+        return pending_;
+    }
+
+    std::atomic<uint32_t> num_sessions;
+    std::atomic<uint32_t> num_started;
+    std::atomic<uint64_t> num_completed;
+    std::atomic<uint64_t> num_refreshes;
+};
+
+typedef SessionExecutor<FakeStore> executor_t;
+
+TEST(SessionExecutor, RunsEveryOperationOnce) {
+    static constexpr uint64_t kNumOps = 100000;
+    FakeStore store;
+    std::vector<std::atomic<uint8_t>> seen(kNumOps);
+    {
+        executor_t executor{store, 4, false};
+        executor.Submit([&seen](FakeStore &store, uint64_t idx) {
+            ++seen[idx];
+            if (idx % 3 == 0) {
+                store.GoPending();
+            }
+        }, 0, kNumOps, 100);
+        executor.Wait();
+
+        for (uint64_t idx = 0; idx < kNumOps; ++idx) {
+            ASSERT_EQ(1, seen[idx].load());
+        }
+        // Everything that went pending was completed before Wait() returned.
+        ASSERT_EQ((kNumOps + 2) / 3, store.num_completed.load());
+        ASSERT_EQ(4, store.num_sessions.load());
+        ASSERT_GT(store.num_refreshes.load(), 0);
+    }
+    ASSERT_EQ(0, store.num_sessions.load());
+    ASSERT_EQ(4, store.num_started.load());
+}
+
+TEST(SessionExecutor, StealsFromBusyWorkers) {
+    static constexpr uint64_t kNumBatches = 16;
+    FakeStore store;
+    executor_t executor{store, 4, false};
+    // All the slow work is queued before the workers can spread it, on the same worker (batches
+    // are dealt round-robin, so every 4th batch); the others must steal it for Wait() to return
+    // quickly.
+    std::atomic<uint64_t> num_done{0};
+    std::vector<std::thread::id> ran_on(kNumBatches);
+    executor.Submit([&](FakeStore &store, uint64_t idx) {
+        if (idx % 4 == 0) {
+            std::this_thread::sleep_for(std::chrono::milliseconds{20});
+        }
+        ran_on[idx] = std::this_thread::get_id();
+        ++num_done;
+    }, 0, kNumBatches, 1);
+    executor.Wait();
+    ASSERT_EQ(kNumBatches, num_done.load());
+
+    std::vector<std::thread::id> slow_threads;
+    for (uint64_t idx = 0; idx < kNumBatches; idx += 4) {
+        if (std::find(slow_threads.begin(), slow_threads.end(), ran_on[idx]) == slow_threads.end()) {
+            slow_threads.push_back(ran_on[idx]);
+        }
+    }
+    ASSERT_GT(slow_threads.size(), 1);
+}
+
+int main(int argc, char **argv) {
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
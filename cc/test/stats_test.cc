@@ -0,0 +1,108 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT license.
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "gtest/gtest.h"
+
+#include "core/faster.h"
+#include "core/stats.h"
+#include "device/null_disk.h"
+
+#include "test_types.h"
+
+using namespace FASTER::core;
+using FASTER::test::Key;
+using FASTER::test::ReadContext;
+using FASTER::test::UpsertContext;
+using FASTER::test::Value;
+
+// (This test is built with FASTER_STATS.)
+static_assert(Stats::kEnabled, "Stats::kEnabled");
+
+typedef FasterKv<Key, Value, FASTER::device::NullDisk> store_t;
+
+static void Unexpected(IAsyncContext *ctxt, Status result) {
+    ASSERT_TRUE(false);
+}
+
+
+TEST(Stats, CountsPerThread) {
+    StatsSnapshot before = Stats::Snapshot();
+    std::vector<std::thread> threads;
+    for (uint32_t thread = 0; thread < 4; ++thread) {
+        threads.emplace_back([]() {
+            for (uint32_t idx = 0; idx < 1000; ++idx) {
+                Stats::Increment(StatCounter::NewPageStalls);
+            }
+            Stats::Increment(StatCounter::PendingIoThrottles);
+        });
+    }
+    for (auto &thread : threads) {
+        thread.join();
+    }
+    StatsSnapshot delta = Stats::Snapshot() - before;
+    ASSERT_EQ(4000, delta[StatCounter::NewPageStalls]);
+    ASSERT_EQ(4, delta[StatCounter::PendingIoThrottles]);
+
+    std::ostringstream text;
+    delta.WriteText(text);
+    ASSERT_NE(std::string::npos, text.str().find("new_page_stalls 4000\n"));
+    std::ostringstream json;
+    delta.WriteJson(json);
+    ASSERT_NE(std::string::npos, json.str().find("\"pending_io_throttles\": 4"));
+    ASSERT_EQ('{', json.str().front());
+    ASSERT_EQ('}', json.str().back());
+}
+
+TEST(Stats, Exporter) {
+    std::mutex mutex;
+    std::vector<std::string> exports;
+    {
+        StatsExporter exporter{std::chrono::milliseconds{10}, StatsFormat::Json, [&](const std::string &text) {
+            std::lock_guard<std::mutex> lock{mutex};
+            exports.push_back(text);
+        }};
+        Stats::Increment(StatCounter::CprShiftRetries);
+        std::this_thread::sleep_for(std::chrono::milliseconds{100});
+    }
+    ASSERT_GE(exports.size(), 2);
+    ASSERT_EQ(0, exports[0].find("{\"elapsed_s\": "));
+    ASSERT_NE(std::string::npos, exports[0].find("\"cpr_shift_retries\": 1"));
+    // Each export covers the events since the previous one.
+    ASSERT_NE(std::string::npos, exports.back().find("\"cpr_shift_retries\": 0"));
+}
+
+TEST(Stats, Store) {
+    store_t store{1, 64, 1073741824, ""};
+    store.StartSession();
+    StatsSnapshot before = Stats::Snapshot();
+    // 64 buckets of 7 entries can't hold 2000 keys (with distinct tags) without overflow buckets.
+    for (uint64_t key = 0; key < 2000; ++key) {
+        UpsertContext context{key, key};
+        ASSERT_EQ(Status::Ok, store.UpsertT(context, Unexpected, 1, 1));
+    }
+    // A different expiry has to be published through the bucket entry, so it takes RCU.
+    for (uint64_t key = 0; key < 100; ++key) {
+        UpsertContext context{key, key + 1};
+        ASSERT_EQ(Status::Ok, store.UpsertT(context, Unexpected, 1, 1, 3600));
+    }
+    store.StopSession();
+    StatsSnapshot delta = Stats::Snapshot() - before;
+    ASSERT_GT(delta[StatCounter::IndexOverflowBuckets], 0);
+    ASSERT_EQ(100, delta[StatCounter::RcuFallbacks]);
+    ASSERT_EQ(0, delta[StatCounter::RecordInstallRetries]);
+    ASSERT_EQ(0, delta[StatCounter::PendingIosIssued]);
+}
+
+int main(int argc, char **argv) {
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -4,8 +4,15 @@
 #pragma once
 
 #include <atomic>
+#include <cstdint>
+#include <cstring>
 #include <functional>
 
+#include "core/async.h"
+#include "core/key_hash.h"
+#include "core/status.h"
+#include "core/utility.h"
+
 namespace FASTER {
 namespace test {
 
@@ -59,5 +66,157 @@ public:
     };
 };
 
+/// An 8-byte key, which the hash table can keep a copy of (see AtomicHashBucketEntry::GetKey()).
+class Key {
+public:
+    Key(uint64_t key)
+            : key_{key} {
+    }
+
+    inline static constexpr uint32_t size() {
+        return static_cast<uint32_t>(sizeof(Key));
+    }
+
+    inline uint32_t length() const {
+        return static_cast<uint32_t>(sizeof(key_));
+    }
+
+    inline core::KeyHash GetHash() const {
+        return core::KeyHash{core::Utility::GetHashCode(key_)};
+    }
+
+    inline void Copy(uint8_t *buffer) const {
+        std::memcpy(buffer, &key_, sizeof(key_));
+    }
+
+    inline bool operator==(const Key &other) const {
+        return key_ == other.key_;
+    }
+
+    inline bool operator==(const uint8_t *other) const {
+        return std::memcmp(&key_, other, sizeof(key_)) == 0;
+    }
+
+    inline bool operator!=(const Key &other) const {
+        return key_ != other.key_;
+    }
+
+private:
+    uint64_t key_;
+};
+
+/// An 8-byte value, updated in place with atomic stores.
+class Value {
+public:
+    Value()
+            : data{0} {
+    }
+
+    inline static constexpr uint32_t size() {
+        return static_cast<uint32_t>(sizeof(Value));
+    }
+
+    std::atomic<uint64_t> data;
+};
+
+/// Upserts for FasterKv<Key, Value, ...>::UpsertT() and UpsertBatch().
+class UpsertContext : public core::IAsyncContext {
+public:
+    typedef Key key_t;
+    typedef Value value_t;
+
+    UpsertContext(uint64_t key, uint64_t value)
+            : key_{key}, value_{value} {
+    }
+
+    inline const Key &key() const {
+        return key_;
+    }
+
+    inline static constexpr uint32_t value_size() {
+        return sizeof(value_t);
+    }
+
+    inline static constexpr uint32_t value_length() {
+        return sizeof(uint64_t);
+    }
+
+    inline void Put(Value &value) {
+        value.data.store(value_);
+    }
+
+    inline bool PutAtomic(Value &value) {
+        value.data.store(value_);
+        return true;
+    }
+
+protected:
+    core::Status DeepCopy_Internal(core::IAsyncContext *&context_copy) {
+        return core::IAsyncContext::DeepCopy_Internal(*this, context_copy);
+    }
+
+private:
+    Key key_;
+    uint64_t value_;
+};
+
+class ReadContext : public core::IAsyncContext {
+public:
+    typedef Key key_t;
+    typedef Value value_t;
+
+    ReadContext(uint64_t key)
+            : key_{key}, value{0} {
+    }
+
+    inline const Key &key() const {
+        return key_;
+    }
+
+    inline void Get(const Value &value) {
+        this->value = value.data.load();
+    }
+
+    inline void GetAtomic(const Value &value) {
+        this->value = value.data.load();
+    }
+
+protected:
+    core::Status DeepCopy_Internal(core::IAsyncContext *&context_copy) {
+        return core::IAsyncContext::DeepCopy_Internal(*this, context_copy);
+    }
+
+private:
+    Key key_;
+public:
+    uint64_t value;
+};
+
+class DeleteContext : public core::IAsyncContext {
+public:
+    typedef Key key_t;
+    typedef Value value_t;
+
+    DeleteContext(uint64_t key)
+            : key_{key} {
+    }
+
+    inline const Key &key() const {
+        return key_;
+    }
+
+    inline static constexpr uint32_t value_size() {
+        return sizeof(value_t);
+    }
+
+protected:
+    core::Status DeepCopy_Internal(core::IAsyncContext *&context_copy) {
+        return core::IAsyncContext::DeepCopy_Internal(*this, context_copy);
+    }
+
+private:
+    Key key_;
+};
+
 }
 } // namespace FASTER::test
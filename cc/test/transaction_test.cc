@@ -0,0 +1,183 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT license.
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <random>
+#include <thread>
+#include <vector>
+#include "gtest/gtest.h"
+
+#include "core/faster.h"
+#include "device/null_disk.h"
+
+#include "test_types.h"
+
+using namespace FASTER::core;
+using FASTER::test::Key;
+using FASTER::test::ReadContext;
+using FASTER::test::UpsertContext;
+using FASTER::test::Value;
+
+/// Moves "amount" from one account to another. (An account's balance is its value, in two's
+/// complement.)
+class TransferContext {
+public:
+    typedef Key key_t;
+    typedef Value value_t;
+
+    TransferContext(uint64_t from, uint64_t to, int64_t amount)
+            : keys_{Key{from}, Key{to}}, balances_{0, 0}, amount_{amount} {
+    }
+
+    inline uint32_t num_keys() const {
+        return 2;
+    }
+
+    inline const Key &key(uint32_t idx) const {
+        return keys_[idx];
+    }
+
+    inline void Get(uint32_t idx, const Value &value) {
+        balances_[idx] = static_cast<int64_t>(value.data.load());
+    }
+
+    inline bool PutAtomic(uint32_t idx, Value &value) {
+        value.data.store(static_cast<uint64_t>(new_balance(idx)));
+        return true;
+    }
+
+    inline void Put(uint32_t idx, Value &value) {
+        value.data.store(static_cast<uint64_t>(new_balance(idx)));
+    }
+
+    inline static constexpr uint32_t value_size(uint32_t idx) {
+        return sizeof(value_t);
+    }
+
+    inline static constexpr uint32_t value_length(uint32_t idx) {
+        return sizeof(int64_t);
+    }
+
+private:
+    inline int64_t new_balance(uint32_t idx) const {
+        return idx == 0 ? balances_[0] - amount_ : balances_[1] + amount_;
+    }
+
+    Key keys_[2];
+    int64_t balances_[2];
+    int64_t amount_;
+};
+
+typedef FasterKv<Key, Value, FASTER::device::NullDisk> store_t;
+
+static constexpr uint64_t kNumAccounts = 4;
+static constexpr int64_t kInitialBalance = 1000;
+
+/// The store keeps its logs in static storage, so the tests share one instance.
+static store_t &Store() {
+    static store_t store{4, 1024, 1073741824, ""};
+    return store;
+}
+
+static int64_t ReadBalance(uint64_t account) {
+    ReadContext context{account};
+    Status result = Store().Read(context, [](IAsyncContext *ctxt, Status result) {
+        ASSERT_TRUE(false);
+    }, 1);
+    EXPECT_EQ(Status::Ok, result);
+    return static_cast<int64_t>(context.value);
+}
+
+TEST(MultiKeyTransaction, ConcurrentTransfers) {
+    static constexpr uint32_t kNumThreads = 4;
+    static constexpr uint32_t kTransfersPerThread = 50000;
+    store_t &store = Store();
+
+    store.StartSession();
+    for (uint64_t account = 0; account < kNumAccounts; ++account) {
+        UpsertContext context{account, kInitialBalance};
+        ASSERT_EQ(Status::Ok, store.UpsertT(context, [](IAsyncContext *ctxt, Status result) {
+            ASSERT_TRUE(false);
+        }, 1, 1));
+    }
+    store.StopSession();
+
+    std::vector<std::thread> threads;
+    for (uint32_t thread_idx = 0; thread_idx < kNumThreads; ++thread_idx) {
+        threads.emplace_back([&store, thread_idx]() {
+            std::mt19937_64 rng{thread_idx};
+            store.StartSession();
+            for (uint32_t idx = 0; idx < kTransfersPerThread; ++idx) {
+                uint64_t from = rng() % kNumAccounts;
+                uint64_t to = (from + 1 + rng() % (kNumAccounts - 1)) % kNumAccounts;
+                TransferContext context{from, to, static_cast<int64_t>(rng() % 10)};
+                Status result;
+                while ((result = store.MultiKeyTransaction(context, idx)) == Status::Aborted) {
+                    store.Refresh();
+                }
+                ASSERT_EQ(Status::Ok, result);
+                if (idx % 256 == 0) {
+                    store.Refresh();
+                }
+            }
+            store.StopSession();
+        });
+    }
+    for (auto &thread : threads) {
+        thread.join();
+    }
+
+    store.StartSession();
+    int64_t total = 0;
+    for (uint64_t account = 0; account < kNumAccounts; ++account) {
+        total += ReadBalance(account);
+    }
+    store.StopSession();
+    // Money was neither created nor destroyed.
+    ASSERT_EQ(static_cast<int64_t>(kNumAccounts) * kInitialBalance, total);
+}
+
+TEST(MultiKeyTransaction, MissingKey) {
+    store_t &store = Store();
+    store.StartSession();
+    UpsertContext upsert_context{100, 5};
+    ASSERT_EQ(Status::Ok, store.UpsertT(upsert_context, [](IAsyncContext *ctxt, Status result) {
+        ASSERT_TRUE(false);
+    }, 1, 1));
+
+    // Nothing is updated if any key is missing.
+    TransferContext context{100, 101, 5};
+    ASSERT_EQ(Status::NotFound, store.MultiKeyTransaction(context, 2));
+    ASSERT_EQ(5, ReadBalance(100));
+
+    UpsertContext second_context{101, 0};
+    ASSERT_EQ(Status::Ok, store.UpsertT(second_context, [](IAsyncContext *ctxt, Status result) {
+        ASSERT_TRUE(false);
+    }, 3, 1));
+    ASSERT_EQ(Status::Ok, store.MultiKeyTransaction(context, 4));
+    ASSERT_EQ(0, ReadBalance(100));
+    ASSERT_EQ(5, ReadBalance(101));
+    store.StopSession();
+}
+
+TEST(MultiKeyTransaction, DuplicateKey) {
+    store_t &store = Store();
+    store.StartSession();
+    UpsertContext upsert_context{200, 7};
+    ASSERT_EQ(Status::Ok, store.UpsertT(upsert_context, [](IAsyncContext *ctxt, Status result) {
+        ASSERT_TRUE(false);
+    }, 1, 1));
+
+    // Rejected before any lock is taken (locking the key twice would spin).
+    TransferContext context{200, 200, 3};
+    ASSERT_EQ(Status::Aborted, store.MultiKeyTransaction(context, 2));
+    ASSERT_EQ(7, ReadBalance(200));
+    store.StopSession();
+}
+
+int main(int argc, char **argv) {
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,136 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT license.
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <thread>
+#include "gtest/gtest.h"
+
+#include "core/faster.h"
+#include "device/null_disk.h"
+
+#include "test_types.h"
+
+using namespace FASTER::core;
+using FASTER::test::DeleteContext;
+using FASTER::test::Key;
+using FASTER::test::ReadContext;
+using FASTER::test::UpsertContext;
+using FASTER::test::Value;
+
+typedef FasterKv<Key, Value, FASTER::device::NullDisk> store_t;
+
+/// The store keeps its logs in static storage, so the tests share one instance.
+static store_t &Store() {
+    static store_t store{2, 1024, 1073741824, ""};
+    return store;
+}
+
+static void Upsert(uint64_t key, uint64_t data, uint32_t ttl_seconds) {
+    UpsertContext context{key, data};
+    Status result = Store().UpsertT(context, [](IAsyncContext *ctxt, Status result) {
+        ASSERT_TRUE(false);
+    }, 1, 1, ttl_seconds);
+    ASSERT_EQ(Status::Ok, result);
+}
+
+static Status Read(uint64_t key) {
+    ReadContext context{key};
+    return Store().Read(context, [](IAsyncContext *ctxt, Status result) {
+        ASSERT_TRUE(false);
+    }, 1);
+}
+
+/// Waits until records upserted now with a 1-second TTL have expired.
+static void WaitForExpiry() {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1100));
+}
+
+TEST(Ttl, ExpiredReadIsNotFound) {
+    store_t &store = Store();
+    store.StartSession();
+    Upsert(1, 10, 1);
+    Upsert(2, 20, 0);
+    ASSERT_EQ(Status::Ok, Read(1));
+
+    WaitForExpiry();
+    ASSERT_EQ(Status::NotFound, Read(1));
+    ASSERT_EQ(Status::Ok, Read(2));
+
+    // Upserting the key again brings it back.
+    Upsert(1, 11, 0);
+    ASSERT_EQ(Status::Ok, Read(1));
+    store.StopSession();
+}
+
+TEST(Ttl, DeleteExpired) {
+    store_t &store = Store();
+    store.StartSession();
+    Upsert(3, 30, 1);
+    WaitForExpiry();
+
+    // There is nothing left to delete.
+    DeleteContext context{3};
+    Status result = store.Delete(context, [](IAsyncContext *ctxt, Status result) {
+        ASSERT_TRUE(false);
+    }, 1);
+    ASSERT_EQ(Status::NotFound, result);
+    ASSERT_EQ(Status::NotFound, Read(3));
+    store.StopSession();
+}
+
+TEST(Ttl, RefreshSweepsExpiredEntries) {
+    static constexpr uint64_t kFirstKey = 1000;
+    static constexpr uint64_t kNumRecords = 100;
+    store_t &store = Store();
+    store.StartSession();
+    for (uint64_t key = kFirstKey; key < kFirstKey + kNumRecords; ++key) {
+        Upsert(key, key, 1);
+    }
+    WaitForExpiry();
+
+    // Every 64th Refresh() sweeps one chunk; with two 512-bucket tables, two sweeps cover the
+    // index.
+    for (uint32_t idx = 0; idx < 2 * 64; ++idx) {
+        store.Refresh();
+    }
+    // Nothing expired is left for an explicit sweep to clear.
+    ASSERT_EQ(0, store.SweepExpiredEntries() + store.SweepExpiredEntries());
+    for (uint64_t key = kFirstKey; key < kFirstKey + kNumRecords; ++key) {
+        ASSERT_EQ(Status::NotFound, Read(key));
+    }
+    store.StopSession();
+}
+
+TEST(Ttl, OwnerSweepsOnlyItsPartition) {
+    static constexpr uint64_t kFirstKey = 2000;
+    static constexpr uint64_t kNumRecords = 100;
+    store_t &store = Store();
+    store.StartSession();
+    // Start from an index with nothing expired in it.
+    while (store.SweepExpiredEntries() + store.SweepExpiredEntries() > 0) {
+    }
+    uint64_t num_owned = 0;
+    for (uint64_t key = kFirstKey; key < kFirstKey + kNumRecords; ++key) {
+        Upsert(key, key, 1);
+        num_owned += store.Partition(Key{key}) == 0;
+    }
+    ASSERT_GT(num_owned, 0);
+    ASSERT_LT(num_owned, kNumRecords);
+    WaitForExpiry();
+
+    // One 512-bucket table is one chunk; the owner of partition 0 never sweeps partition 1's.
+    store.OwnPartition(0);
+    ASSERT_EQ(num_owned, store.SweepExpiredEntries() + store.SweepExpiredEntries());
+    store.StopSession();
+
+    store.StartSession();
+    ASSERT_EQ(kNumRecords - num_owned, store.SweepExpiredEntries() + store.SweepExpiredEntries());
+    store.StopSession();
+}
+
+int main(int argc, char **argv) {
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
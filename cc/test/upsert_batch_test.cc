@@ -0,0 +1,107 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT license.
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+#include "gtest/gtest.h"
+
+#include "core/faster.h"
+#include "device/null_disk.h"
+
+#include "test_types.h"
+
+using namespace FASTER::core;
+using FASTER::test::Key;
+using FASTER::test::ReadContext;
+using FASTER::test::UpsertContext;
+using FASTER::test::Value;
+
+typedef FasterKv<Key, Value, FASTER::device::NullDisk> store_t;
+
+/// The store keeps its logs in static storage, so the tests share one instance.
+static store_t &Store() {
+    static store_t store{4, 1024, 1073741824, ""};
+    return store;
+}
+
+static void Unexpected(IAsyncContext *ctxt, Status result) {
+    ASSERT_TRUE(false);
+}
+
+static uint64_t ReadValue(uint64_t key) {
+    ReadContext context{key};
+    EXPECT_EQ(Status::Ok, Store().Read(context, Unexpected, 1));
+    return context.value;
+}
+
+TEST(UpsertBatch, InsertAndOverwrite) {
+    static constexpr uint64_t kNumKeys = 20000;
+    store_t &store = Store();
+    store.StartSession();
+
+    std::vector<UpsertContext> inserts;
+    for (uint64_t key = 0; key < kNumKeys; ++key) {
+        inserts.emplace_back(key, key * 2);
+    }
+    ASSERT_EQ(Status::Ok, store.UpsertBatch(inserts.data(), kNumKeys, Unexpected, 1));
+    for (uint64_t key = 0; key < kNumKeys; ++key) {
+        ASSERT_EQ(key * 2, ReadValue(key));
+    }
+
+    // Overwrite every other key; a key that appears twice in a batch takes its last value.
+    std::vector<UpsertContext> updates;
+    for (uint64_t key = 0; key < kNumKeys; key += 2) {
+        updates.emplace_back(key, key + 1);
+    }
+    updates.emplace_back(0, 42);
+    ASSERT_EQ(Status::Ok, store.UpsertBatch(updates.data(), updates.size(), Unexpected, 2));
+    ASSERT_EQ(42, ReadValue(0));
+    for (uint64_t key = 1; key < kNumKeys; ++key) {
+        ASSERT_EQ(key % 2 == 0 ? key + 1 : key * 2, ReadValue(key));
+    }
+    store.StopSession();
+}
+
+TEST(UpsertBatch, AcrossCheckpoint) {
+    static constexpr uint64_t kBatchSize = 64;
+    static std::atomic<uint64_t> completed{0};
+    auto callback = [](IAsyncContext *ctxt, Status result) {
+        ASSERT_EQ(Status::Ok, result);
+        ++completed;
+    };
+    store_t &store = Store();
+    store.StartSession();
+
+    // While the checkpoint runs, UpsertBatch() hands its keys to UpsertT(), which may retry them
+    // later; every batch has to land either way.
+    Guid token;
+    ASSERT_TRUE(store.Checkpoint(nullptr, nullptr, token));
+    uint64_t next_key = 100000;
+    uint64_t num_pending = 0;
+    uint64_t serial_num = 1;
+    do {
+        std::vector<UpsertContext> batch;
+        for (uint64_t key = next_key; key < next_key + kBatchSize; ++key) {
+            batch.emplace_back(key, key * 3);
+        }
+        Status result = store.UpsertBatch(batch.data(), kBatchSize, callback, ++serial_num);
+        ASSERT_TRUE(result == Status::Ok || result == Status::Pending);
+        num_pending += result == Status::Pending;
+        next_key += kBatchSize;
+        store.CompletePending(false);
+    } while (!store.CheckpointCheck());
+    ASSERT_TRUE(store.CompletePending(true));
+    ASSERT_TRUE(num_pending == 0 || completed > 0);
+
+    for (uint64_t key = 100000; key < next_key; ++key) {
+        ASSERT_EQ(key * 3, ReadValue(key));
+    }
+    store.StopSession();
+}
+
+int main(int argc, char **argv) {
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}